@@ -0,0 +1,107 @@
+/**********************************************************************************************
+* Explicit MPC runtime
+* (see MPC.h, the trees are generated by tools/mpc_gen)
+************************************************************************************************/
+
+//Standard libraries
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "PID.h"
+#include "MPC.h"
+
+/* Constructor (...)*********************************************************
+ *    starts in MANUAL with the output limits of the tree
+ ***************************************************************************/
+void MPC_constructor(MPC_t* p_MPC, double* Input, double* Output, double* Setpoint,
+        const MPC_Tree_t* Tree, unsigned long SampleTime){
+    p_MPC->tree = Tree;
+    p_MPC->myInput = Input;
+    p_MPC->myOutput = Output;
+    p_MPC->mySetpoint = Setpoint;
+    p_MPC->inAuto = false;
+    p_MPC->badLookups = 0;
+    p_MPC->outMin = Tree->uMin;
+    p_MPC->outMax = Tree->uMax;
+    p_MPC->SampleTime = SampleTime > 0 ? SampleTime : 1;
+    p_MPC->lastTime = millis() - p_MPC->SampleTime;
+}
+
+/* Evaluate(...) ************************************************************
+ *    walks at most Tree->depth levels, so a corrupted tree can't loop. a
+ *    walk that hits that cap without reaching a leaf returns false and
+ *    leaves *u alone
+ ***************************************************************************/
+bool MPC_Evaluate(const MPC_Tree_t* Tree, const double* theta, double* u){
+    const MPC_Node_t* node = &Tree->nodes[0];
+    for(int d = 0; d < Tree->depth && node->dim >= 0; d++){
+        node = &Tree->nodes[theta[node->dim] <= node->threshold ? node->left : node->right];
+    }
+    if(node->dim >= 0) return false;
+
+    const int np = Tree->nStates + 1;
+    const float* law = &Tree->laws[node->left * (np + 1)];
+    double out = law[np];
+    for(int i = 0; i < np; i++) out += law[i] * theta[i];
+    *u = out;
+    return true;
+}
+
+/* Compute() ****************************************************************
+ *    same timing rule as PID_Compute(): does nothing until SampleTime has
+ *    passed since the last update. a failed lookup keeps the previous
+ *    output, counts in badLookups and returns false
+ ***************************************************************************/
+bool MPC_Compute(MPC_t* p_MPC){
+    if(!(p_MPC->inAuto)) return false;
+    unsigned long now = millis();
+    if(now - p_MPC->lastTime < p_MPC->SampleTime) return false;
+
+    double theta[MPC_MAX_STATES + 1];
+    const int n = p_MPC->tree->nStates;
+    for(int i = 0; i < n; i++) theta[i] = p_MPC->myInput[i];
+    theta[n] = *(p_MPC->mySetpoint);
+
+    double output;
+    if(!MPC_Evaluate(p_MPC->tree, theta, &output)){
+        p_MPC->badLookups++;
+        p_MPC->lastTime = now;
+        return false;
+    }
+    if(output > p_MPC->outMax) output = p_MPC->outMax;
+    else if(output < p_MPC->outMin) output = p_MPC->outMin;
+    *(p_MPC->myOutput) = output;
+
+    p_MPC->lastTime = now;
+    return true;
+}
+
+/* SetOutputLimits(...)******************************************************
+ *    the affine laws only respect the tree's input bounds inside the regions
+ *    they were solved for, a state outside them can ask for far more. so the
+ *    limits are intersected with the bounds; limits that leave nothing of
+ *    them are ignored
+ ***************************************************************************/
+void MPC_SetOutputLimits(MPC_t* p_MPC, double Min, double Max){
+    if(Min < p_MPC->tree->uMin) Min = p_MPC->tree->uMin;
+    if(Max > p_MPC->tree->uMax) Max = p_MPC->tree->uMax;
+    if(Min >= Max) return;
+    p_MPC->outMin = Min;
+    p_MPC->outMax = Max;
+
+    if(p_MPC->inAuto)
+    {
+        if(*(p_MPC->myOutput) > p_MPC->outMax) *(p_MPC->myOutput) = p_MPC->outMax;
+        else if(*(p_MPC->myOutput) < p_MPC->outMin) *(p_MPC->myOutput) = p_MPC->outMin;
+    }
+}
+
+/* SetMode(...)**************************************************************
+ *    the explicit law has no internal state, so going to AUTOMATIC only
+ *    restarts the sample timer
+ ***************************************************************************/
+void MPC_SetMode(MPC_t* p_MPC, int Mode){
+    bool newAuto = (Mode == AUTOMATIC);
+    if(newAuto && !(p_MPC->inAuto)) p_MPC->lastTime = millis() - p_MPC->SampleTime;
+    p_MPC->inAuto = newAuto;
+}
@@ -0,0 +1,75 @@
+#ifndef MPC_h
+#define MPC_h
+
+#include <stdbool.h>
+
+/**********************************************************************************************
+* Explicit MPC, used next to the PID library where hard input/state constraints matter
+*
+* The constrained optimal control law of a small linear model is piecewise affine in the
+* parameter vector  theta = [x(0) .. x(n-1), setpoint].  tools/mpc_gen solves the MPC problem
+* offline and emits the law as a binary tree of axis-aligned splits whose leaves hold one
+* affine law each, so on the ESP32 a step is at most 'depth' comparisons plus one dot product.
+* The controller has the same lifecycle as PID_t (constructor / SetMode / Compute /
+* SetOutputLimits) and links to the caller's variables the same way.
+************************************************************************************************/
+
+#define MPC_MAX_STATES 5
+
+typedef struct{
+
+  float threshold;              // * internal node: go left if theta[dim] <= threshold
+  signed char dim;              //   -1 marks a leaf
+  unsigned short left;          // * left child, or the law index for a leaf
+  unsigned short right;         // * right child
+
+}MPC_Node_t;
+
+typedef struct{
+
+  int nStates;                  // * n, theta has n+1 entries (states, then setpoint)
+  int nNodes, nLaws;
+  int depth;                    // * longest root to leaf path, bounds the lookup loop
+  const MPC_Node_t* nodes;      // * nodes[0] is the root
+  const float* laws;            // * nLaws rows of n+2 values: u = F.theta + g, g last
+  double uMin, uMax;            // * input bounds the law was computed with
+
+}MPC_Tree_t;
+
+typedef struct{
+
+  const MPC_Tree_t* tree;
+
+  double *myInput;              // * state vector (tree->nStates entries), Output and Setpoint,
+  double *myOutput;             //   linked like in PID_t
+  double *mySetpoint;
+
+  unsigned long lastTime;
+  unsigned long SampleTime;     // * must match the sample time the tree was generated for
+  double outMin, outMax;
+  bool inAuto;
+  unsigned long badLookups;     // * Compute() calls whose lookup ran past tree->depth without
+                                //   reaching a leaf (corrupted tree), output left unchanged
+
+}MPC_t;
+
+
+void MPC_constructor(MPC_t* p_MPC, double* Input, double* Output, double* Setpoint,
+        const MPC_Tree_t* Tree, unsigned long SampleTime);
+
+void MPC_SetMode(MPC_t* p_MPC, int Mode);             // * MANUAL / AUTOMATIC as in PID.h
+
+bool MPC_Compute(MPC_t* p_MPC);                       // * evaluates the law once every SampleTime.
+                                        //   returns true when the output was updated,
+                                        //   false as well when the lookup failed
+
+void MPC_SetOutputLimits(MPC_t* p_MPC, double Min, double Max); // * extra clamp inside the
+                                        //   bounds built into the tree, e.g. a tighter
+                                        //   speed limit during withdrawal. limits are
+                                        //   intersected with the tree bounds
+
+bool MPC_Evaluate(const MPC_Tree_t* Tree, const double* theta, double* u); // * raw lookup +
+                                        //   affine law into *u. false when no leaf was
+                                        //   reached within tree->depth levels
+
+#endif
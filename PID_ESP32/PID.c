@@ -18,21 +18,28 @@
 //Standard libraries
 #include <stdio.h>
 #include <stdbool.h>
+#ifdef ESP_PLATFORM
 //ESP libraries
 #include "driver/gpio.h"
 #include "driver/i2c.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "sdkconfig.h" // generated by "make menuconfig"
+#endif
 
-#include "PID_v1.h"
+#include "PID.h"
 
+#ifdef ESP_PLATFORM
 // function millis() adapted for freertos
 //returns the amount of ms since the scheduler started
 unsigned long millis(){
   return portTICK_PERIOD_MS*xTaskGetTickCount();
 }
+#endif
+// On host builds (see tools/) millis() is supplied by the program linking
+// this file, usually as a simulated clock.
 
 /*Constructor (...)*********************************************************
  *    The parameters specified here are those for for which we can't set up
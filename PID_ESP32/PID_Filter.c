@@ -0,0 +1,175 @@
+/**********************************************************************************************
+* Input conditioning for the PID library
+* (see PID_Filter.h)
+************************************************************************************************/
+
+//Standard libraries
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "PID_Filter.h"
+
+/* Constructor (...)****************************************************************
+ *    the biquad starts disabled; Decimation < 1 and even or oversized median windows
+ *    are corrected to the nearest valid setting
+ ***********************************************************************************/
+void Filter_constructor(Filter_t* p_F, double** Outputs, int nChannels, int Decimation, int MedianSize){
+  if(nChannels > FILTER_MAX_CHANNELS) nChannels = FILTER_MAX_CHANNELS;
+  if(nChannels < 0) nChannels = 0;
+  if(Decimation < 1) Decimation = 1;
+  if(MedianSize > FILTER_MAX_MEDIAN) MedianSize = FILTER_MAX_MEDIAN;
+  if(MedianSize < 1) MedianSize = 1;
+  if(!(MedianSize & 1)) MedianSize--;
+
+  p_F->nChannels = nChannels;
+  p_F->Decimation = Decimation;
+  p_F->MedianSize = MedianSize;
+  p_F->useBiquad = false;
+  for(int c = 0; c < nChannels; c++) p_F->myOutput[c] = Outputs[c];
+  Filter_Reset(p_F);
+}
+
+void Filter_SetBiquad(Filter_t* p_F, double b0, double b1, double b2, double a1, double a2){
+  p_F->b0 = b0; p_F->b1 = b1; p_F->b2 = b2;
+  p_F->a1 = a1; p_F->a2 = a2;
+  p_F->useBiquad = true;
+  p_F->primed = false;
+}
+
+/* SetLowpass(...)*****************************************************************
+ *    RBJ cookbook low-pass with Q = 1/sqrt(2)
+ ***********************************************************************************/
+void Filter_SetLowpass(Filter_t* p_F, double CutoffHz, double SampleHz){
+  if(CutoffHz <= 0 || SampleHz <= 0 || CutoffHz >= SampleHz / 2) return;
+  double w0 = 2 * M_PI * CutoffHz / SampleHz;
+  double alpha = sin(w0) / (2 * M_SQRT1_2);
+  double cw = cos(w0);
+  double a0 = 1 + alpha;
+  Filter_SetBiquad(p_F, (1 - cw) / 2 / a0, (1 - cw) / a0, (1 - cw) / 2 / a0,
+                   -2 * cw / a0, (1 - alpha) / a0);
+}
+
+void Filter_Reset(Filter_t* p_F){
+  p_F->decimCount = 0;
+  p_F->medPos = 0;
+  p_F->medFill = 0;
+  p_F->primed = false;
+  p_F->rejected = 0;
+  memset(p_F->acc, 0, sizeof(p_F->acc));
+  memset(p_F->accCount, 0, sizeof(p_F->accCount));
+  memset(p_F->lastAvg, 0, sizeof(p_F->lastAvg));
+}
+
+/* median stage ********************************************************************
+ *    the sorted window of each channel is kept up to date by removing the value
+ *    that leaves the ring and inserting the new one; at most MedianSize moves
+ ***********************************************************************************/
+static void Filter_Median(Filter_t* p_F){
+  const int n = p_F->nChannels;
+  const int size = p_F->MedianSize;
+  const int pos = p_F->medPos;
+  const bool full = p_F->medFill == size;
+  const int fill = full ? size : p_F->medFill + 1;
+
+  for(int c = 0; c < n; c++){
+    double* w = p_F->medSorted[c];
+    double x = p_F->stage[c];
+    int len = fill;
+
+    if(full){
+      /*drop the oldest value*/
+      double old = p_F->medRing[pos][c];
+      int i = 0;
+      while(i < size - 1 && w[i] != old) i++;
+      for(; i < size - 1; i++) w[i] = w[i + 1];
+      len = size - 1;
+    }
+    else len = fill - 1;
+
+    /*insert the new one*/
+    int i = len;
+    while(i > 0 && w[i - 1] > x){ w[i] = w[i - 1]; i--; }
+    w[i] = x;
+
+    p_F->medRing[pos][c] = x;
+    p_F->stage[c] = w[fill >> 1];
+  }
+  p_F->medPos = pos + 1 == size ? 0 : pos + 1;
+  p_F->medFill = fill;
+}
+
+/* biquad stage ********************************************************************
+ *    transposed direct form II. the first sample sets the state to the steady state
+ *    for that value so the PID doesn't see a start-up transient
+ ***********************************************************************************/
+static void Filter_Biquad(Filter_t* p_F){
+  const int n = p_F->nChannels;
+  const double b0 = p_F->b0, b1 = p_F->b1, b2 = p_F->b2, a1 = p_F->a1, a2 = p_F->a2;
+  double* restrict x = p_F->stage;
+  double* restrict z1 = p_F->z1;
+  double* restrict z2 = p_F->z2;
+
+  if(!p_F->primed){
+    double g = (b0 + b1 + b2) / (1 + a1 + a2);
+    for(int c = 0; c < n; c++){
+      double y = g * x[c];
+      z1[c] = y - b0 * x[c];
+      z2[c] = b2 * x[c] - a2 * y;
+    }
+    p_F->primed = true;
+  }
+  for(int c = 0; c < n; c++){
+    double in = x[c];
+    double y = b0 * in + z1[c];
+    z1[c] = b1 * in - a1 * y + z2[c];
+    z2[c] = b2 * in - a2 * y;
+    x[c] = y;
+  }
+}
+
+/* Push(...)***********************************************************************
+ *    accumulates one frame, leaving out non-finite samples; every Decimation frames
+ *    the average of the valid ones goes through the median and biquad stages and is
+ *    written to the linked outputs
+ ***********************************************************************************/
+bool Filter_Push(Filter_t* p_F, const double* Samples){
+  const int n = p_F->nChannels;
+  double* restrict acc = p_F->acc;
+  int* restrict cnt = p_F->accCount;
+
+  int valid = 0;
+  for(int c = 0; c < n; c++){
+    int ok = isfinite(Samples[c]);      // * branchless, the loop stays vectorizable
+    acc[c] += ok ? Samples[c] : 0;
+    cnt[c] += ok;
+    valid += ok;
+  }
+  p_F->rejected += n - valid;
+  if(++p_F->decimCount < p_F->Decimation) return false;
+
+  double k = 1.0 / p_F->Decimation;
+  for(int c = 0; c < n; c++){
+    if(cnt[c] > 0) p_F->lastAvg[c] = cnt[c] == p_F->Decimation ? acc[c] * k : acc[c] / cnt[c];
+    p_F->stage[c] = p_F->lastAvg[c];
+    acc[c] = 0;
+    cnt[c] = 0;
+  }
+  p_F->decimCount = 0;
+
+  if(p_F->MedianSize > 1) Filter_Median(p_F);
+  if(p_F->useBiquad) Filter_Biquad(p_F);
+
+  for(int c = 0; c < n; c++) *(p_F->myOutput[c]) = p_F->stage[c];
+  return true;
+}
+
+int Filter_PushBlock(Filter_t* p_F, const double* Samples, int nFrames){
+  int updates = 0;
+  for(int f = 0; f < nFrames; f++){
+    if(Filter_Push(p_F, Samples)) updates++;
+    Samples += p_F->nChannels;
+  }
+  return updates;
+}
@@ -0,0 +1,61 @@
+#ifndef PID_Filter_h
+#define PID_Filter_h
+
+#include <stdbool.h>
+
+/**********************************************************************************************
+* Input conditioning for the PID library
+*
+* A filter bank cleans up to FILTER_MAX_CHANNELS sensor channels before they reach the PID
+* input variables:  oversampling (average of Decimation raw samples)
+*                -> sliding median of the last MedianSize averages (spike rejection)
+*                -> biquad IIR (normally a low-pass, keeps the derivative term quiet)
+* All channels of a bank advance together, so every stage is one loop across the channels.
+* The bank holds all its state, nothing is allocated.
+* A raw sample that is NaN or infinite (a sensor read that failed) is left out of its average;
+* a channel with no valid sample in a whole average repeats its last one, so a single bad read
+* can't break the ordering of the median window or stick in the biquad state.
+************************************************************************************************/
+
+#define FILTER_MAX_CHANNELS 64
+#define FILTER_MAX_MEDIAN 9
+
+typedef struct{
+
+  int nChannels;
+  int Decimation;               // * raw samples averaged into one filter sample
+  int MedianSize;               // * odd window length, 1 disables the median
+  bool useBiquad;
+  double b0, b1, b2, a1, a2;    // * biquad coefficients, a0 normalized to 1
+
+  double *myOutput[FILTER_MAX_CHANNELS];   // * PID input variables fed by this bank
+
+  int decimCount;
+  double acc[FILTER_MAX_CHANNELS];
+  int accCount[FILTER_MAX_CHANNELS];    // * valid samples in acc
+  double lastAvg[FILTER_MAX_CHANNELS];  // * last average, repeated when no sample was valid
+  unsigned long rejected;               // * non-finite samples left out
+  int medPos, medFill;
+  double medRing[FILTER_MAX_MEDIAN][FILTER_MAX_CHANNELS];      // * insertion order, per slot
+  double medSorted[FILTER_MAX_CHANNELS][FILTER_MAX_MEDIAN];    // * sorted window, per channel
+  bool primed;
+  double z1[FILTER_MAX_CHANNELS], z2[FILTER_MAX_CHANNELS];     // * biquad state (transposed DF II)
+  double stage[FILTER_MAX_CHANNELS];
+
+}Filter_t;
+
+
+//links nChannels outputs (usually the variables the PID_t myInput pointers point at)
+void Filter_constructor(Filter_t* p_F, double** Outputs, int nChannels, int Decimation, int MedianSize);
+
+void Filter_SetBiquad(Filter_t* p_F, double b0, double b1, double b2, double a1, double a2);
+void Filter_SetLowpass(Filter_t* p_F, double CutoffHz, double SampleHz); // * 2nd order Butterworth,
+                                        //   SampleHz is the rate after decimation
+void Filter_Reset(Filter_t* p_F);
+
+bool Filter_Push(Filter_t* p_F, const double* Samples);  // * one raw sample per channel. returns true
+                                        //   when the outputs were updated
+int Filter_PushBlock(Filter_t* p_F, const double* Samples, int nFrames); // * nFrames interleaved frames of
+                                        //   nChannels samples. returns the number of output updates
+
+#endif
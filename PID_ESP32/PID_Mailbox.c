@@ -0,0 +1,216 @@
+/**********************************************************************************************
+* Setpoint / tuning mailbox for the PID library
+* (see PID_Mailbox.h)
+************************************************************************************************/
+
+//Standard libraries
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "PID_Mailbox.h"
+
+/* post helpers ********************************************************************************
+ * a post owns the posting side while 'posting' is set; it gives up instead of spinning, a
+ * spinning writer could starve a preempted one on the same core. publishing swaps the filled
+ * back slot with the middle one
+ ***********************************************************************************************/
+static bool Mailbox_Begin(Mailbox_t* p_MB){
+  if(__atomic_test_and_set(&p_MB->posting, __ATOMIC_ACQUIRE)){
+    __atomic_fetch_add(&p_MB->busy, 1, __ATOMIC_RELAXED);
+    return false;
+  }
+  return true;
+}
+
+//stamps a group from the counter shared with the lead; only the order of the stamps matters
+static void Mailbox_Stamp(Mailbox_t* p_MB, int group){
+  p_MB->latest.gen[group] = __atomic_add_fetch(&p_MB->lead->postSeq, 1, __ATOMIC_RELAXED);
+}
+
+static void Mailbox_End(Mailbox_t* p_MB){
+  p_MB->slot[p_MB->back] = p_MB->latest;
+  p_MB->back = __atomic_exchange_n(&p_MB->middle, p_MB->back | MAILBOX_FRESH, __ATOMIC_ACQ_REL) & 3;
+  __atomic_clear(&p_MB->posting, __ATOMIC_RELEASE);
+}
+
+/* Constructor (...)****************************************************************
+ *    takes the PID's current settings so the first Service() call changes
+ *    nothing
+ ***********************************************************************************/
+void Mailbox_constructor(Mailbox_t* p_MB, PID_t* p_PID){
+  memset(p_MB, 0, sizeof(*p_MB));
+  p_MB->pid = p_PID;
+  p_MB->target = *(p_PID->mySetpoint);
+  p_MB->latest.Setpoint = p_MB->target;
+  p_MB->latest.Kp = p_PID->dispKp;
+  p_MB->latest.Ki = p_PID->dispKi;
+  p_MB->latest.Kd = p_PID->dispKd;
+  p_MB->latest.POn = p_PID->pOn;
+  p_MB->latest.outMin = p_PID->outMin;
+  p_MB->latest.outMax = p_PID->outMax;
+  p_MB->latest.Mode = p_PID->inAuto ? AUTOMATIC : MANUAL;
+  p_MB->latest.Direction = p_PID->controllerDirection;
+  p_MB->latest.SampleTime = (int)p_PID->SampleTime;
+  for(int i = 0; i < 3; i++) p_MB->slot[i] = p_MB->latest;
+  p_MB->front = 0;
+  p_MB->middle = 1;
+  p_MB->back = 2;
+  p_MB->lead = p_MB;
+  p_MB->lastTime = millis();
+}
+
+/* constructorShared (...)**********************************************************
+ *    same starting values as the lead, but the target and ramp stay the lead's
+ ***********************************************************************************/
+void Mailbox_constructorShared(Mailbox_t* p_MB, Mailbox_t* p_Lead){
+  Mailbox_constructor(p_MB, p_Lead->pid);
+  p_MB->lead = p_Lead;
+}
+
+bool Mailbox_PostSetpoint(Mailbox_t* p_MB, double Setpoint){
+  if(!Mailbox_Begin(p_MB)) return false;
+  p_MB->latest.Setpoint = Setpoint;
+  Mailbox_Stamp(p_MB, 0);
+  Mailbox_End(p_MB);
+  return true;
+}
+
+bool Mailbox_PostRamp(Mailbox_t* p_MB, double RampRate){
+  if(!Mailbox_Begin(p_MB)) return false;
+  p_MB->latest.RampRate = RampRate < 0 ? 0 : RampRate;
+  Mailbox_Stamp(p_MB, 1);
+  Mailbox_End(p_MB);
+  return true;
+}
+
+bool Mailbox_PostTunings(Mailbox_t* p_MB, double Kp, double Ki, double Kd, int POn){
+  if(!Mailbox_Begin(p_MB)) return false;
+  p_MB->latest.Kp = Kp;
+  p_MB->latest.Ki = Ki;
+  p_MB->latest.Kd = Kd;
+  p_MB->latest.POn = POn;
+  Mailbox_Stamp(p_MB, 2);
+  Mailbox_End(p_MB);
+  return true;
+}
+
+bool Mailbox_PostLimits(Mailbox_t* p_MB, double Min, double Max){
+  if(!Mailbox_Begin(p_MB)) return false;
+  p_MB->latest.outMin = Min;
+  p_MB->latest.outMax = Max;
+  Mailbox_Stamp(p_MB, 3);
+  Mailbox_End(p_MB);
+  return true;
+}
+
+bool Mailbox_PostMode(Mailbox_t* p_MB, int Mode){
+  if(!Mailbox_Begin(p_MB)) return false;
+  p_MB->latest.Mode = Mode;
+  Mailbox_Stamp(p_MB, 4);
+  Mailbox_End(p_MB);
+  return true;
+}
+
+bool Mailbox_PostDirection(Mailbox_t* p_MB, int Direction){
+  if(!Mailbox_Begin(p_MB)) return false;
+  p_MB->latest.Direction = Direction;
+  Mailbox_Stamp(p_MB, 5);
+  Mailbox_End(p_MB);
+  return true;
+}
+
+bool Mailbox_PostSampleTime(Mailbox_t* p_MB, int SampleTime){
+  if(!Mailbox_Begin(p_MB)) return false;
+  p_MB->latest.SampleTime = SampleTime;
+  Mailbox_Stamp(p_MB, 6);
+  Mailbox_End(p_MB);
+  return true;
+}
+
+bool Mailbox_PostGains(Mailbox_t* p_MB, double Kp, double Ki, double Kd, int POn,
+                       int Direction, int SampleTime){
+  if(!Mailbox_Begin(p_MB)) return false;
+  p_MB->latest.Kp = Kp;
+  p_MB->latest.Ki = Ki;
+  p_MB->latest.Kd = Kd;
+  p_MB->latest.POn = POn;
+  Mailbox_Stamp(p_MB, 2);
+  p_MB->latest.Direction = Direction;
+  Mailbox_Stamp(p_MB, 5);
+  if(SampleTime > 0){
+    p_MB->latest.SampleTime = SampleTime;
+    Mailbox_Stamp(p_MB, 6);
+  }
+  Mailbox_End(p_MB);
+  return true;
+}
+
+//later than what was applied, from this mailbox or one sharing the PID; wraps around safely
+static bool Mailbox_Newer(const Mailbox_Msg_t* m, const Mailbox_t* lead, int group){
+  return (long)(m->gen[group] - lead->appliedGen[group]) > 0;
+}
+
+/* Service() ***********************************************************************
+ *    the common case is one load of 'middle' without the fresh bit. otherwise the
+ *    front slot is exchanged for the newest one and the groups whose stamp is
+ *    newer than the one applied last are applied, direction first and mode last.
+ *    the ramp then moves *mySetpoint towards the target by RampRate times the time
+ *    since the last call; a shared mailbox only sets the lead's target and rate and
+ *    leaves the ramp to the lead's Service()
+ ***********************************************************************************/
+int Mailbox_Service(Mailbox_t* p_MB){
+  int changed = 0;
+  PID_t* pid = p_MB->pid;
+  Mailbox_t* lead = p_MB->lead;
+
+  if(__atomic_load_n(&p_MB->middle, __ATOMIC_RELAXED) & MAILBOX_FRESH){
+    p_MB->front = __atomic_exchange_n(&p_MB->middle, p_MB->front, __ATOMIC_ACQ_REL) & 3;
+    const Mailbox_Msg_t* m = &p_MB->slot[p_MB->front];
+    if(Mailbox_Newer(m, lead, 0)){ lead->target = m->Setpoint; changed |= MAILBOX_SETPOINT; }
+    if(Mailbox_Newer(m, lead, 1)){ lead->rampRate = m->RampRate; changed |= MAILBOX_RAMP; }
+    if(Mailbox_Newer(m, lead, 5)){
+      PID_SetControllerDirection(pid, m->Direction);
+      changed |= MAILBOX_DIRECTION;
+    }
+    if(Mailbox_Newer(m, lead, 6)){
+      PID_SetSampleTime(pid, m->SampleTime);
+      changed |= MAILBOX_SAMPLETIME;
+    }
+    if(Mailbox_Newer(m, lead, 2)){
+      PID_SetTunings(pid, m->Kp, m->Ki, m->Kd, m->POn);
+      changed |= MAILBOX_TUNINGS;
+    }
+    else if(changed & MAILBOX_DIRECTION){
+      //SetControllerDirection() only flips the gains in AUTOMATIC
+      PID_SetTunings(pid, pid->dispKp, pid->dispKi, pid->dispKd, pid->pOn);
+    }
+    if(Mailbox_Newer(m, lead, 3)){
+      PID_SetOutputLimits(pid, m->outMin, m->outMax);
+      changed |= MAILBOX_LIMITS;
+    }
+    if(Mailbox_Newer(m, lead, 4)){
+      PID_SetMode(pid, m->Mode);
+      changed |= MAILBOX_MODE;
+    }
+    for(int g = 0; g < MAILBOX_GROUPS; g++)
+      if(Mailbox_Newer(m, lead, g)) lead->appliedGen[g] = m->gen[g];
+    p_MB->applied++;
+  }
+
+  if(lead != p_MB) return changed;
+
+  unsigned long now = millis();
+  double sp = *(pid->mySetpoint);
+  if(sp != p_MB->target){
+    if(p_MB->rampRate <= 0) sp = p_MB->target;
+    else{
+      double step = p_MB->rampRate * (double)(now - p_MB->lastTime) / 1000;
+      if(p_MB->target > sp) sp = sp + step > p_MB->target ? p_MB->target : sp + step;
+      else sp = sp - step < p_MB->target ? p_MB->target : sp - step;
+    }
+    *(pid->mySetpoint) = sp;
+  }
+  p_MB->lastTime = now;
+  return changed;
+}
@@ -0,0 +1,108 @@
+#ifndef PID_Mailbox_h
+#define PID_Mailbox_h
+
+/**********************************************************************************************
+* Setpoint / tuning mailbox for the PID library
+*
+* Carries setpoint, ramp rate, tuning, limit and mode changes from other tasks (the network task, a
+* console) into the control task without locks.  Writers never touch the variables the PID
+* reads: a post fills a whole message in a slot of a triple buffer and publishes it with one
+* atomic exchange, and the control task calls Mailbox_Service() right before PID_Compute() to
+* swap the newest slot in and apply it.  Each side only ever touches its own slot, so the
+* control task always gets a complete message.  A double is two 32 bit stores on the ESP32,
+* so writing *mySetpoint from another task can be read half old, half new; through the
+* mailbox it can't.
+*
+* Nobody ever waits: a post that finds another post in progress returns false instead of
+* spinning (with one writer per mailbox a post always succeeds), and Service() never fails.
+* Only the latest value of each group (setpoint, ramp, tunings, ...) is kept; Service()
+* applies the groups that changed in the order direction, sample time, tunings, limits,
+* mode, so a message that switches to AUTOMATIC starts with its own gains and limits.
+*
+* Several writer tasks give each its own mailbox rather than share one: the first is built
+* with Mailbox_constructor(), the others with Mailbox_constructorShared() on it.  They feed
+* the same PID and hand their setpoints to the first one, which alone runs the ramp; the
+* control task services the shared ones first and the first one last.  Every post is stamped
+* from one counter in the first mailbox, and Service() applies a group only if its stamp is
+* newer than the one applied last, so the latest post wins across the mailboxes too, in
+* whichever order they are serviced.
+************************************************************************************************/
+
+#include "PID.h"
+
+#define MAILBOX_SETPOINT 0x01
+#define MAILBOX_RAMP     0x02
+#define MAILBOX_TUNINGS  0x04
+#define MAILBOX_LIMITS   0x08
+#define MAILBOX_MODE     0x10
+#define MAILBOX_DIRECTION 0x20
+#define MAILBOX_SAMPLETIME 0x40
+#define MAILBOX_GROUPS   7
+
+#define MAILBOX_FRESH    0x04   // * in 'middle': published and not yet taken
+
+typedef struct{
+
+  double Setpoint;              // * target, reached at RampRate
+  double RampRate;              // * setpoint units per second, 0 steps straight to the target
+  double Kp, Ki, Kd;
+  int POn;
+  double outMin, outMax;
+  int Mode, Direction, SampleTime;
+  unsigned long gen[MAILBOX_GROUPS];    // * stamp of the group's last post, in MAILBOX_* bit order
+
+}Mailbox_Msg_t;
+
+typedef struct Mailbox_s{
+
+  Mailbox_Msg_t slot[3];
+  volatile unsigned char middle;        // * last published slot, | MAILBOX_FRESH until taken
+
+  //posting side, owned by whoever holds 'posting'
+  volatile unsigned char posting;
+  unsigned char back;                   // * slot the next post is written into
+  Mailbox_Msg_t latest;                 // * every group as last posted
+  unsigned long busy;                   // * posts refused because another post was in progress
+  unsigned long postSeq;                // * stamps the posts of every mailbox sharing the PID;
+                                        //   the lead's is used, by all their writers
+
+  //control task only
+  PID_t* pid;
+  struct Mailbox_s* lead;               // * holds target, ramp and stamps; itself if not shared
+  unsigned char front;                  // * slot being read
+  unsigned long appliedGen[MAILBOX_GROUPS];     // * stamp applied last per group; the lead's
+                                                //   is used, for all mailboxes sharing the PID
+  double target, rampRate;
+  unsigned long lastTime;               // * millis() of the last ramp step
+  unsigned long applied;                // * messages taken
+
+}Mailbox_t;
+
+
+//binds the mailbox to a constructed PID; the current setpoint, tunings, limits, mode,
+//direction and sample time become the starting values
+void Mailbox_constructor(Mailbox_t* p_MB, PID_t* p_PID);
+
+//another writer's mailbox for the PID of p_Lead; its setpoint and ramp posts go to p_Lead's
+//ramp, so Service() it before p_Lead's on every tick
+void Mailbox_constructorShared(Mailbox_t* p_MB, Mailbox_t* p_Lead);
+
+//any task ***************************************************************************
+bool Mailbox_PostSetpoint(Mailbox_t* p_MB, double Setpoint);    // * all posts return false if
+bool Mailbox_PostRamp(Mailbox_t* p_MB, double RampRate);        //   another post was in progress
+bool Mailbox_PostTunings(Mailbox_t* p_MB, double Kp, double Ki, double Kd, int POn);
+bool Mailbox_PostLimits(Mailbox_t* p_MB, double Min, double Max);
+bool Mailbox_PostMode(Mailbox_t* p_MB, int Mode);
+bool Mailbox_PostDirection(Mailbox_t* p_MB, int Direction);
+bool Mailbox_PostSampleTime(Mailbox_t* p_MB, int SampleTime);
+bool Mailbox_PostGains(Mailbox_t* p_MB, double Kp, double Ki, double Kd, int POn,
+                       int Direction, int SampleTime);  // * tunings, direction and sample time
+                                                        //   (unless <= 0) in one message, so
+                                                        //   no tick runs with half of them
+
+//control task ***********************************************************************
+int Mailbox_Service(Mailbox_t* p_MB);   // * applies pending changes and advances the ramp;
+                                        //   returns the MAILBOX_* groups that changed. O(1),
+                                        //   call it before every PID_Compute()
+
+#endif
@@ -0,0 +1,124 @@
+/**********************************************************************************************
+* Time proportioning output for the PID library
+* (see PID_TPO.h)
+************************************************************************************************/
+
+//Standard libraries
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "PID_TPO.h"
+
+//true if time a is before time b, valid across the millis() wrap-around
+#define TPO_BEFORE(a, b) ((long)((a) - (b)) < 0)
+
+/* heap helpers ********************************************************************************
+ * plain binary min-heap of channel indexes keyed on nextEdge
+ ***********************************************************************************************/
+static void TPO_SiftDown(TPO_t* p_TPO, int i){
+  int n = p_TPO->nChannels;
+  unsigned char* h = p_TPO->heap;
+
+  for(;;){
+    int l = 2*i + 1, r = l + 1, m = i;
+    if(l < n && TPO_BEFORE(p_TPO->ch[h[l]].nextEdge, p_TPO->ch[h[m]].nextEdge)) m = l;
+    if(r < n && TPO_BEFORE(p_TPO->ch[h[r]].nextEdge, p_TPO->ch[h[m]].nextEdge)) m = r;
+    if(m == i) return;
+    unsigned char t = h[i]; h[i] = h[m]; h[m] = t;
+    i = m;
+  }
+}
+
+static void TPO_SetRelay(TPO_t* p_TPO, int c, bool on){
+  TPO_Channel_t* ch = &p_TPO->ch[c];
+  if(ch->on == on) return;
+  ch->on = on;
+  p_TPO->edges++;
+  p_TPO->setRelay(c, on, p_TPO->arg);
+}
+
+/* Constructor (...)****************************************************************
+ *    channel i starts its first window at now + i*WindowSize/nChannels. the relays
+ *    start off.
+ ***********************************************************************************/
+void TPO_constructor(TPO_t* p_TPO, double** Outputs, int nChannels, unsigned long WindowSize,
+        TPO_RelayFn setRelay, void* arg, unsigned long now){
+  if(nChannels > TPO_MAX_CHANNELS) nChannels = TPO_MAX_CHANNELS;
+  if(WindowSize == 0) WindowSize = 1;
+
+  p_TPO->nChannels = nChannels;
+  p_TPO->WindowSize = WindowSize;
+  p_TPO->setRelay = setRelay;
+  p_TPO->arg = arg;
+  p_TPO->edges = 0;
+
+  for(int i = 0; i < nChannels; i++){
+    TPO_Channel_t* ch = &p_TPO->ch[i];
+    ch->myOutput = Outputs[i];
+    ch->onTime = 0;
+    ch->on = false;
+    ch->offPending = false;
+    ch->nextEdge = now + (unsigned long)((unsigned long long)WindowSize * i / nChannels);
+    ch->windowStart = ch->nextEdge - WindowSize;
+    ch->windowLen = WindowSize;
+    setRelay(i, false, arg);
+    p_TPO->heap[i] = (unsigned char)i;     //staggered starts are already in heap order
+  }
+}
+
+/* Service(...)*********************************************************************
+ *    handles the due channel at the top of the heap until the earliest edge is in
+ *    the future. a window start latches the PID output; if we were called so late
+ *    that whole windows were missed, the window grid is moved forward instead of
+ *    replaying them.
+ ***********************************************************************************/
+unsigned long TPO_Service(TPO_t* p_TPO, unsigned long now){
+  if(p_TPO->nChannels == 0) return now + p_TPO->WindowSize;
+
+  for(;;){
+    int c = p_TPO->heap[0];
+    TPO_Channel_t* ch = &p_TPO->ch[c];
+    if(TPO_BEFORE(now, ch->nextEdge)) return ch->nextEdge;
+
+    if(ch->offPending){
+      /*end of the on time*/
+      TPO_SetRelay(p_TPO, c, false);
+      ch->offPending = false;
+      ch->nextEdge = ch->windowStart + ch->windowLen;
+    }
+    else{
+      /*start of a new window*/
+      unsigned long window = p_TPO->WindowSize;
+      ch->windowStart = ch->nextEdge;
+      ch->windowLen = window;
+      if(now - ch->windowStart >= window)
+        ch->windowStart += (now - ch->windowStart) / window * window;
+
+      double out = *(ch->myOutput);
+      if(out <= 0) ch->onTime = 0;
+      else if(out >= (double)window) ch->onTime = window;
+      else ch->onTime = (unsigned long)(out + 0.5);
+
+      TPO_SetRelay(p_TPO, c, ch->onTime > 0);
+      if(ch->onTime > 0 && ch->onTime < window){
+        ch->offPending = true;
+        ch->nextEdge = ch->windowStart + ch->onTime;
+      }
+      else ch->nextEdge = ch->windowStart + window;
+    }
+    TPO_SiftDown(p_TPO, 0);
+  }
+}
+
+unsigned long TPO_NextEdge(TPO_t* p_TPO){
+  return p_TPO->ch[p_TPO->heap[0]].nextEdge;
+}
+
+/* SetWindowSize(...)***************************************************************
+ *    running windows keep their length, the new size is used from each channel's
+ *    next window start. outputs are clamped to the new size when latched.
+ ***********************************************************************************/
+void TPO_SetWindowSize(TPO_t* p_TPO, unsigned long WindowSize){
+  if(WindowSize == 0) return;
+  p_TPO->WindowSize = WindowSize;
+}
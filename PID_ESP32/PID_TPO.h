@@ -0,0 +1,68 @@
+#ifndef PID_TPO_h
+#define PID_TPO_h
+
+#include <stdbool.h>
+
+/**********************************************************************************************
+* Time proportioning output (slow PWM for relays / SSRs)
+*
+* Turns PID outputs in the range 0..WindowSize (use PID_SetOutputLimits(p_PID, 0, WindowSize))
+* into on/off edges: within every window the relay is on for Output ms and off for the rest.
+* Instead of polling every relay each loop, the next edge of every channel is kept in a
+* min-heap and TPO_Service() only runs when the earliest one is due, so a single one-shot
+* timer armed at the returned time drives all the channels.
+* Window starts are staggered by WindowSize/nChannels so the heaters don't switch on together.
+************************************************************************************************/
+
+#define TPO_MAX_CHANNELS 64
+
+typedef void (*TPO_RelayFn)(int channel, bool on, void* arg);   // * drives the relay GPIO
+
+typedef struct{
+
+  double *myOutput;              // * PID output this channel follows, sampled at window start
+  unsigned long windowStart;     // * start of the current window (ms)
+  unsigned long windowLen;       // * length of the current window (ms), WindowSize at its start
+  unsigned long onTime;          // * on time latched for the current window (ms)
+  unsigned long nextEdge;        // * time of the next edge (ms)
+  bool on, offPending;
+
+}TPO_Channel_t;
+
+typedef struct{
+
+  TPO_Channel_t ch[TPO_MAX_CHANNELS];
+  unsigned char heap[TPO_MAX_CHANNELS];   // * channel indexes, min-heap on nextEdge
+  int nChannels;
+
+  unsigned long WindowSize;
+  TPO_RelayFn setRelay;
+  void* arg;
+
+  unsigned long edges;           // * relay edges issued, for statistics
+
+}TPO_t;
+
+
+//links nChannels outputs (Outputs[i] drives relay i) and starts the first staggered windows at now
+void TPO_constructor(TPO_t* p_TPO, double** Outputs, int nChannels, unsigned long WindowSize,
+        TPO_RelayFn setRelay, void* arg, unsigned long now);
+
+unsigned long TPO_Service(TPO_t* p_TPO, unsigned long now);  // * issues every edge due at now and returns
+                                        //   the time of the next one. call it from the timer
+                                        //   callback and re-arm the timer with the result
+
+unsigned long TPO_NextEdge(TPO_t* p_TPO);                    // * time of the earliest pending edge
+
+void TPO_SetWindowSize(TPO_t* p_TPO, unsigned long WindowSize); // * takes effect at each channel's next window
+
+
+/* typical use with esp_timer (the PID still runs in its own task):
+ *
+ *   static void tpo_timer_cb(void* arg){
+ *     unsigned long next = TPO_Service(&tpo, millis());
+ *     esp_timer_start_once(tpo_timer, (next - millis()) * 1000ULL);
+ *   }
+ */
+
+#endif
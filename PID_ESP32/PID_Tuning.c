@@ -0,0 +1,152 @@
+/**********************************************************************************************
+* Transactional tuning for a group of PID loops
+* (see PID_Tuning.h)
+************************************************************************************************/
+
+//Standard libraries
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "PID_Tuning.h"
+
+static void Tuning_CopyBlock(Tuning_t* p_T, Tuning_Block_t* dst, const Tuning_Block_t* src){
+  dst->seq = src->seq;
+  memcpy(dst->p, src->p, sizeof(Tuning_Params_t) * p_T->nLoops);
+}
+
+/* Constructor (...)****************************************************************
+ *    reads the parameters the PIDs run with now; all three blocks start out equal
+ ***********************************************************************************/
+void Tuning_constructor(Tuning_t* p_T, PID_t** pids, int nLoops){
+  if(nLoops > TUNING_MAX_LOOPS) nLoops = TUNING_MAX_LOOPS;
+  memset(p_T, 0, sizeof(*p_T));
+  p_T->nLoops = nLoops;
+
+  for(int i = 0; i < nLoops; i++){
+    PID_t* pid = pids[i];
+    Tuning_Params_t* c = &p_T->current[i];
+    p_T->pid[i] = pid;
+    c->Kp = pid->dispKp;
+    c->Ki = pid->dispKi;
+    c->Kd = pid->dispKd;
+    c->POn = pid->pOn;
+    c->Direction = pid->controllerDirection;
+    c->SampleTime = pid->SampleTime;
+    c->outMin = pid->outMin;
+    c->outMax = pid->outMax;
+  }
+  memcpy(p_T->committed.p, p_T->current, sizeof(Tuning_Params_t) * nLoops);
+  for(int b = 0; b < 3; b++) Tuning_CopyBlock(p_T, &p_T->block[b], &p_T->committed);
+  p_T->front = 0;
+  p_T->middle = 1;
+  p_T->back = 2;
+}
+
+/* Begin() / Stage...() ************************************************************
+ *    a transaction starts from what was last committed, not from what the loops
+ *    happen to run with, so two transactions in a row never undo each other
+ ***********************************************************************************/
+bool Tuning_Begin(Tuning_t* p_T){
+  if(__atomic_test_and_set(&p_T->open, __ATOMIC_ACQUIRE)) return false;
+  Tuning_CopyBlock(p_T, &p_T->block[p_T->back], &p_T->committed);
+  p_T->staged = 0;
+  return true;
+}
+
+static Tuning_Params_t* Tuning_Staging(Tuning_t* p_T, int loop, int group){
+  if(!p_T->open || loop < 0 || loop >= p_T->nLoops) return NULL;
+  p_T->staged++;
+  Tuning_Params_t* p = &p_T->block[p_T->back].p[loop];
+  p->gen[group]++;
+  return p;
+}
+
+bool Tuning_StageTunings(Tuning_t* p_T, int loop, double Kp, double Ki, double Kd, int POn){
+  if(Kp < 0 || Ki < 0 || Kd < 0) return false;
+  Tuning_Params_t* p = Tuning_Staging(p_T, loop, TUNING_GAINS);
+  if(!p) return false;
+  p->Kp = Kp; p->Ki = Ki; p->Kd = Kd;
+  p->POn = POn;
+  return true;
+}
+
+bool Tuning_StageLimits(Tuning_t* p_T, int loop, double Min, double Max){
+  if(Min >= Max) return false;
+  Tuning_Params_t* p = Tuning_Staging(p_T, loop, TUNING_LIMITS);
+  if(!p) return false;
+  p->outMin = Min;
+  p->outMax = Max;
+  return true;
+}
+
+bool Tuning_StageSampleTime(Tuning_t* p_T, int loop, int NewSampleTime){
+  if(NewSampleTime <= 0) return false;
+  Tuning_Params_t* p = Tuning_Staging(p_T, loop, TUNING_SAMPLETIME);
+  if(!p) return false;
+  p->SampleTime = (unsigned long)NewSampleTime;
+  return true;
+}
+
+bool Tuning_StageDirection(Tuning_t* p_T, int loop, int Direction){
+  if(Direction != DIRECT && Direction != REVERSE) return false;
+  Tuning_Params_t* p = Tuning_Staging(p_T, loop, TUNING_DIRECTION);
+  if(!p) return false;
+  p->Direction = Direction;
+  return true;
+}
+
+/* Commit() ************************************************************************
+ *    the staged block becomes 'middle' in one exchange; the block handed back is
+ *    the next one to stage into
+ ***********************************************************************************/
+unsigned long Tuning_Commit(Tuning_t* p_T){
+  unsigned long seq = 0;
+  if(!p_T->open) return 0;
+  if(p_T->staged){
+    Tuning_Block_t* b = &p_T->block[p_T->back];
+    seq = b->seq = p_T->committed.seq + 1;
+    Tuning_CopyBlock(p_T, &p_T->committed, b);
+    p_T->back = __atomic_exchange_n(&p_T->middle, p_T->back | TUNING_FRESH, __ATOMIC_ACQ_REL) & 3;
+  }
+  __atomic_clear(&p_T->open, __ATOMIC_RELEASE);
+  return seq;
+}
+
+void Tuning_Abort(Tuning_t* p_T){
+  __atomic_clear(&p_T->open, __ATOMIC_RELEASE);
+}
+
+/* Service() ***********************************************************************
+ *    one load when nothing was committed. otherwise takes the newest block and
+ *    applies the groups whose generation moved since the last block applied (the
+ *    generations add up, so a block that was overwritten before it was taken is
+ *    covered by the next): direction and sample time first, then the gains, which
+ *    SetTunings recomputes from both. groups nobody staged are left as they are,
+ *    they may have been changed through the mailbox since
+ ***********************************************************************************/
+int Tuning_Service(Tuning_t* p_T){
+  if(!(__atomic_load_n(&p_T->middle, __ATOMIC_RELAXED) & TUNING_FRESH)) return 0;
+  p_T->front = __atomic_exchange_n(&p_T->middle, p_T->front, __ATOMIC_ACQ_REL) & 3;
+  const Tuning_Block_t* b = &p_T->block[p_T->front];
+
+  int changed = 0;
+  for(int i = 0; i < p_T->nLoops; i++){
+    const Tuning_Params_t* n = &b->p[i];
+    Tuning_Params_t* c = &p_T->current[i];
+    if(!memcmp(n->gen, c->gen, sizeof(n->gen))) continue;
+
+    PID_t* pid = p_T->pid[i];
+    bool direction = n->gen[TUNING_DIRECTION] != c->gen[TUNING_DIRECTION];
+    if(direction) PID_SetControllerDirection(pid, n->Direction);
+    if(n->gen[TUNING_SAMPLETIME] != c->gen[TUNING_SAMPLETIME]) PID_SetSampleTime(pid, (int)n->SampleTime);
+    if(n->gen[TUNING_GAINS] != c->gen[TUNING_GAINS]) PID_SetTunings(pid, n->Kp, n->Ki, n->Kd, n->POn);
+    else if(direction) PID_SetTunings(pid, pid->dispKp, pid->dispKi, pid->dispKd, pid->pOn);
+    if(n->gen[TUNING_LIMITS] != c->gen[TUNING_LIMITS]) PID_SetOutputLimits(pid, n->outMin, n->outMax);
+    *c = *n;
+    changed++;
+  }
+  p_T->appliedSeq = b->seq;
+  p_T->applied += changed;
+  return changed;
+}
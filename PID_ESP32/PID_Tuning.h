@@ -0,0 +1,96 @@
+#ifndef PID_Tuning_h
+#define PID_Tuning_h
+
+/**********************************************************************************************
+* Transactional tuning for a group of PID loops
+*
+* Operators retune several loops at once (all heater zones of a coater).  Applying every
+* PID_SetTunings / SetOutputLimits / SetSampleTime as it arrives leaves the zones running
+* with a mix of old and new parameters for a few cycles.  Here the changes are staged into a
+* parameter block holding every loop of the group, and Tuning_Commit() publishes the whole
+* block with one atomic exchange.  The control task calls Tuning_Service() once per tick,
+* before computing the loops: it swaps the newest block in and applies what was staged, so a
+* transaction takes effect on all loops at the same tick or not at all.  Only the groups a
+* transaction staged are applied (every Stage call bumps its group's generation), so a
+* commit that only moves limits leaves gains set through PID_Mailbox alone.
+*
+* The blocks form a triple buffer (see PID_Mailbox.h): the writer owns one, the control
+* task owns one, the third is the published one, nobody waits for anybody.  One transaction
+* is open at a time; Tuning_Begin() returns false while another task has one open.
+************************************************************************************************/
+
+#include "PID.h"
+
+#define TUNING_MAX_LOOPS 64
+
+#define TUNING_FRESH 0x04       // * in 'middle': committed and not yet taken
+
+// * parameter groups, index into Tuning_Params_t.gen
+#define TUNING_GAINS      0
+#define TUNING_LIMITS     1
+#define TUNING_SAMPLETIME 2
+#define TUNING_DIRECTION  3
+#define TUNING_GROUPS     4
+
+typedef struct{
+
+  double Kp, Ki, Kd;            // * in user-entered format, as PID_SetTunings takes them
+  int POn;
+  int Direction;
+  unsigned long SampleTime;     // * ms
+  double outMin, outMax;
+  unsigned long gen[TUNING_GROUPS];     // * bumped by every Stage call of the group
+
+}Tuning_Params_t;
+
+typedef struct{
+
+  unsigned long seq;            // * commit number, 0 for the initial block
+  Tuning_Params_t p[TUNING_MAX_LOOPS];
+
+}Tuning_Block_t;
+
+typedef struct{
+
+  PID_t* pid[TUNING_MAX_LOOPS];
+  int nLoops;
+
+  Tuning_Block_t block[3];
+  volatile unsigned char middle;        // * last committed block, | TUNING_FRESH until taken
+
+  //writer side, owned by whoever holds 'open'
+  volatile unsigned char open;
+  unsigned char back;                   // * block being staged
+  Tuning_Block_t committed;             // * what the last commit published
+  unsigned long staged;                 // * changes in the open transaction
+
+  //control task only
+  unsigned char front;
+  Tuning_Params_t current[TUNING_MAX_LOOPS];    // * what the last applied block staged
+  unsigned long appliedSeq;             // * last commit applied
+  unsigned long applied;                // * loops changed so far
+
+}Tuning_t;
+
+
+//groups nLoops constructed PIDs; their current parameters become the initial block
+void Tuning_constructor(Tuning_t* p_T, PID_t** pids, int nLoops);
+
+//any task, one transaction at a time ************************************************
+bool Tuning_Begin(Tuning_t* p_T);       // * false while another transaction is open
+bool Tuning_StageTunings(Tuning_t* p_T, int loop, double Kp, double Ki, double Kd, int POn);
+bool Tuning_StageLimits(Tuning_t* p_T, int loop, double Min, double Max);
+bool Tuning_StageSampleTime(Tuning_t* p_T, int loop, int NewSampleTime);
+bool Tuning_StageDirection(Tuning_t* p_T, int loop, int Direction);  // * the Stage functions return
+                                        //   false for values the PID would ignore, leaving
+                                        //   the transaction as it was
+unsigned long Tuning_Commit(Tuning_t* p_T);     // * publishes the block, returns its seq
+                                        //   (0 if nothing was staged) and closes the
+                                        //   transaction
+void Tuning_Abort(Tuning_t* p_T);
+
+//control task ***********************************************************************
+int Tuning_Service(Tuning_t* p_T);      // * call once per tick before the PID_Compute()s;
+                                        //   returns the number of loops changed
+
+#endif
@@ -0,0 +1,510 @@
+/**********************************************************************************************
+* mpc_gen: offline generator of explicit MPC trees for MPC.h (host tool)
+*
+* Model      x(k+1) = A x(k) + B u(k),  y = C x,  single input
+* Objective  sum_{k=1..N} Q (y(k) - r)^2 + R u(k-1)^2
+* Limits     umin <= u <= umax,  xmin <= x(k) <= xmax (optional, per state)
+*
+* The MPC problem is condensed to a QP in the N inputs and solved with ADMM for any
+* parameter vector theta = [x, r]. The parameter box given with -range is split recursively
+* (midpoint of the widest dimension) until the first move u(0) is reproduced by one affine
+* law per box within -tol, or -maxdepth is reached. The tree is written as a C header that
+* declares a const MPC_Tree_t for MPC_constructor(). Tree size grows quickly with the number
+* of states and with how often the constraints switch, so always check the reported error.
+*
+* Example, withdrawal speed loop (state = speed mm/s, input = acceleration mm/s^2, Ts=20ms):
+*   mpc_gen -A 1 -B 0.02 -C 1 -Q 1 -R 0.001 -N 20 -umin -50 -umax 50 -xmin 0 -xmax 10
+*           -range "0,10;0,10" -tol 0.05 -name withdraw_mpc -o withdraw_mpc.h
+*
+* build: gcc -O2 -o mpc_gen mpc_gen.c -lm
+************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+#define MAX_N 5                     // states, same as MPC_MAX_STATES
+#define MAX_P (MAX_N + 1)           // parameters
+#define MAX_H 40                    // horizon
+#define MAX_ROWS (MAX_H + MAX_H * MAX_N)
+
+typedef struct{
+  int n, N;
+  double A[MAX_N][MAX_N], B[MAX_N], C[MAX_N];
+  double Q, R, umin, umax;
+  double xmin[MAX_N], xmax[MAX_N];
+  bool xcon[MAX_N];
+  double lo[MAX_P], hi[MAX_P];      // parameter box
+
+  //condensed problem
+  double Ak[MAX_H + 1][MAX_N][MAX_N];   // A^k
+  double G[MAX_H][MAX_N][MAX_H];        // x(k+1) = A^(k+1) x + G[k] U
+  double H[MAX_H][MAX_H];               // 0.5 U'HU + f'U, normalized
+  double scale;
+  int m;                                // constraint rows
+  double M[MAX_ROWS][MAX_H];
+  int rowState[MAX_ROWS], rowStep[MAX_ROWS];    // -1 state for input rows
+  double rowScale[MAX_ROWS];            // state rows are normalized to unit length
+  double L[MAX_H][MAX_H];               // Cholesky of H + sigma I + rho M'M
+  double rho, sigma;
+}Gen_t;
+
+typedef struct{
+  float threshold; int dim; int left, right;
+}Node_t;
+
+static Node_t* nodes; static int nNodes, capNodes;
+static float* laws; static int nLaws, capLaws;
+static int maxDepthSeen;
+static long qpSolves;
+
+/* parsing ***********************************************************************************/
+static int parseRow(const char* s, double* v, int max){
+  int k = 0;
+  while(*s && *s != ';' && k < max){
+    char* end;
+    v[k++] = strtod(s, &end);
+    if(end == s) return -1;
+    s = end;
+    if(*s == ',') s++;
+  }
+  return k;
+}
+
+//"a,b;c,d" -> rows, returns the number of rows, *cols the width of the first one
+static int parseMatrix(const char* s, double* v, int maxRows, int maxCols, int* cols){
+  int r = 0;
+  *cols = 0;
+  while(*s && r < maxRows){
+    int c = parseRow(s, v + r * maxCols, maxCols);
+    if(c <= 0 || (r > 0 && c != *cols)) return -1;
+    *cols = c;
+    r++;
+    s = strchr(s, ';');
+    if(!s) break;
+    s++;
+  }
+  return r;
+}
+
+/* condensing *********************************************************************************/
+static void condense(Gen_t* g){
+  const int n = g->n, N = g->N;
+
+  memset(g->Ak, 0, sizeof(g->Ak));
+  for(int i = 0; i < n; i++) g->Ak[0][i][i] = 1;
+  for(int k = 1; k <= N; k++)
+    for(int i = 0; i < n; i++)
+      for(int j = 0; j < n; j++){
+        double s = 0;
+        for(int l = 0; l < n; l++) s += g->A[i][l] * g->Ak[k - 1][l][j];
+        g->Ak[k][i][j] = s;
+      }
+
+  //G[k][:, j] = A^(k-j) B for j <= k
+  memset(g->G, 0, sizeof(g->G));
+  for(int k = 0; k < N; k++)
+    for(int j = 0; j <= k; j++)
+      for(int i = 0; i < n; i++){
+        double s = 0;
+        for(int l = 0; l < n; l++) s += g->Ak[k - j][i][l] * g->B[l];
+        g->G[k][i][j] = s;
+      }
+
+  //H = 2 (Q Psi'Psi + R I), Psi[k][j] = C G[k][:, j]
+  double Psi[MAX_H][MAX_H];
+  for(int k = 0; k < N; k++)
+    for(int j = 0; j < N; j++){
+      double s = 0;
+      for(int i = 0; i < n; i++) s += g->C[i] * g->G[k][i][j];
+      Psi[k][j] = s;
+    }
+  double hmax = 0;
+  for(int a = 0; a < N; a++)
+    for(int b = 0; b < N; b++){
+      double s = 0;
+      for(int k = 0; k < N; k++) s += Psi[k][a] * Psi[k][b];
+      g->H[a][b] = 2 * (g->Q * s + (a == b ? g->R : 0));
+      if(a == b && g->H[a][b] > hmax) hmax = g->H[a][b];
+    }
+  g->scale = hmax > 0 ? 1 / hmax : 1;
+  for(int a = 0; a < N; a++)
+    for(int b = 0; b < N; b++) g->H[a][b] *= g->scale;
+
+  //constraint rows: inputs, then constrained states at every step
+  g->m = 0;
+  memset(g->M, 0, sizeof(g->M));
+  for(int k = 0; k < N; k++){
+    g->M[g->m][k] = 1;
+    g->rowState[g->m] = -1; g->rowStep[g->m] = k;
+    g->m++;
+  }
+  for(int k = 0; k < N; k++)
+    for(int i = 0; i < n; i++){
+      if(!g->xcon[i]) continue;
+      double norm = 0;
+      for(int j = 0; j < N; j++) norm += g->G[k][i][j] * g->G[k][i][j];
+      norm = norm > 0 ? 1 / sqrt(norm) : 1;
+      for(int j = 0; j < N; j++) g->M[g->m][j] = g->G[k][i][j] * norm;
+      g->rowState[g->m] = i; g->rowStep[g->m] = k;
+      g->rowScale[g->m] = norm;
+      g->m++;
+    }
+
+  //KKT matrix of the ADMM x-update, factored once
+  g->rho = 0.1; g->sigma = 1e-6;
+  double K[MAX_H][MAX_H];
+  for(int a = 0; a < N; a++)
+    for(int b = 0; b < N; b++){
+      double s = 0;
+      for(int r = 0; r < g->m; r++) s += g->M[r][a] * g->M[r][b];
+      K[a][b] = g->H[a][b] + g->rho * s + (a == b ? g->sigma : 0);
+    }
+  for(int j = 0; j < N; j++){
+    double s = K[j][j];
+    for(int k = 0; k < j; k++) s -= g->L[j][k] * g->L[j][k];
+    g->L[j][j] = sqrt(s);
+    for(int i = j + 1; i < N; i++){
+      double t = K[i][j];
+      for(int k = 0; k < j; k++) t -= g->L[i][k] * g->L[j][k];
+      g->L[i][j] = t / g->L[j][j];
+    }
+  }
+}
+
+static void cholSolve(const Gen_t* g, double* v){
+  const int N = g->N;
+  for(int i = 0; i < N; i++){
+    double s = v[i];
+    for(int k = 0; k < i; k++) s -= g->L[i][k] * v[k];
+    v[i] = s / g->L[i][i];
+  }
+  for(int i = N - 1; i >= 0; i--){
+    double s = v[i];
+    for(int k = i + 1; k < N; k++) s -= g->L[k][i] * v[k];
+    v[i] = s / g->L[i][i];
+  }
+}
+
+/* QP *****************************************************************************************
+ * ADMM (OSQP iteration without the adaptive rho) on 0.5 U'HU + f'U, l <= M U <= u.
+ * returns the first move u(0)
+ **********************************************************************************************/
+static double solveQP(const Gen_t* g, const double* theta){
+  const int n = g->n, N = g->N, m = g->m;
+  const double r = theta[n];
+  double f[MAX_H], lo[MAX_ROWS], up[MAX_ROWS];
+  double U[MAX_H] = {0}, z[MAX_ROWS] = {0}, y[MAX_ROWS] = {0};
+  double free_[MAX_N][MAX_H];     // A^(k+1) x, the unforced prediction
+
+  qpSolves++;
+  //f = 2 Q Psi'(Phi x - r)
+  double e[MAX_H];
+  for(int k = 0; k < N; k++){
+    double yk = 0;
+    for(int i = 0; i < n; i++){
+      double s = 0;
+      for(int l = 0; l < n; l++) s += g->Ak[k + 1][i][l] * theta[l];
+      free_[i][k] = s;
+      yk += g->C[i] * s;
+    }
+    e[k] = yk - r;
+  }
+  for(int j = 0; j < N; j++){
+    double s = 0;
+    for(int k = 0; k < N; k++){
+      double psi = 0;
+      for(int i = 0; i < n; i++) psi += g->C[i] * g->G[k][i][j];
+      s += psi * e[k];
+    }
+    f[j] = 2 * g->Q * s * g->scale;
+  }
+  for(int row = 0; row < m; row++){
+    int i = g->rowState[row], k = g->rowStep[row];
+    if(i < 0){ lo[row] = g->umin; up[row] = g->umax; }
+    else{
+      lo[row] = (g->xmin[i] - free_[i][k]) * g->rowScale[row];
+      up[row] = (g->xmax[i] - free_[i][k]) * g->rowScale[row];
+    }
+  }
+
+  const double alpha = 1.6, rho = g->rho, sigma = g->sigma;
+  const double epsP = 1e-6 * (g->umax - g->umin), epsD = 1e-6;
+  for(int it = 0; it < 5000; it++){
+    double v[MAX_H], zt[MAX_ROWS];
+    for(int j = 0; j < N; j++){
+      double s = sigma * U[j] - f[j];
+      for(int row = 0; row < m; row++) s += g->M[row][j] * (rho * z[row] - y[row]);
+      v[j] = s;
+    }
+    cholSolve(g, v);
+    double rp = 0, rd = 0;
+    for(int row = 0; row < m; row++){
+      double s = 0;
+      for(int j = 0; j < N; j++) s += g->M[row][j] * v[j];
+      zt[row] = s;
+    }
+    for(int j = 0; j < N; j++) U[j] = alpha * v[j] + (1 - alpha) * U[j];
+    for(int row = 0; row < m; row++){
+      double zr = alpha * zt[row] + (1 - alpha) * z[row];
+      double zn = zr + y[row] / rho;
+      zn = zn < lo[row] ? lo[row] : (zn > up[row] ? up[row] : zn);
+      y[row] += rho * (zr - zn);
+      rd = fmax(rd, fabs(rho * (zn - z[row])));
+      z[row] = zn;
+      rp = fmax(rp, fabs(zt[row] - zn));
+    }
+    if(it > 20 && rp < epsP && rd < epsD) break;
+  }
+  //the input rows are plain bounds, so report u(0) from the clamped copy
+  return z[0];
+}
+
+/* partitioning *******************************************************************************/
+static int newNode(void){
+  if(nNodes == capNodes){
+    capNodes = capNodes ? capNodes * 2 : 256;
+    nodes = realloc(nodes, sizeof(Node_t) * capNodes);
+  }
+  return nNodes++;
+}
+
+/* least squares affine fit u = F.theta + g, returns the law index
+ * the runtime clamps the law to [umin, umax], so where the box holds enough unsaturated
+ * points only those are fitted and the saturated ones come out of the clamp; the error
+ * is measured after clamping */
+static int fitLaw(const Gen_t* g, double (*pts)[MAX_P], const double* u, int nPts, double* err){
+  const int p = g->n + 1;
+  const int np = p + 1;
+  const double eps = 1e-6 * (g->umax - g->umin);
+  double AtA[MAX_P + 1][MAX_P + 2];
+  int nFree = 0;
+  for(int s = 0; s < nPts; s++) if(u[s] > g->umin + eps && u[s] < g->umax - eps) nFree++;
+  bool onlyFree = nFree >= 2 * np;
+
+  memset(AtA, 0, sizeof(AtA));
+  for(int s = 0; s < nPts; s++){
+    if(onlyFree && !(u[s] > g->umin + eps && u[s] < g->umax - eps)) continue;
+    double row[MAX_P + 1];
+    for(int i = 0; i < p; i++) row[i] = pts[s][i];
+    row[p] = 1;
+    for(int a = 0; a < np; a++){
+      for(int b = 0; b < np; b++) AtA[a][b] += row[a] * row[b];
+      AtA[a][np] += row[a] * u[s];
+    }
+  }
+  //Gauss-Jordan with partial pivoting, tiny ridge for flat directions
+  for(int a = 0; a < np; a++) AtA[a][a] += 1e-12;
+  for(int c = 0; c < np; c++){
+    int piv = c;
+    for(int r = c + 1; r < np; r++) if(fabs(AtA[r][c]) > fabs(AtA[piv][c])) piv = r;
+    for(int k = 0; k <= np; k++){ double t = AtA[c][k]; AtA[c][k] = AtA[piv][k]; AtA[piv][k] = t; }
+    for(int r = 0; r < np; r++){
+      if(r == c || AtA[c][c] == 0) continue;
+      double f = AtA[r][c] / AtA[c][c];
+      for(int k = c; k <= np; k++) AtA[r][k] -= f * AtA[c][k];
+    }
+  }
+  if(nLaws == capLaws){
+    capLaws = capLaws ? capLaws * 2 : 256;
+    laws = realloc(laws, sizeof(float) * (MAX_P + 1) * capLaws);
+  }
+  float* law = &laws[nLaws * np];
+  for(int a = 0; a < np; a++) law[a] = (float)(AtA[a][a] != 0 ? AtA[a][np] / AtA[a][a] : 0);
+
+  *err = 0;
+  for(int s = 0; s < nPts; s++){
+    double v = law[p];
+    for(int i = 0; i < p; i++) v += law[i] * pts[s][i];
+    v = v < g->umin ? g->umin : (v > g->umax ? g->umax : v);
+    *err = fmax(*err, fabs(v - u[s]));
+  }
+  return nLaws++;
+}
+
+static unsigned rngState = 1;
+static double rnd(void){
+  rngState = rngState * 1103515245u + 12345u;
+  return ((rngState >> 8) & 0xFFFFFF) / 16777216.0;
+}
+
+static int build(const Gen_t* g, const double* lo, const double* hi, int depth,
+                 int maxDepth, double tol, double* worstErr){
+  const int p = g->n + 1;
+  double pts[(1 << MAX_P) + 2 * MAX_P + 1][MAX_P];
+  double u[(1 << MAX_P) + 2 * MAX_P + 1];
+  int nPts = 0;
+
+  for(int v = 0; v < (1 << p); v++, nPts++)
+    for(int i = 0; i < p; i++) pts[nPts][i] = (v >> i) & 1 ? hi[i] : lo[i];
+  for(int i = 0; i < p; i++) pts[nPts][i] = 0.5 * (lo[i] + hi[i]);
+  nPts++;
+  for(int s = 0; s < 2 * p; s++, nPts++)
+    for(int i = 0; i < p; i++) pts[nPts][i] = lo[i] + rnd() * (hi[i] - lo[i]);
+  for(int s = 0; s < nPts; s++) u[s] = solveQP(g, pts[s]);
+
+  int savedLaws = nLaws;
+  double err;
+  int law = fitLaw(g, pts, u, nPts, &err);
+  int id = newNode();
+  if(depth > maxDepthSeen) maxDepthSeen = depth;
+
+  if(err <= tol || depth >= maxDepth){
+    nodes[id].dim = -1; nodes[id].left = law; nodes[id].right = 0; nodes[id].threshold = 0;
+    if(err > *worstErr) *worstErr = err;
+    return id;
+  }
+  nLaws = savedLaws;
+
+  //split the widest dimension relative to the root box
+  int dim = 0; double widest = -1;
+  for(int i = 0; i < p; i++){
+    double w = (hi[i] - lo[i]) / (g->hi[i] - g->lo[i]);
+    if(w > widest){ widest = w; dim = i; }
+  }
+  double mid = 0.5 * (lo[dim] + hi[dim]);
+  double cLo[MAX_P], cHi[MAX_P];
+  memcpy(cLo, lo, sizeof(cLo)); memcpy(cHi, hi, sizeof(cHi));
+
+  nodes[id].dim = dim;
+  nodes[id].threshold = (float)mid;
+  cHi[dim] = mid;
+  int l = build(g, cLo, cHi, depth + 1, maxDepth, tol, worstErr);
+  cHi[dim] = hi[dim]; cLo[dim] = mid;
+  int r = build(g, cLo, cHi, depth + 1, maxDepth, tol, worstErr);
+  nodes[id].left = l; nodes[id].right = r;
+  return id;
+}
+
+static double evalTree(const Gen_t* g, const double* theta){
+  const Node_t* nd = &nodes[0];
+  while(nd->dim >= 0) nd = &nodes[theta[nd->dim] <= nd->threshold ? nd->left : nd->right];
+  const int p = g->n + 1;
+  const float* law = &laws[nd->left * (p + 1)];
+  double u = law[p];
+  for(int i = 0; i < p; i++) u += law[i] * theta[i];
+  return u < g->umin ? g->umin : (u > g->umax ? g->umax : u);
+}
+
+//float literal that is valid C even for whole numbers ("5.f", not "5f")
+static const char* floatLit(char* buf, double v){
+  sprintf(buf, "%.9g", v);
+  if(!strpbrk(buf, ".e")) strcat(buf, ".");
+  strcat(buf, "f");
+  return buf;
+}
+
+static void usage(const char* prog){
+  printf("usage: %s -A rows -B col -C row -Q q -R r -N horizon -umin u -umax u\n"
+         "          [-xmin v,.. -xmax v,..] -range \"lo,hi;..\" (one per state, then setpoint)\n"
+         "          [-tol e] [-maxdepth d] [-name ident] [-o file.h]\n"
+         "matrices use ',' between columns and ';' between rows\n", prog);
+}
+
+int main(int argc, char** argv){
+  static Gen_t g;
+  const char* name = "mpc_tree";
+  const char* outFile = NULL;
+  double tol = 0.01;
+  int maxDepth = 16;
+  int rows, cols, nB = 0, nC = 0;
+  double tmp[MAX_P * MAX_P * 2];
+  int nRange = 0;
+
+  memset(&g, 0, sizeof(g));
+  g.Q = 1; g.R = 0.01; g.N = 10; g.umin = -1; g.umax = 1;
+  for(int i = 0; i < MAX_N; i++){ g.xmin[i] = -INFINITY; g.xmax[i] = INFINITY; }
+
+  for(int i = 1; i < argc; i++){
+    const char* a = argv[i];
+    const char* v = i + 1 < argc ? argv[i + 1] : NULL;
+    if(!v){ usage(argv[0]); return 2; }
+    i++;
+    if(!strcmp(a, "-A")){
+      rows = parseMatrix(v, tmp, MAX_N, MAX_N, &cols);
+      if(rows <= 0 || rows != cols){ fprintf(stderr, "-A must be square, at most %d states\n", MAX_N); return 2; }
+      g.n = rows;
+      for(int r = 0; r < rows; r++) for(int c = 0; c < cols; c++) g.A[r][c] = tmp[r * MAX_N + c];
+    }
+    else if(!strcmp(a, "-B")){
+      rows = parseMatrix(v, tmp, MAX_N, 1, &cols);
+      if(rows <= 0){ fprintf(stderr, "bad -B\n"); return 2; }
+      nB = rows;
+      for(int r = 0; r < rows; r++) g.B[r] = tmp[r];
+    }
+    else if(!strcmp(a, "-C")) nC = parseRow(v, g.C, MAX_N);
+    else if(!strcmp(a, "-Q")) g.Q = atof(v);
+    else if(!strcmp(a, "-R")) g.R = atof(v);
+    else if(!strcmp(a, "-N")) g.N = atoi(v);
+    else if(!strcmp(a, "-umin")) g.umin = atof(v);
+    else if(!strcmp(a, "-umax")) g.umax = atof(v);
+    else if(!strcmp(a, "-xmin") || !strcmp(a, "-xmax")){
+      double* dst = a[2] == 'm' && a[3] == 'i' ? g.xmin : g.xmax;
+      int k = parseRow(v, tmp, MAX_N);
+      for(int s = 0; s < k; s++){ dst[s] = tmp[s]; g.xcon[s] = true; }
+    }
+    else if(!strcmp(a, "-range")){
+      rows = parseMatrix(v, tmp, MAX_P, 2, &cols);
+      if(rows <= 0 || cols != 2){ fprintf(stderr, "bad -range\n"); return 2; }
+      nRange = rows;
+      for(int r = 0; r < rows; r++){ g.lo[r] = tmp[r * 2]; g.hi[r] = tmp[r * 2 + 1]; }
+    }
+    else if(!strcmp(a, "-tol")) tol = atof(v);
+    else if(!strcmp(a, "-maxdepth")) maxDepth = atoi(v);
+    else if(!strcmp(a, "-name")) name = v;
+    else if(!strcmp(a, "-o")) outFile = v;
+    else{ usage(argv[0]); return 2; }
+  }
+  if(g.n == 0 || nB != g.n || nC != g.n || nRange != g.n + 1 || g.N < 1 || g.N > MAX_H ||
+     g.umin >= g.umax){
+    usage(argv[0]);
+    return 2;
+  }
+  for(int i = 0; i <= g.n; i++)
+    if(!(g.hi[i] > g.lo[i])){ fprintf(stderr, "empty -range for parameter %d\n", i); return 2; }
+  if(maxDepth > 30) maxDepth = 30;
+
+  condense(&g);
+  double worstErr = 0;
+  build(&g, g.lo, g.hi, 0, maxDepth, tol, &worstErr);
+
+  //validation against the QP on random parameters
+  double maxErr = 0, sumErr = 0;
+  const int nCheck = 2000;
+  for(int s = 0; s < nCheck; s++){
+    double th[MAX_P];
+    for(int i = 0; i <= g.n; i++) th[i] = g.lo[i] + rnd() * (g.hi[i] - g.lo[i]);
+    double e = fabs(evalTree(&g, th) - solveQP(&g, th));
+    maxErr = fmax(maxErr, e); sumErr += e;
+  }
+  fprintf(stderr, "%s: %d nodes, %d laws, depth %d, %ld QP solves\n",
+          name, nNodes, nLaws, maxDepthSeen, qpSolves);
+  fprintf(stderr, "fit error at sample points <= %g; on %d random parameters max %g mean %g\n",
+          worstErr, nCheck, maxErr, sumErr / nCheck);
+  if(nNodes > 65535){ fprintf(stderr, "tree too large for MPC_Node_t\n"); return 1; }
+
+  FILE* f = outFile ? fopen(outFile, "w") : stdout;
+  if(!f){ perror(outFile); return 1; }
+  const int p = g.n + 1;
+  fprintf(f, "// Explicit MPC law generated by tools/mpc_gen, do not edit\n");
+  fprintf(f, "// N=%d Q=%g R=%g u in [%g, %g], %d nodes, %d laws, depth %d, max error %g\n",
+          g.N, g.Q, g.R, g.umin, g.umax, nNodes, nLaws, maxDepthSeen, maxErr);
+  fprintf(f, "#include \"MPC.h\"\n\n");
+  fprintf(f, "static const MPC_Node_t %s_nodes[%d] = {\n", name, nNodes);
+  char lit[40];
+  for(int i = 0; i < nNodes; i++)
+    fprintf(f, "  {%s, %d, %d, %d},\n", floatLit(lit, nodes[i].threshold),
+            nodes[i].dim, nodes[i].left, nodes[i].right);
+  fprintf(f, "};\n\nstatic const float %s_laws[%d] = {\n", name, nLaws * (p + 1));
+  for(int l = 0; l < nLaws; l++){
+    fprintf(f, " ");
+    for(int i = 0; i <= p; i++) fprintf(f, " %s,", floatLit(lit, laws[l * (p + 1) + i]));
+    fprintf(f, "\n");
+  }
+  fprintf(f, "};\n\nstatic const MPC_Tree_t %s = {\n  %d, %d, %d, %d, %s_nodes, %s_laws, %.9g, %.9g\n};\n",
+          name, g.n, nNodes, nLaws, maxDepthSeen, name, name, g.umin, g.umax);
+  if(outFile) fclose(f);
+  return 0;
+}
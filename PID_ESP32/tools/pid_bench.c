@@ -0,0 +1,540 @@
+/**********************************************************************************************
+* pid_bench: host benchmarks for the modules that sit around the PID library
+*
+* Each subcommand drives one module with a simulated clock and prints its cost per
+* operation on the host.
+*
+* build: gcc -O2 -o pid_bench pid_bench.c ../PID.c ../PID_TPO.c ../PID_Filter.c ../MPC.c \
+*            ../PID_Mailbox.c ../PID_Tuning.c -lm -lpthread
+* usage: pid_bench tpo [channels] [window_ms] [sim_seconds]
+*        pid_bench filter [frames] [decimation] [median]
+*        pid_bench mpc [lookups] [states]
+*        pid_bench mailbox [seconds] [steps]
+*        pid_bench tuning [transactions] [loops] [tick_us] [msg_us]
+************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../PID_TPO.h"
+#include "../PID_Filter.h"
+#include "../PID.h"
+#include "../MPC.h"
+#include "../PID_Mailbox.h"
+#include "../PID_Tuning.h"
+
+//simulated clock behind millis() for the modules that use it
+static unsigned long simMillis;
+unsigned long millis(){
+  return simMillis;
+}
+
+static double nowSec(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t rngState = 12345;
+static uint32_t rng(void){
+  rngState ^= rngState << 13; rngState ^= rngState >> 17; rngState ^= rngState << 5;
+  return rngState;
+}
+
+/* tpo ****************************************************************************************
+ * 64 relays following outputs that a PID would change every 100 ms; compares the heap driven
+ * TPO_Service() with polling every relay each 1 ms tick, and the peak number of relays on
+ **********************************************************************************************/
+typedef struct{
+  bool state[TPO_MAX_CHANNELS];
+  int on, peak;
+}RelayStats_t;
+
+static void countRelay(int channel, bool on, void* arg){
+  RelayStats_t* s = arg;
+  if(s->state[channel] == on) return;
+  s->state[channel] = on;
+  s->on += on ? 1 : -1;
+  if(s->on > s->peak) s->peak = s->on;
+}
+
+static int benchTPO(int argc, char** argv){
+  int n = argc > 0 ? atoi(argv[0]) : 64;
+  unsigned long window = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000;
+  unsigned long simMs = (argc > 2 ? strtoul(argv[2], NULL, 0) : 3600) * 1000UL;
+  const unsigned long pidPeriod = 100;
+  if(n < 1 || n > TPO_MAX_CHANNELS || window == 0) return 2;
+
+  static double out[TPO_MAX_CHANNELS];
+  static double* outs[TPO_MAX_CHANNELS];
+  for(int i = 0; i < n; i++){ out[i] = 0.6 * window; outs[i] = &out[i]; }
+
+  //event driven
+  static TPO_t tpo;
+  static RelayStats_t st;
+  unsigned long calls = 0;
+  double t0 = nowSec();
+  TPO_constructor(&tpo, outs, n, window, countRelay, &st, 0);
+  unsigned long now = 0, nextEdge = TPO_NextEdge(&tpo), nextPid = pidPeriod;
+  while(now < simMs){
+    if((long)(nextPid - nextEdge) <= 0){
+      now = nextPid;
+      nextPid += pidPeriod;
+      for(int i = 0; i < n; i++) out[i] = 0.5 * window + (double)(rng() % window) * 0.2 - 0.1 * window;
+    }
+    else{
+      now = nextEdge;
+      nextEdge = TPO_Service(&tpo, now);
+      calls++;
+    }
+  }
+  double tEvent = nowSec() - t0;
+  int peakEvent = st.peak;
+  unsigned long edges = tpo.edges;
+
+  //polling baseline, every relay every 1 ms tick, windows aligned
+  static bool relay[TPO_MAX_CHANNELS];
+  static unsigned long onTime[TPO_MAX_CHANNELS];
+  int on = 0, peakPoll = 0;
+  unsigned long pollEdges = 0;
+  memset(relay, 0, sizeof(relay));
+  t0 = nowSec();
+  for(now = 0; now < simMs; now++){
+    if(now % pidPeriod == 0)
+      for(int i = 0; i < n; i++) out[i] = 0.5 * window + (double)(rng() % window) * 0.2 - 0.1 * window;
+    for(int i = 0; i < n; i++){
+      if(now % window == 0) onTime[i] = out[i] <= 0 ? 0 : (unsigned long)(out[i] + 0.5);
+      bool want = now % window < onTime[i];
+      if(want != relay[i]){ relay[i] = want; pollEdges++; on += want ? 1 : -1; }
+    }
+    if(on > peakPoll) peakPoll = on;
+  }
+  double tPoll = nowSec() - t0;
+
+  printf("tpo: %d channels, window %lums, %lus simulated, outputs updated every %lums\n",
+         n, window, simMs / 1000, pidPeriod);
+  printf("  event queue: %lu service calls, %lu edges, %.1f ns/edge, %.4f%% of one core, peak relays on %d\n",
+         calls, edges, tEvent * 1e9 / (edges ? edges : 1), 100 * tEvent / (simMs / 1000.0), peakEvent);
+  printf("  1ms polling: %lu edges, %.1f ns/edge, %.4f%% of one core, peak relays on %d (aligned windows)\n",
+         pollEdges, tPoll * 1e9 / (pollEdges ? pollEdges : 1), 100 * tPoll / (simMs / 1000.0), peakPoll);
+  return 0;
+}
+
+/* filter *************************************************************************************
+ * noisy thermocouple-like channels with occasional spikes through the full pipeline, for
+ * 1..64 channels per bank; cost is reported per raw sample and channel
+ **********************************************************************************************/
+static int benchFilter(int argc, char** argv){
+  int frames = argc > 0 ? atoi(argv[0]) : 200000;
+  int decim = argc > 1 ? atoi(argv[1]) : 4;
+  int median = argc > 2 ? atoi(argv[2]) : 5;
+  if(frames < 1) return 2;
+
+  static Filter_t f;
+  static double out[FILTER_MAX_CHANNELS];
+  static double* outs[FILTER_MAX_CHANNELS];
+  const int block = 64;
+  double* raw = malloc(sizeof(double) * FILTER_MAX_CHANNELS * block);
+  for(int c = 0; c < FILTER_MAX_CHANNELS; c++) outs[c] = &out[c];
+
+  printf("filter: decimation %d, median %d, 2nd order low-pass, %d frames\n", decim, median, frames);
+  printf("%9s %14s %14s %12s\n", "channels", "ns/sample/ch", "Msamples/s", "spikes out");
+  for(int n = 1; n <= FILTER_MAX_CHANNELS; n *= 2){
+    Filter_constructor(&f, outs, n, decim, median);
+    Filter_SetLowpass(&f, 2, 100);
+    int spikesOut = 0;
+    double t = 0;
+
+    for(int done = 0; done < frames; done += block){
+      int nb = frames - done < block ? frames - done : block;
+      for(int i = 0; i < nb; i++)
+        for(int c = 0; c < n; c++){
+          double noise = ((int)(rng() % 2001) - 1000) * 1e-3;
+          raw[i * n + c] = 100 + c + noise + (rng() % 500 == 0 ? 50 : 0);
+        }
+      double t0 = nowSec();
+      Filter_PushBlock(&f, raw, nb);
+      t += nowSec() - t0;
+      for(int c = 0; c < n; c++) if(fabs(out[c] - (100 + c)) > 5) spikesOut++;
+    }
+    double samples = (double)frames * n;
+    printf("%9d %14.2f %14.1f %12d\n", n, t * 1e9 / samples, samples / t / 1e6, spikesOut);
+  }
+  free(raw);
+  return 0;
+}
+
+/* mpc ****************************************************************************************
+ * balanced synthetic trees of growing depth (random split dimensions and thresholds), timed
+ * through MPC_Evaluate() and through MPC_Compute() with the sample time always elapsed
+ **********************************************************************************************/
+static int benchMPC(int argc, char** argv){
+  long lookups = argc > 0 ? atol(argv[0]) : 2000000;
+  int nStates = argc > 1 ? atoi(argv[1]) : 2;
+  if(lookups < 1 || nStates < 1 || nStates > MPC_MAX_STATES) return 2;
+  const int np = nStates + 1;
+
+  printf("mpc: %d states, %ld lookups per tree\n", nStates, lookups);
+  printf("%6s %8s %8s %16s %16s\n", "depth", "nodes", "laws", "ns/Evaluate", "ns/Compute");
+  for(int depth = 2; depth <= 14; depth += 2){      // 16 would overflow the 16 bit node indexes
+    int nNodes = (1 << (depth + 1)) - 1, nLaws = 1 << depth;
+    MPC_Node_t* nodes = malloc(sizeof(MPC_Node_t) * nNodes);
+    float* laws = malloc(sizeof(float) * nLaws * (np + 1));
+    for(int i = 0; i < nNodes; i++){
+      if(i < nLaws - 1){
+        nodes[i].dim = (signed char)(rng() % np);
+        nodes[i].threshold = (float)(rng() % 1000) / 100;
+        nodes[i].left = (unsigned short)(2 * i + 1);
+        nodes[i].right = (unsigned short)(2 * i + 2);
+      }
+      else{
+        nodes[i].dim = -1;
+        nodes[i].left = (unsigned short)(i - (nLaws - 1));
+        nodes[i].right = 0;
+      }
+    }
+    for(int i = 0; i < nLaws * (np + 1); i++) laws[i] = (float)((int)(rng() % 2001) - 1000) / 100;
+    MPC_Tree_t tree = { nStates, nNodes, nLaws, depth, nodes, laws, -50, 50 };
+
+    //parameter vectors drawn up front so the timing is the lookup only
+    enum { NTH = 4096 };
+    static double theta[NTH][MPC_MAX_STATES + 1];
+    for(int t = 0; t < NTH; t++)
+      for(int i = 0; i < np; i++) theta[t][i] = (double)(rng() % 1000) / 100;
+
+    volatile double sink = 0;
+    long bad = 0;
+    double t0 = nowSec();
+    for(long k = 0; k < lookups; k++){
+      double uk;
+      if(MPC_Evaluate(&tree, theta[k & (NTH - 1)], &uk)) sink += uk;
+      else bad++;
+    }
+    double tEval = nowSec() - t0;
+
+    MPC_t mpc;
+    double x[MPC_MAX_STATES] = {0}, u = 0, sp = 5;
+    simMillis = 0;
+    MPC_constructor(&mpc, x, &u, &sp, &tree, 1);
+    MPC_SetMode(&mpc, AUTOMATIC);
+    t0 = nowSec();
+    for(long k = 0; k < lookups; k++){
+      simMillis++;
+      x[0] = theta[k & (NTH - 1)][0];
+      MPC_Compute(&mpc);
+      sink += u;
+    }
+    double tComp = nowSec() - t0;
+    (void)sink;
+
+    printf("%6d %8d %8d %16.1f %16.1f\n", depth, nNodes, nLaws,
+           tEval * 1e9 / lookups, tComp * 1e9 / lookups);
+    if(bad || mpc.badLookups) printf("       %ld + %lu lookups did not reach a leaf\n", bad, mpc.badLookups);
+    free(nodes);
+    free(laws);
+  }
+  return 0;
+}
+
+/* mailbox ************************************************************************************
+ * a writer thread posts setpoints and tunings as fast as it can while the control thread
+ * services the mailbox and checks every value it sees.  the setpoint k + k*1e-9 changes both
+ * 32 bit halves with k, and the tunings are always (k, 2k, 3k), so a torn read shows as a value
+ * no post wrote.  the baseline writes the shared variables directly, the double as two 32 bit
+ * stores the way the ESP32 does.  then the per step cost next to PID_Compute(), single thread
+ **********************************************************************************************/
+static double mbPattern(unsigned long k){ return (double)k + (double)k * 1e-9; }
+static bool mbValid(double v){ return v == mbPattern((unsigned long)v); }
+
+typedef struct{
+  Mailbox_t* mb;
+  volatile double* sp;                  // * baseline targets
+  volatile double* gains;
+  volatile bool stop;
+  unsigned long posts;
+}MbWriter_t;
+
+static void* mbMailboxWriter(void* arg){
+  MbWriter_t* w = arg;
+  for(unsigned long k = 1; !w->stop; k++){
+    Mailbox_PostSetpoint(w->mb, mbPattern(k));
+    Mailbox_PostTunings(w->mb, k, 2.0 * k, 3.0 * k, P_ON_E);
+    w->posts++;
+  }
+  return NULL;
+}
+
+static void* mbDirectWriter(void* arg){
+  MbWriter_t* w = arg;
+  for(unsigned long k = 1; !w->stop; k++){
+    double v = mbPattern(k);
+    uint32_t half[2];
+    memcpy(half, &v, sizeof(v));
+    volatile uint32_t* dst = (volatile uint32_t*)w->sp;
+    dst[0] = half[0];
+    dst[1] = half[1];
+    w->gains[0] = k; w->gains[1] = 2.0 * k; w->gains[2] = 3.0 * k;
+    w->posts++;
+  }
+  return NULL;
+}
+
+static int benchMailbox(int argc, char** argv){
+  double secs = argc > 0 ? atof(argv[0]) : 2;
+  long steps = argc > 1 ? atol(argv[1]) : 5000000;
+  if(secs <= 0 || steps < 1) return 2;
+
+  double in = 0, out = 0, sp = 0;
+  PID_t pid;
+  simMillis = 0;
+  PID_constructor(&pid, &in, &out, &sp, 1, 2, 3, P_ON_E, DIRECT);
+  PID_SetSampleTime(&pid, 1);
+  PID_SetMode(&pid, AUTOMATIC);
+
+  static Mailbox_t mb;
+  volatile double shared = 0, gains[3] = {0, 0, 0};
+  MbWriter_t w = { &mb, &shared, gains, false, 0 };
+  pthread_t th;
+
+  printf("mailbox: %.1f s stress per variant, writer and control thread\n", secs);
+  printf("%10s %12s %12s %12s %12s %12s\n", "variant", "posts", "reads", "applied", "torn sp", "torn gains");
+
+  //mailbox
+  Mailbox_constructor(&mb, &pid);
+  pthread_create(&th, NULL, mbMailboxWriter, &w);
+  unsigned long reads = 0, tornSp = 0, tornGains = 0;
+  double t0 = nowSec();
+  while(nowSec() - t0 < secs){
+    for(int i = 0; i < 1000; i++){
+      Mailbox_Service(&mb);
+      if(sp != 0 && !mbValid(sp)) tornSp++;
+      if(pid.dispKi != 2 * pid.dispKp || pid.dispKd != 3 * pid.dispKp) tornGains++;
+      reads++;
+    }
+  }
+  w.stop = true;
+  pthread_join(th, NULL);
+  printf("%10s %12lu %12lu %12lu %12lu %12lu\n", "mailbox", w.posts, reads, mb.applied, tornSp, tornGains);
+
+  //direct writes
+  w.stop = false; w.posts = 0;
+  reads = tornSp = tornGains = 0;
+  pthread_create(&th, NULL, mbDirectWriter, &w);
+  t0 = nowSec();
+  while(nowSec() - t0 < secs){
+    for(int i = 0; i < 1000; i++){
+      double v = shared;
+      double kp = gains[0], ki = gains[1], kd = gains[2];
+      if(v != 0 && !mbValid(v)) tornSp++;
+      if(ki != 2 * kp || kd != 3 * kp) tornGains++;
+      reads++;
+    }
+  }
+  w.stop = true;
+  pthread_join(th, NULL);
+  printf("%10s %12lu %12lu %12s %12lu %12lu\n", "direct", w.posts, reads, "-", tornSp, tornGains);
+
+  //cost per control step
+  const char* names[] = { "PID_Compute only", "+ Service, idle", "+ Service, post every step", "+ Service, ramping" };
+  printf("\n%28s %10s\n", "per step", "ns");
+  for(int v = 0; v < 4; v++){
+    Mailbox_constructor(&mb, &pid);
+    if(v == 3){ Mailbox_PostRamp(&mb, 1); Mailbox_PostSetpoint(&mb, 1e9); }
+    volatile double sink = 0;
+    t0 = nowSec();
+    for(long k = 0; k < steps; k++){
+      simMillis++;
+      in = (double)(k & 255);
+      if(v == 2) Mailbox_PostSetpoint(&mb, (double)(k & 1023));
+      if(v > 0) Mailbox_Service(&mb);
+      PID_Compute(&pid);
+      sink += out;
+    }
+    double t = nowSec() - t0;
+    (void)sink;
+    printf("%28s %10.1f\n", names[v], t * 1e9 / steps);
+  }
+  return 0;
+}
+
+/* tuning *************************************************************************************
+ * a group of loops retuned together.  single thread first: what a tick costs with nothing
+ * committed, what Commit() costs, and what the tick that applies a transaction of every loop
+ * costs.  then a control thread ticking every tick_us against a writer thread that commits
+ * transactions setting Kp = n on every loop at random times, one loop per message msg_us
+ * apart the way they arrive from the network: the ticks where the loops don't all have the
+ * same Kp, and the delay from Commit() to the tick that applied it.  the baseline calls
+ * PID_SetTunings() for each loop as its message arrives, from the writer thread
+ **********************************************************************************************/
+typedef struct{
+  Tuning_t* t;
+  PID_t* pid;
+  int nLoops;
+  long transactions;
+  long msgUs;
+  bool direct;
+  double* committedAt;          // * by commit seq
+  volatile bool done;
+}TuneWriter_t;
+
+static void* tuneWriter(void* arg){
+  TuneWriter_t* w = arg;
+  for(long k = 1; k <= w->transactions; k++){
+    struct timespec ts = { 0, (long)(rng() % 3000) * 1000 };
+    nanosleep(&ts, NULL);
+    struct timespec gap = { 0, w->msgUs * 1000 };
+    if(w->direct){
+      for(int i = 0; i < w->nLoops; i++){
+        PID_SetTunings(&w->pid[i], (double)k, 0.5, 0.1, P_ON_E);
+        nanosleep(&gap, NULL);
+      }
+      continue;
+    }
+    while(!Tuning_Begin(w->t)){}
+    for(int i = 0; i < w->nLoops; i++){
+      Tuning_StageTunings(w->t, i, (double)k, 0.5, 0.1, P_ON_E);
+      nanosleep(&gap, NULL);
+    }
+    unsigned long seq = Tuning_Commit(w->t);
+    w->committedAt[seq] = nowSec();
+  }
+  w->done = true;
+  return NULL;
+}
+
+static int cmpDouble(const void* a, const void* b){
+  double x = *(const double*)a, y = *(const double*)b;
+  return x < y ? -1 : x > y;
+}
+
+static int benchTuning(int argc, char** argv){
+  long transactions = argc > 0 ? atol(argv[0]) : 2000;
+  int n = argc > 1 ? atoi(argv[1]) : 64;
+  long tickUs = argc > 2 ? atol(argv[2]) : 1000;
+  long msgUs = argc > 3 ? atol(argv[3]) : 10;
+  if(transactions < 1 || n < 1 || n > TUNING_MAX_LOOPS || tickUs < 1 || msgUs < 0 || msgUs > 999999) return 2;
+
+  static PID_t pid[TUNING_MAX_LOOPS];
+  static PID_t* pids[TUNING_MAX_LOOPS];
+  static double in[TUNING_MAX_LOOPS], out[TUNING_MAX_LOOPS], sp[TUNING_MAX_LOOPS];
+  static Tuning_t t;
+  simMillis = 0;
+  for(int i = 0; i < n; i++){
+    sp[i] = 50;
+    PID_constructor(&pid[i], &in[i], &out[i], &sp[i], 1, 0.5, 0.1, P_ON_E, DIRECT);
+    PID_SetSampleTime(&pid[i], 1);
+    PID_SetMode(&pid[i], AUTOMATIC);
+    pids[i] = &pid[i];
+  }
+  Tuning_constructor(&t, pids, n);
+
+  //single thread costs
+  const long ticks = 100000;
+  double tBare = 1, tIdle = 1, t0;     // * best of 5 alternating runs, the box is not quiet
+  for(int rep = 0; rep < 5; rep++){
+    t0 = nowSec();
+    for(long k = 0; k < ticks; k++){
+      simMillis++;
+      for(int i = 0; i < n; i++){ in[i] = (double)(k & 127); PID_Compute(&pid[i]); }
+    }
+    double d = (nowSec() - t0) / ticks;
+    if(d < tBare) tBare = d;
+    t0 = nowSec();
+    for(long k = 0; k < ticks; k++){
+      simMillis++;
+      Tuning_Service(&t);
+      for(int i = 0; i < n; i++){ in[i] = (double)(k & 127); PID_Compute(&pid[i]); }
+    }
+    d = (nowSec() - t0) / ticks;
+    if(d < tIdle) tIdle = d;
+  }
+  const long commits = 20000;
+  double tCommit = 0, tApply = 0;
+  for(long k = 0; k < commits; k++){
+    t0 = nowSec();
+    Tuning_Begin(&t);
+    for(int i = 0; i < n; i++) Tuning_StageTunings(&t, i, 1 + (k & 1), 0.5, 0.1, P_ON_E);
+    Tuning_Commit(&t);
+    double t1 = nowSec();
+    Tuning_Service(&t);
+    tApply += nowSec() - t1;
+    tCommit += t1 - t0;
+  }
+  printf("tuning: %d loops\n", n);
+  printf("  tick, %d x PID_Compute:            %8.0f ns\n", n, tBare * 1e9);
+  printf("  tick + Tuning_Service, idle:        %8.0f ns  (%+.1f ns)\n", tIdle * 1e9, (tIdle - tBare) * 1e9);
+  printf("  Begin + %d stages + Commit:         %8.0f ns\n", n, tCommit * 1e9 / commits);
+  printf("  Tuning_Service applying %d loops:   %8.0f ns\n", n, tApply * 1e9 / commits);
+
+  //threads
+  printf("\n  %ld transactions at random 0-3 ms gaps, %ld us between messages, control tick %ld us\n",
+         transactions, msgUs, tickUs);
+  printf("  %8s %12s %12s %12s %12s %12s %12s\n", "variant", "ticks", "mixed ticks", "superseded",
+         "p50 us", "p99 us", "max us");
+  double* committedAt = calloc(transactions + 2, sizeof(double));
+  double* lat = malloc(sizeof(double) * (transactions + 1));
+  for(int v = 0; v < 2; v++){
+    for(int i = 0; i < n; i++) PID_SetTunings(&pid[i], 1, 0.5, 0.1, P_ON_E);
+    Tuning_constructor(&t, pids, n);
+    TuneWriter_t w = { &t, pid, n, transactions, msgUs, v == 1, committedAt, false };
+    pthread_t th;
+    pthread_create(&th, NULL, tuneWriter, &w);
+
+    long nTicks = 0, mixed = 0, nLat = 0;
+    unsigned long lastSeq = 0, superseded = 0;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while(!w.done){
+      next.tv_nsec += tickUs * 1000;
+      while(next.tv_nsec >= 1000000000L){ next.tv_nsec -= 1000000000L; next.tv_sec++; }
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+      simMillis++;
+      if(v == 0 && Tuning_Service(&t) && t.appliedSeq != lastSeq){
+        double now = nowSec();
+        superseded += t.appliedSeq - lastSeq - 1;
+        lastSeq = t.appliedSeq;
+        if(committedAt[lastSeq] > 0) lat[nLat++] = now - committedAt[lastSeq];
+      }
+      double kp = pid[0].dispKp;
+      bool same = true;
+      for(int i = 0; i < n; i++){
+        if(pid[i].dispKp != kp) same = false;
+        PID_Compute(&pid[i]);
+      }
+      if(!same) mixed++;
+      nTicks++;
+    }
+    pthread_join(th, NULL);
+    if(v == 0){
+      qsort(lat, nLat, sizeof(double), cmpDouble);
+      printf("  %8s %12ld %12ld %12lu %12.0f %12.0f %12.0f\n", "commit", nTicks, mixed, superseded,
+             nLat ? lat[nLat / 2] * 1e6 : 0, nLat ? lat[(long)(nLat * 0.99)] * 1e6 : 0,
+             nLat ? lat[nLat - 1] * 1e6 : 0);
+    }
+    else printf("  %8s %12ld %12ld %12s %12s %12s %12s\n", "direct", nTicks, mixed, "-", "-", "-", "-");
+  }
+  free(committedAt);
+  free(lat);
+  return 0;
+}
+
+int main(int argc, char** argv){
+  if(argc >= 2 && !strcmp(argv[1], "tpo")) return benchTPO(argc - 2, argv + 2);
+  if(argc >= 2 && !strcmp(argv[1], "filter")) return benchFilter(argc - 2, argv + 2);
+  if(argc >= 2 && !strcmp(argv[1], "mpc")) return benchMPC(argc - 2, argv + 2);
+  if(argc >= 2 && !strcmp(argv[1], "mailbox")) return benchMailbox(argc - 2, argv + 2);
+  if(argc >= 2 && !strcmp(argv[1], "tuning")) return benchTuning(argc - 2, argv + 2);
+
+  printf("usage: %s tpo [channels] [window_ms] [sim_seconds]\n"
+         "       %s filter [frames] [decimation] [median]\n"
+         "       %s mpc [lookups] [states]\n"
+         "       %s mailbox [seconds] [steps]\n"
+         "       %s tuning [transactions] [loops] [tick_us] [msg_us]\n", argv[0], argv[0], argv[0], argv[0], argv[0]);
+  return 2;
+}
@@ -0,0 +1,280 @@
+/**********************************************************************************************
+* pid_freqresp: open-loop frequency response and stability margins of a PID_t loop (host tool)
+*
+* The controller is the discrete law of PID_Compute() with the gains the library leaves in
+* the PID_t (so SampleTime, direction and P_ON_M/P_ON_E are taken into account):
+*   feedback path  C(z)   = kp + ki/(1 - z^-1) + kd*(1 - z^-1)
+*   setpoint path  Csp(z) = kp + ki/(1 - z^-1)   (P_ON_E)
+*                         =      ki/(1 - z^-1)   (P_ON_M, proportional acts on the input)
+* The plant is either the zero-order-hold FOPDT model from -K/-tau/-dead or a discrete
+* transfer function given with -num/-den (coefficients of z^-1) and -delay (samples).
+*
+* The frequency grid, the plant response and the integrator/derivative terms are evaluated
+* once into arrays; each gain set then costs a handful of multiply-adds per point, so the
+* analysis is cheap enough to call from inside a gain sweep (-sweep).
+*
+* build: gcc -O3 -march=native -o pid_freqresp pid_freqresp.c pid_tool.c ../PID.c -lm
+* usage: pid_freqresp [PID/plant options] [-num b0,b1,..] [-den 1,a1,..] [-delay N]
+*                     [-points N] [-wmin RAD_S] [-reps N] [-csv FILE] [-sweep KPMIN KPMAX N]
+************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+
+#include "pid_tool.h"
+
+#define MAX_COEFS 16
+
+typedef struct{
+  int n;
+  double* w;                    // rad/s
+  double* pRe; double* pIm;     // plant response P(e^jwT)
+  double* iRe; double* iIm;     // 1/(1 - z^-1)
+  double* dRe; double* dIm;     // 1 - z^-1
+  double* lRe; double* lIm;     // scratch: loop response of the last evaluation
+}FR_Grid_t;
+
+typedef struct{
+  double gainMargin_dB, phaseCrossover;     // inf / NAN when the phase never reaches -180
+  double phaseMargin_deg, gainCrossover;    // NAN when |L| never crosses 1
+  double bandwidth;                         // -3dB of the setpoint->input response, rad/s
+  double sensitivityPeak;                   // max |1/(1+L)|
+}FR_Margins_t;
+
+static double nowSec(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int parseCoefs(const char* s, double* c){
+  int n = 0;
+  while(*s){
+    if(n == MAX_COEFS) return -1;      //too many coefficients, refuse rather than truncate
+    char* end;
+    c[n++] = strtod(s, &end);
+    if(end == s) return -1;
+    s = (*end == ',') ? end + 1 : end;
+  }
+  return n;
+}
+
+/* Grid setup ********************************************************************************
+ * log spaced from wmin up to the Nyquist frequency; everything that does not depend on the
+ * controller gains is computed here
+ **********************************************************************************************/
+static void gridInit(FR_Grid_t* g, int n, double wmin, double Ts,
+                     const double* num, int nNum, const double* den, int nDen, int delay){
+  double* mem = malloc(sizeof(double) * n * 9);
+  g->n = n;
+  g->w = mem;
+  g->pRe = mem + n;     g->pIm = mem + 2 * n;
+  g->iRe = mem + 3 * n; g->iIm = mem + 4 * n;
+  g->dRe = mem + 5 * n; g->dIm = mem + 6 * n;
+  g->lRe = mem + 7 * n; g->lIm = mem + 8 * n;
+
+  double wmax = M_PI / Ts;
+  double ratio = log(wmax / wmin) / (n > 1 ? n - 1 : 1);
+  for(int k = 0; k < n; k++) g->w[k] = wmin * exp(ratio * k);
+
+  for(int k = 0; k < n; k++){
+    double th = g->w[k] * Ts;
+    double zr = cos(th), zi = -sin(th);          // z^-1
+
+    //Horner in z^-1 for numerator and denominator
+    double nr = 0, ni = 0, dr = 0, di = 0;
+    for(int j = nNum - 1; j >= 0; j--){
+      double t = nr * zr - ni * zi;
+      ni = nr * zi + ni * zr; nr = t + num[j];
+    }
+    for(int j = nDen - 1; j >= 0; j--){
+      double t = dr * zr - di * zi;
+      di = dr * zi + di * zr; dr = t + den[j];
+    }
+    double dd = dr * dr + di * di;
+    double pr = (nr * dr + ni * di) / dd, pi = (ni * dr - nr * di) / dd;
+    //pure delay z^-delay
+    double cr = cos(delay * th), ci = -sin(delay * th);
+    g->pRe[k] = pr * cr - pi * ci;
+    g->pIm[k] = pr * ci + pi * cr;
+
+    //1 - z^-1 and its inverse
+    double ar = 1 - zr, ai = -zi;
+    g->dRe[k] = ar; g->dIm[k] = ai;
+    double aa = ar * ar + ai * ai;
+    g->iRe[k] = ar / aa; g->iIm[k] = -ai / aa;
+  }
+}
+
+static double interpLogW(double w0, double w1, double f){
+  return exp(log(w0) + f * (log(w1) - log(w0)));
+}
+
+/* Margins ************************************************************************************
+ * L = P*C is formed in one vector loop; crossover searches and the sensitivity/bandwidth
+ * scan read the arrays afterwards
+ **********************************************************************************************/
+static void evalMargins(FR_Grid_t* g, const PID_t* pid, FR_Margins_t* m){
+  const int n = g->n;
+  const double kp = pid->kp, ki = pid->ki, kd = pid->kd;
+  double* restrict lRe = g->lRe;
+  double* restrict lIm = g->lIm;
+
+  for(int k = 0; k < n; k++){
+    double cr = kp + ki * g->iRe[k] + kd * g->dRe[k];
+    double ci = ki * g->iIm[k] + kd * g->dIm[k];
+    lRe[k] = g->pRe[k] * cr - g->pIm[k] * ci;
+    lIm[k] = g->pRe[k] * ci + g->pIm[k] * cr;
+  }
+
+  //sensitivity peak and closed loop bandwidth of setpoint -> input
+  double spKp = pid->pOnE ? kp : 0;
+  double ms = 0, t0 = -1;
+  m->bandwidth = NAN;
+  for(int k = 0; k < n; k++){
+    double sr = 1 + lRe[k], si = lIm[k];
+    double s2 = sr * sr + si * si;
+    if(1 / s2 > ms) ms = 1 / s2;
+    if(isnan(m->bandwidth)){
+      double cr = spKp + ki * g->iRe[k], ci = ki * g->iIm[k];
+      double tr = g->pRe[k] * cr - g->pIm[k] * ci, ti = g->pRe[k] * ci + g->pIm[k] * cr;
+      double t2 = (tr * tr + ti * ti) / s2;
+      if(t0 < 0) t0 = t2;
+      else if(t2 < 0.5 * t0) m->bandwidth = g->w[k];
+    }
+  }
+  m->sensitivityPeak = sqrt(ms);
+
+  //crossovers on the unwrapped phase
+  m->gainMargin_dB = INFINITY; m->phaseCrossover = NAN;
+  m->phaseMargin_deg = NAN; m->gainCrossover = NAN;
+  double prevPh = atan2(lIm[0], lRe[0]);
+  double prevMag = hypot(lRe[0], lIm[0]);
+  if(prevPh > 0) prevPh -= 2 * M_PI;       // a loop with integral action starts near -90deg
+  for(int k = 1; k < n; k++){
+    double ph = atan2(lIm[k], lRe[k]);
+    ph += 2 * M_PI * round((prevPh - ph) / (2 * M_PI));
+    double mag = hypot(lRe[k], lIm[k]);
+
+    if(isnan(m->gainCrossover) && prevMag >= 1 && mag < 1){
+      double f = log(prevMag) / (log(prevMag) - log(mag));
+      m->gainCrossover = interpLogW(g->w[k - 1], g->w[k], f);
+      m->phaseMargin_deg = 180 + (prevPh + f * (ph - prevPh)) * 180 / M_PI;
+    }
+    if(isnan(m->phaseCrossover)){
+      double turns = floor((prevPh + M_PI) / (2 * M_PI));
+      double target = -M_PI + 2 * M_PI * turns;   // nearest -180 (mod 360) at or below prevPh
+      if(ph < target && prevPh >= target){
+        double f = (prevPh - target) / (prevPh - ph);
+        m->phaseCrossover = interpLogW(g->w[k - 1], g->w[k], f);
+        m->gainMargin_dB = -20 * log10(prevMag * pow(mag / prevMag, f));
+      }
+    }
+    prevPh = ph; prevMag = mag;
+  }
+}
+
+static void printMargins(const FR_Margins_t* m){
+  printf("gain margin:     %.2f dB at %.4g rad/s\n", m->gainMargin_dB, m->phaseCrossover);
+  printf("phase margin:    %.1f deg at %.4g rad/s\n", m->phaseMargin_deg, m->gainCrossover);
+  printf("bandwidth:       %.4g rad/s\n", m->bandwidth);
+  printf("sensitivity Ms:  %.3f (%.2f dB)\n", m->sensitivityPeak, 20 * log10(m->sensitivityPeak));
+}
+
+int main(int argc, char** argv){
+  PIDTool_t T;
+  PIDTool_Defaults(&T);
+  double num[MAX_COEFS], den[MAX_COEFS];
+  int nNum = 0, nDen = 0, delay = -1, points = 100000, reps = 100, sweepN = 0;
+  double wmin = 0, sweepMin = 0, sweepMax = 0;
+  const char* csv = NULL;
+
+  for(int i = 1; i < argc; i++){
+    if(PIDTool_ParseArg(&T, argc, argv, &i)) continue;
+    if(!strcmp(argv[i], "-num") && i + 1 < argc) nNum = parseCoefs(argv[++i], num);
+    else if(!strcmp(argv[i], "-den") && i + 1 < argc) nDen = parseCoefs(argv[++i], den);
+    else if(!strcmp(argv[i], "-delay") && i + 1 < argc) delay = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-points") && i + 1 < argc) points = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-wmin") && i + 1 < argc) wmin = atof(argv[++i]);
+    else if(!strcmp(argv[i], "-reps") && i + 1 < argc) reps = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-csv") && i + 1 < argc) csv = argv[++i];
+    else if(!strcmp(argv[i], "-sweep") && i + 3 < argc){
+      sweepMin = atof(argv[++i]); sweepMax = atof(argv[++i]); sweepN = atoi(argv[++i]);
+    }
+    else{
+      printf("usage: %s [options]\n", argv[0]);
+      PIDTool_PrintUsage();
+      printf("model options: -num b0,b1,.. -den 1,a1,.. -delay N  (z^-1 coefficients)\n"
+             "run options:   -points N -wmin RAD_S -reps N -csv FILE -sweep KPMIN KPMAX N\n");
+      return 2;
+    }
+  }
+  if(nNum < 0 || nDen < 0 || points < 2){
+    fprintf(stderr, "bad model or grid (at most %d coefficients per polynomial)\n", MAX_COEFS);
+    return 2;
+  }
+
+  PIDTool_Setup(&T);
+  double Ts = T.pid.SampleTime / 1000.0;
+  if(nDen == 0){
+    //zero-order-hold FOPDT: K(1-a) z^-1 / (1 - a z^-1), dead time rounded to samples
+    double a = exp(-Ts / T.plantTau);
+    num[0] = 0; num[1] = T.plantK * (1 - a); nNum = 2;
+    den[0] = 1; den[1] = -a; nDen = 2;
+    if(delay < 0) delay = (int)lround(T.plantDead / Ts);
+  }
+  if(nNum == 0 || den[0] == 0){
+    fprintf(stderr, "-num and -den are both required, den[0] != 0\n");
+    return 2;
+  }
+  if(delay < 0) delay = 0;
+  if(wmin <= 0) wmin = 1e-4 * M_PI / Ts;
+
+  PIDTool_PrintConfig(&T);
+  printf("grid: %d points, %.3g..%.3g rad/s, plant delay %d samples\n",
+         points, wmin, M_PI / Ts, delay);
+
+  FR_Grid_t g;
+  double t0 = nowSec();
+  gridInit(&g, points, wmin, Ts, num, nNum, den, nDen, delay);
+  double tGrid = nowSec() - t0;
+
+  FR_Margins_t m;
+  t0 = nowSec();
+  for(int r = 0; r < reps; r++) evalMargins(&g, &T.pid, &m);
+  double tEval = (nowSec() - t0) / (reps > 0 ? reps : 1);
+  if(reps <= 0) evalMargins(&g, &T.pid, &m);
+
+  printMargins(&m);
+  printf("timing: grid setup %.3f ms, evaluation %.3f ms per gain set\n", tGrid * 1e3, tEval * 1e3);
+
+  if(csv){
+    FILE* f = fopen(csv, "w");
+    if(!f){ perror(csv); return 1; }
+    fprintf(f, "w_rad_s,mag_dB,phase_deg\n");
+    for(int k = 0; k < g.n; k++)
+      fprintf(f, "%.6g,%.6g,%.6g\n", g.w[k], 20 * log10(hypot(g.lRe[k], g.lIm[k])),
+              atan2(g.lIm[k], g.lRe[k]) * 180 / M_PI);
+    fclose(f);
+  }
+
+  if(sweepN > 1){
+    printf("\n%10s %10s %10s %12s %8s\n", "Kp", "GM[dB]", "PM[deg]", "BW[rad/s]", "Ms");
+    t0 = nowSec();
+    for(int s = 0; s < sweepN; s++){
+      double kp = sweepMin + (sweepMax - sweepMin) * s / (sweepN - 1);
+      PID_SetTunings(&T.pid, kp, T.Ki, T.Kd, T.POn);
+      evalMargins(&g, &T.pid, &m);
+      printf("%10.4g %10.2f %10.1f %12.4g %8.3f\n", kp, m.gainMargin_dB,
+             m.phaseMargin_deg, m.bandwidth, m.sensitivityPeak);
+    }
+    printf("sweep: %.3f ms total\n", (nowSec() - t0) * 1e3);
+  }
+
+  free(g.w);
+  return 0;
+}
@@ -0,0 +1,326 @@
+/**********************************************************************************************
+* pid_montecarlo: robustness check of a PID_t tuning against plant variations (host tool)
+*
+* Runs many closed-loop step responses of the configured PID_t against randomized
+* first order plus dead time plants (thermal mass / time constant and dead time varied
+* by +-spread) and reports worst-case overshoot, settling time percentiles and the rate
+* of unstable or never-settling runs.
+*
+* The output limits keep every run bounded, so a run counts as unstable when it still
+* oscillates at the end: the error envelope over the last quarter of the run is outside
+* the settling band, has not decayed against the quarter before it, and the error keeps
+* changing sign (a growing oscillation or a limit cycle between the output limits).
+*
+* The controller arithmetic is the one in PID_Compute(), rewritten for a batch of plant
+* variants in structure-of-arrays form so the inner loop vectorizes; the gains are read
+* from a PID_t set up through the real library. "-verify N" replays the first N variants
+* through PID_Compute() itself and prints the largest deviation from the batched kernel.
+*
+* build: gcc -O3 -march=native -o pid_montecarlo pid_montecarlo.c pid_tool.c ../PID.c -lm -lpthread
+* usage: pid_montecarlo [PID/plant options] [-runs N] [-steps N] [-spread F] [-band F]
+*                       [-threads N] [-seed N] [-verify N]
+************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "pid_tool.h"
+
+#define BATCH 256                   // plant variants integrated side by side
+
+typedef struct{
+  //controller, as left in the PID_t by the library
+  double kpE, kpM, ki, kd, outMin, outMax;
+  double setpoint, input0, output0;
+  //plant nominal values and spread
+  double K, tau, dead, spread, Ts;
+  double band;                      // settling band, fraction of the step size
+  long runs, steps;
+  int delaySlots;                   // power of two > max dead time in samples
+  uint64_t seed;
+}MC_Config_t;
+
+typedef struct{
+  double overshoot;                 // fraction of the step size
+  float settle;                     // seconds, <0 if it never settled
+  float tau, dead;                  // the variant, for reporting the worst case
+  bool unstable;
+}MC_Result_t;
+
+typedef struct{
+  const MC_Config_t* cfg;
+  MC_Result_t* results;
+  atomic_long* nextBatch;
+}MC_Worker_t;
+
+/* random numbers ****************************************************************************/
+static uint64_t rngNext(uint64_t* s){
+  uint64_t x = *s;
+  x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+  *s = x;
+  return x * 0x2545F4914F6CDD1DULL;
+}
+
+static double rngUniform(uint64_t* s){   // [-1, 1)
+  return (double)(rngNext(s) >> 11) * (2.0 / 9007199254740992.0) - 1.0;
+}
+
+//each variant is drawn from its own index so results do not depend on the thread count
+static void drawVariant(const MC_Config_t* c, long run, double* tau, int* delay){
+  uint64_t s = (c->seed ^ ((uint64_t)run * 0x9E3779B97F4A7C15ULL)) | 1;
+  rngNext(&s);
+  *tau = c->tau * (1 + c->spread * rngUniform(&s));
+  double dead = c->dead * (1 + c->spread * rngUniform(&s));
+  *delay = (int)lround(dead / c->Ts);
+  if(*delay >= c->delaySlots) *delay = c->delaySlots - 1;
+}
+
+/* batch kernel *******************************************************************************
+ * One PID_Compute() + plant step for every lane, per time step. Lanes only differ in the
+ * plant coefficients and the dead time, so the controller part is a straight vector loop.
+ **********************************************************************************************/
+static void runBatch(const MC_Config_t* c, long first, int n, double* ubuf, MC_Result_t* out){
+  double a[BATCH], b[BATCH], y[BATCH], lastY[BATCH], sum[BATCH];
+  double peak[BATCH];
+  double envPrev[BATCH], envLate[BATCH], lastErr[BATCH];   // |error| envelopes, 3rd and 4th quarter
+  int crossings[BATCH];             // error sign changes in the 4th quarter
+  int delay[BATCH];
+  long lastOut[BATCH];
+  double tau[BATCH];
+
+  const double sp = c->setpoint;
+  const double step = fabs(sp - c->input0) > 1e-12 ? sp - c->input0 : 1.0;
+  const double band = fabs(step) * c->band;
+  const double stepSign = step > 0 ? 1.0 : -1.0;
+  const double kpE = c->kpE, kpM = c->kpM, ki = c->ki, kd = c->kd;
+  const double outMin = c->outMin, outMax = c->outMax;
+  const int mask = c->delaySlots - 1;
+  const long q3 = c->steps / 2, q4 = c->steps - c->steps / 4;
+
+  for(int l = 0; l < BATCH; l++){
+    int d = 0;
+    double t = c->tau;
+    if(l < n) drawVariant(c, first + l, &t, &d);
+    tau[l] = t;
+    delay[l] = d;
+    a[l] = exp(-c->Ts / t);
+    b[l] = c->K * (1 - a[l]);
+    y[l] = c->input0;
+    lastY[l] = c->input0;
+    //PID_Initialize(): bumpless start from the current output
+    sum[l] = c->output0 < outMin ? outMin : (c->output0 > outMax ? outMax : c->output0);
+    peak[l] = -INFINITY;
+    envPrev[l] = envLate[l] = 0;
+    lastErr[l] = sp - c->input0;
+    crossings[l] = 0;
+    lastOut[l] = -1;
+  }
+  for(int s = 0; s <= mask; s++)
+    for(int l = 0; l < BATCH; l++) ubuf[s * BATCH + l] = c->output0;
+
+  for(long t = 0; t < c->steps; t++){
+    double* uNow = &ubuf[(t & mask) * BATCH];
+    const int inPrev = t >= q3 && t < q4, inLate = t >= q4;
+
+    for(int l = 0; l < BATCH; l++){
+      double in = y[l];
+      double error = sp - in;
+      double dInput = in - lastY[l];
+      double s = sum[l] + ki * error;
+      s -= kpM * dInput;
+      s = s > outMax ? outMax : (s < outMin ? outMin : s);
+      double o = kpE * error + s - kd * dInput;
+      o = o > outMax ? outMax : (o < outMin ? outMin : o);
+      sum[l] = s;
+      lastY[l] = in;
+      uNow[l] = o;
+
+      double excess = (in - sp) * stepSign;
+      peak[l] = excess > peak[l] ? excess : peak[l];
+      lastOut[l] = fabs(error) > band ? t : lastOut[l];
+
+      double ae = fabs(error);
+      envPrev[l] = inPrev && ae > envPrev[l] ? ae : envPrev[l];
+      envLate[l] = inLate && ae > envLate[l] ? ae : envLate[l];
+      crossings[l] += inLate && (error > 0) != (lastErr[l] > 0);
+      lastErr[l] = error;
+    }
+    for(int l = 0; l < BATCH; l++){
+      double u = ubuf[((t - delay[l]) & mask) * BATCH + l];
+      y[l] = a[l] * y[l] + b[l] * u;
+    }
+  }
+
+  for(int l = 0; l < n; l++){
+    MC_Result_t* r = &out[first + l];
+    r->tau = (float)tau[l];
+    r->dead = (float)(delay[l] * c->Ts);
+    r->unstable = !isfinite(y[l]) || !isfinite(peak[l]) ||
+                  (envLate[l] > band && envLate[l] >= 0.9 * envPrev[l] && crossings[l] >= 2);
+    r->overshoot = isfinite(peak[l]) ? (peak[l] > 0 ? peak[l] / fabs(step) : 0) : INFINITY;
+    if(r->unstable || lastOut[l] == c->steps - 1) r->settle = -1;
+    else r->settle = (float)((lastOut[l] + 1) * c->Ts);
+  }
+}
+
+static void* worker(void* arg){
+  MC_Worker_t* w = arg;
+  const MC_Config_t* c = w->cfg;
+  double* ubuf = aligned_alloc(64, sizeof(double) * BATCH * c->delaySlots);
+
+  for(;;){
+    long batch = atomic_fetch_add(w->nextBatch, 1);
+    long first = batch * BATCH;
+    if(first >= c->runs) break;
+    int n = (int)(c->runs - first < BATCH ? c->runs - first : BATCH);
+    runBatch(c, first, n, ubuf, w->results);
+  }
+  free(ubuf);
+  return NULL;
+}
+
+/* verification against the real PID_Compute() ***********************************************/
+static double verify(PIDTool_t* T, const MC_Config_t* c, const MC_Result_t* res, long n){
+  double worst = 0;
+  double* ubuf = malloc(sizeof(double) * c->delaySlots);
+  int mask = c->delaySlots - 1;
+
+  for(long r = 0; r < n && r < c->runs; r++){
+    double tau; int delay;
+    drawVariant(c, r, &tau, &delay);
+    double a = exp(-c->Ts / tau), b = c->K * (1 - a);
+
+    T->input = c->input0;
+    T->output = c->output0;
+    PIDTool_Setup(T);
+    PID_SetMode(&T->pid, AUTOMATIC);
+    for(int s = 0; s <= mask; s++) ubuf[s] = c->output0;
+
+    double peak = -INFINITY;
+    double step = fabs(c->setpoint - c->input0) > 1e-12 ? c->setpoint - c->input0 : 1.0;
+    for(long t = 0; t < c->steps; t++){
+      PIDTool_SetClock((unsigned long)((t + 1) * T->SampleTime));
+      PID_Compute(&T->pid);
+      ubuf[t & mask] = T->output;
+      double excess = (T->input - c->setpoint) * (step > 0 ? 1 : -1);
+      if(excess > peak) peak = excess;
+      T->input = a * T->input + b * ubuf[(t - delay) & mask];
+    }
+    double ov = peak > 0 ? peak / fabs(step) : 0;
+    double d;
+    if(!isfinite(ov) || !isfinite(res[r].overshoot)) d = isfinite(ov) == isfinite(res[r].overshoot) ? 0 : INFINITY;
+    else d = fabs(ov - res[r].overshoot);
+    if(d > worst) worst = d;
+  }
+  free(ubuf);
+  return worst;
+}
+
+static int cmpFloat(const void* a, const void* b){
+  float x = *(const float*)a, y = *(const float*)b;
+  return (x > y) - (x < y);
+}
+
+static double nowSec(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char** argv){
+  PIDTool_t T;
+  PIDTool_Defaults(&T);
+  long runs = 100000, steps = 10000, verifyRuns = 0;
+  double spread = 0.3, band = 0.02;
+  int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  uint64_t seed = 1;
+
+  for(int i = 1; i < argc; i++){
+    if(PIDTool_ParseArg(&T, argc, argv, &i)) continue;
+    if(!strcmp(argv[i], "-runs") && i + 1 < argc) runs = atol(argv[++i]);
+    else if(!strcmp(argv[i], "-steps") && i + 1 < argc) steps = atol(argv[++i]);
+    else if(!strcmp(argv[i], "-spread") && i + 1 < argc) spread = atof(argv[++i]);
+    else if(!strcmp(argv[i], "-band") && i + 1 < argc) band = atof(argv[++i]);
+    else if(!strcmp(argv[i], "-threads") && i + 1 < argc) threads = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-seed") && i + 1 < argc) seed = strtoull(argv[++i], NULL, 0);
+    else if(!strcmp(argv[i], "-verify") && i + 1 < argc) verifyRuns = atol(argv[++i]);
+    else{
+      printf("usage: %s [options]\n", argv[0]);
+      PIDTool_PrintUsage();
+      printf("run options:   -runs N -steps N -spread F -band F -threads N -seed N -verify N\n");
+      return 2;
+    }
+  }
+  if(threads < 1) threads = 1;
+  if(runs < 1 || steps < 1) return 2;
+
+  PIDTool_Setup(&T);
+  PIDTool_PrintConfig(&T);
+
+  MC_Config_t c;
+  const PID_t* pid = &T.pid;
+  c.kpE = pid->pOnE ? pid->kp : 0;
+  c.kpM = pid->pOnE ? 0 : pid->kp;
+  c.ki = pid->ki; c.kd = pid->kd;
+  c.outMin = pid->outMin; c.outMax = pid->outMax;
+  c.setpoint = T.setpoint; c.input0 = 0; c.output0 = 0;
+  c.K = T.plantK; c.tau = T.plantTau; c.dead = T.plantDead; c.spread = spread;
+  c.Ts = pid->SampleTime / 1000.0;
+  c.band = band;
+  c.runs = runs; c.steps = steps; c.seed = seed;
+  int maxDelay = (int)ceil(T.plantDead * (1 + spread) / c.Ts) + 1;
+  c.delaySlots = 1;
+  while(c.delaySlots <= maxDelay) c.delaySlots <<= 1;
+
+  MC_Result_t* res = calloc((size_t)runs, sizeof(*res));
+  atomic_long nextBatch = 0;
+  MC_Worker_t w = { &c, res, &nextBatch };
+  pthread_t* th = malloc(sizeof(pthread_t) * threads);
+
+  double t0 = nowSec();
+  for(int i = 0; i < threads; i++) pthread_create(&th[i], NULL, worker, &w);
+  for(int i = 0; i < threads; i++) pthread_join(th[i], NULL);
+  double elapsed = nowSec() - t0;
+
+  long unstable = 0, unsettled = 0, worst = -1;
+  float* settle = malloc(sizeof(float) * runs);
+  long nSettled = 0;
+  for(long r = 0; r < runs; r++){
+    if(res[r].unstable){ unstable++; continue; }
+    if(res[r].settle < 0) unsettled++;
+    else settle[nSettled++] = res[r].settle;
+    if(worst < 0 || res[r].overshoot > res[worst].overshoot) worst = r;
+  }
+  qsort(settle, nSettled, sizeof(float), cmpFloat);
+
+  printf("runs: %ld x %ld steps, spread +-%.0f%%, %d threads, %.2fs (%.1f Msteps/s)\n",
+         runs, steps, spread * 100, threads, elapsed, runs * (double)steps / elapsed / 1e6);
+  printf("unstable: %ld (%.3f%%)  not settled within %.0f%%: %ld (%.3f%%)\n",
+         unstable, 100.0 * unstable / runs, band * 100, unsettled, 100.0 * unsettled / runs);
+  if(worst >= 0)
+    printf("worst overshoot: %.2f%% (tau=%.3gs dead=%.3gs)\n",
+           res[worst].overshoot * 100, res[worst].tau, res[worst].dead);
+  else
+    printf("worst overshoot: n/a, all %ld runs unstable\n", runs);
+  if(nSettled){
+    printf("settling time: p50=%.3gs p90=%.3gs p99=%.3gs max=%.3gs\n",
+           settle[(long)(nSettled * 0.50)], settle[(long)(nSettled * 0.90)],
+           settle[(long)(nSettled * 0.99)], settle[nSettled - 1]);
+  }
+  if(verifyRuns > 0)
+    printf("verify: max |overshoot difference| vs PID_Compute over %ld runs = %g\n",
+           verifyRuns, verify(&T, &c, res, verifyRuns));
+
+  free(settle);
+  free(th);
+  free(res);
+  return unstable ? 1 : 0;
+}
@@ -0,0 +1,83 @@
+/**********************************************************************************************
+* Host-side helpers shared by the PID tools in this folder (see pid_tool.h)
+************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "pid_tool.h"
+
+static unsigned long simClock;
+
+unsigned long millis(){
+  return simClock;
+}
+
+void PIDTool_SetClock(unsigned long ms){
+  simClock = ms;
+}
+
+void PIDTool_Defaults(PIDTool_t* p_T){
+  memset(p_T, 0, sizeof(*p_T));
+  p_T->Kp = 2; p_T->Ki = 0.5; p_T->Kd = 0;
+  p_T->POn = P_ON_E;
+  p_T->Direction = DIRECT;
+  p_T->SampleTime = 100;
+  p_T->outMin = 0; p_T->outMax = 255;
+  p_T->setpoint = 1;
+  p_T->plantK = 1; p_T->plantTau = 10; p_T->plantDead = 0;
+}
+
+static double argValue(int argc, char** argv, int* i){
+  if(*i + 1 >= argc){
+    fprintf(stderr, "missing value for %s\n", argv[*i]);
+    exit(2);
+  }
+  return atof(argv[++(*i)]);
+}
+
+bool PIDTool_ParseArg(PIDTool_t* p_T, int argc, char** argv, int* i){
+  const char* a = argv[*i];
+
+  if(!strcmp(a, "-kp")) p_T->Kp = argValue(argc, argv, i);
+  else if(!strcmp(a, "-ki")) p_T->Ki = argValue(argc, argv, i);
+  else if(!strcmp(a, "-kd")) p_T->Kd = argValue(argc, argv, i);
+  else if(!strcmp(a, "-ts")) p_T->SampleTime = (int)argValue(argc, argv, i);
+  else if(!strcmp(a, "-min")) p_T->outMin = argValue(argc, argv, i);
+  else if(!strcmp(a, "-max")) p_T->outMax = argValue(argc, argv, i);
+  else if(!strcmp(a, "-sp")) p_T->setpoint = argValue(argc, argv, i);
+  else if(!strcmp(a, "-K")) p_T->plantK = argValue(argc, argv, i);
+  else if(!strcmp(a, "-tau")) p_T->plantTau = argValue(argc, argv, i);
+  else if(!strcmp(a, "-dead")) p_T->plantDead = argValue(argc, argv, i);
+  else if(!strcmp(a, "-pom")) p_T->POn = P_ON_M;
+  else if(!strcmp(a, "-poe")) p_T->POn = P_ON_E;
+  else if(!strcmp(a, "-reverse")) p_T->Direction = REVERSE;
+  else if(!strcmp(a, "-direct")) p_T->Direction = DIRECT;
+  else return false;
+  return true;
+}
+
+void PIDTool_Setup(PIDTool_t* p_T){
+  PIDTool_SetClock(0);
+  PID_constructor(&p_T->pid, &p_T->input, &p_T->output, &p_T->setpoint,
+          p_T->Kp, p_T->Ki, p_T->Kd, p_T->POn, p_T->Direction);
+  PID_SetSampleTime(&p_T->pid, p_T->SampleTime);
+  PID_SetOutputLimits(&p_T->pid, p_T->outMin, p_T->outMax);
+}
+
+void PIDTool_PrintConfig(const PIDTool_t* p_T){
+  printf("PID: Kp=%g Ki=%g Kd=%g SampleTime=%dms %s %s limits=[%g, %g]\n",
+         p_T->Kp, p_T->Ki, p_T->Kd, p_T->SampleTime,
+         p_T->POn == P_ON_E ? "P_ON_E" : "P_ON_M",
+         p_T->Direction == DIRECT ? "DIRECT" : "REVERSE",
+         p_T->outMin, p_T->outMax);
+  printf("plant: K=%g tau=%gs dead=%gs\n", p_T->plantK, p_T->plantTau, p_T->plantDead);
+}
+
+void PIDTool_PrintUsage(void){
+  printf("PID options:   -kp X -ki X -kd X -ts MS -min X -max X -sp X\n"
+         "               -poe | -pom   -direct | -reverse\n"
+         "plant options: -K X -tau SEC -dead SEC\n");
+}
@@ -0,0 +1,47 @@
+/**********************************************************************************************
+* Host-side helpers shared by the PID tools in this folder.
+*
+* The tools link the real PID.c, so every PID_t they analyse is configured through
+* PID_constructor / PID_SetSampleTime / PID_SetOutputLimits exactly like on the ESP32.
+* PID.c expects millis() from the program on host builds; pid_tool.c provides it as a
+* simulated clock that the tools advance by hand.
+************************************************************************************************/
+
+#ifndef PID_tool_h
+#define PID_tool_h
+
+#include <stdbool.h>
+#include "../PID.h"
+
+typedef struct{
+
+  PID_t pid;                    // * controller under analysis, configured by PIDTool_Setup()
+  double input, output, setpoint;  //   variables the PID_t points at
+
+  double Kp, Ki, Kd;            // * user-entered tuning, as given to PID_SetTunings()
+  int POn, Direction;
+  int SampleTime;               // * ms, as given to PID_SetSampleTime()
+  double outMin, outMax;
+
+  double plantK;                // * nominal first order plus dead time plant:
+  double plantTau;              //   K * exp(-s*dead) / (tau*s + 1), tau and dead in seconds
+  double plantDead;
+
+}PIDTool_t;
+
+//fills in the defaults (PID library defaults, unity plant with tau=10s)
+void PIDTool_Defaults(PIDTool_t* p_T);
+
+//consumes one option at argv[*i] (and its value); returns false if it is not a PID/plant option
+bool PIDTool_ParseArg(PIDTool_t* p_T, int argc, char** argv, int* i);
+
+//runs the PID library setup sequence with the parsed parameters
+void PIDTool_Setup(PIDTool_t* p_T);
+
+void PIDTool_PrintConfig(const PIDTool_t* p_T);
+void PIDTool_PrintUsage(void);
+
+//simulated clock behind millis()
+void PIDTool_SetClock(unsigned long ms);
+
+#endif
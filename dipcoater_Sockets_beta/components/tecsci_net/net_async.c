@@ -0,0 +1,435 @@
+/* Stackless coroutines over non-blocking sockets (see net_async.h) */
+#include "net_async.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#define EPOLL_BATCH 64
+#endif
+
+static const char *TAG = "net_async";
+
+/* timer heap ----------------------------------------------------------------------------- */
+
+static void heap_set(net_async_t *a, int i, net_task_t *t)
+{
+    a->timers[i] = t;
+    t->heap = i;
+}
+
+static void heap_up(net_async_t *a, int i)
+{
+    net_task_t *t = a->timers[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (a->timers[parent]->deadline_us <= t->deadline_us) {
+            break;
+        }
+        heap_set(a, i, a->timers[parent]);
+        i = parent;
+    }
+    heap_set(a, i, t);
+}
+
+static void heap_down(net_async_t *a, int i)
+{
+    net_task_t *t = a->timers[i];
+    while (1) {
+        int c = 2 * i + 1;
+        if (c >= a->ntimers) {
+            break;
+        }
+        if (c + 1 < a->ntimers && a->timers[c + 1]->deadline_us < a->timers[c]->deadline_us) {
+            c++;
+        }
+        if (t->deadline_us <= a->timers[c]->deadline_us) {
+            break;
+        }
+        heap_set(a, i, a->timers[c]);
+        i = c;
+    }
+    heap_set(a, i, t);
+}
+
+static void timer_add(net_async_t *a, net_task_t *t)
+{
+    if (t->heap >= 0 || t->deadline_us == INT64_MAX) {
+        return;
+    }
+    if (a->ntimers == NET_ASYNC_MAX_TASKS) {
+        NET_LOGW(TAG, "timer heap full, a timeout is lost");
+        return;
+    }
+    heap_set(a, a->ntimers++, t);
+    heap_up(a, t->heap);
+}
+
+static void timer_del(net_async_t *a, net_task_t *t)
+{
+    int i = t->heap;
+    if (i < 0) {
+        return;
+    }
+    t->heap = -1;
+    net_task_t *last = a->timers[--a->ntimers];
+    if (i == a->ntimers) {
+        return;
+    }
+    heap_set(a, i, last);
+    heap_up(a, i);
+    heap_down(a, last->heap);
+}
+
+/* scheduling ----------------------------------------------------------------------------- */
+
+void net_async_ready(net_async_t *a, net_task_t *t)
+{
+    if (t->queued) {
+        return;
+    }
+    t->queued = true;
+    t->next = NULL;
+    if (a->ready_tail) {
+        a->ready_tail->next = t;
+    } else {
+        a->ready = t;
+    }
+    a->ready_tail = t;
+}
+
+/* readiness seen on the task's socket */
+static void wake(net_async_t *a, net_task_t *t, uint8_t events)
+{
+    t->events |= events;
+    if (t->wait & events) {
+        net_async_ready(a, t);
+    }
+}
+
+int net_async_init(net_async_t *a)
+{
+    memset(a, 0, sizeof(*a));
+#ifdef __linux__
+    a->epoll_fd = epoll_create1(0);
+    if (a->epoll_fd < 0) {
+        NET_LOGE(TAG, "epoll_create1 failed: errno %d", errno);
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+void net_async_deinit(net_async_t *a)
+{
+#ifdef __linux__
+    close(a->epoll_fd);
+#endif
+    a->ready = a->ready_tail = NULL;
+    a->ntimers = 0;
+}
+
+void net_async_start(net_async_t *a, net_task_t *t, net_task_fn_t fn)
+{
+    memset(t, 0, sizeof(*t));
+    t->fn = fn;
+    t->fd = -1;
+    t->heap = -1;
+    t->deadline_us = INT64_MAX;
+    a->stats.started++;
+    net_async_ready(a, t);
+}
+
+int net_async_attach(net_async_t *a, net_task_t *t, int fd)
+{
+    net_set_nonblocking(fd);
+    t->fd = fd;
+    t->events = 0;
+#ifdef __linux__
+    /* edge triggered for both directions, once: a waiting session needs no epoll_ctl, it
+       only has to have run into EAGAIN before it waits */
+    struct epoll_event ev = {
+        .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+        .data.ptr = t,
+    };
+    if (epoll_ctl(a->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        NET_LOGE(TAG, "epoll_ctl failed: errno %d", errno);
+        t->fd = -1;
+        close(fd);
+        return -1;
+    }
+#else
+    if (a->nattached == NET_ASYNC_MAX_TASKS) {
+        NET_LOGW(TAG, "too many sockets");
+        t->fd = -1;
+        close(fd);
+        return -1;
+    }
+    a->attached[a->nattached++] = t;
+#endif
+    return 0;
+}
+
+void net_async_detach(net_async_t *a, net_task_t *t)
+{
+    if (t->fd < 0) {
+        return;
+    }
+#ifdef __linux__
+    epoll_ctl(a->epoll_fd, EPOLL_CTL_DEL, t->fd, NULL);
+#else
+    for (int i = 0; i < a->nattached; i++) {
+        if (a->attached[i] == t) {
+            a->attached[i] = a->attached[--a->nattached];
+            break;
+        }
+    }
+#endif
+    close(t->fd);
+    t->fd = -1;
+    t->events = 0;
+}
+
+void net_async_finish(net_async_t *a, net_task_t *t)
+{
+    net_async_detach(a, t);
+    timer_del(a, t);
+    t->lc = 0;
+    t->wait = 0;
+    a->stats.finished++;
+}
+
+/* operations ----------------------------------------------------------------------------- */
+
+void net_async_arm(net_async_t *a, net_task_t *t, int timeout_ms)
+{
+    timer_del(a, t);
+    t->deadline_us = timeout_ms > 0 ? net_time_us() + (int64_t)timeout_ms * 1000 : INT64_MAX;
+    t->timed_out = false;
+}
+
+/* the operation can't go on before 'events': wait for them, unless time is up */
+static bool must_wait(net_async_t *a, net_task_t *t, uint8_t events)
+{
+    if (t->timed_out) {
+        t->wait = 0;
+        t->result = -1;
+        return false;
+    }
+    t->events &= ~events;
+    t->wait = events;
+    timer_add(a, t);
+    return true;
+}
+
+static bool done(net_async_t *a, net_task_t *t, int result)
+{
+    timer_del(a, t);
+    t->wait = 0;
+    t->result = result;
+    return false;
+}
+
+bool net_async_recv(net_async_t *a, net_task_t *t, void *buf, size_t len)
+{
+    if (t->fd < 0) {
+        return done(a, t, -1);
+    }
+    ssize_t n = recv(t->fd, buf, len, 0);
+    if (n >= 0) {
+        return done(a, t, (int)n);
+    }
+    if (net_would_block(errno)) {
+        return must_wait(a, t, NET_WAIT_READ);
+    }
+    return done(a, t, -1);
+}
+
+bool net_async_send(net_async_t *a, net_task_t *t, const void *buf, size_t len)
+{
+    if (t->fd < 0) {
+        return done(a, t, -1);
+    }
+    while (t->io_done < len) {
+        ssize_t n = send(t->fd, (const uint8_t *)buf + t->io_done, len - t->io_done, MSG_NOSIGNAL);
+        if (n > 0) {
+            t->io_done += (uint32_t)n;
+        } else if (n < 0 && net_would_block(errno)) {
+            return must_wait(a, t, NET_WAIT_WRITE);
+        } else {
+            return done(a, t, -1);
+        }
+    }
+    return done(a, t, (int)len);
+}
+
+bool net_async_accept(net_async_t *a, net_task_t *t)
+{
+    if (t->fd < 0) {
+        return done(a, t, -1);
+    }
+    int fd = accept(t->fd, NULL, NULL);
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return done(a, t, fd);
+    }
+    if (net_would_block(errno) || errno == ECONNABORTED || errno == EINTR) {
+        return must_wait(a, t, NET_WAIT_READ);
+    }
+    NET_LOGW(TAG, "accept failed: errno %d", errno);
+    return done(a, t, -1);
+}
+
+/* t->result is 1 on the first call (NET_PT_CONNECT), 0 once connect() is under way */
+bool net_async_connect(net_async_t *a, net_task_t *t, const struct sockaddr_in *addr)
+{
+    if (t->result == 1) {
+        int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (fd < 0 || net_async_attach(a, t, fd) < 0) {
+            return done(a, t, -1);
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        t->result = 0;
+        if (connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) == 0) {
+            return done(a, t, 0);
+        }
+        if (!net_would_block(errno)) {
+            net_async_detach(a, t);
+            return done(a, t, -1);
+        }
+        return must_wait(a, t, NET_WAIT_WRITE);
+    }
+    int err = 0;
+    socklen_t elen = sizeof(err);
+    if (!t->timed_out && !(t->events & NET_WAIT_WRITE)) {
+        return must_wait(a, t, NET_WAIT_WRITE);
+    }
+    if (t->timed_out || getsockopt(t->fd, SOL_SOCKET, SO_ERROR, &err, &elen) < 0 || err != 0) {
+        net_async_detach(a, t);
+        return done(a, t, -1);
+    }
+    return done(a, t, 0);
+}
+
+bool net_async_sleep(net_async_t *a, net_task_t *t)
+{
+    if (t->timed_out) {
+        t->timed_out = false;
+        return done(a, t, 0);
+    }
+    return must_wait(a, t, 0);
+}
+
+/* loop ----------------------------------------------------------------------------------- */
+
+static int wait_ms(net_async_t *a, int timeout_ms)
+{
+    if (a->ready) {
+        return 0;
+    }
+    if (a->ntimers > 0) {
+        int64_t left = a->timers[0]->deadline_us - net_time_us();
+        int ms = left <= 0 ? 0 : (int)((left + 999) / 1000);
+        if (timeout_ms < 0 || ms < timeout_ms) {
+            return ms;
+        }
+    }
+    return timeout_ms;
+}
+
+static int poll_sockets(net_async_t *a, int timeout_ms)
+{
+    a->stats.polls++;
+#ifdef __linux__
+    struct epoll_event events[EPOLL_BATCH];
+    int n = epoll_wait(a->epoll_fd, events, EPOLL_BATCH, timeout_ms);
+    if (n < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    for (int i = 0; i < n; i++) {
+        uint32_t e = events[i].events;
+        uint8_t ev = 0;
+        if (e & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            ev |= NET_WAIT_READ;
+        }
+        if (e & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+            ev |= NET_WAIT_WRITE;
+        }
+        wake(a, events[i].data.ptr, ev);
+    }
+    return n;
+#else
+    fd_set rfds, wfds;
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    int max_fd = -1;
+    for (int i = 0; i < a->nattached; i++) {
+        net_task_t *t = a->attached[i];
+        if (t->wait & NET_WAIT_READ) {
+            FD_SET(t->fd, &rfds);
+        }
+        if (t->wait & NET_WAIT_WRITE) {
+            FD_SET(t->fd, &wfds);
+        }
+        if (t->wait && t->fd > max_fd) {
+            max_fd = t->fd;
+        }
+    }
+    if (max_fd < 0) {
+        if (timeout_ms > 0) {
+            net_sleep_ms(timeout_ms);
+        }
+        return 0;
+    }
+    struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+    int n = select(max_fd + 1, &rfds, &wfds, NULL, timeout_ms < 0 ? NULL : &tv);
+    if (n <= 0) {
+        return n < 0 && errno != EINTR ? -1 : 0;
+    }
+    for (int i = 0; i < a->nattached; i++) {
+        net_task_t *t = a->attached[i];
+        uint8_t ev = 0;
+        if (FD_ISSET(t->fd, &rfds)) {
+            ev |= NET_WAIT_READ;
+        }
+        if (FD_ISSET(t->fd, &wfds)) {
+            ev |= NET_WAIT_WRITE;
+        }
+        if (ev) {
+            wake(a, t, ev);
+        }
+    }
+    return n;
+#endif
+}
+
+int net_async_run(net_async_t *a, int timeout_ms)
+{
+    if (poll_sockets(a, wait_ms(a, timeout_ms)) < 0) {
+        NET_LOGE(TAG, "poll failed: errno %d", errno);
+        return -1;
+    }
+    int64_t now = net_time_us();
+    while (a->ntimers > 0 && a->timers[0]->deadline_us <= now) {
+        net_task_t *t = a->timers[0];
+        timer_del(a, t);
+        t->timed_out = true;
+        a->stats.timeouts++;
+        net_async_ready(a, t);
+    }
+
+    /* only what is ready now: a session that yields runs again next round */
+    net_task_t *t = a->ready;
+    a->ready = a->ready_tail = NULL;
+    int ran = 0;
+    while (t) {
+        net_task_t *next = t->next;
+        t->queued = false;
+        t->wait = 0;
+        a->stats.resumes++;
+        ran++;
+        t->fn(a, t);
+        t = next;
+    }
+    return ran;
+}
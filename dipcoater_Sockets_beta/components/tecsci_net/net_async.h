@@ -0,0 +1,208 @@
+/* Stackless coroutines over non-blocking sockets for the dip-coater socket projects
+
+   The first tcp_client / tcp_server projects give every protocol session its own FreeRTOS
+   task with blocking socket calls, and every task its own stack of several kB.  Here a
+   session is a protothread instead: a function that is written top to bottom like the
+   blocking version, but returns to the scheduler wherever it would block and carries on
+   from the same line when its socket is ready or its timer expires.  Many sessions
+   (clients, server connections, heartbeats, uploads) run inside one task; all a session
+   costs is its own struct.
+
+   The price of having no stack: local variables don't survive a wait.  Whatever a session
+   needs across NET_PT_* operations lives in its struct, which starts with a net_task_t.
+   The operations use the source line as resume point, so two of them can't share a line,
+   and a NET_PT_* operation can't be used inside a switch of the session's own.  Their
+   buf and len arguments are evaluated again every time the session is resumed, so they
+   must not have side effects (encode into the buffer first, then send it).
+
+       typedef struct {
+           net_task_t task;                // first
+           uint32_t corr;
+           size_t len;
+           uint8_t buf[16];
+       } pinger_t;
+
+       static int pinger(net_async_t *a, net_task_t *t)
+       {
+           pinger_t *p = (pinger_t *)t;
+           NET_PT_BEGIN(t);
+           NET_PT_CONNECT(a, t, &server_addr, 1000);
+           if (t->result < 0) {
+               NET_PT_EXIT(a, t);
+           }
+           while (1) {
+               p->len = encode_ping(p->buf, p->corr++);
+               NET_PT_SEND(a, t, p->buf, p->len, 1000);
+               NET_PT_RECV(a, t, p->buf, sizeof(p->buf), 1000);
+               if (t->result <= 0) {
+                   break;
+               }
+               NET_PT_SLEEP(a, t, 500);
+           }
+           NET_PT_END(a, t);           // closes the socket
+       }
+
+       static net_async_t loop;
+       net_async_init(&loop);
+       net_async_start(&loop, &p.task, pinger);
+       while (1) {
+           net_async_run(&loop, 100);
+       }
+
+   Readiness comes from epoll on Linux (edge triggered, so a waiting session costs no
+   system call) and from select() on lwIP; timeouts and sleeps are kept in a binary heap.
+*/
+#ifndef NET_ASYNC_H
+#define NET_ASYNC_H
+
+#include "net_port.h"
+
+/* sessions with a socket or a timer at the same time */
+#ifndef NET_ASYNC_MAX_TASKS
+#ifdef ESP_PLATFORM
+#define NET_ASYNC_MAX_TASKS 32
+#else
+#define NET_ASYNC_MAX_TASKS 4096
+#endif
+#endif
+
+#define NET_PT_WAITING  0
+#define NET_PT_DONE     1
+
+#define NET_WAIT_READ   0x01
+#define NET_WAIT_WRITE  0x02
+
+typedef struct net_async net_async_t;
+typedef struct net_task net_task_t;
+
+typedef int (*net_task_fn_t)(net_async_t *a, net_task_t *t);
+
+struct net_task {
+    net_task_fn_t fn;
+    net_task_t *next;                   /* ready list */
+    int64_t deadline_us;                /* of the running operation, INT64_MAX for none */
+    int32_t heap;                       /* index in the timer heap, -1 when not in it */
+    int fd;                             /* the session's socket, -1 for none */
+    int result;                         /* of the last operation, see the NET_PT_* macros */
+    uint32_t io_done;                   /* bytes of the running send done */
+    uint16_t lc;                        /* line to resume at, 0 = from the start */
+    uint8_t events;                     /* readiness seen and not used up yet */
+    uint8_t wait;                       /* readiness waited for */
+    bool queued;                        /* on the ready list */
+    bool timed_out;
+};
+
+typedef struct {
+    uint32_t started;
+    uint32_t finished;
+    uint32_t resumes;                   /* session functions called */
+    uint32_t timeouts;
+    uint32_t polls;                     /* epoll_wait() / select() calls */
+} net_async_stats_t;
+
+struct net_async {
+#ifdef __linux__
+    int epoll_fd;
+#else
+    net_task_t *attached[NET_ASYNC_MAX_TASKS];  /* sessions with a socket, for select() */
+    int nattached;
+#endif
+    net_task_t *ready, *ready_tail;
+    int ntimers;
+    net_async_stats_t stats;
+    net_task_t *timers[NET_ASYNC_MAX_TASKS];    /* min heap on deadline_us */
+};
+
+int net_async_init(net_async_t *a);
+void net_async_deinit(net_async_t *a);
+
+/* runs fn from the start on the next net_async_run() */
+void net_async_start(net_async_t *a, net_task_t *t, net_task_fn_t fn);
+
+/* waits up to timeout_ms for sockets and timers (less when a timer is due earlier) and
+   runs every session that can go on; returns the number of sessions run, -1 on error */
+int net_async_run(net_async_t *a, int timeout_ms);
+
+/* hands a socket to the session (made non-blocking; NET_PT_ACCEPT and NET_PT_CONNECT do
+   it themselves); detach closes it */
+int net_async_attach(net_async_t *a, net_task_t *t, int fd);
+void net_async_detach(net_async_t *a, net_task_t *t);
+
+/* the steps behind the macros; true while the session has to wait */
+void net_async_arm(net_async_t *a, net_task_t *t, int timeout_ms);
+bool net_async_recv(net_async_t *a, net_task_t *t, void *buf, size_t len);
+bool net_async_send(net_async_t *a, net_task_t *t, const void *buf, size_t len);
+bool net_async_accept(net_async_t *a, net_task_t *t);
+bool net_async_connect(net_async_t *a, net_task_t *t, const struct sockaddr_in *addr);
+bool net_async_sleep(net_async_t *a, net_task_t *t);
+void net_async_ready(net_async_t *a, net_task_t *t);
+void net_async_finish(net_async_t *a, net_task_t *t);
+
+/* protothread macros ---------------------------------------------------------------------
+   Each operation leaves its outcome in t->result; t->timed_out tells a timeout from an
+   error.  A timeout_ms of 0 waits for ever. */
+
+#if defined(__GNUC__) && __GNUC__ >= 7
+#define NET_PT_FALL         __attribute__((fallthrough))
+#else
+#define NET_PT_FALL         do { } while (0)
+#endif
+
+#define NET_PT_BEGIN(t)     switch ((t)->lc) { case 0:
+
+/* the session is over: its socket is closed and its timer dropped */
+#define NET_PT_END(a, t)    } net_async_finish(a, t); return NET_PT_DONE
+
+#define NET_PT_EXIT(a, t)   do { net_async_finish(a, t); return NET_PT_DONE; } while (0)
+
+/* result: bytes received, 0 when the peer closed, -1 on error or timeout */
+#define NET_PT_RECV(a, t, buf, len, timeout_ms)                             \
+    do {                                                                    \
+        net_async_arm(a, t, timeout_ms);                                    \
+        (t)->lc = __LINE__; NET_PT_FALL; case __LINE__:                     \
+        if (net_async_recv(a, t, buf, len)) return NET_PT_WAITING;          \
+    } while (0)
+
+/* all len bytes; result: len, or -1 on error or timeout */
+#define NET_PT_SEND(a, t, buf, len, timeout_ms)                             \
+    do {                                                                    \
+        net_async_arm(a, t, timeout_ms);                                    \
+        (t)->io_done = 0;                                                   \
+        (t)->lc = __LINE__; NET_PT_FALL; case __LINE__:                     \
+        if (net_async_send(a, t, buf, len)) return NET_PT_WAITING;          \
+    } while (0)
+
+/* on the listening socket attached to t; result: the new connection's socket or -1 */
+#define NET_PT_ACCEPT(a, t, timeout_ms)                                     \
+    do {                                                                    \
+        net_async_arm(a, t, timeout_ms);                                    \
+        (t)->lc = __LINE__; NET_PT_FALL; case __LINE__:                     \
+        if (net_async_accept(a, t)) return NET_PT_WAITING;                  \
+    } while (0)
+
+/* opens the session's socket; result: 0 when connected, -1 otherwise */
+#define NET_PT_CONNECT(a, t, addr, timeout_ms)                              \
+    do {                                                                    \
+        net_async_arm(a, t, timeout_ms);                                    \
+        (t)->result = 1;                                                    \
+        (t)->lc = __LINE__; NET_PT_FALL; case __LINE__:                     \
+        if (net_async_connect(a, t, addr)) return NET_PT_WAITING;           \
+    } while (0)
+
+/* a sleep of 0 ms lets the sessions that are ready run first, like NET_PT_YIELD */
+#define NET_PT_SLEEP(a, t, ms)                                              \
+    do {                                                                    \
+        net_async_arm(a, t, ms);                                            \
+        if ((t)->deadline_us == INT64_MAX) (t)->deadline_us = 0;            \
+        (t)->lc = __LINE__; NET_PT_FALL; case __LINE__:                     \
+        if (net_async_sleep(a, t)) return NET_PT_WAITING;                   \
+    } while (0)
+
+/* lets the other sessions run first */
+#define NET_PT_YIELD(a, t)                                                  \
+    do {                                                                    \
+        net_async_ready(a, t);                                              \
+        (t)->lc = __LINE__; return NET_PT_WAITING; case __LINE__:;          \
+    } while (0)
+
+#endif
@@ -0,0 +1,56 @@
+/* Receive buffer pool (see net_buf.h) */
+#include "net_buf.h"
+
+void net_buf_pool_init(net_buf_pool_t *pool)
+{
+    net_lock_t init = NET_LOCK_INIT;
+    pool->lock = init;
+    pool->free = NULL;
+    for (int i = NET_BUF_COUNT - 1; i >= 0; i--) {
+        pool->bufs[i].pool = pool;
+        pool->bufs[i].refs = 0;
+        pool->bufs[i].queued = 0;
+        pool->bufs[i].next = pool->free;
+        pool->free = &pool->bufs[i];
+    }
+    pool->nfree = NET_BUF_COUNT;
+    memset(&pool->stats, 0, sizeof(pool->stats));
+    pool->stats.min_free = NET_BUF_COUNT;
+}
+
+net_buf_t *net_buf_get(net_buf_pool_t *pool)
+{
+    net_lock(&pool->lock);
+    net_buf_t *buf = pool->free;
+    if (buf) {
+        pool->free = buf->next;
+        pool->nfree--;
+        pool->stats.gets++;
+        if (pool->nfree < pool->stats.min_free) {
+            pool->stats.min_free = pool->nfree;
+        }
+    } else {
+        pool->stats.empty++;
+    }
+    net_unlock(&pool->lock);
+    if (buf) {
+        buf->next = NULL;
+        buf->refs = 1;
+        buf->len = 0;
+        buf->queued = 0;
+    }
+    return buf;
+}
+
+void net_buf_release(net_buf_t *buf)
+{
+    if (__atomic_sub_fetch(&buf->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+    net_buf_pool_t *pool = buf->pool;
+    net_lock(&pool->lock);
+    buf->next = pool->free;
+    pool->free = buf;
+    pool->nfree++;
+    net_unlock(&pool->lock);
+}
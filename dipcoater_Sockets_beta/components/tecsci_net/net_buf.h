@@ -0,0 +1,77 @@
+/* Receive buffer pool for the dip-coater socket servers
+
+   A fixed number of slabs allocated once with the pool; nothing on the receive path
+   calls malloc.  net_server receives straight into a slab and hands the handler pointers
+   into it, and a handler that wants to keep a parsed frame beyond on_data (queue it for
+   the control task, for instance) takes a reference with net_conn_hold() instead of
+   copying the bytes out.  The slab goes back to the free list when the last reference is
+   released, from any task.  The same slabs carry frames that are serialized once and
+   queued on several connections (net_server_send_buf()).
+*/
+#ifndef NET_BUF_H
+#define NET_BUF_H
+
+#include "net_port.h"
+
+/* one slab holds the largest tecsci_proto frame */
+#ifndef NET_BUF_SIZE
+#ifdef ESP_PLATFORM
+#define NET_BUF_SIZE 1536
+#else
+#define NET_BUF_SIZE 2048
+#endif
+#endif
+
+#ifndef NET_BUF_COUNT
+#ifdef ESP_PLATFORM
+#define NET_BUF_COUNT 12
+#else
+#define NET_BUF_COUNT 1024
+#endif
+#endif
+
+typedef struct net_buf_pool net_buf_pool_t;
+
+typedef struct net_buf {
+    struct net_buf *next;               /* free list link */
+    net_buf_pool_t *pool;
+    uint32_t refs;
+    size_t len;                         /* bytes used, for slabs queued for sending */
+    uint16_t queued;                    /* send queues holding it (server task only) */
+    uint8_t data[NET_BUF_SIZE];
+} net_buf_t;
+
+typedef struct {
+    uint32_t gets;
+    uint32_t empty;                     /* net_buf_get() found no free slab */
+    uint32_t min_free;
+} net_buf_stats_t;
+
+struct net_buf_pool {
+    net_lock_t lock;
+    net_buf_t *free;
+    uint32_t nfree;
+    net_buf_stats_t stats;
+    net_buf_t bufs[NET_BUF_COUNT];
+};
+
+void net_buf_pool_init(net_buf_pool_t *pool);
+
+/* returns a slab with one reference, or NULL if the pool is empty */
+net_buf_t *net_buf_get(net_buf_pool_t *pool);
+
+static inline net_buf_t *net_buf_ref(net_buf_t *buf)
+{
+    __atomic_add_fetch(&buf->refs, 1, __ATOMIC_RELAXED);
+    return buf;
+}
+
+/* drops one reference; the last one returns the slab to its pool */
+void net_buf_release(net_buf_t *buf);
+
+static inline bool net_buf_shared(const net_buf_t *buf)
+{
+    return __atomic_load_n(&buf->refs, __ATOMIC_ACQUIRE) > 1;
+}
+
+#endif
@@ -0,0 +1,265 @@
+/* Pipelined request client (see net_client.h) */
+#include "net_client.h"
+
+static const char *TAG = "net_client";
+
+#define INFLIGHT_MASK (NET_CLIENT_MAX_INFLIGHT - 1)
+#define SWEEP_PERIOD_US 10000
+
+void net_client_init(net_client_t *c, proto_handler_t on_frame, void *frame_arg)
+{
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+    c->next_corr = 1;
+    c->timeout_us = 2000000;
+    c->on_frame = on_frame;
+    c->frame_arg = frame_arg;
+}
+
+int net_client_connect(net_client_t *c, const char *host, uint16_t port, int timeout_ms)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = inet_addr(host),
+    };
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (fd < 0) {
+        NET_LOGE(TAG, "Unable to create socket: errno %d", errno);
+        return -1;
+    }
+    net_set_nonblocking(fd);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        if (!net_would_block(errno)) {
+            NET_LOGE(TAG, "Socket unable to connect: errno %d", errno);
+            close(fd);
+            return -1;
+        }
+        fd_set wfds;
+        FD_ZERO(&wfds);
+        FD_SET(fd, &wfds);
+        struct timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+        int err = 0;
+        socklen_t err_len = sizeof(err);
+        if (select(fd + 1, NULL, &wfds, NULL, &tv) != 1 ||
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) != 0 || err != 0) {
+            NET_LOGE(TAG, "Socket unable to connect to %s:%u: errno %d", host, port, err ? err : ETIMEDOUT);
+            close(fd);
+            return -1;
+        }
+    }
+    int opt = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+    c->fd = fd;
+    c->last_rx_us = net_time_us();
+    c->rx_len = 0;
+    c->tx_off = c->tx_len = 0;
+    NET_LOGI(TAG, "Successfully connected to %s:%u", host, port);
+    return 0;
+}
+
+static void fail_inflight(net_client_t *c, int status, bool only_overdue, int64_t now)
+{
+    for (int i = 0; i < NET_CLIENT_MAX_INFLIGHT && c->inflight > 0; i++) {
+        net_request_t *r = &c->req[i];
+        if (r->corr == 0 || (only_overdue && now - r->sent_us < c->timeout_us)) {
+            continue;
+        }
+        uint32_t corr = r->corr;
+        r->corr = 0;
+        c->inflight--;
+        if (status == NET_CLIENT_TIMEOUT) {
+            c->stats.timeouts++;
+        }
+        if (r->cb) {
+            r->cb(r->arg, corr, status, NULL);
+        }
+    }
+}
+
+void net_client_close(net_client_t *c)
+{
+    if (c->fd >= 0) {
+        shutdown(c->fd, 0);
+        close(c->fd);
+        c->fd = -1;
+    }
+    c->rx_len = 0;
+    c->tx_off = c->tx_len = 0;
+    fail_inflight(c, NET_CLIENT_CLOSED, false, 0);
+}
+
+static int queue_frame(net_client_t *c, const uint8_t *frame, size_t len, uint32_t corr)
+{
+    size_t need = len + (corr ? PROTO_CORR_SIZE : 0);
+    if (c->tx_len + need > NET_CLIENT_TX_SIZE) {
+        return -1;
+    }
+    if (c->tx_off + c->tx_len + need > NET_CLIENT_TX_SIZE) {
+        memmove(c->tx, c->tx + c->tx_off, c->tx_len);
+        c->tx_off = 0;
+    }
+    uint8_t *dst = c->tx + c->tx_off + c->tx_len;
+    memcpy(dst, frame, len);
+    if (corr && proto_set_corr(dst, NET_CLIENT_TX_SIZE - (dst - c->tx), len, corr) == 0) {
+        return -1;
+    }
+    c->tx_len += need;
+    return 0;
+}
+
+uint32_t net_client_request(net_client_t *c, const uint8_t *frame, size_t len,
+                            net_client_cb_t cb, void *arg)
+{
+    if (c->fd < 0 || c->inflight >= NET_CLIENT_MAX_INFLIGHT) {
+        c->stats.rejected++;
+        return 0;
+    }
+    /* ids run in order, skip the ones whose slot is still waiting for an old answer */
+    while (c->next_corr == 0 || c->req[c->next_corr & INFLIGHT_MASK].corr != 0) {
+        c->next_corr++;
+    }
+    uint32_t corr = c->next_corr++;
+    if (queue_frame(c, frame, len, corr) != 0) {
+        c->stats.rejected++;
+        return 0;
+    }
+    net_request_t *r = &c->req[corr & INFLIGHT_MASK];
+    r->corr = corr;
+    r->sent_us = net_time_us();
+    r->cb = cb;
+    r->arg = arg;
+    c->inflight++;
+    c->stats.sent++;
+    if ((uint32_t)c->inflight > c->stats.max_inflight) {
+        c->stats.max_inflight = c->inflight;
+    }
+    return corr;
+}
+
+int net_client_send(net_client_t *c, const uint8_t *frame, size_t len)
+{
+    if (c->fd < 0 || queue_frame(c, frame, len, 0) != 0) {
+        c->stats.rejected++;
+        return -1;
+    }
+    return 0;
+}
+
+static void dispatch(const proto_frame_t *frame, void *arg)
+{
+    net_client_t *c = arg;
+    if ((frame->flags & (PROTO_F_CORR | PROTO_F_RESPONSE)) != (PROTO_F_CORR | PROTO_F_RESPONSE)) {
+        if (c->on_frame) {
+            c->on_frame(frame, c->frame_arg);
+        }
+        return;
+    }
+    net_request_t *r = &c->req[frame->corr & INFLIGHT_MASK];
+    if (frame->corr == 0 || r->corr != frame->corr) {
+        return;     /* answer to a request that already timed out */
+    }
+    r->corr = 0;
+    c->inflight--;
+    c->stats.completed++;
+    int status = PROTO_ACK_OK;
+    uint8_t type, ack;
+    if (frame->type == PROTO_MSG_ACK && proto_read_ack(frame, &type, &ack)) {
+        status = ack;
+    }
+    if (r->cb) {
+        r->cb(r->arg, frame->corr, status, frame);
+    }
+}
+
+static int flush_tx(net_client_t *c)
+{
+    while (c->tx_len > 0) {
+        int n = send(c->fd, c->tx + c->tx_off, c->tx_len, 0);
+        c->stats.send_calls++;
+        if (n < 0) {
+            if (net_would_block(errno)) {
+                break;
+            }
+            NET_LOGE(TAG, "Error occurred during sending: errno %d", errno);
+            return -1;
+        }
+        c->tx_off += n;
+        c->tx_len -= n;
+    }
+    if (c->tx_len == 0) {
+        c->tx_off = 0;
+    }
+    return 0;
+}
+
+static int read_rx(net_client_t *c)
+{
+    while (1) {
+        int n = recv(c->fd, c->rx + c->rx_len, NET_CLIENT_RX_SIZE - c->rx_len, 0);
+        if (n < 0) {
+            if (net_would_block(errno)) {
+                return 0;
+            }
+            NET_LOGE(TAG, "recv failed: errno %d", errno);
+            return -1;
+        }
+        if (n == 0) {
+            NET_LOGW(TAG, "Connection closed by server");
+            return -1;
+        }
+        c->rx_len += n;
+        c->last_rx_us = net_time_us();
+        int used = proto_consume(c->rx, c->rx_len, dispatch, c);
+        if (c->fd < 0) {
+            return -1;      /* closed from a callback */
+        }
+        if (used < 0) {
+            NET_LOGE(TAG, "Malformed frame from server");
+            return -1;
+        }
+        memmove(c->rx, c->rx + used, c->rx_len - used);
+        c->rx_len -= used;
+    }
+}
+
+int net_client_poll(net_client_t *c, int timeout_ms)
+{
+    if (c->fd < 0) {
+        return -1;
+    }
+    if (flush_tx(c) != 0) {
+        net_client_close(c);
+        return -1;
+    }
+
+    fd_set rfds, wfds;
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    FD_SET(c->fd, &rfds);
+    if (c->tx_len > 0) {
+        FD_SET(c->fd, &wfds);
+    }
+    struct timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+    int ready = select(c->fd + 1, &rfds, &wfds, NULL, &tv);
+    if (ready < 0 && errno != EINTR) {
+        NET_LOGE(TAG, "select failed: errno %d", errno);
+        net_client_close(c);
+        return -1;
+    }
+    if (ready > 0) {
+        if ((FD_ISSET(c->fd, &rfds) && read_rx(c) != 0) ||
+            (c->fd >= 0 && FD_ISSET(c->fd, &wfds) && flush_tx(c) != 0)) {
+            net_client_close(c);
+            return -1;
+        }
+    }
+
+    int64_t now = net_time_us();
+    if (c->inflight > 0 && now >= c->next_sweep_us) {
+        c->next_sweep_us = now + SWEEP_PERIOD_US;
+        fail_inflight(c, NET_CLIENT_TIMEOUT, true, now);
+    }
+    return ready < 0 ? 0 : ready;
+}
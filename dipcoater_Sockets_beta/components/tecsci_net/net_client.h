@@ -0,0 +1,111 @@
+/* Pipelined request client for the dip-coater socket projects
+
+   Keeps one persistent connection to a tecsci server and lets the caller have many
+   requests in flight on it.  Each request is tagged with a correlation id (PROTO_F_CORR,
+   see tecsci_proto.h) and parked in a fixed in-flight table; the callback fires when the
+   answer with the same id comes back, in whatever order the server answers.  Requests
+   issued between two net_client_poll() calls go out together in one send().
+
+   Typical use from the tcp_client task:
+
+       static net_client_t client;
+       net_client_init(&client, on_telemetry, NULL);
+       net_client_connect(&client, HOST_IP_ADDR, PORT, 3000);
+       net_client_request(&client, frame, len, on_ack, NULL);
+       while (1) {
+           net_client_poll(&client, 100);
+       }
+*/
+#ifndef NET_CLIENT_H
+#define NET_CLIENT_H
+
+#include "net_port.h"
+#include "tecsci_proto.h"
+
+/* power of two, the slot of a request is corr & (NET_CLIENT_MAX_INFLIGHT - 1) */
+#ifndef NET_CLIENT_MAX_INFLIGHT
+#ifdef ESP_PLATFORM
+#define NET_CLIENT_MAX_INFLIGHT 32
+#else
+#define NET_CLIENT_MAX_INFLIGHT 1024
+#endif
+#endif
+
+#ifndef NET_CLIENT_RX_SIZE
+#define NET_CLIENT_RX_SIZE 2048
+#endif
+
+#ifndef NET_CLIENT_TX_SIZE
+#define NET_CLIENT_TX_SIZE 4096
+#endif
+
+/* status handed to the callback when no answer arrived */
+#define NET_CLIENT_TIMEOUT  (-1)
+#define NET_CLIENT_CLOSED   (-2)
+
+/* reply is the answer frame (PROTO_MSG_ACK or a typed answer), NULL if status < 0 */
+typedef void (*net_client_cb_t)(void *arg, uint32_t corr, int status, const proto_frame_t *reply);
+
+typedef struct {
+    uint32_t corr;                      /* 0 when the slot is free */
+    int64_t sent_us;
+    net_client_cb_t cb;
+    void *arg;
+} net_request_t;
+
+typedef struct {
+    uint32_t sent;
+    uint32_t completed;
+    uint32_t timeouts;
+    uint32_t rejected;                  /* in-flight table or tx buffer full */
+    uint32_t send_calls;
+    uint32_t max_inflight;
+} net_client_stats_t;
+
+typedef struct {
+    int fd;
+    uint32_t next_corr;
+    int inflight;
+    int64_t timeout_us;                 /* answers later than this complete with NET_CLIENT_TIMEOUT */
+    int64_t next_sweep_us;
+    int64_t last_rx_us;                 /* last time anything arrived from the server */
+
+    proto_handler_t on_frame;           /* frames that aren't answers, e.g. telemetry */
+    void *frame_arg;
+
+    uint8_t rx[NET_CLIENT_RX_SIZE];
+    size_t rx_len;
+    uint8_t tx[NET_CLIENT_TX_SIZE];
+    size_t tx_off, tx_len;
+
+    net_client_stats_t stats;
+    net_request_t req[NET_CLIENT_MAX_INFLIGHT];
+} net_client_t;
+
+void net_client_init(net_client_t *c, proto_handler_t on_frame, void *frame_arg);
+
+/* connects with a timeout; the socket is non-blocking afterwards.  Returns 0 or -1. */
+int net_client_connect(net_client_t *c, const char *host, uint16_t port, int timeout_ms);
+
+/* closes the socket and completes everything in flight with NET_CLIENT_CLOSED */
+void net_client_close(net_client_t *c);
+
+static inline bool net_client_connected(const net_client_t *c)
+{
+    return c->fd >= 0;
+}
+
+/* tags the frame at frame (len bytes, from one of the proto_encode_* functions) with a
+   new correlation id and queues it; returns the id, or 0 if the in-flight table or the
+   tx buffer is full or the client isn't connected */
+uint32_t net_client_request(net_client_t *c, const uint8_t *frame, size_t len,
+                            net_client_cb_t cb, void *arg);
+
+/* queues a frame that expects no answer; returns 0 or -1 */
+int net_client_send(net_client_t *c, const uint8_t *frame, size_t len);
+
+/* sends what is queued, waits up to timeout_ms for answers and dispatches them, and
+   expires overdue requests.  Returns -1 once the connection is lost. */
+int net_client_poll(net_client_t *c, int timeout_ms);
+
+#endif
@@ -0,0 +1,161 @@
+/* Clock synchronization (see net_clock.h) */
+#include <math.h>
+
+#include "net_clock.h"
+
+static const char *TAG = "net_clock";
+
+void net_clock_init(net_clock_t *c)
+{
+    memset(c, 0, sizeof(*c));
+    c->last_used_us = INT64_MIN;
+}
+
+/* (a * q) >> 32 for a q32 factor, rounded toward minus infinity like the shift */
+static inline int64_t mul_q32(int64_t a, int64_t q)
+{
+    return (a * q) >> 32;
+}
+
+int64_t net_clock_shared_us(const net_clock_t *c, int64_t local_us)
+{
+    if (!c->synced) {
+        return local_us;
+    }
+    int64_t d = local_us - c->base_local_us;
+    int64_t s = d < 0 ? 0 : d < c->slew_us ? d : c->slew_us;
+    return c->base_shared_us + d + mul_q32(d, c->rate_q32) + mul_q32(s, c->slew_q32);
+}
+
+/* least squares line through the used offsets, times relative to the newest one */
+static void fit(net_clock_t *c)
+{
+    const net_clock_sample_t *last = &c->hist[(c->hist_next + NET_CLOCK_HISTORY - 1) % NET_CLOCK_HISTORY];
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (int i = 0; i < c->hist_n; i++) {
+        double x = (double)(c->hist[i].mid_us - last->mid_us);
+        double y = (double)(c->hist[i].offset_us - last->offset_us);
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+    double n = c->hist_n;
+    double den = n * sxx - sx * sx;
+    double drift = 0;
+    /* with fewer than 3 points a single noisy delay would decide the drift */
+    if (c->hist_n >= 3 && den > 0) {
+        drift = (n * sxy - sx * sy) / den;
+    }
+    if (drift > NET_CLOCK_MAX_DRIFT_PPM * 1e-6) {
+        drift = NET_CLOCK_MAX_DRIFT_PPM * 1e-6;
+    } else if (drift < -NET_CLOCK_MAX_DRIFT_PPM * 1e-6) {
+        drift = -NET_CLOCK_MAX_DRIFT_PPM * 1e-6;
+    }
+    c->fit_mid_us = last->mid_us;
+    c->fit_drift = drift;
+    c->fit_offset = (double)last->offset_us + (sy - drift * sx) / n;
+}
+
+static void add_history(net_clock_t *c, const net_clock_sample_t *s)
+{
+    /* a reference restart (or a local reset) breaks the line: start over */
+    if (c->hist_n > 0) {
+        double predicted = c->fit_offset + c->fit_drift * (double)(s->mid_us - c->fit_mid_us);
+        if (fabs((double)s->offset_us - predicted) > NET_CLOCK_STEP_US) {
+            c->hist_n = c->hist_next = 0;
+        }
+    }
+    c->hist[c->hist_next] = *s;
+    c->hist_next = (c->hist_next + 1) % NET_CLOCK_HISTORY;
+    if (c->hist_n < NET_CLOCK_HISTORY) {
+        c->hist_n++;
+    }
+    fit(c);
+}
+
+/* rebases the mapping at now and steers it onto the fitted line */
+static void steer(net_clock_t *c, int64_t now)
+{
+    int64_t target = now + (int64_t)llround(c->fit_offset + c->fit_drift * (double)(now - c->fit_mid_us));
+    int64_t cur = net_clock_shared_us(c, now);
+    int64_t err = target - cur;
+
+    c->base_local_us = now;
+    c->base_shared_us = cur;
+    c->rate_q32 = (int64_t)llround(c->fit_drift * 4294967296.0);
+    c->slew_q32 = 0;
+    c->slew_us = 0;
+    c->stats.last_error_us = -err;
+    c->stats.drift_ppb = (int32_t)llround(c->fit_drift * 1e9);
+
+    if (!c->synced || err > NET_CLOCK_STEP_US || err < -NET_CLOCK_STEP_US) {
+        if (c->synced) {
+            NET_LOGW(TAG, "stepping the clock by %lld us", (long long)err);
+        }
+        c->base_shared_us = target;
+        c->synced = true;
+        c->stats.steps++;
+        return;
+    }
+    if (err == 0) {
+        return;
+    }
+    const int64_t max_q32 = ((int64_t)NET_CLOCK_MAX_SLEW_PPM << 32) / 1000000;
+    int64_t slew = (err << 32) / NET_CLOCK_SLEW_US;
+    if (slew > max_q32) {
+        slew = max_q32;
+    } else if (slew < -max_q32) {
+        slew = -max_q32;
+    }
+    if (slew == 0) {
+        slew = err > 0 ? 1 : -1;
+    }
+    c->slew_q32 = slew;
+    c->slew_us = (err << 32) / slew;
+}
+
+int net_clock_update(net_clock_t *c, int64_t t1, int64_t t2, int64_t t3, int64_t t4)
+{
+    c->stats.exchanges++;
+    int64_t delay = (t4 - t1) - (t3 - t2);
+    if (t4 < t1 || t3 < t2 || delay < 0) {
+        c->stats.rejected++;
+        return -1;
+    }
+    net_clock_sample_t *s = &c->filter[c->filter_next];
+    s->mid_us = t1 + (t4 - t1) / 2;
+    s->offset_us = ((t2 - t1) + (t3 - t4)) / 2;
+    s->delay_us = delay;
+    c->filter_next = (c->filter_next + 1) % NET_CLOCK_FILTER;
+    if (c->filter_n < NET_CLOCK_FILTER) {
+        c->filter_n++;
+    }
+
+    const net_clock_sample_t *best = &c->filter[0];
+    for (int i = 1; i < c->filter_n; i++) {
+        if (c->filter[i].delay_us < best->delay_us) {
+            best = &c->filter[i];
+        }
+    }
+    if (best->mid_us <= c->last_used_us) {
+        return 0;
+    }
+    c->last_used_us = best->mid_us;
+    c->stats.used++;
+    c->stats.last_offset_us = best->offset_us;
+    c->stats.last_delay_us = best->delay_us;
+    add_history(c, best);
+    steer(c, t4);
+    return 1;
+}
+
+size_t net_clock_answer(uint8_t *buf, size_t cap, const proto_frame_t *req, int64_t t2, int64_t t3)
+{
+    int64_t t1, r2, r3;
+    if (req->type != PROTO_MSG_TIME || (req->flags & PROTO_F_RESPONSE) || !(req->flags & PROTO_F_CORR) ||
+        !proto_read_time(req, &t1, &r2, &r3)) {
+        return 0;
+    }
+    return proto_encode_time_reply(buf, cap, req->corr, t1, t2, t3);
+}
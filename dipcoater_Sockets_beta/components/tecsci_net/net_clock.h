@@ -0,0 +1,100 @@
+/* Clock synchronization for the dip-coater socket projects
+
+   Every board stamps its telemetry with its own esp_timer / millis() base, so runs of
+   several coaters can't be lined up.  net_clock disciplines the local microsecond clock
+   to a reference (the PC the coaters talk to) with the NTP four timestamp exchange,
+   carried in PROTO_MSG_TIME frames:
+
+       t1  request leaves      (local clock)       offset = ((t2 - t1) + (t3 - t4)) / 2
+       t2  request arrives     (reference clock)   delay  = (t4 - t1) - (t3 - t2)
+       t3  answer leaves       (reference clock)
+       t4  answer arrives      (local clock)
+
+   Exchanges go through a clock filter: of the last NET_CLOCK_FILTER only the one with the
+   smallest delay is used, and only if it is newer than the last one used.  Queueing only
+   ever adds delay, so that is the exchange least bent by an asymmetric path.  The drift of
+   the local oscillator is the least squares slope of the last NET_CLOCK_HISTORY used
+   offsets against local time.
+
+   net_clock_shared_us() maps a local time into the shared timebase.  It follows the fitted
+   line, but a correction is slewed: the mapping runs faster or slower by at most
+   NET_CLOCK_MAX_SLEW_PPM until it meets the line, so shared time never jumps back and
+   samples stay evenly spaced.  Only an error over NET_CLOCK_STEP_US (first exchange,
+   reference restarted) is stepped.  The mapping is integer only, cheap enough to stamp
+   every sample; the fit (doubles) runs once per used exchange.
+
+   One exchange is a 16 byte request and a 32 byte answer, so it can run every few
+   seconds for free; net_link runs it every clock_sync_ms.  The reference only answers,
+   with net_clock_answer().
+*/
+#ifndef NET_CLOCK_H
+#define NET_CLOCK_H
+
+#include "net_port.h"
+#include "tecsci_proto.h"
+
+#define NET_CLOCK_FILTER        8
+#define NET_CLOCK_HISTORY       16
+#define NET_CLOCK_STEP_US       128000
+#define NET_CLOCK_SLEW_US       2000000     /* a correction is worked off over this long */
+#define NET_CLOCK_MAX_SLEW_PPM  500
+#define NET_CLOCK_MAX_DRIFT_PPM 1000        /* fits beyond this are clamped */
+
+typedef struct {
+    int64_t mid_us;                     /* local time halfway between t1 and t4 */
+    int64_t offset_us;                  /* reference - local */
+    int64_t delay_us;
+} net_clock_sample_t;
+
+typedef struct {
+    uint32_t exchanges;
+    uint32_t used;                      /* passed the clock filter */
+    uint32_t rejected;                  /* negative delay: timestamps out of order */
+    uint32_t steps;
+    int64_t last_offset_us;             /* of the last used exchange */
+    int64_t last_delay_us;
+    int64_t last_error_us;              /* mapping minus fitted line when it was used */
+    int32_t drift_ppb;                  /* fitted drift of the reference against local */
+} net_clock_stats_t;
+
+typedef struct {
+    bool synced;
+
+    /* shared(l) = base_shared + d + d * rate + min(d, slew_us) * slew,  d = l - base_local,
+       rate and slew in units of 2^-32 */
+    int64_t base_local_us, base_shared_us;
+    int64_t rate_q32;
+    int64_t slew_q32;
+    int64_t slew_us;
+
+    net_clock_sample_t filter[NET_CLOCK_FILTER];
+    int filter_n, filter_next;
+    int64_t last_used_us;               /* mid of the last used exchange */
+
+    net_clock_sample_t hist[NET_CLOCK_HISTORY];
+    int hist_n, hist_next;
+    int64_t fit_mid_us;                 /* offset(l) = fit_offset + fit_drift * (l - fit_mid) */
+    double fit_offset, fit_drift;
+
+    net_clock_stats_t stats;
+} net_clock_t;
+
+void net_clock_init(net_clock_t *c);
+
+/* feeds one exchange; t4 is the local time the answer arrived.  Returns 1 if it was used,
+   0 if the clock filter passed it over and -1 if it was rejected. */
+int net_clock_update(net_clock_t *c, int64_t t1, int64_t t2, int64_t t3, int64_t t4);
+
+/* the local time in the shared timebase (unchanged until the first exchange was used) */
+int64_t net_clock_shared_us(const net_clock_t *c, int64_t local_us);
+
+static inline bool net_clock_synced(const net_clock_t *c)
+{
+    return c->synced;
+}
+
+/* reference side: the answer to the PROTO_MSG_TIME request req, received at t2 and sent
+   at t3 on the reference clock.  Returns the frame size, 0 if req isn't a valid request. */
+size_t net_clock_answer(uint8_t *buf, size_t cap, const proto_frame_t *req, int64_t t2, int64_t t3);
+
+#endif
@@ -0,0 +1,275 @@
+/* Text command parser (see net_cmd.h) */
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "net_cmd.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* delimiter search ----------------------------------------------------------------------- */
+
+typedef uintptr_t word_t;
+#define WORD_ONES  ((word_t)-1 / 0xff)            /* 0x0101...01 */
+#define WORD_HIGHS (WORD_ONES * 0x80)             /* 0x8080...80 */
+
+/* high bit set in every byte of x that is zero.  The lowest one is exact (the bits above
+   it can be false after a borrow), and on a little endian machine (ESP32, x86) the lowest
+   one is the first byte in memory. */
+static inline word_t zero_bytes(word_t x)
+{
+    return (x - WORD_ONES) & ~x & WORD_HIGHS;
+}
+
+const uint8_t *net_cmd_find_nl_swar(const uint8_t *p, const uint8_t *end)
+{
+    /* byte by byte up to a word boundary: Xtensa can't load unaligned words */
+    while (p < end && ((uintptr_t)p & (sizeof(word_t) - 1))) {
+        if (*p == '\n') {
+            return p;
+        }
+        p++;
+    }
+    const word_t nl = WORD_ONES * '\n';
+    while (p + sizeof(word_t) <= end) {
+        word_t w;
+        memcpy(&w, p, sizeof(w));       /* aligned here, compiles to one load */
+        word_t m = zero_bytes(w ^ nl);
+        if (m) {
+            return p + __builtin_ctzl((unsigned long)m) / 8;
+        }
+        p += sizeof(word_t);
+    }
+    while (p < end && *p != '\n') {
+        p++;
+    }
+    return p;
+}
+
+const uint8_t *net_cmd_find_nl(const uint8_t *p, const uint8_t *end)
+{
+#if defined(__SSE2__)
+    const __m128i nl = _mm_set1_epi8('\n');
+    while (p + 16 <= end) {
+        int m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), nl));
+        if (m) {
+            return p + __builtin_ctz((unsigned)m);
+        }
+        p += 16;
+    }
+    while (p < end && *p != '\n') {
+        p++;
+    }
+    return p;
+#else
+    return net_cmd_find_nl_swar(p, end);
+#endif
+}
+
+/* command table -------------------------------------------------------------------------- */
+
+static inline uint32_t name_hash(uint32_t seed, const char *s, size_t len)
+{
+    uint32_t h = seed;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)s[i]) * 0x01000193;
+    }
+    return h ^ (h >> 15);
+}
+
+int net_cmd_table_init(net_cmd_table_t *t, const net_cmd_def_t *defs, int n)
+{
+    memset(t, 0, sizeof(*t));
+    t->defs = defs;
+    t->n = n;
+    /* the smallest table at least twice the command count, grown when no seed fits */
+    for (t->bits = 1; (1 << t->bits) < 2 * n; t->bits++) {
+    }
+    for (; t->bits <= NET_CMD_TABLE_BITS; t->bits++) {
+        for (uint32_t seed = 0x811c9dc5; seed < 0x811c9dc5 + 4096; seed++) {
+            memset(t->slot, 0, sizeof(t->slot));
+            int i;
+            for (i = 0; i < n; i++) {
+                uint32_t s = name_hash(seed, defs[i].name, strlen(defs[i].name)) >> (32 - t->bits);
+                if (t->slot[s]) {
+                    break;
+                }
+                t->slot[s] = (uint8_t)(i + 1);
+            }
+            if (i == n) {
+                t->seed = seed;
+                return 0;
+            }
+        }
+    }
+    memset(t->slot, 0, sizeof(t->slot));
+    return -1;
+}
+
+const net_cmd_def_t *net_cmd_lookup(const net_cmd_table_t *t, const char *name, size_t len)
+{
+    uint8_t i = t->slot[name_hash(t->seed, name, len) >> (32 - t->bits)];
+    if (i == 0) {
+        return NULL;
+    }
+    const net_cmd_def_t *d = &t->defs[i - 1];
+    return strncmp(d->name, name, len) == 0 && d->name[len] == 0 ? d : NULL;
+}
+
+/* parsing -------------------------------------------------------------------------------- */
+
+static inline bool is_space(uint8_t c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static void run_line(net_cmd_parser_t *p, const net_cmd_table_t *t, const uint8_t *s, const uint8_t *e,
+                     void *arg)
+{
+    net_cmd_t cmd;
+    cmd.argc = 0;
+    while (s < e && cmd.argc < NET_CMD_MAX_ARGS) {
+        while (s < e && is_space(*s)) {
+            s++;
+        }
+        if (s == e) {
+            break;
+        }
+        const uint8_t *b = s;
+        while (s < e && !is_space(*s)) {
+            s++;
+        }
+        cmd.argv[cmd.argc].p = (const char *)b;
+        cmd.argv[cmd.argc].len = (size_t)(s - b);
+        cmd.argc++;
+    }
+    if (cmd.argc == 0) {
+        return;                         /* empty line */
+    }
+    p->stats.lines++;
+    const net_cmd_def_t *d = net_cmd_lookup(t, cmd.argv[0].p, cmd.argv[0].len);
+    if (d == NULL) {
+        p->stats.unknown++;
+        if (t->reject) {
+            t->reject(&cmd, arg);
+        }
+        return;
+    }
+    if (cmd.argc - 1 < d->min_args) {
+        p->stats.failed++;
+        if (t->reject) {
+            t->reject(&cmd, arg);
+        }
+        return;
+    }
+    if (d->fn(&cmd, arg) != 0) {
+        p->stats.failed++;
+        return;
+    }
+    p->stats.done++;
+}
+
+size_t net_cmd_feed(net_cmd_parser_t *p, const net_cmd_table_t *t, const uint8_t *data, size_t len,
+                    void *arg)
+{
+    const uint8_t *end = data + len;
+    const uint8_t *line = data;
+    const uint8_t *scan = data + (p->scanned < len ? p->scanned : len);
+
+    for (;;) {
+        const uint8_t *nl = net_cmd_find_nl(scan, end);
+        if (nl == end) {
+            break;
+        }
+        run_line(p, t, line, nl, arg);
+        line = scan = nl + 1;
+    }
+    size_t used = (size_t)(line - data);
+    p->scanned = len - used;            /* the partial line has been looked at already */
+    p->stats.bytes += used;
+    return used;
+}
+
+/* arguments ------------------------------------------------------------------------------ */
+
+bool net_cmd_int(const net_cmd_tok_t *tok, long *v)
+{
+    const char *s = tok->p, *e = tok->p + tok->len;
+    bool neg = false;
+    if (s < e && (*s == '-' || *s == '+')) {
+        neg = *s++ == '-';
+    }
+    /* 18 digits can't overflow the 64 bit accumulator; whether the value fits a long
+       (32 bits on the ESP32) is checked at the end */
+    if (s == e || e - s > 18) {
+        return false;
+    }
+    uint64_t r = 0;
+    for (; s < e; s++) {
+        if (*s < '0' || *s > '9') {
+            return false;
+        }
+        r = r * 10 + (uint64_t)(*s - '0');
+    }
+    if (r > (neg ? (uint64_t)LONG_MAX + 1 : (uint64_t)LONG_MAX)) {
+        return false;
+    }
+    *v = neg ? (long)(0 - r) : (long)r;
+    return true;
+}
+
+static const double pow10_tab[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+};
+
+bool net_cmd_double(const net_cmd_tok_t *tok, double *v)
+{
+    /* [-]digits[.digits] with up to 15 significant digits is exact as mantissa / 10^k;
+       everything else (exponents, long mantissas) goes through strtod, which would also
+       take nan, inf and hex floats: those are refused, and so is whatever overflows */
+    const char *s = tok->p, *e = tok->p + tok->len;
+    bool neg = false;
+    if (s < e && (*s == '-' || *s == '+')) {
+        neg = *s++ == '-';
+    }
+    uint64_t m = 0;
+    int digits = 0, frac = -1;
+    for (; s < e; s++) {
+        if (*s >= '0' && *s <= '9') {
+            m = m * 10 + (uint64_t)(*s - '0');
+            digits++;
+            if (frac >= 0) {
+                frac++;
+            }
+        } else if (*s == '.' && frac < 0) {
+            frac = 0;
+        } else {
+            break;
+        }
+    }
+    if (s == e && digits > 0 && digits <= 15) {
+        double r = (double)m / pow10_tab[frac > 0 ? frac : 0];
+        *v = neg ? -r : r;
+        return true;
+    }
+    if (tok->len == 0 || tok->len >= 64) {
+        return false;
+    }
+    for (s = tok->p; s < e; s++) {
+        if (!((*s >= '0' && *s <= '9') || *s == '.' || *s == 'e' || *s == 'E' || *s == '-' || *s == '+')) {
+            return false;
+        }
+    }
+    char buf[64];
+    memcpy(buf, tok->p, tok->len);
+    buf[tok->len] = 0;
+    char *stop;
+    double r = strtod(buf, &stop);
+    if (stop != buf + tok->len || !isfinite(r)) {
+        return false;
+    }
+    *v = r;
+    return true;
+}
@@ -0,0 +1,103 @@
+/* Text command parser for the dip-coater socket projects
+
+   The first socket projects take newline terminated text commands ("SP 0 85.5\n").  This
+   parser runs them from a net_server on_data handler without copying anything:
+
+   - incremental: net_server hands the unconsumed tail of a read over again together with
+     the next bytes, so the parser remembers how far it already looked for the delimiter
+     and carries on from there instead of rescanning the partial line after every recv().
+   - the '\n' search compares 16 bytes at a time with SSE2 on x86 hosts and a machine word
+     at a time (SWAR) everywhere else, Xtensa included.
+   - a line is split into tokens that point into the receive buffer (no strtok, no copies).
+   - the command name is looked up in a perfect hash table built once at start: one hash
+     of the name, one slot, one memcmp, however many commands there are.
+
+   Typical use:
+
+       static const net_cmd_def_t defs[] = {
+           { "SP", cmd_setpoint, 2 },          // SP <loop> <value>
+           { "PING", cmd_ping, 0 },
+       };
+       static net_cmd_table_t table;
+       net_cmd_table_init(&table, defs, sizeof(defs) / sizeof(defs[0]));
+
+       // on_data: returns the bytes of the complete lines, the rest comes back next time
+       return net_cmd_feed(parser_of(conn), &table, data, len, conn);
+*/
+#ifndef NET_CMD_H
+#define NET_CMD_H
+
+#include "net_port.h"
+
+#define NET_CMD_MAX_ARGS    8           /* command name included; further tokens are ignored */
+#define NET_CMD_TABLE_BITS  8           /* up to 256 slots, so up to about 100 commands */
+
+typedef struct {
+    const char *p;                      /* into the receive buffer, not terminated */
+    size_t len;
+} net_cmd_tok_t;
+
+typedef struct {
+    int argc;                           /* tokens, argv[0] is the command name */
+    net_cmd_tok_t argv[NET_CMD_MAX_ARGS];
+} net_cmd_t;
+
+/* returns 0 when the command was carried out, anything else counts as failed */
+typedef int (*net_cmd_fn_t)(const net_cmd_t *cmd, void *arg);
+
+typedef struct {
+    const char *name;
+    net_cmd_fn_t fn;
+    int min_args;                       /* arguments after the name; fewer is an error */
+} net_cmd_def_t;
+
+typedef struct {
+    const net_cmd_def_t *defs;
+    int n;
+    uint32_t seed;
+    int bits;
+    uint8_t slot[1 << NET_CMD_TABLE_BITS];  /* index into defs + 1, 0 = empty */
+    net_cmd_fn_t reject;                /* optional, set after init: unknown names and
+                                           commands with too few arguments */
+} net_cmd_table_t;
+
+typedef struct {
+    uint32_t lines;
+    uint32_t done;
+    uint32_t failed;                    /* handler returned nonzero, or too few arguments */
+    uint32_t unknown;
+    uint64_t bytes;
+} net_cmd_stats_t;
+
+typedef struct {
+    size_t scanned;                     /* leading bytes of the pending data without a '\n' */
+    net_cmd_stats_t stats;
+} net_cmd_parser_t;
+
+/* finds a seed that gives every name its own slot; -1 if there is none (too many
+   commands or a duplicate name) */
+int net_cmd_table_init(net_cmd_table_t *t, const net_cmd_def_t *defs, int n);
+
+const net_cmd_def_t *net_cmd_lookup(const net_cmd_table_t *t, const char *name, size_t len);
+
+static inline void net_cmd_parser_init(net_cmd_parser_t *p)
+{
+    memset(p, 0, sizeof(*p));
+}
+
+/* runs every complete line in data and returns the bytes they took; the partial line at
+   the end is left for the next call, which must start with it */
+size_t net_cmd_feed(net_cmd_parser_t *p, const net_cmd_table_t *t, const uint8_t *data, size_t len,
+                    void *arg);
+
+/* first '\n' in [p, end), or end.  net_cmd_find_nl() is the fastest one for the build,
+   the SWAR one is exported for comparison. */
+const uint8_t *net_cmd_find_nl(const uint8_t *p, const uint8_t *end);
+const uint8_t *net_cmd_find_nl_swar(const uint8_t *p, const uint8_t *end);
+
+/* argument conversions; false if the token isn't entirely a decimal number or doesn't fit
+   (net_cmd_double() never returns nan or inf) */
+bool net_cmd_int(const net_cmd_tok_t *tok, long *v);
+bool net_cmd_double(const net_cmd_tok_t *tok, double *v);
+
+#endif
@@ -0,0 +1,257 @@
+/* Persistent client connection (see net_link.h) */
+#include "net_link.h"
+
+static const char *TAG = "net_link";
+
+static uint32_t link_random(net_link_t *link)
+{
+    link->rng ^= link->rng << 13;
+    link->rng ^= link->rng >> 17;
+    link->rng ^= link->rng << 5;
+    return link->rng;
+}
+
+static void set_state(net_link_t *link, net_link_state_t state)
+{
+    if (link->state == state) {
+        return;
+    }
+    link->state = state;
+    if (link->on_state) {
+        link->on_state(link, state, link->arg);
+    }
+}
+
+void net_link_init(net_link_t *link, const net_link_config_t *cfg, proto_handler_t on_frame,
+                   void *frame_arg, net_link_state_cb_t on_state, void *arg)
+{
+    memset(link, 0, sizeof(*link));
+    net_client_init(&link->client, on_frame, frame_arg);
+    link->cfg = *cfg;
+    link->on_state = on_state;
+    link->arg = arg;
+    link->rng = (uint32_t)net_time_us() | 1;
+    link->client.timeout_us = (int64_t)cfg->heartbeat_ms * cfg->miss_limit * 1000;
+    net_clock_init(&link->clock);
+}
+
+static void schedule_retry(net_link_t *link)
+{
+    int delay = link->cfg.backoff_max_ms;
+    if (link->attempt < 16 && (link->cfg.backoff_min_ms << link->attempt) < delay) {
+        delay = link->cfg.backoff_min_ms << link->attempt;
+    }
+    link->attempt++;
+    /* somewhere in the upper half of the backoff window */
+    delay = delay / 2 + (int)(link_random(link) % (uint32_t)(delay / 2 + 1));
+    link->retry_at_us = net_time_us() + (int64_t)delay * 1000;
+}
+
+void net_link_drop(net_link_t *link)
+{
+    if (link->state == NET_LINK_DOWN) {
+        return;
+    }
+    net_client_close(&link->client);
+    link->attempt = 0;
+    schedule_retry(link);
+    set_state(link, NET_LINK_DOWN);
+}
+
+static void state_done(void *arg, uint32_t corr, int status, const proto_frame_t *reply);
+
+/* true when the request went out; otherwise the slot stays dirty for the next heartbeat */
+static bool send_slot(net_link_t *link, net_link_slot_t *s)
+{
+    s->corr = net_client_request(&link->client, s->frame, s->len, state_done, link);
+    return s->corr != 0;
+}
+
+static void check_synced(net_link_t *link)
+{
+    if (link->state != NET_LINK_UP) {
+        return;
+    }
+    for (int i = 0; i < NET_LINK_MAX_STATE; i++) {
+        if (link->slots[i].used && link->slots[i].dirty) {
+            return;
+        }
+    }
+    set_state(link, NET_LINK_SYNCED);
+}
+
+/* an answer for an older version of the slot finds no slot with its corr and changes nothing */
+static void state_done(void *arg, uint32_t corr, int status, const proto_frame_t *reply)
+{
+    net_link_t *link = arg;
+    net_link_slot_t *s = NULL;
+    for (int i = 0; i < NET_LINK_MAX_STATE; i++) {
+        if (link->slots[i].used && link->slots[i].corr == corr) {
+            s = &link->slots[i];
+            break;
+        }
+    }
+    if (s == NULL) {
+        return;
+    }
+    s->corr = 0;
+    if (status == NET_CLIENT_CLOSED) {
+        return;
+    }
+    if (status == PROTO_ACK_OK) {
+        s->dirty = false;
+    } else if (status != NET_CLIENT_TIMEOUT && status != PROTO_ACK_BUSY) {
+        NET_LOGW(TAG, "state command 0x%02x for loop %u rejected: status %d, dropped",
+                 s->type, s->loop, status);
+        link->stats.state_rejected++;
+        s->used = false;
+    }
+    check_synced(link);
+}
+
+static void resend_dirty(net_link_t *link)
+{
+    for (int i = 0; i < NET_LINK_MAX_STATE; i++) {
+        net_link_slot_t *s = &link->slots[i];
+        if (s->used && s->dirty && s->corr == 0 && send_slot(link, s)) {
+            link->stats.replayed++;
+        }
+    }
+}
+
+static void clock_done(void *arg, uint32_t corr, int status, const proto_frame_t *reply)
+{
+    net_link_t *link = arg;
+    int64_t t4 = net_time_us();
+    int64_t t1, t2, t3;
+    if (status == PROTO_ACK_OK && reply->type == PROTO_MSG_TIME && proto_read_time(reply, &t1, &t2, &t3)) {
+        net_clock_update(&link->clock, t1, t2, t3, t4);
+    }
+}
+
+static void set_keepalive(net_link_t *link)
+{
+    int fd = link->client.fd;
+    int on = link->cfg.keepalive_idle_s > 0;
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+    if (!on) {
+        return;
+    }
+#ifdef TCP_KEEPIDLE
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &link->cfg.keepalive_idle_s, sizeof(int));
+#endif
+#ifdef TCP_KEEPINTVL
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &link->cfg.keepalive_interval_s, sizeof(int));
+#endif
+#ifdef TCP_KEEPCNT
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &link->cfg.keepalive_count, sizeof(int));
+#endif
+}
+
+static void try_connect(net_link_t *link)
+{
+    if (net_client_connect(&link->client, link->cfg.host, link->cfg.port,
+                           link->cfg.connect_timeout_ms) != 0) {
+        link->stats.connect_failures++;
+        schedule_retry(link);
+        return;
+    }
+    set_keepalive(link);
+    link->stats.connects++;
+    link->attempt = 0;
+    link->next_ping_us = net_time_us() + (int64_t)link->cfg.heartbeat_ms * 1000;
+    link->next_sync_us = net_time_us();
+    set_state(link, NET_LINK_UP);
+
+    for (int i = 0; i < NET_LINK_MAX_STATE; i++) {
+        link->slots[i].dirty = link->slots[i].used;
+        link->slots[i].corr = 0;
+    }
+    resend_dirty(link);
+    check_synced(link);
+}
+
+int net_link_set_state(net_link_t *link, const uint8_t *frame, size_t len)
+{
+    if (len < PROTO_HEADER_SIZE + 1 || len > NET_LINK_STATE_FRAME) {
+        return -1;
+    }
+    uint8_t type = frame[2], loop = frame[PROTO_HEADER_SIZE];
+    net_link_slot_t *slot = NULL;
+    for (int i = 0; i < NET_LINK_MAX_STATE; i++) {
+        net_link_slot_t *s = &link->slots[i];
+        if (s->used && s->type == type && s->loop == loop) {
+            slot = s;
+            break;
+        }
+        if (!s->used && !slot) {
+            slot = s;
+        }
+    }
+    if (!slot) {
+        return -1;
+    }
+    slot->used = true;
+    slot->dirty = true;
+    slot->corr = 0;
+    slot->type = type;
+    slot->loop = loop;
+    slot->len = (uint8_t)len;
+    memcpy(slot->frame, frame, len);
+    if (link->state != NET_LINK_DOWN) {
+        send_slot(link, slot);
+    }
+    return 0;
+}
+
+void net_link_poll(net_link_t *link, int timeout_ms)
+{
+    int64_t now = net_time_us();
+    if (link->state == NET_LINK_DOWN) {
+        if (now < link->retry_at_us) {
+            int64_t wait_ms = (link->retry_at_us - now + 999) / 1000;
+            net_sleep_ms(wait_ms < timeout_ms ? (int)wait_ms : timeout_ms);
+            return;
+        }
+        try_connect(link);
+        return;
+    }
+
+    net_client_t *c = &link->client;
+    if (now >= link->next_ping_us) {
+        uint8_t ping[PROTO_HEADER_SIZE];
+        net_client_request(c, ping, proto_encode_ping(ping, sizeof(ping)), NULL, NULL);
+        link->next_ping_us = now + (int64_t)link->cfg.heartbeat_ms * 1000;
+        resend_dirty(link);
+    }
+    if (link->cfg.clock_sync_ms > 0 && now >= link->next_sync_us) {
+        /* t1 is taken as late as possible: the request goes out in the net_client_poll() below */
+        uint8_t req[PROTO_HEADER_SIZE + PROTO_TIME_SIZE];
+        net_client_request(c, req, proto_encode_time(req, sizeof(req), net_time_us()), clock_done, link);
+        link->next_sync_us = now + (int64_t)link->cfg.clock_sync_ms * 1000;
+    }
+    int64_t silent_limit = c->last_rx_us + (int64_t)link->cfg.heartbeat_ms * link->cfg.miss_limit * 1000;
+    int64_t wake = link->next_ping_us < silent_limit ? link->next_ping_us : silent_limit;
+    if (link->cfg.clock_sync_ms > 0 && link->next_sync_us < wake) {
+        wake = link->next_sync_us;
+    }
+    int wait_ms = (int)((wake - now + 999) / 1000);
+    if (wait_ms > timeout_ms) {
+        wait_ms = timeout_ms;
+    }
+    if (wait_ms < 0) {
+        wait_ms = 0;
+    }
+
+    if (net_client_poll(c, wait_ms) < 0) {
+        link->stats.closed_by_peer++;
+        NET_LOGW(TAG, "connection lost, reconnecting");
+        net_link_drop(link);
+        return;
+    }
+    if (net_time_us() > c->last_rx_us + (int64_t)link->cfg.heartbeat_ms * link->cfg.miss_limit * 1000) {
+        link->stats.heartbeat_losses++;
+        NET_LOGW(TAG, "no answer for %d heartbeats, reconnecting", link->cfg.miss_limit);
+        net_link_drop(link);
+    }
+}
@@ -0,0 +1,132 @@
+/* Persistent client connection for the dip-coater socket projects
+
+   Wraps a net_client and keeps it connected:
+
+   - application heartbeats: a PROTO_MSG_PING goes out every heartbeat period, and the
+     link is declared dead when nothing at all arrived for miss_limit periods.  A hung
+     server or a dropped Wi-Fi link is noticed in about two periods, instead of waiting
+     for TCP retransmissions to give up after minutes.
+   - TCP keepalive on the socket as a second line for idle links.
+   - reconnects with exponential backoff and random jitter, so several clients that lost
+     the same server don't retry in lockstep.
+   - state replay: the last command of each kind per loop (setpoint, gains, limits, mode)
+     is kept in a small table.  Commands given while the link is down only update the
+     table, and after every reconnect the whole table is sent again; the link reports
+     NET_LINK_SYNCED once the server acknowledged every entry with PROTO_ACK_OK.  An entry
+     that timed out, was answered PROTO_ACK_BUSY or couldn't be queued is sent again with
+     the next heartbeat; one the server rejects otherwise is dropped from the table.
+   - clock sync: every clock_sync_ms a PROTO_MSG_TIME exchange disciplines link->clock to
+     the server's clock (net_clock.h), so net_clock_shared_us(&link->clock, net_time_us())
+     stamps samples in the server's timebase.
+
+   Typical use from the tcp_client task:
+
+       static net_link_t link;
+       net_link_config_t cfg = NET_LINK_CONFIG_DEFAULT(HOST_IP_ADDR, PORT);
+       net_link_init(&link, &cfg, on_telemetry, NULL, on_link_state, NULL);
+       while (1) {
+           net_link_poll(&link, 100);
+       }
+*/
+#ifndef NET_LINK_H
+#define NET_LINK_H
+
+#include "net_client.h"
+#include "net_clock.h"
+
+#ifndef NET_LINK_MAX_STATE
+#define NET_LINK_MAX_STATE 16
+#endif
+
+/* largest command kept for replay */
+#define NET_LINK_STATE_FRAME (PROTO_HEADER_SIZE + PROTO_GAINS_SIZE)
+
+typedef enum {
+    NET_LINK_DOWN = 0,      /* waiting for the next connection attempt */
+    NET_LINK_UP,            /* connected, replaying the state table */
+    NET_LINK_SYNCED,        /* connected and the server has acknowledged the state table */
+} net_link_state_t;
+
+typedef struct {
+    const char *host;
+    uint16_t port;
+    int heartbeat_ms;
+    int miss_limit;                     /* silent heartbeat periods before the link is dropped */
+    int connect_timeout_ms;
+    int backoff_min_ms;
+    int backoff_max_ms;
+    int keepalive_idle_s;               /* 0 leaves TCP keepalive off */
+    int keepalive_interval_s;
+    int keepalive_count;
+    int clock_sync_ms;                  /* 0 leaves the clock alone */
+} net_link_config_t;
+
+#define NET_LINK_CONFIG_DEFAULT(h, p) {         \
+    .host = (h),                                \
+    .port = (p),                                \
+    .heartbeat_ms = 500,                        \
+    .miss_limit = 2,                            \
+    .connect_timeout_ms = 1000,                 \
+    .backoff_min_ms = 50,                       \
+    .backoff_max_ms = 5000,                     \
+    .keepalive_idle_s = 5,                      \
+    .keepalive_interval_s = 1,                  \
+    .keepalive_count = 3,                       \
+    .clock_sync_ms = 4000,                      \
+}
+
+typedef struct net_link net_link_t;
+
+typedef void (*net_link_state_cb_t)(net_link_t *link, net_link_state_t state, void *arg);
+
+typedef struct {
+    uint32_t connects;
+    uint32_t connect_failures;
+    uint32_t heartbeat_losses;          /* links dropped because the server went silent */
+    uint32_t closed_by_peer;            /* links dropped by a socket error or close */
+    uint32_t replayed;                  /* state commands sent again after a reconnect or a failure */
+    uint32_t state_rejected;            /* state commands the server refused, dropped from the table */
+} net_link_stats_t;
+
+typedef struct {
+    bool used;
+    bool dirty;                         /* not acknowledged by the server since it last changed */
+    uint32_t corr;                      /* of the request in flight for it, 0 for none */
+    uint8_t type, loop;
+    uint8_t len;
+    uint8_t frame[NET_LINK_STATE_FRAME];
+} net_link_slot_t;
+
+struct net_link {
+    net_client_t client;
+    net_link_config_t cfg;
+    net_link_state_t state;
+    net_link_state_cb_t on_state;
+    void *arg;
+
+    int attempt;                        /* failed connection attempts in a row */
+    int64_t retry_at_us;
+    int64_t next_ping_us;
+    int64_t next_sync_us;
+    uint32_t rng;
+
+    net_link_stats_t stats;
+    net_clock_t clock;
+    net_link_slot_t slots[NET_LINK_MAX_STATE];
+};
+
+void net_link_init(net_link_t *link, const net_link_config_t *cfg, proto_handler_t on_frame,
+                   void *frame_arg, net_link_state_cb_t on_state, void *arg);
+
+/* records a command (frame from proto_encode_setpoint/gains/limits/mode) as the current
+   state of its loop and sends it if connected; returns -1 if it doesn't fit the table */
+int net_link_set_state(net_link_t *link, const uint8_t *frame, size_t len);
+
+/* connects, heartbeats, detects failures and replays state; call it in the task loop.
+   Waits up to timeout_ms. */
+void net_link_poll(net_link_t *link, int timeout_ms);
+
+/* drops the connection now (as if it failed) */
+void net_link_drop(net_link_t *link);
+
+#endif
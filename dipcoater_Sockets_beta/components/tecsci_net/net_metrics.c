@@ -0,0 +1,345 @@
+/* Prometheus style metrics (see net_metrics.h) */
+#include <stdio.h>
+#include <stdarg.h>
+
+#include "net_metrics.h"
+
+static const char *TAG = "net_metrics";
+
+/* room kept in front of the rendered body for the HTTP response header */
+#define HTTP_HEADER_RESERVE 128
+
+void net_metrics_init(net_metrics_t *m)
+{
+    memset(m, 0, sizeof(*m));
+    for (int i = 0; i < NET_METRICS_SHARDS; i++) {
+        m->shards[i].metrics = m;
+    }
+}
+
+static int add_def(net_metrics_t *m, const char *name, const char *help, net_metric_type_t type,
+                   int nslots)
+{
+    if (m->count == NET_METRICS_MAX || m->slots + nslots > NET_METRICS_SLOTS) {
+        NET_LOGW(TAG, "no room for metric %s", name);
+        return -1;
+    }
+    net_metric_def_t *d = &m->defs[m->count];
+    memset(d, 0, sizeof(*d));
+    d->name = name;
+    d->help = help;
+    d->type = type;
+    d->slot = m->slots;
+    d->scale = 1;
+    m->slots += nslots;
+    return m->count++;
+}
+
+int net_metrics_counter(net_metrics_t *m, const char *name, const char *help)
+{
+    return add_def(m, name, help, NET_METRIC_COUNTER, 1);
+}
+
+int net_metrics_gauge(net_metrics_t *m, const char *name, const char *help)
+{
+    return add_def(m, name, help, NET_METRIC_GAUGE, 1);
+}
+
+int net_metrics_histogram(net_metrics_t *m, const char *name, const char *help,
+                          const uint32_t *bounds, int nbounds, double scale)
+{
+    if (nbounds < 1 || nbounds > NET_METRICS_MAX_BOUNDS) {
+        return -1;
+    }
+    /* one value per bucket, one for +Inf, one for the sum */
+    int id = add_def(m, name, help, NET_METRIC_HISTOGRAM, nbounds + 2);
+    if (id >= 0) {
+        m->defs[id].bounds = bounds;
+        m->defs[id].nbounds = (uint8_t)nbounds;
+        m->defs[id].scale = scale;
+    }
+    return id;
+}
+
+int net_metrics_read_fn(net_metrics_t *m, const char *name, const char *help, net_metric_type_t type,
+                        double (*read)(void *arg), void *arg)
+{
+    if (type == NET_METRIC_HISTOGRAM) {
+        return -1;
+    }
+    int id = add_def(m, name, help, type, 0);
+    if (id >= 0) {
+        m->defs[id].read = read;
+        m->defs[id].arg = arg;
+    }
+    return id;
+}
+
+net_metrics_shard_t *net_metrics_shard(net_metrics_t *m)
+{
+    uint32_t i = __atomic_fetch_add(&m->nshards, 1, __ATOMIC_RELAXED);
+    if (i >= NET_METRICS_SHARDS) {
+        NET_LOGW(TAG, "all %d shards taken", NET_METRICS_SHARDS);
+        return NULL;
+    }
+    return &m->shards[i];
+}
+
+/* server statistics ------------------------------------------------------------------- */
+
+/* summed over the servers added, which share a port */
+#define SERVER_STAT(field) \
+    static double read_##field(void *arg) \
+    { \
+        const net_metrics_t *m = arg; \
+        double v = 0; \
+        for (int i = 0; i < m->nservers; i++) { \
+            v += (double)m->servers[i]->stats.field; \
+        } \
+        return v; \
+    }
+
+SERVER_STAT(accepted)
+SERVER_STAT(rejected)
+SERVER_STAT(closed)
+SERVER_STAT(open)
+SERVER_STAT(bytes_in)
+SERVER_STAT(bytes_out)
+SERVER_STAT(send_calls)
+SERVER_STAT(tx_overflows)
+SERVER_STAT(rx_starved)
+SERVER_STAT(tx_dropped)
+SERVER_STAT(throttled)
+SERVER_STAT(tx_stalled)
+SERVER_STAT(tx_mem)
+SERVER_STAT(tx_mem_max)
+
+static double read_pool_free(void *arg)
+{
+    const net_metrics_t *m = arg;
+    double v = 0;
+    for (int i = 0; i < m->nservers; i++) {
+        v += (double)m->servers[i]->rx_pool.nfree;
+    }
+    return v;
+}
+
+static double read_pool_min_free(void *arg)
+{
+    const net_metrics_t *m = arg;
+    double v = 0;
+    for (int i = 0; i < m->nservers; i++) {
+        v += (double)m->servers[i]->rx_pool.stats.min_free;
+    }
+    return v;
+}
+
+static double read_pool_size(void *arg)
+{
+    return (double)NET_BUF_COUNT * ((const net_metrics_t *)arg)->nservers;
+}
+
+void net_metrics_add_server(net_metrics_t *m, net_server_t *srv)
+{
+    if (m->nservers == NET_METRICS_SERVERS) {
+        NET_LOGW(TAG, "no room for another server");
+        return;
+    }
+    m->servers[m->nservers++] = srv;
+    if (m->nservers > 1) {
+        return;
+    }
+    net_metrics_read_fn(m, "tecsci_connections_accepted_total", "Connections accepted",
+                        NET_METRIC_COUNTER, read_accepted, m);
+    net_metrics_read_fn(m, "tecsci_connections_rejected_total", "Connections refused for lack of a slot",
+                        NET_METRIC_COUNTER, read_rejected, m);
+    net_metrics_read_fn(m, "tecsci_connections_closed_total", "Connections closed",
+                        NET_METRIC_COUNTER, read_closed, m);
+    net_metrics_read_fn(m, "tecsci_connections_open", "Connections currently open",
+                        NET_METRIC_GAUGE, read_open, m);
+    net_metrics_read_fn(m, "tecsci_received_bytes_total", "Bytes received",
+                        NET_METRIC_COUNTER, read_bytes_in, m);
+    net_metrics_read_fn(m, "tecsci_sent_bytes_total", "Bytes sent",
+                        NET_METRIC_COUNTER, read_bytes_out, m);
+    net_metrics_read_fn(m, "tecsci_send_calls_total", "send() and sendmsg() system calls",
+                        NET_METRIC_COUNTER, read_send_calls, m);
+    net_metrics_read_fn(m, "tecsci_tx_overflows_total", "Answers refused because no buffer was left for them",
+                        NET_METRIC_COUNTER, read_tx_overflows, m);
+    net_metrics_read_fn(m, "tecsci_tx_dropped_total", "Telemetry frames dropped to stay within the send budgets",
+                        NET_METRIC_COUNTER, read_tx_dropped, m);
+    net_metrics_read_fn(m, "tecsci_tx_throttled_total", "Times a connection went above the send high watermark",
+                        NET_METRIC_COUNTER, read_throttled, m);
+    net_metrics_read_fn(m, "tecsci_tx_stalled_total", "Connections closed because an answer did not fit",
+                        NET_METRIC_COUNTER, read_tx_stalled, m);
+    net_metrics_read_fn(m, "tecsci_tx_queued_bytes", "Bytes of buffers held by send queues",
+                        NET_METRIC_GAUGE, read_tx_mem, m);
+    net_metrics_read_fn(m, "tecsci_tx_queued_max_bytes", "Most bytes of buffers send queues have held",
+                        NET_METRIC_GAUGE, read_tx_mem_max, m);
+    net_metrics_read_fn(m, "tecsci_rx_starved_total", "Reads postponed because the buffer pool was empty",
+                        NET_METRIC_COUNTER, read_rx_starved, m);
+    net_metrics_read_fn(m, "tecsci_rx_pool_free_buffers", "Free receive buffers",
+                        NET_METRIC_GAUGE, read_pool_free, m);
+    net_metrics_read_fn(m, "tecsci_rx_pool_min_free_buffers", "Lowest number of free receive buffers",
+                        NET_METRIC_GAUGE, read_pool_min_free, m);
+    net_metrics_read_fn(m, "tecsci_rx_pool_buffers", "Receive buffers in the pool",
+                        NET_METRIC_GAUGE, read_pool_size, m);
+}
+
+/* rendering --------------------------------------------------------------------------- */
+
+typedef struct {
+    char *buf;
+    size_t cap, len;
+    bool full;
+} text_t;
+
+static void put(text_t *t, const char *fmt, ...)
+{
+    if (t->full) {
+        return;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(t->buf + t->len, t->cap - t->len, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= t->cap - t->len) {
+        t->full = true;
+        return;
+    }
+    t->len += n;
+}
+
+static uint64_t shard_sum(const net_metrics_t *m, int slot)
+{
+    uint32_t n = m->nshards < NET_METRICS_SHARDS ? m->nshards : NET_METRICS_SHARDS;
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        sum += m->shards[i].val[slot];
+    }
+    return sum;
+}
+
+static void put_value(text_t *t, double v)
+{
+    if (v == (double)(int64_t)v && v < 9e15 && v > -9e15) {
+        put(t, "%lld\n", (long long)v);
+    } else {
+        put(t, "%.9g\n", v);
+    }
+}
+
+static const char *const type_names[] = { "counter", "gauge", "histogram" };
+
+size_t net_metrics_render(net_metrics_t *m, size_t reserve)
+{
+    text_t t = { m->text + reserve, sizeof(m->text) - reserve, 0, false };
+    const char *prev = NULL;
+    int prev_len = 0;
+
+    for (int i = 0; i < m->count; i++) {
+        const net_metric_def_t *d = &m->defs[i];
+        const char *brace = strchr(d->name, '{');
+        int fam_len = brace ? (int)(brace - d->name) : (int)strlen(d->name);
+        /* labels without the braces, so le="" can be appended for the buckets */
+        const char *labels = brace ? brace + 1 : "";
+        int labels_len = brace ? (int)strlen(labels) - 1 : 0;
+
+        if (!prev || fam_len != prev_len || memcmp(prev, d->name, fam_len) != 0) {
+            put(&t, "# HELP %.*s %s\n# TYPE %.*s %s\n", fam_len, d->name, d->help,
+                fam_len, d->name, type_names[d->type]);
+            prev = d->name;
+            prev_len = fam_len;
+        }
+        if (d->read) {
+            put(&t, "%s ", d->name);
+            put_value(&t, d->read(d->arg));
+        } else if (d->type != NET_METRIC_HISTOGRAM) {
+            put(&t, "%s ", d->name);
+            put_value(&t, (double)shard_sum(m, d->slot) * d->scale);
+        } else {
+            const char *sep = labels_len > 0 ? "," : "";
+            uint64_t cum = 0;
+            for (int b = 0; b <= d->nbounds; b++) {
+                cum += shard_sum(m, d->slot + b);
+                if (b < d->nbounds) {
+                    put(&t, "%.*s_bucket{%.*s%sle=\"%.9g\"} %llu\n", fam_len, d->name, labels_len, labels,
+                        sep, d->bounds[b] * d->scale, (unsigned long long)cum);
+                } else {
+                    put(&t, "%.*s_bucket{%.*s%sle=\"+Inf\"} %llu\n", fam_len, d->name, labels_len, labels,
+                        sep, (unsigned long long)cum);
+                }
+            }
+            put(&t, "%.*s_sum%s ", fam_len, d->name, brace ? brace : "");
+            put_value(&t, (double)shard_sum(m, d->slot + d->nbounds + 1) * d->scale);
+            put(&t, "%.*s_count%s %llu\n", fam_len, d->name, brace ? brace : "", (unsigned long long)cum);
+        }
+    }
+    if (t.full) {
+        NET_LOGW(TAG, "scrape output larger than %d bytes", NET_METRICS_TEXT_SIZE);
+        return 0;
+    }
+    m->scrapes++;
+    return t.len;
+}
+
+/* HTTP -------------------------------------------------------------------------------- */
+
+static const uint8_t *find_end_of_header(const uint8_t *data, size_t len)
+{
+    for (size_t i = 3; i < len; i++) {
+        if (data[i] == '\n' && data[i - 1] == '\r' && data[i - 2] == '\n' && data[i - 3] == '\r') {
+            return data + i + 1;
+        }
+    }
+    return NULL;
+}
+
+/* the response goes out as slabs from the server's pool queued in order, so it doesn't
+   have to fit the connection's tx buffer */
+static bool send_text(net_server_t *srv, net_conn_t *conn, const char *text, size_t len)
+{
+    while (len > 0) {
+        net_buf_t *buf = net_buf_get(&srv->rx_pool);
+        if (buf == NULL) {
+            return false;
+        }
+        buf->len = len < NET_BUF_SIZE ? len : NET_BUF_SIZE;
+        memcpy(buf->data, text, buf->len);
+        text += buf->len;
+        len -= buf->len;
+        if (net_server_send_buf(srv, conn, buf, NET_TX_COMMAND) != 0) {
+            net_buf_release(buf);
+            return false;
+        }
+        net_buf_release(buf);
+    }
+    return true;
+}
+
+size_t net_metrics_http(net_metrics_t *m, net_server_t *srv, net_conn_t *conn,
+                        const uint8_t *data, size_t len)
+{
+    const uint8_t *end = find_end_of_header(data, len);
+    if (end == NULL) {
+        return 0;       /* wait for the rest of the request */
+    }
+
+    size_t body = 0;
+    const char *status = "404 Not Found";
+    if (len >= 13 && memcmp(data, "GET /metrics", 12) == 0 && (data[12] == ' ' || data[12] == '?')) {
+        body = net_metrics_render(m, HTTP_HEADER_RESERVE);
+        status = body ? "200 OK" : "500 Internal Server Error";
+    }
+
+    char header[HTTP_HEADER_RESERVE];
+    int hlen = snprintf(header, sizeof(header),
+                        "HTTP/1.1 %s\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                        "Content-Length: %u\r\nConnection: close\r\n\r\n", status, (unsigned)body);
+    char *start = m->text + HTTP_HEADER_RESERVE - hlen;
+    memcpy(start, header, hlen);
+    if (!send_text(srv, conn, start, hlen + body)) {
+        NET_LOGW(TAG, "conn %u: no room for the scrape response", (unsigned)conn->id);
+    }
+    net_server_close(srv, conn);
+    return len;
+}
@@ -0,0 +1,146 @@
+/* Prometheus style metrics for the dip-coater socket servers
+
+   Counters, gauges and histograms are registered once at startup.  Every task that
+   records values claims its own shard (net_metrics_shard()) and updates it with plain
+   stores, no locks, no atomics, no formatting: a counter is an add, a histogram
+   observation a short scan of the bucket bounds and two adds.  Only a scrape walks all
+   shards, sums them and prints the text exposition format.  Metrics can also be read
+   at scrape time from a function (net_server statistics, pool occupancy, ...).
+
+   The scrape is served by the socket server itself: on_data passes requests that start
+   with "GET " to net_metrics_http(), which answers GET /metrics and closes the
+   connection.
+
+       static net_metrics_t metrics;
+       net_metrics_init(&metrics);
+       net_metrics_add_server(&metrics, &server);
+       int jitter = net_metrics_histogram(&metrics, "pid_loop_jitter_seconds{loop=\"0\"}",
+                                          "Wake-up delay of the control loop", us_bounds, 8, 1e-6);
+       ...control task:
+       net_metrics_shard_t *sh = net_metrics_shard(&metrics);
+       net_metric_observe(sh, jitter, late_us);
+
+   Values are 32 bit on the target so a shard update is never torn for the scrape;
+   counters wrap at 2^32 there, which rate() treats like a restart.  Names may carry a
+   label set; consecutive metrics of one family share the HELP and TYPE lines.
+*/
+#ifndef NET_METRICS_H
+#define NET_METRICS_H
+
+#include "net_server.h"
+
+#ifndef NET_METRICS_MAX
+#ifdef ESP_PLATFORM
+#define NET_METRICS_MAX 48
+#define NET_METRICS_SLOTS 192           /* values per shard, a histogram takes bounds + 2 */
+#define NET_METRICS_SHARDS 4
+#define NET_METRICS_SERVERS 1
+#define NET_METRICS_TEXT_SIZE 6144
+#else
+#define NET_METRICS_MAX 256
+#define NET_METRICS_SLOTS 1024
+#define NET_METRICS_SHARDS 32            /* a worker thread each, see tcp_server_linux */
+#define NET_METRICS_SERVERS 16
+#define NET_METRICS_TEXT_SIZE 65536
+#endif
+#endif
+
+#define NET_METRICS_MAX_BOUNDS 16
+
+#ifdef ESP_PLATFORM
+typedef uint32_t net_metric_val_t;
+#else
+typedef uint64_t net_metric_val_t;
+#endif
+
+typedef enum {
+    NET_METRIC_COUNTER = 0,
+    NET_METRIC_GAUGE,
+    NET_METRIC_HISTOGRAM,
+} net_metric_type_t;
+
+typedef struct {
+    const char *name;                   /* family name, optionally followed by {labels} */
+    const char *help;
+    net_metric_type_t type;
+    uint16_t slot;                      /* first value in every shard */
+    uint8_t nbounds;
+    const uint32_t *bounds;             /* histogram upper bounds, raw units, ascending */
+    double scale;                       /* raw value * scale = exposed value */
+    double (*read)(void *arg);          /* scraped from a function instead of the shards */
+    void *arg;
+} net_metric_def_t;
+
+typedef struct net_metrics net_metrics_t;
+
+typedef struct {
+    net_metric_val_t val[NET_METRICS_SLOTS];
+    const net_metrics_t *metrics;
+} __attribute__((aligned(64))) net_metrics_shard_t;
+
+struct net_metrics {
+    net_metric_def_t defs[NET_METRICS_MAX];
+    int count;
+    uint16_t slots;
+    uint32_t nshards;
+    uint32_t scrapes;
+    net_server_t *servers[NET_METRICS_SERVERS];
+    int nservers;
+    net_metrics_shard_t shards[NET_METRICS_SHARDS];
+    char text[NET_METRICS_TEXT_SIZE];   /* scrape output, one scrape at a time */
+};
+
+void net_metrics_init(net_metrics_t *m);
+
+/* registration, before any shard is in use; each returns the metric id or -1 when the
+   registry is full */
+int net_metrics_counter(net_metrics_t *m, const char *name, const char *help);
+int net_metrics_gauge(net_metrics_t *m, const char *name, const char *help);
+int net_metrics_histogram(net_metrics_t *m, const char *name, const char *help,
+                          const uint32_t *bounds, int nbounds, double scale);
+int net_metrics_read_fn(net_metrics_t *m, const char *name, const char *help, net_metric_type_t type,
+                        double (*read)(void *arg), void *arg);
+
+/* counters and gauges of the server and its receive pool, read at scrape time.  Servers
+   added later (SO_REUSEPORT workers on the same port) are summed into the same metrics. */
+void net_metrics_add_server(net_metrics_t *m, net_server_t *srv);
+
+/* claims a shard for the calling task, once; NULL when all are taken */
+net_metrics_shard_t *net_metrics_shard(net_metrics_t *m);
+
+static inline void net_metric_add(net_metrics_shard_t *sh, int id, net_metric_val_t v)
+{
+    sh->val[sh->metrics->defs[id].slot] += v;
+}
+
+/* gauges are summed over the shards, so each task sets its own share */
+static inline void net_metric_set(net_metrics_shard_t *sh, int id, net_metric_val_t v)
+{
+    sh->val[sh->metrics->defs[id].slot] = v;
+}
+
+static inline void net_metric_observe(net_metrics_shard_t *sh, int id, uint32_t v)
+{
+    const net_metric_def_t *d = &sh->metrics->defs[id];
+    int b = 0;
+    while (b < d->nbounds && v > d->bounds[b]) {
+        b++;
+    }
+    sh->val[d->slot + b]++;
+    sh->val[d->slot + d->nbounds + 1] += v;
+}
+
+/* writes the text exposition into m->text; returns its length, or 0 if it didn't fit */
+size_t net_metrics_render(net_metrics_t *m, size_t reserve);
+
+static inline bool net_metrics_is_http(const uint8_t *data, size_t len)
+{
+    return len >= 4 && memcmp(data, "GET ", 4) == 0;
+}
+
+/* on_data helper for HTTP requests: waits for the end of the request header, answers
+   GET /metrics (404 otherwise) and closes the connection; returns the bytes consumed */
+size_t net_metrics_http(net_metrics_t *m, net_server_t *srv, net_conn_t *conn,
+                        const uint8_t *data, size_t len);
+
+#endif
@@ -0,0 +1,116 @@
+/* Platform glue for the tecsci_net component
+
+   The same sources build against lwIP inside ESP-IDF and against POSIX sockets on Linux
+   (see ../../host), this header hides the few differences: includes, logging, sleeping,
+   locking and the monotonic clock.
+*/
+#ifndef NET_PORT_H
+#define NET_PORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef ESP_PLATFORM
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#define NET_LOGI(tag, ...) ESP_LOGI(tag, __VA_ARGS__)
+#define NET_LOGW(tag, ...) ESP_LOGW(tag, __VA_ARGS__)
+#define NET_LOGE(tag, ...) ESP_LOGE(tag, __VA_ARGS__)
+
+static inline int64_t net_time_us(void)
+{
+    return esp_timer_get_time();
+}
+
+static inline void net_sleep_ms(int ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+/* short critical sections shared with other tasks */
+typedef portMUX_TYPE net_lock_t;
+#define NET_LOCK_INIT portMUX_INITIALIZER_UNLOCKED
+
+static inline void net_lock(net_lock_t *l)
+{
+    portENTER_CRITICAL(l);
+}
+
+static inline void net_unlock(net_lock_t *l)
+{
+    portEXIT_CRITICAL(l);
+}
+
+#else
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define NET_LOGI(tag, fmt, ...) fprintf(stderr, "I %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define NET_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define NET_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+
+static inline int64_t net_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline void net_sleep_ms(int ms)
+{
+    usleep(ms * 1000);
+}
+
+typedef struct {
+    volatile bool held;
+} net_lock_t;
+#define NET_LOCK_INIT { false }
+
+static inline void net_lock(net_lock_t *l)
+{
+    while (__atomic_test_and_set(&l->held, __ATOMIC_ACQUIRE)) {
+    }
+}
+
+static inline void net_unlock(net_lock_t *l)
+{
+    __atomic_clear(&l->held, __ATOMIC_RELEASE);
+}
+
+#endif
+
+static inline int net_set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) {
+        return -1;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static inline bool net_would_block(int err)
+{
+    return err == EAGAIN || err == EWOULDBLOCK || err == EINPROGRESS;
+}
+
+#endif
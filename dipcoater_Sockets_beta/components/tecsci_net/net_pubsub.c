@@ -0,0 +1,136 @@
+/* Telemetry fan-out (see net_pubsub.h) */
+#include "net_pubsub.h"
+
+static const char *TAG = "net_pubsub";
+
+void net_pubsub_init(net_pubsub_t *ps, net_server_t *srv)
+{
+    memset(ps, 0, sizeof(*ps));
+    ps->srv = srv;
+    net_buf_pool_init(&ps->pool);
+}
+
+static net_sub_t *find_sub(net_pubsub_t *ps, const net_conn_t *conn)
+{
+    for (int i = 0; i < ps->nsubs; i++) {
+        if (ps->subs[i].conn == conn && ps->subs[i].conn_id == conn->id) {
+            return &ps->subs[i];
+        }
+    }
+    return NULL;
+}
+
+int net_pubsub_subscribe(net_pubsub_t *ps, net_conn_t *conn, uint32_t loops,
+                         net_sub_policy_t policy, int depth)
+{
+    if (loops == 0) {
+        net_pubsub_unsubscribe(ps, conn);
+        return 0;
+    }
+    net_sub_t *sub = find_sub(ps, conn);
+    if (sub == NULL) {
+        if (ps->nsubs == NET_PUBSUB_MAX_SUBS) {
+            NET_LOGW(TAG, "conn %u: no free subscriber slot", (unsigned)conn->id);
+            return -1;
+        }
+        sub = &ps->subs[ps->nsubs++];
+        memset(sub, 0, sizeof(*sub));
+        sub->conn = conn;
+        sub->conn_id = conn->id;
+    }
+    sub->loops = loops;
+    sub->policy = policy;
+    sub->depth = (depth <= 0 || depth > NET_CONN_TXQ) ? NET_CONN_TXQ : depth;
+    return 0;
+}
+
+void net_pubsub_unsubscribe(net_pubsub_t *ps, net_conn_t *conn)
+{
+    net_sub_t *sub = find_sub(ps, conn);
+    if (sub) {
+        *sub = ps->subs[--ps->nsubs];   /* keep the active slots packed */
+    }
+}
+
+bool net_pubsub_handle(net_pubsub_t *ps, net_conn_t *conn, const proto_frame_t *frame)
+{
+    uint32_t loops;
+    uint8_t policy, depth;
+    if (frame->type != PROTO_MSG_SUBSCRIBE || !proto_read_subscribe(frame, &loops, &policy, &depth)) {
+        return false;
+    }
+    if (policy > NET_SUB_DISCONNECT) {
+        policy = NET_SUB_DROP_OLDEST;
+    }
+    net_pubsub_subscribe(ps, conn, loops, (net_sub_policy_t)policy, depth);
+    return true;
+}
+
+net_buf_t *net_pubsub_frame(net_pubsub_t *ps)
+{
+    net_buf_t *buf = net_buf_get(&ps->pool);
+    if (buf == NULL) {
+        ps->stats.no_buffer++;
+    }
+    return buf;
+}
+
+int net_pubsub_publish(net_pubsub_t *ps, uint8_t loop, net_buf_t *buf)
+{
+    int queued = 0;
+    ps->stats.published++;
+    for (int i = 0; i < ps->nsubs; i++) {
+        net_sub_t *sub = &ps->subs[i];
+        net_conn_t *conn = sub->conn;
+        if (conn->state != NET_CONN_OPEN || conn->id != sub->conn_id) {
+            *sub = ps->subs[--ps->nsubs];   /* closed without unsubscribing */
+            i--;
+            continue;
+        }
+        if (!(sub->loops & (1u << (loop & 31)))) {
+            continue;
+        }
+        if (NET_CONN_TXQ - net_conn_txq_free(conn) >= sub->depth) {
+            if (sub->policy == NET_SUB_DISCONNECT) {
+                NET_LOGW(TAG, "conn %u: subscriber too slow, closing", (unsigned)conn->id);
+                ps->stats.disconnects++;
+                *sub = ps->subs[--ps->nsubs];
+                i--;
+                net_server_close(ps->srv, conn);
+                continue;
+            }
+            if (sub->policy == NET_SUB_DROP_NEWEST || !net_server_drop_queued(ps->srv, conn)) {
+                sub->dropped++;
+                ps->stats.drops++;
+                continue;
+            }
+            sub->dropped++;
+            ps->stats.drops++;
+        }
+        if (net_server_send_buf(ps->srv, conn, buf, NET_TX_TELEMETRY) == 0) {
+            sub->sent++;
+            queued++;
+        }
+        if (i < ps->nsubs && ps->subs[i].conn != conn) {
+            i--;    /* the send failed and on_close unsubscribed it */
+        }
+    }
+    ps->stats.deliveries += queued;
+    net_buf_release(buf);
+    return queued;
+}
+
+int net_pubsub_publish_telemetry(net_pubsub_t *ps, uint8_t loop, uint16_t period_ms,
+                                 uint32_t t0_ms, const proto_sample_t *samples, int count)
+{
+    net_buf_t *buf = net_pubsub_frame(ps);
+    if (buf == NULL) {
+        return 0;
+    }
+    buf->len = proto_encode_telemetry(buf->data, NET_BUF_SIZE, loop, period_ms, t0_ms, samples, count);
+    if (buf->len == 0) {
+        net_buf_release(buf);
+        return 0;
+    }
+    return net_pubsub_publish(ps, loop, buf);
+}
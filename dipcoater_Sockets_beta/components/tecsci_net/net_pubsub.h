@@ -0,0 +1,84 @@
+/* Telemetry fan-out for the dip-coater socket servers
+
+   The publisher serializes a telemetry batch once into a slab from the pub/sub pool and
+   publishes it for a loop; every connection subscribed to that loop gets a reference to
+   the same slab queued (net_server_send_buf()), nothing is encoded or copied per
+   subscriber.  A subscriber whose queue is full doesn't hold up the publisher or the
+   other subscribers, its own policy decides what happens:
+
+   - NET_SUB_DROP_NEWEST  the new frame is skipped for this subscriber
+   - NET_SUB_DROP_OLDEST  the oldest frame not yet on the wire is dropped to make room
+                          (the subscriber always sees the most recent data)
+   - NET_SUB_DISCONNECT   the subscriber is closed
+
+   Clients subscribe with PROTO_MSG_SUBSCRIBE; on_data hands those frames to
+   net_pubsub_handle() and on_close calls net_pubsub_unsubscribe().
+*/
+#ifndef NET_PUBSUB_H
+#define NET_PUBSUB_H
+
+#include "net_server.h"
+#include "tecsci_proto.h"
+
+#ifndef NET_PUBSUB_MAX_SUBS
+#ifdef ESP_PLATFORM
+#define NET_PUBSUB_MAX_SUBS 4
+#else
+#define NET_PUBSUB_MAX_SUBS 64
+#endif
+#endif
+
+typedef enum {
+    NET_SUB_DROP_NEWEST = 0,
+    NET_SUB_DROP_OLDEST,
+    NET_SUB_DISCONNECT,
+} net_sub_policy_t;
+
+typedef struct {
+    net_conn_t *conn;                   /* NULL when the slot is free */
+    uint32_t conn_id;
+    uint32_t loops;                     /* bit n: telemetry of loop n */
+    net_sub_policy_t policy;
+    int depth;                          /* frames allowed in the connection's queue */
+    uint32_t sent;
+    uint32_t dropped;
+} net_sub_t;
+
+typedef struct {
+    uint32_t published;
+    uint32_t deliveries;
+    uint32_t drops;
+    uint32_t disconnects;
+    uint32_t no_buffer;                 /* net_pubsub_frame() found the pool empty */
+} net_pubsub_stats_t;
+
+typedef struct {
+    net_server_t *srv;
+    int nsubs;
+    net_pubsub_stats_t stats;
+    net_sub_t subs[NET_PUBSUB_MAX_SUBS];
+    net_buf_pool_t pool;
+} net_pubsub_t;
+
+void net_pubsub_init(net_pubsub_t *ps, net_server_t *srv);
+
+/* depth 0 means the whole NET_CONN_TXQ; returns -1 if there is no free subscriber slot */
+int net_pubsub_subscribe(net_pubsub_t *ps, net_conn_t *conn, uint32_t loops,
+                         net_sub_policy_t policy, int depth);
+void net_pubsub_unsubscribe(net_pubsub_t *ps, net_conn_t *conn);
+
+/* applies a PROTO_MSG_SUBSCRIBE frame; returns false for any other frame */
+bool net_pubsub_handle(net_pubsub_t *ps, net_conn_t *conn, const proto_frame_t *frame);
+
+/* an empty slab to serialize into (set buf->len), or NULL if the pool is empty */
+net_buf_t *net_pubsub_frame(net_pubsub_t *ps);
+
+/* queues buf on every subscriber of loop and drops the caller's reference; returns the
+   number of subscribers it was queued on */
+int net_pubsub_publish(net_pubsub_t *ps, uint8_t loop, net_buf_t *buf);
+
+/* serializes samples into one telemetry frame and publishes it */
+int net_pubsub_publish_telemetry(net_pubsub_t *ps, uint8_t loop, uint16_t period_ms,
+                                 uint32_t t0_ms, const proto_sample_t *samples, int count);
+
+#endif
@@ -0,0 +1,821 @@
+/* Event driven TCP server for the dip-coater socket projects (see net_server.h) */
+#include "net_server.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+static const char *TAG = "net_server";
+
+#ifdef ESP_PLATFORM
+#define LISTEN_BACKLOG 4
+#else
+#define LISTEN_BACKLOG 128
+#endif
+
+#ifdef __linux__
+#define LISTEN_TAG UINT32_MAX
+#define EPOLL_BATCH 64
+
+static void set_interest(net_server_t *srv, net_conn_t *conn, bool write)
+{
+    struct epoll_event ev = {
+        .events = (conn->state == NET_CONN_OPEN && !conn->throttled && !conn->rx_waiting ? EPOLLIN : 0) |
+                  (write ? EPOLLOUT : 0),
+        .data.u32 = (uint32_t)(conn - srv->conns),
+    };
+    epoll_ctl(srv->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+    conn->want_write = write;
+}
+#else
+static void set_interest(net_server_t *srv, net_conn_t *conn, bool write)
+{
+    (void)srv;
+    conn->want_write = write;
+}
+#endif
+
+/* a slab counts against the server's budget while any send queue holds it */
+static void txq_hold(net_server_t *srv, net_buf_t *buf)
+{
+    if (buf->queued++ == 0) {
+        srv->stats.tx_mem += NET_BUF_SIZE;
+        if (srv->stats.tx_mem > srv->stats.tx_mem_max) {
+            srv->stats.tx_mem_max = srv->stats.tx_mem;
+        }
+    }
+    net_buf_ref(buf);
+}
+
+static void txq_unhold(net_server_t *srv, net_buf_t *buf)
+{
+    if (--buf->queued == 0) {
+        srv->stats.tx_mem -= NET_BUF_SIZE;
+    }
+    net_buf_release(buf);
+}
+
+static void conn_release(net_server_t *srv, net_conn_t *conn)
+{
+    if (srv->handlers.on_close) {
+        srv->handlers.on_close(srv, conn);
+    }
+#ifdef __linux__
+    epoll_ctl(srv->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+#endif
+    shutdown(conn->fd, 0);
+    close(conn->fd);
+    if (conn->rx_buf) {
+        net_buf_release(conn->rx_buf);
+        conn->rx_buf = NULL;
+    }
+    while (conn->txq_count > 0) {
+        txq_unhold(srv, conn->txq[conn->txq_head]);
+        conn->txq_head = (conn->txq_head + 1) % NET_CONN_TXQ;
+        conn->txq_count--;
+    }
+    conn->txq_off = 0;
+    conn->txq_bytes = 0;
+    conn->txq_commands = 0;
+    conn->throttled = false;
+    if (conn->rx_waiting) {
+        conn->rx_waiting = false;
+        srv->rx_waiting--;
+    }
+    conn->fd = -1;
+    conn->state = NET_CONN_FREE;
+    conn->user = NULL;
+    srv->stats.closed++;
+    srv->stats.open--;
+}
+
+static void txq_pop(net_server_t *srv, net_conn_t *conn)
+{
+    if (conn->txq_class[conn->txq_head] == NET_TX_COMMAND) {
+        conn->txq_commands--;
+    }
+    txq_unhold(srv, conn->txq[conn->txq_head]);
+    conn->txq_head = (conn->txq_head + 1) % NET_CONN_TXQ;
+    conn->txq_count--;
+    conn->txq_off = 0;
+}
+
+/* read interest follows the watermarks: a connection that doesn't take its answers isn't
+   read from either */
+static void check_pressure(net_server_t *srv, net_conn_t *conn)
+{
+    size_t pending = net_conn_pending(conn);
+    if (!conn->throttled && pending >= NET_CONN_TX_HIGH) {
+        conn->throttled = true;
+        srv->stats.throttled++;
+    } else if (conn->throttled && pending <= NET_CONN_TX_LOW) {
+        conn->throttled = false;
+    } else {
+        return;
+    }
+    set_interest(srv, conn, conn->want_write);
+    if (srv->handlers.on_pressure) {
+        srv->handlers.on_pressure(srv, conn, conn->throttled);
+    }
+}
+
+/* writes pending tx data and queued frames with one sendmsg() per round: first the rest of
+   a frame that went out partly, then the tx bytes, then the other frames.  Returns false
+   if the connection was closed. */
+static bool conn_flush(net_server_t *srv, net_conn_t *conn)
+{
+    while (conn->tx_len > 0 || conn->txq_count > 0) {
+        struct iovec iov[NET_CONN_TXQ + 1];
+        int cnt = 0, q = 0;
+        if (conn->txq_off > 0) {
+            net_buf_t *head = conn->txq[conn->txq_head];
+            iov[cnt].iov_base = head->data + conn->txq_off;
+            iov[cnt++].iov_len = head->len - conn->txq_off;
+            q = 1;
+        }
+        if (conn->tx_len > 0) {
+            iov[cnt].iov_base = conn->tx + conn->tx_off;
+            iov[cnt++].iov_len = conn->tx_len;
+        }
+        for (; q < conn->txq_count; q++) {
+            net_buf_t *b = conn->txq[(conn->txq_head + q) % NET_CONN_TXQ];
+            iov[cnt].iov_base = b->data;
+            iov[cnt++].iov_len = b->len;
+        }
+        struct msghdr msg = { .msg_iov = iov, .msg_iovlen = cnt };
+        int n = sendmsg(conn->fd, &msg, 0);
+        srv->stats.send_calls++;
+        if (n < 0) {
+            if (net_would_block(errno)) {
+                break;
+            }
+            NET_LOGW(TAG, "conn %u: send failed: errno %d", (unsigned)conn->id, errno);
+            conn_release(srv, conn);
+            return false;
+        }
+        srv->stats.bytes_out += n;
+
+        /* retire what went out, in the order it was gathered */
+        size_t left = n;
+        if (conn->txq_off > 0) {
+            size_t rest = conn->txq[conn->txq_head]->len - conn->txq_off;
+            size_t take = left < rest ? left : rest;
+            conn->txq_off += take;
+            conn->txq_bytes -= take;
+            left -= take;
+            if (take == rest) {
+                txq_pop(srv, conn);
+            }
+        }
+        if (left > 0 && conn->tx_len > 0) {
+            size_t take = left < conn->tx_len ? left : conn->tx_len;
+            conn->tx_off += take;
+            conn->tx_len -= take;
+            left -= take;
+        }
+        while (left > 0) {
+            size_t rest = conn->txq[conn->txq_head]->len - conn->txq_off;
+            size_t take = left < rest ? left : rest;
+            conn->txq_off += take;
+            conn->txq_bytes -= take;
+            left -= take;
+            if (take == rest) {
+                txq_pop(srv, conn);
+            }
+        }
+        if (conn->tx_len == 0) {
+            conn->tx_off = 0;
+        }
+    }
+    if (conn->tx_len == 0 && conn->txq_count == 0 && conn->state == NET_CONN_DRAINING) {
+        conn_release(srv, conn);
+        return false;
+    }
+    check_pressure(srv, conn);
+    bool want = conn->tx_len > 0 || conn->txq_count > 0;
+    if (want != conn->want_write) {
+        set_interest(srv, conn, want);
+    }
+    return true;
+}
+
+static void handle_accept(net_server_t *srv)
+{
+    while (1) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        int fd = accept(srv->listen_fd, (struct sockaddr *)&addr, &addr_len);
+        if (fd < 0) {
+            if (!net_would_block(errno)) {
+                NET_LOGE(TAG, "accept failed: errno %d", errno);
+            }
+            return;
+        }
+
+        net_conn_t *conn = NULL;
+        for (int i = 0; i < NET_SERVER_MAX_CONN; i++) {
+            if (srv->conns[i].state == NET_CONN_FREE) {
+                conn = &srv->conns[i];
+                break;
+            }
+        }
+        if (conn == NULL || net_set_nonblocking(fd) < 0) {
+            srv->stats.rejected++;
+            close(fd);
+            continue;
+        }
+
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        conn->fd = fd;
+        conn->state = NET_CONN_OPEN;
+        conn->id = srv->next_id++;
+        conn->peer = addr;
+        conn->rx_buf = NULL;
+        conn->rx_off = 0;
+        conn->rx_len = 0;
+        conn->tx_off = 0;
+        conn->tx_len = 0;
+        conn->txq_head = 0;
+        conn->txq_count = 0;
+        conn->txq_off = 0;
+        conn->txq_bytes = 0;
+        conn->txq_commands = 0;
+        conn->tx_dropped = 0;
+        conn->want_write = false;
+        conn->throttled = false;
+        conn->rx_waiting = false;
+        conn->user = NULL;
+#ifdef __linux__
+        struct epoll_event ev = {
+            .events = EPOLLIN,
+            .data.u32 = (uint32_t)(conn - srv->conns),
+        };
+        epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+#endif
+        srv->stats.accepted++;
+        srv->stats.open++;
+        if (srv->handlers.on_open) {
+            srv->handlers.on_open(srv, conn);
+        }
+    }
+}
+
+/* after on_data: gives the slab back once everything in it was consumed (a handler may
+   still hold it), and makes room at the end for the rest of a partial frame */
+static void rx_settle(net_server_t *srv, net_conn_t *conn)
+{
+    net_buf_t *buf = conn->rx_buf;
+    if (conn->rx_len == 0) {
+        net_buf_release(buf);
+        conn->rx_buf = NULL;
+        conn->rx_off = 0;
+        return;
+    }
+    if (conn->rx_off + conn->rx_len < NET_BUF_SIZE || conn->rx_off == 0) {
+        return;
+    }
+    if (net_buf_shared(buf)) {
+        /* frames before the partial one are still referenced, continue in a new slab */
+        net_buf_t *fresh = net_buf_get(&srv->rx_pool);
+        if (fresh == NULL) {
+            return;
+        }
+        memcpy(fresh->data, buf->data + conn->rx_off, conn->rx_len);
+        net_buf_release(buf);
+        conn->rx_buf = fresh;
+    } else {
+        memmove(buf->data, buf->data + conn->rx_off, conn->rx_len);
+    }
+    conn->rx_off = 0;
+    srv->stats.rx_copied += conn->rx_len;
+}
+
+static size_t rx_room(const net_conn_t *conn)
+{
+    return NET_BUF_SIZE - conn->rx_off - conn->rx_len;
+}
+
+/* the socket stays readable while its bytes wait for a slab, so its read interest is
+   dropped (level triggered epoll would report it on every poll, and select() likewise)
+   until rx_resume() finds room for them again */
+static void rx_wait(net_server_t *srv, net_conn_t *conn)
+{
+    srv->stats.rx_starved++;
+    conn->rx_waiting = true;
+    srv->rx_waiting++;
+    set_interest(srv, conn, conn->want_write);
+}
+
+/* a connection without a slab waits for a free one; one whose slab ends in a partial frame
+   waits until rx_settle() can move the frame, into a free slab or, once the handlers let go
+   of the slab, to its start */
+static void rx_resume(net_server_t *srv)
+{
+    if (srv->rx_waiting == 0) {
+        return;
+    }
+    bool slabs = __atomic_load_n(&srv->rx_pool.nfree, __ATOMIC_RELAXED) > 0;
+    for (int i = 0; i < NET_SERVER_MAX_CONN && srv->rx_waiting > 0; i++) {
+        net_conn_t *conn = &srv->conns[i];
+        if (!conn->rx_waiting) {
+            continue;
+        }
+        if (conn->rx_buf != NULL && rx_room(conn) == 0) {
+            rx_settle(srv, conn);
+        }
+        if (conn->rx_buf != NULL ? rx_room(conn) > 0 : slabs) {
+            conn->rx_waiting = false;
+            srv->rx_waiting--;
+            set_interest(srv, conn, conn->want_write);
+        }
+    }
+}
+
+static void handle_read(net_server_t *srv, net_conn_t *conn)
+{
+    while (conn->state == NET_CONN_OPEN && !conn->throttled && !conn->rx_waiting) {
+        if (conn->rx_buf == NULL) {
+            conn->rx_buf = net_buf_get(&srv->rx_pool);
+            if (conn->rx_buf == NULL) {
+                rx_wait(srv, conn);
+                return;
+            }
+            conn->rx_off = 0;
+            conn->rx_len = 0;
+        }
+        if (rx_room(conn) == 0) {
+            rx_settle(srv, conn);           /* the slab may have been let go of since */
+            if (rx_room(conn) == 0) {
+                rx_wait(srv, conn);         /* for a slab to move a partial frame into */
+                return;
+            }
+        }
+        uint8_t *data = conn->rx_buf->data + conn->rx_off;
+        size_t room = rx_room(conn);
+        int n = recv(conn->fd, data + conn->rx_len, room, 0);
+        if (n == 0) {
+            conn_release(srv, conn);
+            return;
+        }
+        if (n < 0) {
+            if (!net_would_block(errno)) {
+                conn_release(srv, conn);
+            }
+            return;
+        }
+        srv->stats.bytes_in += n;
+        conn->rx_len += n;
+
+        size_t used = 0;
+        while (used < conn->rx_len && conn->state == NET_CONN_OPEN) {
+            size_t c = srv->handlers.on_data(srv, conn, data + used, conn->rx_len - used);
+            if (c == 0) {
+                break;
+            }
+            used += c;
+        }
+        if (conn->state == NET_CONN_FREE) {
+            return;
+        }
+        conn->rx_off += used;
+        conn->rx_len -= used;
+        if (conn->rx_len == NET_BUF_SIZE) {
+            NET_LOGW(TAG, "conn %u: message larger than the rx buffer", (unsigned)conn->id);
+            conn_release(srv, conn);
+            return;
+        }
+        rx_settle(srv, conn);
+        if ((size_t)n < room / 2) {
+            return;     /* socket drained, no need for another EAGAIN round trip */
+        }
+    }
+}
+
+static int server_init(net_server_t *srv, uint16_t port, const net_handlers_t *handlers, bool reuseport)
+{
+    memset(srv, 0, sizeof(*srv));
+    srv->handlers = *handlers;
+    srv->next_id = 1;
+    net_buf_pool_init(&srv->rx_pool);
+    for (int i = 0; i < NET_SERVER_MAX_CONN; i++) {
+        srv->conns[i].fd = -1;
+    }
+
+    srv->listen_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (srv->listen_fd < 0) {
+        NET_LOGE(TAG, "Unable to create socket: errno %d", errno);
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(srv->listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+#ifdef SO_REUSEPORT
+    if (reuseport && setsockopt(srv->listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) != 0) {
+        NET_LOGE(TAG, "SO_REUSEPORT failed: errno %d", errno);
+        close(srv->listen_fd);
+        return -1;
+    }
+#else
+    if (reuseport) {
+        NET_LOGE(TAG, "SO_REUSEPORT is not supported here");
+        close(srv->listen_fd);
+        return -1;
+    }
+#endif
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(srv->listen_fd, LISTEN_BACKLOG) != 0 ||
+        net_set_nonblocking(srv->listen_fd) < 0) {
+        NET_LOGE(TAG, "Unable to listen on port %u: errno %d", port, errno);
+        close(srv->listen_fd);
+        return -1;
+    }
+
+#ifdef __linux__
+    srv->epoll_fd = epoll_create1(0);
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = LISTEN_TAG };
+    if (srv->epoll_fd < 0 || epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, srv->listen_fd, &ev) < 0) {
+        NET_LOGE(TAG, "epoll setup failed: errno %d", errno);
+        close(srv->listen_fd);
+        return -1;
+    }
+#endif
+    NET_LOGI(TAG, "Socket listening on port %u", port);
+    return 0;
+}
+
+int net_server_init(net_server_t *srv, uint16_t port, const net_handlers_t *handlers)
+{
+    return server_init(srv, port, handlers, false);
+}
+
+int net_server_init_reuseport(net_server_t *srv, uint16_t port, const net_handlers_t *handlers)
+{
+    return server_init(srv, port, handlers, true);
+}
+
+void net_server_deinit(net_server_t *srv)
+{
+    for (int i = 0; i < NET_SERVER_MAX_CONN; i++) {
+        if (srv->conns[i].state != NET_CONN_FREE) {
+            conn_release(srv, &srv->conns[i]);
+        }
+    }
+#ifdef __linux__
+    close(srv->epoll_fd);
+#endif
+    close(srv->listen_fd);
+}
+
+#ifdef __linux__
+int net_server_poll(net_server_t *srv, int timeout_ms)
+{
+    struct epoll_event events[EPOLL_BATCH];
+    rx_resume(srv);
+    if (srv->rx_waiting > 0 && (timeout_ms < 0 || timeout_ms > NET_SERVER_RX_RETRY_MS)) {
+        timeout_ms = NET_SERVER_RX_RETRY_MS;
+    }
+    int n = epoll_wait(srv->epoll_fd, events, EPOLL_BATCH, timeout_ms);
+    if (n < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    for (int i = 0; i < n; i++) {
+        uint32_t tag = events[i].data.u32;
+        if (tag == LISTEN_TAG) {
+            handle_accept(srv);
+            continue;
+        }
+        net_conn_t *conn = &srv->conns[tag];
+        if (conn->state == NET_CONN_FREE) {
+            continue;
+        }
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+            conn_release(srv, conn);
+            continue;
+        }
+        if (events[i].events & EPOLLOUT) {
+            if (!conn_flush(srv, conn)) {
+                continue;
+            }
+        }
+        if (events[i].events & EPOLLIN) {
+            handle_read(srv, conn);
+        }
+    }
+    return n;
+}
+#else
+int net_server_poll(net_server_t *srv, int timeout_ms)
+{
+    fd_set rfds, wfds;
+    rx_resume(srv);
+    if (srv->rx_waiting > 0 && (timeout_ms < 0 || timeout_ms > NET_SERVER_RX_RETRY_MS)) {
+        timeout_ms = NET_SERVER_RX_RETRY_MS;
+    }
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    FD_SET(srv->listen_fd, &rfds);
+    int max_fd = srv->listen_fd;
+
+    for (int i = 0; i < NET_SERVER_MAX_CONN; i++) {
+        net_conn_t *conn = &srv->conns[i];
+        if (conn->state == NET_CONN_FREE) {
+            continue;
+        }
+        if (conn->state == NET_CONN_OPEN && !conn->throttled && !conn->rx_waiting) {
+            FD_SET(conn->fd, &rfds);
+        }
+        if (conn->want_write) {
+            FD_SET(conn->fd, &wfds);
+        }
+        if (conn->fd > max_fd) {
+            max_fd = conn->fd;
+        }
+    }
+
+    struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    int n = select(max_fd + 1, &rfds, &wfds, NULL, timeout_ms < 0 ? NULL : &tv);
+    if (n <= 0) {
+        return (n < 0 && errno != EINTR) ? -1 : 0;
+    }
+
+    if (FD_ISSET(srv->listen_fd, &rfds)) {
+        handle_accept(srv);
+    }
+    for (int i = 0; i < NET_SERVER_MAX_CONN; i++) {
+        net_conn_t *conn = &srv->conns[i];
+        if (conn->state == NET_CONN_FREE) {
+            continue;
+        }
+        int fd = conn->fd;
+        if (FD_ISSET(fd, &wfds) && !conn_flush(srv, conn)) {
+            continue;
+        }
+        if (FD_ISSET(fd, &rfds)) {
+            handle_read(srv, conn);
+        }
+    }
+    return n;
+}
+#endif
+
+static void count_dropped(net_server_t *srv, net_conn_t *conn);
+
+/* an answer that doesn't fit the tx buffer goes into command slabs from the receive pool
+   instead of being lost; once one is queued, the answers after it follow it there so they
+   stay in order.  Small answers share the last slab while nothing else references it.
+   A telemetry frame gets a slab of its own, so the budgets can drop it on its own. */
+static int queue_answer(net_server_t *srv, net_conn_t *conn, const struct iovec *iov, int iovcnt, size_t total,
+                        net_tx_class_t cls)
+{
+    if (total > NET_BUF_SIZE) {
+        srv->stats.tx_overflows++;
+        return -1;
+    }
+    net_buf_t *buf = NULL;
+    if (cls == NET_TX_COMMAND && conn->txq_commands > 0) {
+        int tail = (conn->txq_head + conn->txq_count - 1) % NET_CONN_TXQ;
+        net_buf_t *t = conn->txq[tail];
+        if (conn->txq_class[tail] == NET_TX_COMMAND && !net_buf_shared(t) && t->len + total <= NET_BUF_SIZE) {
+            buf = t;
+        }
+    }
+    bool fresh = buf == NULL;
+    if (fresh && (buf = net_buf_get(&srv->rx_pool)) == NULL) {
+        if (cls == NET_TX_TELEMETRY) {
+            count_dropped(srv, conn);
+        } else {
+            srv->stats.tx_overflows++;
+        }
+        return -1;
+    }
+    size_t at = buf->len;
+    for (int i = 0; i < iovcnt; i++) {
+        memcpy(buf->data + buf->len, iov[i].iov_base, iov[i].iov_len);
+        buf->len += iov[i].iov_len;
+    }
+    if (!fresh) {
+        conn->txq_bytes += buf->len - at;
+        check_pressure(srv, conn);
+        return 0;
+    }
+    int r = net_server_send_buf(srv, conn, buf, cls);
+    net_buf_release(buf);
+    return r;
+}
+
+int net_server_send(net_server_t *srv, net_conn_t *conn, const void *data, size_t len)
+{
+    if (conn->state != NET_CONN_OPEN) {
+        return -1;
+    }
+    if (conn->txq_commands > 0 || len > net_conn_tx_free(conn)) {
+        struct iovec iov = { (void *)data, len };
+        return queue_answer(srv, conn, &iov, 1, len, NET_TX_COMMAND);
+    }
+    if (conn->tx_off + conn->tx_len + len > NET_CONN_TX_SIZE) {
+        memmove(conn->tx, conn->tx + conn->tx_off, conn->tx_len);
+        conn->tx_off = 0;
+    }
+    memcpy(conn->tx + conn->tx_off + conn->tx_len, data, len);
+    conn->tx_len += len;
+    conn_flush(srv, conn);
+    return 0;
+}
+
+int net_server_sendv(net_server_t *srv, net_conn_t *conn, const struct iovec *iov, int iovcnt,
+                     net_tx_class_t cls)
+{
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+    }
+    if (conn->state != NET_CONN_OPEN) {
+        return -1;
+    }
+    if (conn->txq_commands > 0 || total > net_conn_tx_free(conn)) {
+        return queue_answer(srv, conn, iov, iovcnt, total, cls);
+    }
+
+    size_t sent = 0;
+    if (conn->tx_len == 0 && conn->txq_count == 0) {
+        struct msghdr msg = {
+            .msg_iov = (struct iovec *)iov,
+            .msg_iovlen = iovcnt,
+        };
+        int n = sendmsg(conn->fd, &msg, 0);
+        srv->stats.send_calls++;
+        if (n < 0 && !net_would_block(errno)) {
+            NET_LOGW(TAG, "conn %u: sendmsg failed: errno %d", (unsigned)conn->id, errno);
+            conn_release(srv, conn);
+            return -1;
+        }
+        if (n > 0) {
+            sent = n;
+            srv->stats.bytes_out += n;
+        }
+        if (sent == total) {
+            return 0;
+        }
+    }
+
+    /* queue the rest behind whatever is pending */
+    if (conn->tx_off + conn->tx_len + (total - sent) > NET_CONN_TX_SIZE) {
+        memmove(conn->tx, conn->tx + conn->tx_off, conn->tx_len);
+        conn->tx_off = 0;
+    }
+    uint8_t *dst = conn->tx + conn->tx_off + conn->tx_len;
+    size_t skip = sent;
+    for (int i = 0; i < iovcnt; i++) {
+        size_t len = iov[i].iov_len;
+        const uint8_t *src = iov[i].iov_base;
+        if (skip >= len) {
+            skip -= len;
+            continue;
+        }
+        memcpy(dst, src + skip, len - skip);
+        dst += len - skip;
+        skip = 0;
+    }
+    conn->tx_len += total - sent;
+    if (!conn->want_write) {
+        set_interest(srv, conn, true);
+    }
+    check_pressure(srv, conn);
+    return 0;
+}
+
+/* index in the ring of the oldest telemetry frame that hasn't started going out, or -1 */
+static int oldest_telemetry(const net_conn_t *conn)
+{
+    for (int k = conn->txq_off > 0 ? 1 : 0; k < conn->txq_count; k++) {
+        int i = (conn->txq_head + k) % NET_CONN_TXQ;
+        if (conn->txq_class[i] == NET_TX_TELEMETRY) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+static bool drop_telemetry(net_server_t *srv, net_conn_t *conn)
+{
+    int k = oldest_telemetry(conn);
+    if (k < 0) {
+        return false;
+    }
+    int i = (conn->txq_head + k) % NET_CONN_TXQ;
+    conn->txq_bytes -= conn->txq[i]->len;
+    txq_unhold(srv, conn->txq[i]);
+    for (; k < conn->txq_count - 1; k++) {
+        int next = (i + 1) % NET_CONN_TXQ;
+        conn->txq[i] = conn->txq[next];
+        conn->txq_class[i] = conn->txq_class[next];
+        i = next;
+    }
+    conn->txq_count--;
+    return true;
+}
+
+/* a frame dropped by the budgets, queued or the new one */
+static void count_dropped(net_server_t *srv, net_conn_t *conn)
+{
+    conn->tx_dropped++;
+    srv->stats.tx_dropped++;
+}
+
+/* over the server budget: telemetry goes from the connection with the most queued, the
+   one furthest behind, so the clients that keep up don't lose anything */
+static bool shed_longest(net_server_t *srv)
+{
+    net_conn_t *longest = NULL;
+    for (int i = 0; i < NET_SERVER_MAX_CONN; i++) {
+        net_conn_t *c = &srv->conns[i];
+        if (c->txq_count > 0 && (longest == NULL || c->txq_bytes > longest->txq_bytes) &&
+            oldest_telemetry(c) >= 0) {
+            longest = c;
+        }
+    }
+    if (longest == NULL) {
+        return false;
+    }
+    drop_telemetry(srv, longest);
+    count_dropped(srv, longest);
+    return true;
+}
+
+int net_server_send_buf(net_server_t *srv, net_conn_t *conn, net_buf_t *buf, net_tx_class_t cls)
+{
+    if (conn->state != NET_CONN_OPEN) {
+        return -1;
+    }
+    if (cls == NET_TX_TELEMETRY) {
+        while (conn->txq_count == NET_CONN_TXQ || conn->txq_bytes + buf->len > NET_CONN_TX_BUDGET) {
+            bool dropped = drop_telemetry(srv, conn);
+            count_dropped(srv, conn);
+            if (!dropped) {
+                return -1;
+            }
+        }
+        while (buf->queued == 0 && srv->stats.tx_mem + NET_BUF_SIZE > NET_SERVER_TX_BUDGET) {
+            if (!shed_longest(srv)) {
+                count_dropped(srv, conn);
+                return -1;
+            }
+        }
+    } else {
+        while (conn->txq_count == NET_CONN_TXQ) {
+            if (!drop_telemetry(srv, conn)) {
+                NET_LOGW(TAG, "conn %u: not taking its answers, closing", (unsigned)conn->id);
+                srv->stats.tx_stalled++;
+                conn_release(srv, conn);
+                return -1;
+            }
+        }
+        /* may go over the server budget, but not without making room where it can */
+        while (buf->queued == 0 && srv->stats.tx_mem + NET_BUF_SIZE > NET_SERVER_TX_BUDGET &&
+               shed_longest(srv)) {
+        }
+    }
+    int i = (conn->txq_head + conn->txq_count) % NET_CONN_TXQ;
+    txq_hold(srv, buf);
+    conn->txq[i] = buf;
+    conn->txq_class[i] = (uint8_t)cls;
+    conn->txq_count++;
+    conn->txq_commands += cls == NET_TX_COMMAND;
+    conn->txq_bytes += buf->len;
+    if (!conn->want_write) {
+        conn_flush(srv, conn);      /* otherwise the socket is full and poll flushes it */
+    } else {
+        check_pressure(srv, conn);
+    }
+    return 0;
+}
+
+bool net_server_drop_queued(net_server_t *srv, net_conn_t *conn)
+{
+    if (!drop_telemetry(srv, conn)) {
+        return false;
+    }
+    check_pressure(srv, conn);
+    return true;
+}
+
+void net_server_close(net_server_t *srv, net_conn_t *conn)
+{
+    if (conn->state != NET_CONN_OPEN) {
+        return;
+    }
+    conn->state = NET_CONN_DRAINING;
+    if (conn_flush(srv, conn)) {
+        set_interest(srv, conn, true);   /* stop reading, wait for the tx buffer to drain */
+    }
+}
@@ -0,0 +1,234 @@
+/* Event driven TCP server for the dip-coater socket projects
+
+   One task runs net_server_poll() in a loop; every connection is a small state machine
+   inside net_server_t, so many operator and telemetry clients are served at once instead
+   of one client at a time.  Sockets are non-blocking; readiness comes from epoll on
+   Linux and from select() on lwIP.  Received bytes land directly in slabs of a fixed
+   buffer pool (net_buf.h) and are handed to on_data without being copied.
+
+   What a connection has waiting to be sent is bounded in bytes, so a client that stops
+   reading (an operator laptop gone to sleep) can't take the memory of the others:
+   - frames are queued with a class.  NET_TX_TELEMETRY frames count against the
+     connection's NET_CONN_TX_BUDGET and the oldest not yet on the wire is dropped to make
+     room; NET_TX_COMMAND frames (answers, responses) are never dropped, telemetry is
+     dropped for them instead, and a connection that can't take one is closed.
+   - slabs held by send queues count once against NET_SERVER_TX_BUDGET, whichever pools
+     they come from and however many connections share them; past it, telemetry is
+     dropped from the longest queues first.
+   - above NET_CONN_TX_HIGH bytes waiting, the server stops reading from the connection
+     (no new requests from a client that doesn't take its answers) and calls on_pressure;
+     below NET_CONN_TX_LOW it reads again.
+
+   A connection that finds the receive pool empty isn't read from either until slabs are
+   back; they may be released from other tasks, so meanwhile net_server_poll() waits at
+   most NET_SERVER_RX_RETRY_MS before it looks again.
+
+   Typical use from the tcp_server task:
+
+       static net_server_t server;
+       net_server_init(&server, PORT, &handlers);
+       while (1) {
+           net_server_poll(&server, 100);
+       }
+*/
+#ifndef NET_SERVER_H
+#define NET_SERVER_H
+
+#include "net_port.h"
+#include "net_buf.h"
+
+#ifndef NET_SERVER_MAX_CONN
+#ifdef ESP_PLATFORM
+#define NET_SERVER_MAX_CONN 8
+#else
+#define NET_SERVER_MAX_CONN 1024
+#endif
+#endif
+
+#ifndef NET_CONN_TX_SIZE
+#define NET_CONN_TX_SIZE 4096
+#endif
+
+/* shared frames queued per connection, see net_server_send_buf() */
+#ifndef NET_CONN_TXQ
+#ifdef ESP_PLATFORM
+#define NET_CONN_TXQ 8
+#else
+#define NET_CONN_TXQ 32
+#endif
+#endif
+
+/* bytes of telemetry frames queued per connection */
+#ifndef NET_CONN_TX_BUDGET
+#ifdef ESP_PLATFORM
+#define NET_CONN_TX_BUDGET 4096
+#else
+#define NET_CONN_TX_BUDGET 32768
+#endif
+#endif
+
+#ifndef NET_CONN_TX_HIGH
+#define NET_CONN_TX_HIGH (NET_CONN_TX_BUDGET * 3 / 4)
+#endif
+#ifndef NET_CONN_TX_LOW
+#define NET_CONN_TX_LOW (NET_CONN_TX_BUDGET / 4)
+#endif
+
+/* bytes of slabs all send queues together may hold */
+#ifndef NET_SERVER_TX_BUDGET
+#ifdef ESP_PLATFORM
+#define NET_SERVER_TX_BUDGET (8 * NET_BUF_SIZE)
+#else
+#define NET_SERVER_TX_BUDGET (4 * 1024 * 1024)
+#endif
+#endif
+
+/* longest poll while connections wait for receive slabs */
+#ifndef NET_SERVER_RX_RETRY_MS
+#define NET_SERVER_RX_RETRY_MS 10
+#endif
+
+typedef enum {
+    NET_TX_TELEMETRY = 0,   /* dropped, oldest first, to stay within the budgets */
+    NET_TX_COMMAND,         /* never dropped */
+} net_tx_class_t;
+
+typedef enum {
+    NET_CONN_FREE = 0,
+    NET_CONN_OPEN,          /* reading and writing */
+    NET_CONN_DRAINING,      /* close requested, flushing what is queued */
+} net_conn_state_t;
+
+typedef struct net_conn {
+    int fd;
+    net_conn_state_t state;
+    uint32_t id;                        /* increases with every accept, never reused */
+    struct sockaddr_in peer;
+    bool want_write;                    /* write interest currently registered */
+    bool throttled;                     /* above the high watermark, not read from */
+    bool rx_waiting;                    /* no receive slab for it, not read from */
+
+    net_buf_t *rx_buf;                  /* from the server's pool, NULL while nothing is pending */
+    size_t rx_off, rx_len;              /* pending bytes are rx_buf->data[rx_off .. rx_off + rx_len) */
+    uint8_t tx[NET_CONN_TX_SIZE];
+    size_t tx_off, tx_len;              /* pending bytes are tx[tx_off .. tx_off + tx_len) */
+    net_buf_t *txq[NET_CONN_TXQ];       /* ring of referenced frames waiting to be sent */
+    uint8_t txq_class[NET_CONN_TXQ];    /* net_tx_class_t of each */
+    uint8_t txq_head, txq_count;
+    uint8_t txq_commands;               /* NET_TX_COMMAND frames among them */
+    size_t txq_off;                     /* bytes of txq[txq_head] already sent */
+    size_t txq_bytes;                   /* bytes of queued frames not sent yet */
+    uint32_t tx_dropped;                /* telemetry frames dropped for the budgets */
+
+    void *user;                         /* per connection protocol state */
+} net_conn_t;
+
+typedef struct net_server net_server_t;
+
+typedef struct {
+    void (*on_open)(net_server_t *srv, net_conn_t *conn);
+    /* returns how many bytes of data were consumed; unconsumed bytes are kept and handed
+       over again together with the next ones */
+    size_t (*on_data)(net_server_t *srv, net_conn_t *conn, const uint8_t *data, size_t len);
+    void (*on_close)(net_server_t *srv, net_conn_t *conn);
+    void *ctx;
+    /* optional: the bytes waiting for conn crossed the high (true) or low (false) watermark */
+    void (*on_pressure)(net_server_t *srv, net_conn_t *conn, bool high);
+} net_handlers_t;
+
+typedef struct {
+    uint32_t accepted;
+    uint32_t rejected;                  /* no free connection slot */
+    uint32_t closed;
+    uint32_t open;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t rx_copied;                 /* partial frames moved to the front of a slab */
+    uint32_t rx_starved;                /* reads postponed because the pool was empty */
+    uint32_t send_calls;                /* send()/sendmsg() system calls */
+    uint32_t tx_overflows;              /* net_server_send() refused, no room for the answer */
+    uint32_t tx_dropped;                /* telemetry frames dropped for the budgets */
+    uint32_t throttled;                 /* connections that went above the high watermark */
+    uint32_t tx_stalled;                /* connections closed because a command didn't fit */
+    size_t tx_mem;                      /* bytes of slabs held by send queues */
+    size_t tx_mem_max;
+} net_server_stats_t;
+
+struct net_server {
+    int listen_fd;
+#ifdef __linux__
+    int epoll_fd;
+#endif
+    uint32_t next_id;
+    net_handlers_t handlers;
+    net_server_stats_t stats;
+    int rx_waiting;                     /* connections waiting for a receive slab */
+    net_buf_pool_t rx_pool;
+    net_conn_t conns[NET_SERVER_MAX_CONN];
+};
+
+int net_server_init(net_server_t *srv, uint16_t port, const net_handlers_t *handlers);
+
+/* the same with SO_REUSEPORT on the listening socket (Linux): several servers, each
+   polled by a thread of its own, listen on one port and the kernel spreads the incoming
+   connections over them.  A connection stays with the server that accepted it. */
+int net_server_init_reuseport(net_server_t *srv, uint16_t port, const net_handlers_t *handlers);
+void net_server_deinit(net_server_t *srv);
+
+/* waits up to timeout_ms for socket events and handles all of them; returns the number
+   of ready sockets or -1 on error */
+int net_server_poll(net_server_t *srv, int timeout_ms);
+
+/* queues len bytes and writes as much as the socket takes right away.  What doesn't fit
+   in the connection's tx buffer is queued as a NET_TX_COMMAND frame in a slab from the
+   receive pool; returns -1 without queuing anything only if there is no slab left (or the
+   connection was closed because it doesn't take its answers). */
+int net_server_send(net_server_t *srv, net_conn_t *conn, const void *data, size_t len);
+
+/* gathers iovcnt buffers into one sendmsg() when nothing is queued, so separately built
+   headers and payloads go out without being copied together; only what the socket doesn't
+   take is copied into the tx buffer.  What doesn't fit there is queued as a frame of class
+   cls, so a NET_TX_TELEMETRY frame is dropped under the budgets like one from
+   net_server_send_buf() (and -1 then means it was dropped, the connection stays open).
+   Otherwise the same return convention as net_server_send(). */
+int net_server_sendv(net_server_t *srv, net_conn_t *conn, const struct iovec *iov, int iovcnt,
+                     net_tx_class_t cls);
+
+/* only valid inside on_data: takes a reference on the slab the data points into, so frames
+   parsed from it stay valid after on_data returns; drop it with net_buf_release() */
+static inline net_buf_t *net_conn_hold(net_conn_t *conn)
+{
+    return net_buf_ref(conn->rx_buf);
+}
+
+/* queues a reference to buf (buf->len bytes, one or more whole frames) instead of copying
+   it, so one serialized frame can go to many connections.  Frames from the queue and bytes
+   from net_server_send() may go out in either order, but never interleave inside a frame.
+   Returns -1 if a telemetry frame doesn't fit the budgets even after dropping older ones,
+   or if a command frame doesn't fit (the connection is closed then). */
+int net_server_send_buf(net_server_t *srv, net_conn_t *conn, net_buf_t *buf, net_tx_class_t cls);
+
+/* drops the oldest queued telemetry frame that hasn't started going out; returns false if
+   none */
+bool net_server_drop_queued(net_server_t *srv, net_conn_t *conn);
+
+static inline int net_conn_txq_free(const net_conn_t *conn)
+{
+    return NET_CONN_TXQ - conn->txq_count;
+}
+
+/* closes once the queued data is sent */
+void net_server_close(net_server_t *srv, net_conn_t *conn);
+
+static inline size_t net_conn_tx_free(const net_conn_t *conn)
+{
+    return NET_CONN_TX_SIZE - conn->tx_len;
+}
+
+/* bytes waiting to be sent, what the watermarks look at */
+static inline size_t net_conn_pending(const net_conn_t *conn)
+{
+    return conn->tx_len + conn->txq_bytes;
+}
+
+#endif
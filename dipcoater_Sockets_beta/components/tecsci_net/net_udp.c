@@ -0,0 +1,194 @@
+/* UDP side channel (see net_udp.h) */
+#include "net_udp.h"
+
+static const char *TAG = "net_udp";
+
+int net_udp_open(net_udp_t *u, uint16_t local_port)
+{
+    memset(u, 0, sizeof(*u));
+    u->learn_peer = true;
+    u->tx_session = (uint32_t)net_time_us() ^ ((uint32_t)(uintptr_t)u << 7);
+    u->fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (u->fd < 0) {
+        NET_LOGE(TAG, "Unable to create socket: errno %d", errno);
+        return -1;
+    }
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(local_port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(u->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || net_set_nonblocking(u->fd) < 0) {
+        NET_LOGE(TAG, "Socket unable to bind port %u: errno %d", local_port, errno);
+        close(u->fd);
+        u->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void net_udp_close(net_udp_t *u)
+{
+    if (u->fd >= 0) {
+        close(u->fd);
+        u->fd = -1;
+    }
+}
+
+void net_udp_set_peer(net_udp_t *u, const char *host, uint16_t port)
+{
+    u->peer.sin_family = AF_INET;
+    u->peer.sin_port = htons(port);
+    u->peer.sin_addr.s_addr = inet_addr(host);
+    u->have_peer = true;
+    u->learn_peer = false;
+}
+
+int net_udp_send(net_udp_t *u, const uint8_t *frame, size_t len)
+{
+    if (!u->have_peer || len > PROTO_HEADER_SIZE + PROTO_MAX_PAYLOAD) {
+        return -1;
+    }
+    uint8_t hdr[NET_UDP_HEADER];
+    proto_put_u32(hdr, u->tx_session);
+    proto_put_u32(hdr + 4, ++u->tx_seq);
+    struct iovec iov[2] = {
+        { .iov_base = hdr, .iov_len = sizeof(hdr) },
+        { .iov_base = (void *)frame, .iov_len = len },
+    };
+    struct msghdr msg = {
+        .msg_name = &u->peer,
+        .msg_namelen = sizeof(u->peer),
+        .msg_iov = iov,
+        .msg_iovlen = 2,
+    };
+    if (sendmsg(u->fd, &msg, 0) < 0) {
+        return -1;      /* a full socket buffer loses the datagram, like the air would */
+    }
+    u->stats.sent++;
+    return 0;
+}
+
+static bool session_retired(const net_udp_t *u, uint32_t session)
+{
+    for (int i = 0; i < u->rx_nretired; i++) {
+        if (u->rx_retired[i] == session) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* sliding window over the sequence numbers; false for duplicates and stale datagrams */
+static bool window_accept(net_udp_t *u, uint32_t session, uint32_t seq)
+{
+    if (!u->rx_started || session != u->rx_session) {
+        if (u->rx_started) {
+            if (session_retired(u, session)) {
+                u->stats.retired++;
+                return false;
+            }
+            u->stats.sessions++;
+            u->rx_retired[u->rx_retired_next] = u->rx_session;
+            u->rx_retired_next = (u->rx_retired_next + 1) % NET_UDP_RETIRED;
+            if (u->rx_nretired < NET_UDP_RETIRED) {
+                u->rx_nretired++;
+            }
+        }
+        u->rx_started = true;
+        u->rx_session = session;
+        u->rx_highest = seq;
+        u->rx_window = 1;
+        u->nkeys = 0;
+        return true;
+    }
+    int32_t ahead = (int32_t)(seq - u->rx_highest);
+    if (ahead > 0) {
+        u->rx_window = ahead >= NET_UDP_WINDOW ? 0 : u->rx_window << ahead;
+        u->rx_window |= 1;
+        u->rx_highest = seq;
+        return true;
+    }
+    uint32_t behind = (uint32_t)-ahead;
+    if (behind >= NET_UDP_WINDOW) {
+        u->stats.too_old++;
+        return false;
+    }
+    if (u->rx_window & ((uint64_t)1 << behind)) {
+        u->stats.duplicates++;
+        return false;
+    }
+    u->rx_window |= (uint64_t)1 << behind;
+    return true;
+}
+
+/* latest-value-wins for commands */
+static bool key_accept(net_udp_t *u, const proto_frame_t *f, uint32_t seq)
+{
+    if (f->type == PROTO_MSG_TELEMETRY || f->type == PROTO_MSG_TELEMETRY_DZ || f->len == 0) {
+        return true;
+    }
+    uint8_t loop = f->payload[0];
+    for (int i = 0; i < u->nkeys; i++) {
+        if (u->keys[i].type == f->type && u->keys[i].loop == loop) {
+            if ((int32_t)(seq - u->keys[i].seq) <= 0) {
+                u->stats.superseded++;
+                return false;
+            }
+            u->keys[i].seq = seq;
+            return true;
+        }
+    }
+    if (u->nkeys < NET_UDP_MAX_KEYS) {
+        u->keys[u->nkeys].type = f->type;
+        u->keys[u->nkeys].loop = loop;
+        u->keys[u->nkeys].seq = seq;
+        u->nkeys++;
+    }
+    return true;
+}
+
+int net_udp_poll(net_udp_t *u, int timeout_ms, proto_handler_t handler, void *arg)
+{
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    FD_SET(u->fd, &rfds);
+    struct timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+    int ready = select(u->fd + 1, &rfds, NULL, NULL, &tv);
+    if (ready < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    int delivered = 0;
+    while (ready > 0) {
+        uint8_t dgram[NET_UDP_HEADER + PROTO_HEADER_SIZE + PROTO_MAX_PAYLOAD];
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int n = recvfrom(u->fd, dgram, sizeof(dgram), 0, (struct sockaddr *)&from, &from_len);
+        if (n < 0) {
+            if (!net_would_block(errno)) {
+                NET_LOGW(TAG, "recvfrom failed: errno %d", errno);
+            }
+            break;
+        }
+        u->stats.received++;
+        proto_frame_t f;
+        if (n < NET_UDP_HEADER + PROTO_HEADER_SIZE ||
+            proto_parse(dgram + NET_UDP_HEADER, n - NET_UDP_HEADER, &f) != n - NET_UDP_HEADER) {
+            u->stats.malformed++;
+            continue;
+        }
+        uint32_t session = proto_get_u32(dgram), seq = proto_get_u32(dgram + 4);
+        if (!window_accept(u, session, seq) || !key_accept(u, &f, seq)) {
+            continue;
+        }
+        if (u->learn_peer) {
+            u->peer = from;
+            u->have_peer = true;
+        }
+        u->stats.delivered++;
+        delivered++;
+        handler(&f, arg);
+    }
+    return delivered;
+}
@@ -0,0 +1,82 @@
+/* UDP side channel for the dip-coater socket projects
+
+   Jog setpoints and live telemetry don't need TCP's retransmissions: after a lost Wi-Fi
+   frame TCP holds back everything behind it until the retransmission arrives (hundreds of
+   milliseconds), while only the newest value matters.  This channel sends one
+   tecsci_proto frame per datagram behind an 8 byte header:
+
+       offset 0  u32  session (random per sender start, a new one resets the receiver)
+              4  u32  sequence number, +1 per datagram
+              8  ...  tecsci_proto frame
+
+   The receiver keeps a sliding window of the last NET_UDP_WINDOW sequence numbers and
+   drops duplicates and datagrams older than the window.  Session ids are random, so they
+   don't tell which is newer: the first datagram of an unknown session starts it, and the
+   last NET_UDP_RETIRED sessions it replaced are remembered so that their datagrams, still
+   delayed somewhere in the network, are dropped instead of resetting the receiver back
+   to the old sender.  Commands (setpoint, limits,
+   mode, ...) are latest-value-wins per type and loop: one older than the last applied
+   for its key is dropped even inside the window.  Telemetry is passed on in arrival
+   order.  Everything that must arrive stays on the TCP connection.
+*/
+#ifndef NET_UDP_H
+#define NET_UDP_H
+
+#include "net_port.h"
+#include "tecsci_proto.h"
+
+#define NET_UDP_HEADER  8
+#define NET_UDP_WINDOW  64
+#define NET_UDP_MAX_KEYS 16
+#define NET_UDP_RETIRED 4
+
+typedef struct {
+    uint32_t sent;
+    uint32_t received;
+    uint32_t delivered;
+    uint32_t duplicates;
+    uint32_t too_old;                   /* behind the sliding window */
+    uint32_t superseded;                /* older than the last applied command of its key */
+    uint32_t malformed;
+    uint32_t sessions;                  /* sender restarts seen */
+    uint32_t retired;                   /* from a session that was replaced by a newer one */
+} net_udp_stats_t;
+
+typedef struct {
+    int fd;
+    struct sockaddr_in peer;            /* where net_udp_send() goes */
+    bool have_peer;
+    bool learn_peer;                    /* answer whoever sent the last valid datagram */
+
+    uint32_t tx_session, tx_seq;
+
+    bool rx_started;
+    uint32_t rx_session;
+    uint32_t rx_highest;
+    uint64_t rx_window;                 /* bit i: rx_highest - i was received */
+    uint32_t rx_retired[NET_UDP_RETIRED];   /* sessions replaced, most recent at rx_retired_next - 1 */
+    int rx_nretired, rx_retired_next;
+    struct {
+        uint8_t type, loop;
+        uint32_t seq;
+    } keys[NET_UDP_MAX_KEYS];
+    int nkeys;
+
+    net_udp_stats_t stats;
+} net_udp_t;
+
+/* binds local_port (0 for any) and makes the socket non-blocking; returns 0 or -1 */
+int net_udp_open(net_udp_t *u, uint16_t local_port);
+void net_udp_close(net_udp_t *u);
+
+/* fixes the destination; without it the channel answers the last valid sender */
+void net_udp_set_peer(net_udp_t *u, const char *host, uint16_t port);
+
+/* sends one frame (from a proto_encode_* function); returns 0 or -1 */
+int net_udp_send(net_udp_t *u, const uint8_t *frame, size_t len);
+
+/* waits up to timeout_ms, then hands every datagram that passes the window and the
+   latest-value check to handler; returns the number of frames delivered or -1 */
+int net_udp_poll(net_udp_t *u, int timeout_ms, proto_handler_t handler, void *arg);
+
+#endif
@@ -0,0 +1,583 @@
+/* Bulk log upload (see net_upload.h) */
+#include <stdio.h>
+
+#include "net_upload.h"
+
+#if defined(__linux__) && !defined(ESP_PLATFORM)
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#define HAVE_SENDFILE 1
+#endif
+
+#ifndef ESP_PLATFORM
+#include <sys/stat.h>
+#endif
+
+static const char *TAG = "net_upload";
+
+/* crc32 ------------------------------------------------------------------------------- */
+
+/* slice-by-8 on the host; the target uses one 1 KB table, the link is the limit there */
+#ifdef ESP_PLATFORM
+#define CRC_SLICES 1
+#else
+#define CRC_SLICES 8
+#endif
+
+static uint32_t crc_table[CRC_SLICES][256];
+static bool crc_ready;
+
+static void crc_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c >> 1) ^ (0xEDB88320u & -(c & 1));
+        }
+        crc_table[0][i] = c;
+    }
+    for (int s = 1; s < CRC_SLICES; s++) {
+        for (int i = 0; i < 256; i++) {
+            uint32_t c = crc_table[s - 1][i];
+            crc_table[s][i] = (c >> 8) ^ crc_table[0][c & 0xFF];
+        }
+    }
+    crc_ready = true;
+}
+
+uint32_t net_crc32(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    if (!crc_ready) {
+        crc_init();
+    }
+    crc = ~crc;
+#if CRC_SLICES == 8
+    while (len >= 8) {
+        uint32_t lo = crc ^ (p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24);
+        uint32_t hi = p[4] | p[5] << 8 | p[6] << 16 | (uint32_t)p[7] << 24;
+        crc = crc_table[7][lo & 0xFF] ^ crc_table[6][(lo >> 8) & 0xFF] ^
+              crc_table[5][(lo >> 16) & 0xFF] ^ crc_table[4][lo >> 24] ^
+              crc_table[3][hi & 0xFF] ^ crc_table[2][(hi >> 8) & 0xFF] ^
+              crc_table[1][(hi >> 16) & 0xFF] ^ crc_table[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+#endif
+    while (len--) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xFF];
+    }
+    return ~crc;
+}
+
+/* messages ---------------------------------------------------------------------------- */
+
+static size_t encode_upload(uint8_t *buf, uint8_t type, uint32_t a, uint32_t b, uint64_t c)
+{
+    uint8_t *p = buf + proto_write_header(buf, type, 0, PROTO_UPLOAD_SIZE);
+    proto_put_u32(p, a);
+    proto_put_u32(p + 4, b);
+    proto_put_u64(p + 8, c);
+    return PROTO_HEADER_SIZE + PROTO_UPLOAD_SIZE;
+}
+
+static size_t encode_chunk(uint8_t *buf, uint64_t offset, uint32_t len, uint32_t crc)
+{
+    uint8_t *p = buf + proto_write_header(buf, PROTO_MSG_UPLOAD_CHUNK, 0, PROTO_UPLOAD_SIZE);
+    proto_put_u64(p, offset);
+    proto_put_u32(p + 8, len);
+    proto_put_u32(p + 12, crc);
+    return PROTO_HEADER_SIZE + PROTO_UPLOAD_SIZE;
+}
+
+/* sender ------------------------------------------------------------------------------ */
+
+int net_upload_open(net_upload_t *u, const char *path, uint32_t log_id, bool zero_copy)
+{
+    memset(u, 0, sizeof(*u) - sizeof(u->buf));
+    u->sock = -1;
+    u->file = open(path, O_RDONLY);
+    if (u->file < 0) {
+        NET_LOGE(TAG, "cannot open %s: errno %d", path, errno);
+        return -1;
+    }
+    off_t size = lseek(u->file, 0, SEEK_END);
+    if (size < 0) {
+        close(u->file);
+        u->file = -1;
+        return -1;
+    }
+    u->size = (uint64_t)size;
+    u->log_id = log_id;
+#ifdef HAVE_SENDFILE
+    u->zero_copy = zero_copy;
+#endif
+    return 0;
+}
+
+void net_upload_close(net_upload_t *u)
+{
+    if (u->sock >= 0) {
+        close(u->sock);
+        u->sock = -1;
+    }
+    if (u->file >= 0) {
+        close(u->file);
+        u->file = -1;
+    }
+}
+
+static void drop(net_upload_t *u)
+{
+    close(u->sock);
+    u->sock = -1;
+}
+
+/* blocking read of one frame during the handshake */
+static int read_frame(int fd, uint8_t *buf, size_t cap, proto_frame_t *f, int timeout_ms)
+{
+    size_t len = 0;
+    int64_t end = net_time_us() + (int64_t)timeout_ms * 1000;
+    while (1) {
+        int n = proto_parse(buf, len, f);
+        if (n != 0) {
+            return n;
+        }
+        int64_t left = end - net_time_us();
+        if (left <= 0 || len == cap) {
+            return -1;
+        }
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(fd, &rfds);
+        struct timeval tv = { left / 1000000, left % 1000000 };
+        if (select(fd + 1, &rfds, NULL, NULL, &tv) <= 0) {
+            return -1;
+        }
+        int r = recv(fd, buf + len, cap - len, 0);
+        if (r <= 0 && !(r < 0 && net_would_block(errno))) {
+            return -1;
+        }
+        len += r > 0 ? r : 0;
+    }
+}
+
+int net_upload_connect(net_upload_t *u, const char *host, uint16_t port, int timeout_ms)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = inet_addr(host),
+    };
+    if (u->sock >= 0) {
+        drop(u);
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (fd < 0) {
+        NET_LOGE(TAG, "Unable to create socket: errno %d", errno);
+        return -1;
+    }
+    net_set_nonblocking(fd);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fd_set wfds;
+        FD_ZERO(&wfds);
+        FD_SET(fd, &wfds);
+        struct timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+        int err = 0;
+        socklen_t err_len = sizeof(err);
+        if (!net_would_block(errno) || select(fd + 1, NULL, &wfds, NULL, &tv) != 1 ||
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) != 0 || err != 0) {
+            NET_LOGE(TAG, "Socket unable to connect to %s:%u", host, port);
+            close(fd);
+            return -1;
+        }
+    }
+
+    uint8_t buf[PROTO_HEADER_SIZE + PROTO_UPLOAD_SIZE];
+    size_t len = encode_upload(buf, PROTO_MSG_UPLOAD_BEGIN, u->log_id, 0, u->size);
+    proto_frame_t f;
+    uint8_t rx[sizeof(buf)];
+    if (send(fd, buf, len, 0) != (ssize_t)len ||
+        read_frame(fd, rx, sizeof(rx), &f, timeout_ms) <= 0 ||
+        f.type != PROTO_MSG_UPLOAD_ACK || f.len < PROTO_UPLOAD_SIZE ||
+        f.payload[4] != PROTO_ACK_OK) {
+        NET_LOGE(TAG, "log %u: no resume offset from %s:%u", (unsigned)u->log_id, host, port);
+        close(fd);
+        return -1;
+    }
+    uint64_t committed = proto_get_u64(f.payload + 8);
+
+    u->sock = fd;
+    u->acked = u->next = committed < u->size ? committed : u->size;
+    u->slot[0].full = u->slot[1].full = false;
+    u->cur = 0;
+    u->rewind = false;
+    u->rx_len = 0;
+    NET_LOGI(TAG, "log %u: %llu of %llu bytes already there", (unsigned)u->log_id,
+             (unsigned long long)u->acked, (unsigned long long)u->size);
+    return 0;
+}
+
+/* reads (or maps) the next chunk into slot s; chunks end on NET_UPLOAD_CHUNK boundaries
+   of the file, so after a resume in the middle of one the reads are aligned again */
+static int fill(net_upload_t *u, int s)
+{
+    net_upload_slot_t *sl = &u->slot[s];
+    uint64_t room = NET_UPLOAD_CHUNK - u->next % NET_UPLOAD_CHUNK;
+    uint32_t len = (uint32_t)(u->size - u->next < room ? u->size - u->next : room);
+    uint32_t crc;
+
+#ifdef HAVE_SENDFILE
+    if (u->zero_copy) {
+        uint64_t base = u->next & ~(uint64_t)(sysconf(_SC_PAGESIZE) - 1);
+        size_t map_len = (size_t)(u->next - base) + len;
+        uint8_t *map = mmap(NULL, map_len, PROT_READ, MAP_SHARED, u->file, (off_t)base);
+        if (map == MAP_FAILED) {
+            NET_LOGE(TAG, "mmap failed: errno %d", errno);
+            return -1;
+        }
+        crc = net_crc32(0, map + (u->next - base), len);
+        munmap(map, map_len);
+    } else
+#endif
+    {
+        size_t got = 0;
+        while (got < len) {
+            ssize_t r = pread(u->file, u->buf[s] + got, len - got, (off_t)(u->next + got));
+            if (r <= 0) {
+                NET_LOGE(TAG, "read failed at %llu: errno %d", (unsigned long long)(u->next + got), errno);
+                return -1;
+            }
+            got += r;
+        }
+        crc = net_crc32(0, u->buf[s], len);
+    }
+    u->stats.reads++;
+    encode_chunk(sl->hdr, u->next, len, crc);
+    sl->offset = u->next;
+    sl->len = len;
+    sl->sent = 0;
+    sl->full = true;
+    u->next += len;
+    return 0;
+}
+
+/* writes what the socket takes of the current slot; returns bytes written, -1 on error */
+static ssize_t send_slot(net_upload_t *u)
+{
+    net_upload_slot_t *sl = &u->slot[u->cur];
+    const size_t hdr = sizeof(sl->hdr);
+    ssize_t n;
+
+#ifdef HAVE_SENDFILE
+    if (u->zero_copy) {
+        if (sl->sent < hdr) {
+            n = send(u->sock, sl->hdr + sl->sent, hdr - sl->sent, MSG_NOSIGNAL | MSG_MORE);
+        } else {
+            off_t off = (off_t)(sl->offset + sl->sent - hdr);
+            n = sendfile(u->sock, u->file, &off, sl->len - (sl->sent - hdr));
+        }
+    } else
+#endif
+    {
+        struct iovec iov[2];
+        int cnt = 0;
+        if (sl->sent < hdr) {
+            iov[cnt].iov_base = sl->hdr + sl->sent;
+            iov[cnt++].iov_len = hdr - sl->sent;
+        }
+        size_t body = sl->sent > hdr ? sl->sent - hdr : 0;
+        iov[cnt].iov_base = u->buf[u->cur] + body;
+        iov[cnt++].iov_len = sl->len - body;
+        struct msghdr msg = { .msg_iov = iov, .msg_iovlen = cnt };
+        n = sendmsg(u->sock, &msg, MSG_NOSIGNAL);
+    }
+    if (n < 0) {
+        return net_would_block(errno) ? 0 : -1;
+    }
+    if (sl->sent + n > hdr) {
+        u->stats.bytes += sl->sent >= hdr ? (size_t)n : sl->sent + n - hdr;
+    }
+    sl->sent += n;
+    if (sl->sent == hdr + sl->len) {
+        sl->full = false;
+        u->stats.chunks++;
+        u->cur ^= 1;
+        if (u->rewind) {
+            /* whatever was read ahead is stale, restart after the last good chunk */
+            u->slot[0].full = u->slot[1].full = false;
+            u->next = u->acked;
+            u->rewind = false;
+        }
+    }
+    return n;
+}
+
+static int read_acks(net_upload_t *u)
+{
+    int n = recv(u->sock, u->rx + u->rx_len, sizeof(u->rx) - u->rx_len, 0);
+    if (n == 0 || (n < 0 && !net_would_block(errno))) {
+        return -1;
+    }
+    if (n < 0) {
+        return 0;
+    }
+    u->rx_len += n;
+    size_t used = 0;
+    proto_frame_t f;
+    int r;
+    while ((r = proto_parse(u->rx + used, u->rx_len - used, &f)) > 0) {
+        if (f.type == PROTO_MSG_UPLOAD_ACK && f.len >= PROTO_UPLOAD_SIZE) {
+            uint64_t committed = proto_get_u64(f.payload + 8);
+            if (f.payload[4] == PROTO_ACK_BAD_CRC) {
+                u->stats.rewinds++;
+                u->rewind = true;
+                u->acked = committed;
+                if (!u->slot[u->cur].full || u->slot[u->cur].sent == 0) {
+                    u->slot[0].full = u->slot[1].full = false;
+                    u->next = u->acked;
+                    u->rewind = false;
+                }
+            } else if (committed > u->acked) {
+                u->acked = committed;
+            }
+        }
+        used += r;
+    }
+    if (r < 0) {
+        return -1;
+    }
+    memmove(u->rx, u->rx + used, u->rx_len - used);
+    u->rx_len -= used;
+    return n;
+}
+
+int net_upload_poll(net_upload_t *u, int timeout_ms)
+{
+    if (u->sock < 0) {
+        return -1;
+    }
+    bool progress = false;
+    while (1) {
+        if (read_acks(u) < 0) {
+            NET_LOGW(TAG, "log %u: connection lost at %llu", (unsigned)u->log_id, (unsigned long long)u->acked);
+            drop(u);
+            return -1;
+        }
+        if (u->acked == u->size) {
+            return 1;
+        }
+        /* keep both halves full, within the window */
+        for (int i = 0; i < 2; i++) {
+            int s = u->cur ^ i;
+            if (!u->slot[s].full && u->next < u->size &&
+                u->next - u->acked < (uint64_t)NET_UPLOAD_WINDOW * NET_UPLOAD_CHUNK) {
+                if (fill(u, s) != 0) {
+                    drop(u);
+                    return -1;
+                }
+            }
+        }
+        if (!u->slot[u->cur].full) {
+            break;                      /* window full or all sent, wait for ACKs */
+        }
+        ssize_t n = send_slot(u);
+        if (n < 0) {
+            drop(u);
+            return -1;
+        }
+        if (n == 0) {
+            break;                      /* socket full */
+        }
+        progress = true;
+    }
+    if (progress) {
+        return 0;
+    }
+
+    fd_set rfds, wfds;
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    FD_SET(u->sock, &rfds);
+    if (u->slot[u->cur].full) {
+        FD_SET(u->sock, &wfds);
+    }
+    struct timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+    select(u->sock + 1, &rfds, &wfds, NULL, &tv);
+    return 0;
+}
+
+/* receiver ---------------------------------------------------------------------------- */
+
+#ifndef ESP_PLATFORM
+
+void net_upload_rx_init(net_upload_rx_t *rx, const char *dir)
+{
+    memset(rx, 0, sizeof(*rx));
+    rx->dir = dir;
+    for (int i = 0; i < NET_UPLOAD_MAX_SESSIONS; i++) {
+        rx->sessions[i].file = -1;
+    }
+}
+
+static void send_ack(net_server_t *srv, net_upload_session_t *s, uint8_t status)
+{
+    uint8_t buf[PROTO_HEADER_SIZE + PROTO_UPLOAD_SIZE];
+    encode_upload(buf, PROTO_MSG_UPLOAD_ACK, s->log_id, status, s->committed);
+    net_server_send(srv, s->conn, buf, sizeof(buf));
+}
+
+static net_upload_session_t *begin(net_upload_rx_t *rx, net_conn_t *conn, const proto_frame_t *f)
+{
+    net_upload_session_t *s = NULL;
+    for (int i = 0; i < NET_UPLOAD_MAX_SESSIONS && !s; i++) {
+        if (rx->sessions[i].conn == NULL) {
+            s = &rx->sessions[i];
+        }
+    }
+    if (s == NULL) {
+        NET_LOGW(TAG, "conn %u: no free upload session", (unsigned)conn->id);
+        return NULL;
+    }
+    memset(s, 0, sizeof(*s));
+    s->file = -1;
+    s->log_id = proto_get_u32(f->payload);
+    s->size = proto_get_u64(f->payload + 8);
+    if (rx->dir) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/log_%u.bin", rx->dir, (unsigned)s->log_id);
+        s->file = open(path, O_WRONLY | O_CREAT, 0644);
+        if (s->file < 0) {
+            NET_LOGE(TAG, "cannot open %s: errno %d", path, errno);
+            return NULL;
+        }
+        struct stat st;
+        if (fstat(s->file, &st) != 0) {
+            NET_LOGE(TAG, "cannot stat %s: errno %d", path, errno);
+            close(s->file);
+            s->file = -1;
+            return NULL;
+        }
+        s->committed = (uint64_t)st.st_size;
+        if (s->committed > s->size) {
+            s->committed = 0;           /* a different log under the same id, start over */
+            if (ftruncate(s->file, 0) != 0) {
+                NET_LOGE(TAG, "cannot truncate %s: errno %d", path, errno);
+                close(s->file);
+                s->file = -1;
+                return NULL;
+            }
+        }
+    }
+    s->conn = conn;
+    conn->user = s;
+    return s;
+}
+
+/* returns -1 when the file can no longer be cut back to the committed offset; the caller
+   closes the connection so the upload fails instead of resuming over stray bytes */
+static int end_chunk(net_upload_rx_t *rx, net_server_t *srv, net_upload_session_t *s)
+{
+    s->in_chunk = false;
+    if (s->skip) {
+        rx->stats.skipped++;
+        return 0;
+    }
+    if (s->crc != s->want_crc) {
+        rx->stats.bad_crc++;
+        if (s->file >= 0 && ftruncate(s->file, (off_t)s->committed) != 0) {
+            NET_LOGE(TAG, "log %u: truncate failed: errno %d", (unsigned)s->log_id, errno);
+            return -1;
+        }
+        send_ack(srv, s, PROTO_ACK_BAD_CRC);
+        return 0;
+    }
+    s->committed += s->len;
+    rx->stats.chunks++;
+    send_ack(srv, s, PROTO_ACK_OK);
+    return 0;
+}
+
+size_t net_upload_rx_data(net_upload_rx_t *rx, net_server_t *srv, net_conn_t *conn,
+                          const uint8_t *data, size_t len)
+{
+    net_upload_session_t *s = conn->user;
+    size_t used = 0;
+
+    while (used < len) {
+        if (s && s->in_chunk) {
+            size_t n = len - used < s->len - s->got ? len - used : s->len - s->got;
+            if (!s->skip) {
+                s->crc = net_crc32(s->crc, data + used, n);
+                if (s->file >= 0 && pwrite(s->file, data + used, n, (off_t)(s->offset + s->got)) != (ssize_t)n) {
+                    NET_LOGE(TAG, "log %u: write failed: errno %d", (unsigned)s->log_id, errno);
+                    net_server_close(srv, conn);
+                    return len;
+                }
+                rx->stats.bytes += n;
+            }
+            s->got += n;
+            used += n;
+            if (s->got == s->len && end_chunk(rx, srv, s) != 0) {
+                net_server_close(srv, conn);
+                return len;
+            }
+            continue;
+        }
+
+        proto_frame_t f;
+        int n = proto_parse(data + used, len - used, &f);
+        if (n == 0) {
+            break;
+        }
+        if (n < 0 || f.len < PROTO_UPLOAD_SIZE) {
+            net_server_close(srv, conn);
+            return len;
+        }
+        used += n;
+        if (f.type == PROTO_MSG_UPLOAD_BEGIN && s == NULL) {
+            s = begin(rx, conn, &f);
+            if (s == NULL) {
+                net_server_close(srv, conn);
+                return len;
+            }
+            send_ack(srv, s, PROTO_ACK_OK);
+        } else if (f.type == PROTO_MSG_UPLOAD_CHUNK && s != NULL) {
+            s->offset = proto_get_u64(f.payload);
+            s->len = proto_get_u32(f.payload + 8);
+            s->want_crc = proto_get_u32(f.payload + 12);
+            s->got = 0;
+            s->crc = 0;
+            s->in_chunk = true;
+            /* chunks already in flight behind a rejected one don't line up any more */
+            s->skip = s->offset != s->committed || s->offset + s->len > s->size;
+            if (s->len == 0 && end_chunk(rx, srv, s) != 0) {
+                net_server_close(srv, conn);
+                return len;
+            }
+        } else {
+            net_server_close(srv, conn);
+            return len;
+        }
+    }
+    return used;
+}
+
+void net_upload_rx_close(net_upload_rx_t *rx, net_conn_t *conn)
+{
+    net_upload_session_t *s = conn->user;
+    if (s == NULL) {
+        return;
+    }
+    if (s->file >= 0) {
+        /* drop a partially received chunk so the file ends at the committed offset */
+        if (ftruncate(s->file, (off_t)s->committed) != 0) {
+            NET_LOGE(TAG, "log %u: truncate failed: errno %d", (unsigned)s->log_id, errno);
+        }
+        close(s->file);
+    }
+    s->conn = NULL;
+    conn->user = NULL;
+}
+
+#endif
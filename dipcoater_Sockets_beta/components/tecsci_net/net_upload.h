@@ -0,0 +1,144 @@
+/* Bulk log upload for the dip-coater socket clients
+
+   Streams a log file to the PC in large chunks instead of one send() per record.  Each
+   chunk is a PROTO_MSG_UPLOAD_CHUNK frame followed by the raw file bytes (not counted in
+   the frame length, so chunks can be much larger than a frame):
+
+       UPLOAD_BEGIN  u32 log_id, u32 0, u64 file size
+       UPLOAD_CHUNK  u64 offset, u32 length, u32 crc32 of the bytes that follow
+       UPLOAD_ACK    u32 log_id, u8 status (PROTO_ACK_*), u8[3], u64 committed offset
+
+   The receiver answers BEGIN with the offset it already holds, so a broken upload resumes
+   where it stopped after net_upload_connect() is called again.  Every chunk is checked
+   against its CRC before it counts; a bad one is answered PROTO_ACK_BAD_CRC and the sender
+   rewinds to the committed offset.  At most NET_UPLOAD_WINDOW chunks are sent ahead of the
+   last ACK.
+
+   Sender, from its own low priority task so the control task never waits on it:
+
+       static net_upload_t up;
+       net_upload_open(&up, "/sdcard/run42.log", 42, false);
+       int r = -1;
+       while (r != 1) {
+           if (net_upload_connect(&up, HOST, PORT, 2000) != 0) {
+               net_sleep_ms(1000);
+               continue;
+           }
+           while ((r = net_upload_poll(&up, 100)) == 0) {
+           }                                    // -1: reconnect, the upload resumes
+       }
+       net_upload_close(&up);
+
+   The target reads the file with chunk aligned reads into one half of a double buffer
+   while the other half drains into the socket.  On Linux with zero_copy set the body goes
+   out with sendfile() and the CRC is taken from an mmap() of the chunk, so file data is
+   never copied into user space.
+
+   The receiver (host builds only) is a set of net_server handlers: net_upload_rx_data()
+   from on_data, net_upload_rx_close() from on_close.
+*/
+#ifndef NET_UPLOAD_H
+#define NET_UPLOAD_H
+
+#include "net_server.h"
+#include "tecsci_proto.h"
+
+#ifndef NET_UPLOAD_CHUNK
+#ifdef ESP_PLATFORM
+#define NET_UPLOAD_CHUNK 4096           /* one flash sector per read */
+#else
+#define NET_UPLOAD_CHUNK (256 * 1024)
+#endif
+#endif
+
+#ifndef NET_UPLOAD_WINDOW
+#define NET_UPLOAD_WINDOW 4
+#endif
+
+#ifndef NET_UPLOAD_MAX_SESSIONS
+#define NET_UPLOAD_MAX_SESSIONS 8
+#endif
+
+#define PROTO_UPLOAD_SIZE 16            /* every upload message has a 16 byte payload */
+
+/* crc32 (IEEE 802.3, the zlib one); start with crc = 0 and chain over consecutive pieces */
+uint32_t net_crc32(uint32_t crc, const void *data, size_t len);
+
+/* sender -------------------------------------------------------------------------------- */
+
+typedef struct {
+    bool full;
+    uint64_t offset;
+    uint32_t len;
+    uint8_t hdr[PROTO_HEADER_SIZE + PROTO_UPLOAD_SIZE];
+    size_t sent;                        /* header and body bytes already written */
+} net_upload_slot_t;
+
+typedef struct {
+    uint32_t chunks;
+    uint32_t rewinds;                   /* chunks answered with PROTO_ACK_BAD_CRC */
+    uint32_t reads;                     /* file reads or mappings */
+    uint64_t bytes;                     /* body bytes written to the socket */
+} net_upload_stats_t;
+
+typedef struct {
+    int sock, file;
+    uint32_t log_id;
+    bool zero_copy;                     /* sendfile() + mmap(), Linux only */
+    uint64_t size;
+    uint64_t next;                      /* next file offset to read */
+    uint64_t acked;                     /* committed by the receiver */
+    bool rewind;                        /* BAD_CRC seen, restart at acked after this slot */
+    int cur;                            /* slot being sent */
+    net_upload_slot_t slot[2];
+    uint8_t rx[64];
+    size_t rx_len;
+    net_upload_stats_t stats;
+    uint8_t buf[2][NET_UPLOAD_CHUNK] __attribute__((aligned(64)));   /* double buffer */
+} net_upload_t;
+
+int net_upload_open(net_upload_t *u, const char *path, uint32_t log_id, bool zero_copy);
+void net_upload_close(net_upload_t *u);
+
+/* connects, announces the file and waits for the resume offset; -1 on failure */
+int net_upload_connect(net_upload_t *u, const char *host, uint16_t port, int timeout_ms);
+
+/* moves the upload along, waiting at most timeout_ms for the socket; returns 1 once the
+   receiver committed the whole file, 0 while in progress, -1 when the connection is lost */
+int net_upload_poll(net_upload_t *u, int timeout_ms);
+
+/* receiver ------------------------------------------------------------------------------ */
+
+#ifndef ESP_PLATFORM
+
+typedef struct {
+    net_conn_t *conn;                   /* NULL when the slot is free */
+    int file;
+    uint32_t log_id;
+    uint64_t size, committed;
+    bool in_chunk, skip;                /* receiving a body; skip: not at the committed offset */
+    uint64_t offset;
+    uint32_t len, got, crc, want_crc;
+} net_upload_session_t;
+
+typedef struct {
+    uint32_t chunks;
+    uint32_t bad_crc;
+    uint32_t skipped;                   /* chunks sent ahead of a rejected one */
+    uint64_t bytes;
+} net_upload_rx_stats_t;
+
+typedef struct {
+    const char *dir;                    /* files go to dir/log_<id>.bin; NULL checks and discards */
+    net_upload_rx_stats_t stats;
+    net_upload_session_t sessions[NET_UPLOAD_MAX_SESSIONS];
+} net_upload_rx_t;
+
+void net_upload_rx_init(net_upload_rx_t *rx, const char *dir);
+size_t net_upload_rx_data(net_upload_rx_t *rx, net_server_t *srv, net_conn_t *conn,
+                          const uint8_t *data, size_t len);
+void net_upload_rx_close(net_upload_rx_t *rx, net_conn_t *conn);
+
+#endif
+
+#endif
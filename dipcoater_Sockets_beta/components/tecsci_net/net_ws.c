@@ -0,0 +1,432 @@
+/* WebSocket live plot stream (see net_ws.h) */
+#include <stdio.h>
+#include <strings.h>
+
+#include "net_ws.h"
+
+static const char *TAG = "net_ws";
+
+/* handshake ------------------------------------------------------------------------------ */
+
+static uint32_t rol32(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+static void sha1_block(uint32_t h[5], const uint8_t *p)
+{
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        uint32_t t = rol32(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rol32(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+/* SHA-1 of a short message (the handshake key + GUID is 60 bytes) */
+static void sha1(const uint8_t *msg, size_t len, uint8_t out[20])
+{
+    uint32_t h[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+    uint8_t block[64];
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        sha1_block(h, msg + i);
+    }
+    size_t rest = len - i;
+    memcpy(block, msg + i, rest);
+    block[rest++] = 0x80;
+    if (rest > 56) {
+        memset(block + rest, 0, 64 - rest);
+        sha1_block(h, block);
+        rest = 0;
+    }
+    memset(block + rest, 0, 56 - rest);
+    uint64_t bits = (uint64_t)len * 8;
+    for (int j = 0; j < 8; j++) {
+        block[63 - j] = (uint8_t)(bits >> (8 * j));
+    }
+    sha1_block(h, block);
+    for (int j = 0; j < 20; j++) {
+        out[j] = (uint8_t)(h[j / 4] >> (24 - 8 * (j % 4)));
+    }
+}
+
+void net_ws_accept_key(const char *key, size_t key_len, char out[29])
+{
+    static const char guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    uint8_t msg[64 + sizeof(guid)], digest[20];
+    if (key_len > 64) {
+        key_len = 64;
+    }
+    memcpy(msg, key, key_len);
+    memcpy(msg + key_len, guid, sizeof(guid) - 1);
+    sha1(msg, key_len + sizeof(guid) - 1, digest);
+
+    char *o = out;
+    for (int i = 0; i < 20; i += 3) {
+        uint32_t v = (uint32_t)digest[i] << 16 | (i + 1 < 20 ? (uint32_t)digest[i + 1] << 8 : 0) |
+                     (i + 2 < 20 ? digest[i + 2] : 0);
+        *o++ = b64[(v >> 18) & 63];
+        *o++ = b64[(v >> 12) & 63];
+        *o++ = i + 1 < 20 ? b64[(v >> 6) & 63] : '=';
+        *o++ = i + 2 < 20 ? b64[v & 63] : '=';
+    }
+    *o = 0;
+}
+
+static const uint8_t *end_of_header(const uint8_t *data, size_t len)
+{
+    for (size_t i = 3; i < len; i++) {
+        if (data[i] == '\n' && data[i - 1] == '\r' && data[i - 2] == '\n' && data[i - 3] == '\r') {
+            return data + i + 1;
+        }
+    }
+    return NULL;
+}
+
+/* value of header 'name' (case insensitive) in [data, end), not terminated */
+static const char *find_header(const uint8_t *data, const uint8_t *end, const char *name, size_t *vlen)
+{
+    size_t n = strlen(name);
+    for (const uint8_t *p = data; p + n + 1 < end; p++) {
+        if ((p == data || p[-1] == '\n') && p[n] == ':' && strncasecmp((const char *)p, name, n) == 0) {
+            const uint8_t *v = p + n + 1, *e = v;
+            while (v < end && (*v == ' ' || *v == '\t')) {
+                v++;
+            }
+            for (e = v; e < end && *e != '\r'; e++) {
+            }
+            *vlen = (size_t)(e - v);
+            return (const char *)v;
+        }
+    }
+    return NULL;
+}
+
+bool net_ws_is_upgrade(const uint8_t *data, size_t len)
+{
+    return len >= 8 && memcmp(data, "GET /ws", 7) == 0 && (data[7] == ' ' || data[7] == '?');
+}
+
+void net_ws_init(net_ws_t *ws, net_server_t *srv, uint16_t period_ms)
+{
+    memset(ws, 0, sizeof(*ws));
+    ws->srv = srv;
+    ws->period_ms = period_ms;
+    net_buf_pool_init(&ws->pool);
+}
+
+net_ws_client_t *net_ws_client(net_ws_t *ws, net_conn_t *conn)
+{
+    for (int i = 0; i < ws->nclients; i++) {
+        if (ws->clients[i].conn == conn) {
+            return &ws->clients[i];
+        }
+    }
+    return NULL;
+}
+
+size_t net_ws_accept(net_ws_t *ws, net_conn_t *conn, const uint8_t *data, size_t len)
+{
+    const uint8_t *end = end_of_header(data, len);
+    if (end == NULL) {
+        return 0;
+    }
+    size_t klen, ulen;
+    const char *key = find_header(data, end, "Sec-WebSocket-Key", &klen);
+    const char *upgrade = find_header(data, end, "Upgrade", &ulen);
+    if (key == NULL || upgrade == NULL || ulen != 9 || strncasecmp(upgrade, "websocket", 9) != 0 ||
+        ws->nclients == NET_WS_MAX_CLIENTS) {
+        static const char bad[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        net_server_send(ws->srv, conn, bad, sizeof(bad) - 1);
+        net_server_close(ws->srv, conn);
+        ws->stats.refused++;
+        return len;
+    }
+
+    char accept[29], resp[160];
+    net_ws_accept_key(key, klen, accept);
+    int n = snprintf(resp, sizeof(resp), "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+                     "Connection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n", accept);
+    net_server_send(ws->srv, conn, resp, (size_t)n);
+
+    net_ws_client_t *c = &ws->clients[ws->nclients++];
+    memset(c, 0, sizeof(*c));
+    c->conn = conn;
+    ws->stats.upgrades++;
+    NET_LOGI(TAG, "conn %u: websocket open, %d clients", (unsigned)conn->id, ws->nclients);
+    return (size_t)(end - data);
+}
+
+void net_ws_close(net_ws_t *ws, net_conn_t *conn)
+{
+    net_ws_client_t *c = net_ws_client(ws, conn);
+    if (c) {
+        *c = ws->clients[--ws->nclients];
+    }
+}
+
+/* framing -------------------------------------------------------------------------------- */
+
+size_t net_ws_header(uint8_t *h, uint8_t opcode, uint64_t len)
+{
+    h[0] = 0x80 | opcode;               /* FIN, never fragmented */
+    if (len < 126) {
+        h[1] = (uint8_t)len;
+        return 2;
+    }
+    if (len <= 0xffff) {
+        h[1] = 126;
+        h[2] = (uint8_t)(len >> 8);
+        h[3] = (uint8_t)len;
+        return 4;
+    }
+    h[1] = 127;
+    for (int i = 0; i < 8; i++) {
+        h[2 + i] = (uint8_t)(len >> (56 - 8 * i));
+    }
+    return 10;
+}
+
+typedef uintptr_t word_t;
+
+void net_ws_mask(uint8_t *data, size_t len, const uint8_t key[4])
+{
+    size_t i = 0;
+    /* bytes up to a word boundary, then whole words with the key turned to match; a
+       ping or a short command isn't worth building the word for */
+    if (len < 4 * sizeof(word_t)) {
+        for (; i < len; i++) {
+            data[i] ^= key[i & 3];
+        }
+        return;
+    }
+    for (; i < len && ((uintptr_t)(data + i) & (sizeof(word_t) - 1)); i++) {
+        data[i] ^= key[i & 3];
+    }
+    uint8_t k[sizeof(word_t)];
+    for (size_t j = 0; j < sizeof(word_t); j++) {
+        k[j] = key[(i + j) & 3];
+    }
+    word_t m;
+    memcpy(&m, k, sizeof(m));
+    for (; i + sizeof(word_t) <= len; i += sizeof(word_t)) {
+        word_t w;
+        memcpy(&w, data + i, sizeof(w));
+        w ^= m;
+        memcpy(data + i, &w, sizeof(w));
+    }
+    for (; i < len; i++) {
+        data[i] ^= key[i & 3];
+    }
+}
+
+static void send_control(net_ws_t *ws, net_conn_t *conn, uint8_t opcode, const uint8_t *data, size_t len)
+{
+    uint8_t frame[2 + 125];
+    if (len > 125) {
+        len = 125;
+    }
+    size_t h = net_ws_header(frame, opcode, len);
+    memcpy(frame + h, data, len);
+    net_server_send(ws->srv, conn, frame, h + len);
+}
+
+size_t net_ws_data(net_ws_t *ws, net_conn_t *conn, const uint8_t *data, size_t len)
+{
+    size_t used = 0;
+    while (len - used >= 2) {
+        const uint8_t *f = data + used;
+        uint8_t opcode = f[0] & 0x0f;
+        bool masked = f[1] & 0x80;
+        uint64_t plen = f[1] & 0x7f;
+        size_t h = 2;
+        if (plen == 126) {
+            if (len - used < 4) {
+                break;
+            }
+            plen = (uint64_t)f[2] << 8 | f[3];
+            h = 4;
+        } else if (plen == 127) {
+            if (len - used < 10) {
+                break;
+            }
+            plen = 0;
+            for (int i = 0; i < 8; i++) {
+                plen = plen << 8 | f[2 + i];
+            }
+            h = 10;
+        }
+        if (!masked || plen > NET_BUF_SIZE - 14) {
+            /* clients must mask, and nothing the dashboard sends is near a slab */
+            NET_LOGW(TAG, "conn %u: bad frame, closing", (unsigned)conn->id);
+            net_server_close(ws->srv, conn);
+            return len;
+        }
+        if (len - used < h + 4 + plen) {
+            break;
+        }
+        /* unmasked in place: the bytes are in this connection's rx slab */
+        uint8_t *payload = (uint8_t *)f + h + 4;
+        net_ws_mask(payload, (size_t)plen, f + h);
+        used += h + 4 + (size_t)plen;
+
+        switch (opcode) {
+        case NET_WS_OP_PING:
+            send_control(ws, conn, NET_WS_OP_PONG, payload, (size_t)plen);
+            break;
+        case NET_WS_OP_CLOSE:
+            send_control(ws, conn, NET_WS_OP_CLOSE, payload, plen >= 2 ? 2 : 0);
+            net_server_close(ws->srv, conn);
+            return len;
+        case NET_WS_OP_TEXT:
+        case NET_WS_OP_BINARY:
+            ws->stats.rx_messages++;
+            if (ws->on_message) {
+                ws->on_message(ws, conn, opcode, payload, (size_t)plen);
+            }
+            break;
+        default:
+            break;                      /* pong, continuation */
+        }
+    }
+    return used;
+}
+
+/* stream --------------------------------------------------------------------------------- */
+
+void net_ws_add_sample(net_ws_t *ws, uint8_t loop, const proto_sample_t *sample, uint32_t t_ms)
+{
+    if (loop >= NET_WS_LOOPS) {
+        return;
+    }
+    net_ws_stage_t *st = &ws->stage[loop];
+    if (st->count == NET_WS_SAMPLES) {
+        ws->stats.samples_dropped++;
+        return;
+    }
+    if (st->count == 0) {
+        st->t0_ms = t_ms;
+    }
+    st->s[st->count++] = *sample;
+    ws->stats.samples++;
+}
+
+static void deliver(net_ws_t *ws, net_buf_t *buf)
+{
+    ws->stats.messages++;
+    for (int i = 0; i < ws->nclients; i++) {
+        net_ws_client_t *c = &ws->clients[i];
+        if (NET_CONN_TXQ - net_conn_txq_free(c->conn) >= NET_WS_DEPTH) {
+            if (!net_server_drop_queued(ws->srv, c->conn)) {
+                c->dropped++;
+                ws->stats.drops++;
+                continue;               /* the one queued is half sent, skip this one */
+            }
+            c->dropped++;
+            ws->stats.drops++;
+        }
+        if (net_server_send_buf(ws->srv, c->conn, buf, NET_TX_TELEMETRY) == 0) {
+            c->sent++;
+            ws->stats.deliveries++;
+        }
+    }
+    net_buf_release(buf);
+}
+
+/* puts the header in front of the body that was written at data + 4: a body under 126
+   bytes takes a 2 byte header and moves down */
+static void finish(net_ws_t *ws, net_buf_t *buf, size_t body)
+{
+    uint8_t h[NET_WS_HEADER_MAX];
+    size_t hl = net_ws_header(h, NET_WS_OP_BINARY, body);
+    if (hl < 4) {
+        memmove(buf->data + hl, buf->data + 4, body);
+    }
+    memcpy(buf->data, h, hl);
+    buf->len = hl + body;
+    deliver(ws, buf);
+}
+
+/* one binary message per slab: as many whole loop frames as fit */
+static void flush(net_ws_t *ws)
+{
+    net_buf_t *buf = NULL;
+    size_t body = 0;
+    for (int l = 0; l < NET_WS_LOOPS; l++) {
+        net_ws_stage_t *st = &ws->stage[l];
+        if (st->count == 0) {
+            continue;
+        }
+        size_t need = PROTO_HEADER_SIZE + PROTO_TELEMETRY_HDR + (size_t)st->count * PROTO_SAMPLE_SIZE;
+        if (buf && 4 + body + need > NET_BUF_SIZE) {
+            finish(ws, buf, body);
+            buf = NULL;
+        }
+        if (buf == NULL) {
+            buf = net_buf_get(&ws->pool);
+            body = 0;
+            if (buf == NULL) {
+                ws->stats.no_buffer++;
+                break;
+            }
+        }
+        body += proto_encode_telemetry(buf->data + 4 + body, NET_BUF_SIZE - 4 - body, (uint8_t)l,
+                                       ws->period_ms, st->t0_ms, st->s, st->count);
+    }
+    if (buf) {
+        finish(ws, buf, body);
+    }
+    for (int l = 0; l < NET_WS_LOOPS; l++) {
+        ws->stage[l].count = 0;
+    }
+}
+
+int64_t net_ws_poll(net_ws_t *ws, int64_t now_us)
+{
+    if (now_us < ws->next_flush_us) {
+        return ws->next_flush_us - now_us;
+    }
+    if (ws->nclients > 0) {
+        flush(ws);
+    } else {
+        for (int l = 0; l < NET_WS_LOOPS; l++) {
+            ws->stage[l].count = 0;
+        }
+    }
+    ws->next_flush_us += NET_WS_PERIOD_US;
+    if (ws->next_flush_us <= now_us) {
+        ws->next_flush_us = now_us + NET_WS_PERIOD_US;
+    }
+    return ws->next_flush_us - now_us;
+}
@@ -0,0 +1,134 @@
+/* WebSocket live plot stream for the dip-coater socket servers
+
+   Lets a browser dashboard plot the loops straight from the server, without a gateway
+   in between.  A request for GET /ws with "Upgrade: websocket" on the server port is
+   answered with the RFC 6455 handshake (SHA-1 + base64 of the client key) by
+   net_ws_accept(), and from then on the connection belongs to the hub.
+
+   The application adds samples as the control loop produces them; they are staged per
+   loop and every NET_WS_PERIOD_US (one display refresh, about 30 Hz) the hub serializes
+   them once, as tecsci_proto telemetry frames inside one binary WebSocket message, into
+   a slab from its pool and queues a reference to that slab on every client (like
+   net_pubsub).  A browser that doesn't keep up doesn't grow anything: when its queue
+   already holds NET_WS_DEPTH messages, the oldest one not yet on the wire is dropped,
+   so it always gets the newest data.  Memory per client is the connection's queue of
+   slab references; staging is per hub and fixed.
+
+   Frames from the browser are masked; they are unmasked in place a machine word at a
+   time.  Ping is answered with pong, close with close, and text or binary messages go to
+   on_message (commands from the dashboard, for instance).
+
+       net_ws_init(&ws, &server, LOOP_PERIOD_MS);
+       // on_data
+       if (net_ws_client(&ws, conn)) return net_ws_data(&ws, conn, data, len);
+       if (net_ws_is_upgrade(data, len)) return net_ws_accept(&ws, conn, data, len);
+       // on_close
+       net_ws_close(&ws, conn);
+       // network task loop
+       net_ws_add_sample(&ws, loop, &sample, t_ms);
+       int64_t wait_us = net_ws_poll(&ws, net_time_us());
+*/
+#ifndef NET_WS_H
+#define NET_WS_H
+
+#include "net_server.h"
+#include "tecsci_proto.h"
+
+#ifndef NET_WS_MAX_CLIENTS
+#ifdef ESP_PLATFORM
+#define NET_WS_MAX_CLIENTS 4
+#else
+#define NET_WS_MAX_CLIENTS 256
+#endif
+#endif
+
+#ifndef NET_WS_LOOPS
+#define NET_WS_LOOPS 8
+#endif
+
+/* staged samples per loop and refresh; more are dropped until the next flush */
+#ifndef NET_WS_SAMPLES
+#ifdef ESP_PLATFORM
+#define NET_WS_SAMPLES 16
+#else
+#define NET_WS_SAMPLES 64
+#endif
+#endif
+
+#define NET_WS_PERIOD_US    33333
+#define NET_WS_DEPTH        2           /* messages queued per client before dropping */
+#define NET_WS_HEADER_MAX   10          /* server frames are never masked */
+
+#define NET_WS_OP_TEXT      0x1
+#define NET_WS_OP_BINARY    0x2
+#define NET_WS_OP_CLOSE     0x8
+#define NET_WS_OP_PING      0x9
+#define NET_WS_OP_PONG      0xa
+
+typedef struct net_ws net_ws_t;
+
+typedef void (*net_ws_message_cb_t)(net_ws_t *ws, net_conn_t *conn, uint8_t opcode,
+                                    const uint8_t *data, size_t len);
+
+typedef struct {
+    net_conn_t *conn;                   /* NULL when the slot is free */
+    uint32_t sent;
+    uint32_t dropped;                   /* messages dropped because the client was behind */
+} net_ws_client_t;
+
+typedef struct {
+    uint32_t upgrades;
+    uint32_t refused;                   /* bad handshake or no free client slot */
+    uint32_t messages;                  /* batches serialized */
+    uint32_t deliveries;
+    uint32_t drops;
+    uint32_t samples;
+    uint32_t samples_dropped;           /* staging full */
+    uint32_t no_buffer;
+    uint32_t rx_messages;
+} net_ws_stats_t;
+
+typedef struct {
+    uint32_t t0_ms;
+    int count;
+    proto_sample_t s[NET_WS_SAMPLES];
+} net_ws_stage_t;
+
+struct net_ws {
+    net_server_t *srv;
+    uint16_t period_ms;                 /* of the samples */
+    int64_t next_flush_us;
+    net_ws_message_cb_t on_message;
+    int nclients;
+    net_ws_stats_t stats;
+    net_ws_client_t clients[NET_WS_MAX_CLIENTS];
+    net_ws_stage_t stage[NET_WS_LOOPS];
+    net_buf_pool_t pool;
+};
+
+void net_ws_init(net_ws_t *ws, net_server_t *srv, uint16_t period_ms);
+
+/* the request at data asks for the WebSocket endpoint (it may not be complete yet) */
+bool net_ws_is_upgrade(const uint8_t *data, size_t len);
+
+/* answers the handshake once the request is complete; on_data return value */
+size_t net_ws_accept(net_ws_t *ws, net_conn_t *conn, const uint8_t *data, size_t len);
+
+net_ws_client_t *net_ws_client(net_ws_t *ws, net_conn_t *conn);
+
+/* frames from an upgraded connection; on_data return value */
+size_t net_ws_data(net_ws_t *ws, net_conn_t *conn, const uint8_t *data, size_t len);
+
+void net_ws_close(net_ws_t *ws, net_conn_t *conn);
+
+void net_ws_add_sample(net_ws_t *ws, uint8_t loop, const proto_sample_t *sample, uint32_t t_ms);
+
+/* sends the batch when the refresh is due; returns the microseconds until the next one */
+int64_t net_ws_poll(net_ws_t *ws, int64_t now_us);
+
+/* framing helpers, also used by the host test client */
+size_t net_ws_header(uint8_t *h, uint8_t opcode, uint64_t len);
+void net_ws_mask(uint8_t *data, size_t len, const uint8_t key[4]);
+void net_ws_accept_key(const char *key, size_t key_len, char out[29]);
+
+#endif
@@ -0,0 +1,314 @@
+/* Binary command / telemetry framing (see tecsci_proto.h) */
+#include "tecsci_proto.h"
+
+int proto_parse(const uint8_t *buf, size_t len, proto_frame_t *frame)
+{
+    if (len < PROTO_HEADER_SIZE) {
+        return 0;
+    }
+    uint16_t plen = proto_get_u16(buf);
+    if (plen > PROTO_MAX_PAYLOAD) {
+        return -1;
+    }
+    if (len < (size_t)PROTO_HEADER_SIZE + plen) {
+        return 0;
+    }
+    frame->len = plen;
+    frame->type = buf[2];
+    frame->flags = buf[3];
+    frame->corr = 0;
+    frame->payload = buf + PROTO_HEADER_SIZE;
+    if (frame->flags & PROTO_F_CORR) {
+        if (plen < PROTO_CORR_SIZE) {
+            return -1;
+        }
+        frame->corr = proto_get_u32(frame->payload);
+        frame->payload += PROTO_CORR_SIZE;
+        frame->len -= PROTO_CORR_SIZE;
+    }
+    return PROTO_HEADER_SIZE + plen;
+}
+
+int proto_consume(const uint8_t *data, size_t len, proto_handler_t handler, void *arg)
+{
+    size_t used = 0;
+    while (1) {
+        proto_frame_t frame;
+        int n = proto_parse(data + used, len - used, &frame);
+        if (n < 0) {
+            return -1;
+        }
+        if (n == 0) {
+            return (int)used;
+        }
+        handler(&frame, arg);
+        used += n;
+    }
+}
+
+bool proto_read_setpoint(const proto_frame_t *frame, uint8_t *loop, double *setpoint)
+{
+    if (frame->len < PROTO_SETPOINT_SIZE) {
+        return false;
+    }
+    *loop = frame->payload[0];
+    *setpoint = proto_get_f64(frame->payload + 4);
+    return true;
+}
+
+bool proto_read_gains(const proto_frame_t *frame, proto_gains_t *gains)
+{
+    const uint8_t *p = frame->payload;
+    if (frame->len < PROTO_GAINS_SIZE) {
+        return false;
+    }
+    gains->loop = p[0];
+    gains->p_on = p[1];
+    gains->direction = p[2];
+    gains->kp = proto_get_f32(p + 4);
+    gains->ki = proto_get_f32(p + 8);
+    gains->kd = proto_get_f32(p + 12);
+    gains->sample_ms = proto_get_u32(p + 16);
+    return true;
+}
+
+bool proto_read_limits(const proto_frame_t *frame, uint8_t *loop, float *min, float *max)
+{
+    if (frame->len < PROTO_LIMITS_SIZE) {
+        return false;
+    }
+    *loop = frame->payload[0];
+    *min = proto_get_f32(frame->payload + 4);
+    *max = proto_get_f32(frame->payload + 8);
+    return true;
+}
+
+bool proto_read_mode(const proto_frame_t *frame, uint8_t *loop, uint8_t *mode)
+{
+    if (frame->len < PROTO_MODE_SIZE) {
+        return false;
+    }
+    *loop = frame->payload[0];
+    *mode = frame->payload[1];
+    return true;
+}
+
+bool proto_read_telemetry(const proto_frame_t *frame, uint8_t *loop, uint8_t *count,
+                          uint16_t *period_ms, uint32_t *t0_ms)
+{
+    const uint8_t *p = frame->payload;
+    if (frame->len < PROTO_TELEMETRY_HDR ||
+        frame->len < PROTO_TELEMETRY_HDR + p[1] * PROTO_SAMPLE_SIZE) {
+        return false;
+    }
+    *loop = p[0];
+    *count = p[1];
+    *period_ms = proto_get_u16(p + 2);
+    *t0_ms = proto_get_u32(p + 4);
+    return true;
+}
+
+bool proto_read_ack(const proto_frame_t *frame, uint8_t *type, uint8_t *status)
+{
+    if (frame->len < PROTO_ACK_SIZE) {
+        return false;
+    }
+    *type = frame->payload[0];
+    *status = frame->payload[1];
+    return true;
+}
+
+bool proto_read_subscribe(const proto_frame_t *frame, uint32_t *loops, uint8_t *policy, uint8_t *depth)
+{
+    if (frame->len < PROTO_SUBSCRIBE_SIZE) {
+        return false;
+    }
+    *loops = proto_get_u32(frame->payload);
+    *policy = frame->payload[4];
+    *depth = frame->payload[5];
+    return true;
+}
+
+bool proto_read_time(const proto_frame_t *frame, int64_t *t1, int64_t *t2, int64_t *t3)
+{
+    if (frame->len < PROTO_TIME_SIZE) {
+        return false;
+    }
+    *t1 = (int64_t)proto_get_u64(frame->payload);
+    *t2 = *t3 = 0;
+    if (frame->flags & PROTO_F_RESPONSE) {
+        if (frame->len < PROTO_TIME_REPLY_SIZE) {
+            return false;
+        }
+        *t2 = (int64_t)proto_get_u64(frame->payload + 8);
+        *t3 = (int64_t)proto_get_u64(frame->payload + 16);
+    }
+    return true;
+}
+
+size_t proto_write_header(uint8_t *buf, uint8_t type, uint8_t flags, uint16_t payload_len)
+{
+    proto_put_u16(buf, payload_len);
+    buf[2] = type;
+    buf[3] = flags;
+    return PROTO_HEADER_SIZE;
+}
+
+size_t proto_encode_setpoint(uint8_t *buf, size_t cap, uint8_t loop, double setpoint)
+{
+    if (cap < PROTO_HEADER_SIZE + PROTO_SETPOINT_SIZE) {
+        return 0;
+    }
+    uint8_t *p = buf + proto_write_header(buf, PROTO_MSG_SETPOINT, 0, PROTO_SETPOINT_SIZE);
+    p[0] = loop;
+    p[1] = p[2] = p[3] = 0;
+    proto_put_f64(p + 4, setpoint);
+    return PROTO_HEADER_SIZE + PROTO_SETPOINT_SIZE;
+}
+
+size_t proto_encode_gains(uint8_t *buf, size_t cap, const proto_gains_t *gains)
+{
+    if (cap < PROTO_HEADER_SIZE + PROTO_GAINS_SIZE) {
+        return 0;
+    }
+    uint8_t *p = buf + proto_write_header(buf, PROTO_MSG_GAINS, 0, PROTO_GAINS_SIZE);
+    p[0] = gains->loop;
+    p[1] = gains->p_on;
+    p[2] = gains->direction;
+    p[3] = 0;
+    proto_put_f32(p + 4, gains->kp);
+    proto_put_f32(p + 8, gains->ki);
+    proto_put_f32(p + 12, gains->kd);
+    proto_put_u32(p + 16, gains->sample_ms);
+    return PROTO_HEADER_SIZE + PROTO_GAINS_SIZE;
+}
+
+size_t proto_encode_limits(uint8_t *buf, size_t cap, uint8_t loop, float min, float max)
+{
+    if (cap < PROTO_HEADER_SIZE + PROTO_LIMITS_SIZE) {
+        return 0;
+    }
+    uint8_t *p = buf + proto_write_header(buf, PROTO_MSG_LIMITS, 0, PROTO_LIMITS_SIZE);
+    p[0] = loop;
+    p[1] = p[2] = p[3] = 0;
+    proto_put_f32(p + 4, min);
+    proto_put_f32(p + 8, max);
+    return PROTO_HEADER_SIZE + PROTO_LIMITS_SIZE;
+}
+
+size_t proto_encode_mode(uint8_t *buf, size_t cap, uint8_t loop, uint8_t mode)
+{
+    if (cap < PROTO_HEADER_SIZE + PROTO_MODE_SIZE) {
+        return 0;
+    }
+    uint8_t *p = buf + proto_write_header(buf, PROTO_MSG_MODE, 0, PROTO_MODE_SIZE);
+    p[0] = loop;
+    p[1] = mode;
+    return PROTO_HEADER_SIZE + PROTO_MODE_SIZE;
+}
+
+size_t proto_encode_telemetry(uint8_t *buf, size_t cap, uint8_t loop, uint16_t period_ms,
+                              uint32_t t0_ms, const proto_sample_t *samples, int count)
+{
+    size_t plen = PROTO_TELEMETRY_HDR + (size_t)count * PROTO_SAMPLE_SIZE;
+    if (count < 0 || count > PROTO_MAX_SAMPLES || cap < PROTO_HEADER_SIZE + plen) {
+        return 0;
+    }
+    uint8_t *p = buf + proto_write_header(buf, PROTO_MSG_TELEMETRY, 0, (uint16_t)plen);
+    p[0] = loop;
+    p[1] = (uint8_t)count;
+    proto_put_u16(p + 2, period_ms);
+    proto_put_u32(p + 4, t0_ms);
+    p += PROTO_TELEMETRY_HDR;
+    for (int i = 0; i < count; i++, p += PROTO_SAMPLE_SIZE) {
+        proto_put_f32(p, samples[i].input);
+        proto_put_f32(p + 4, samples[i].output);
+        proto_put_f32(p + 8, samples[i].setpoint);
+    }
+    return PROTO_HEADER_SIZE + plen;
+}
+
+size_t proto_encode_ping(uint8_t *buf, size_t cap)
+{
+    if (cap < PROTO_HEADER_SIZE) {
+        return 0;
+    }
+    return proto_write_header(buf, PROTO_MSG_PING, 0, 0);
+}
+
+size_t proto_encode_commit(uint8_t *buf, size_t cap, bool abort)
+{
+    if (cap < PROTO_HEADER_SIZE) {
+        return 0;
+    }
+    return proto_write_header(buf, abort ? PROTO_MSG_ABORT : PROTO_MSG_COMMIT, 0, 0);
+}
+
+size_t proto_encode_time(uint8_t *buf, size_t cap, int64_t t1)
+{
+    if (cap < PROTO_HEADER_SIZE + PROTO_TIME_SIZE) {
+        return 0;
+    }
+    uint8_t *p = buf + proto_write_header(buf, PROTO_MSG_TIME, 0, PROTO_TIME_SIZE);
+    proto_put_u64(p, (uint64_t)t1);
+    return PROTO_HEADER_SIZE + PROTO_TIME_SIZE;
+}
+
+size_t proto_encode_time_reply(uint8_t *buf, size_t cap, uint32_t corr, int64_t t1, int64_t t2, int64_t t3)
+{
+    const size_t plen = PROTO_CORR_SIZE + PROTO_TIME_REPLY_SIZE;
+    if (cap < PROTO_HEADER_SIZE + plen) {
+        return 0;
+    }
+    uint8_t *p = buf + proto_write_header(buf, PROTO_MSG_TIME, PROTO_F_CORR | PROTO_F_RESPONSE, plen);
+    proto_put_u32(p, corr);
+    p += PROTO_CORR_SIZE;
+    proto_put_u64(p, (uint64_t)t1);
+    proto_put_u64(p + 8, (uint64_t)t2);
+    proto_put_u64(p + 16, (uint64_t)t3);
+    return PROTO_HEADER_SIZE + plen;
+}
+
+size_t proto_encode_subscribe(uint8_t *buf, size_t cap, uint32_t loops, uint8_t policy, uint8_t depth)
+{
+    if (cap < PROTO_HEADER_SIZE + PROTO_SUBSCRIBE_SIZE) {
+        return 0;
+    }
+    uint8_t *p = buf + proto_write_header(buf, PROTO_MSG_SUBSCRIBE, 0, PROTO_SUBSCRIBE_SIZE);
+    proto_put_u32(p, loops);
+    p[4] = policy;
+    p[5] = depth;
+    p[6] = p[7] = 0;
+    return PROTO_HEADER_SIZE + PROTO_SUBSCRIBE_SIZE;
+}
+
+size_t proto_encode_ack(uint8_t *buf, size_t cap, uint32_t corr, uint8_t type, uint8_t status)
+{
+    const size_t plen = PROTO_CORR_SIZE + PROTO_ACK_SIZE;
+    if (cap < PROTO_HEADER_SIZE + plen) {
+        return 0;
+    }
+    uint8_t *p = buf + proto_write_header(buf, PROTO_MSG_ACK, PROTO_F_CORR | PROTO_F_RESPONSE, plen);
+    proto_put_u32(p, corr);
+    p += PROTO_CORR_SIZE;
+    p[0] = type;
+    p[1] = status;
+    p[2] = p[3] = 0;
+    return PROTO_HEADER_SIZE + plen;
+}
+
+size_t proto_set_corr(uint8_t *buf, size_t cap, size_t len, uint32_t corr)
+{
+    if (len < PROTO_HEADER_SIZE || cap < len + PROTO_CORR_SIZE) {
+        return 0;
+    }
+    size_t plen = len - PROTO_HEADER_SIZE + PROTO_CORR_SIZE;
+    if (plen > PROTO_MAX_PAYLOAD || (buf[3] & PROTO_F_CORR)) {
+        return 0;
+    }
+    memmove(buf + PROTO_HEADER_SIZE + PROTO_CORR_SIZE, buf + PROTO_HEADER_SIZE, len - PROTO_HEADER_SIZE);
+    proto_put_u16(buf, (uint16_t)plen);
+    buf[3] |= PROTO_F_CORR;
+    proto_put_u32(buf + PROTO_HEADER_SIZE, corr);
+    return len + PROTO_CORR_SIZE;
+}
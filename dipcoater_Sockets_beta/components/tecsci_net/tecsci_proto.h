@@ -0,0 +1,218 @@
+/* Binary command / telemetry framing used between the tecsci clients and servers
+
+   Every frame is a 4 byte header followed by the payload:
+
+       offset 0  u16  payload length
+              2  u8   message type (PROTO_MSG_*)
+              3  u8   flags
+              4  ...  payload, fixed little-endian layout per type
+
+   Frames are decoded in place: proto_parse() only checks the header and points into the
+   receive buffer, and the proto_get_*() helpers read fields straight from the payload.
+
+   A request that wants an answer carries PROTO_F_CORR and a u32 correlation id right
+   after the header (counted in the payload length).  The answer repeats the id with
+   PROTO_F_CORR | PROTO_F_RESPONSE, so a client can keep many requests in flight on one
+   connection and match the answers in any order.  proto_parse() strips the id into
+   frame->corr, so the typed readers below see the same payload either way.
+
+   GAINS and LIMITS sent with PROTO_F_STAGED don't take effect on their own: they join the
+   sender's open transaction, and PROTO_MSG_COMMIT applies everything staged to all loops at
+   the same control tick (PID_Tuning.h).  PROTO_MSG_ABORT, or closing the connection, drops
+   the transaction.  While one connection has a transaction open, staged requests from the
+   others are answered PROTO_ACK_BUSY.
+*/
+#ifndef TECSCI_PROTO_H
+#define TECSCI_PROTO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define PROTO_HEADER_SIZE   4
+#define PROTO_MAX_PAYLOAD   1460
+
+typedef enum {
+    PROTO_MSG_SETPOINT  = 0x01,     /* u8 loop, u8[3], f64 setpoint */
+    PROTO_MSG_GAINS     = 0x02,     /* u8 loop, u8 p_on, u8 direction, u8, f32 kp, ki, kd, u32 sample_ms */
+    PROTO_MSG_LIMITS    = 0x03,     /* u8 loop, u8[3], f32 min, f32 max */
+    PROTO_MSG_MODE      = 0x04,     /* u8 loop, u8 mode (MANUAL / AUTOMATIC) */
+    PROTO_MSG_COMMIT    = 0x05,     /* empty, applies the staged GAINS / LIMITS together */
+    PROTO_MSG_ABORT     = 0x06,     /* empty, drops them */
+    PROTO_MSG_TELEMETRY = 0x10,     /* u8 loop, u8 count, u16 period_ms, u32 t0_ms, count x sample */
+    PROTO_MSG_TELEMETRY_DZ = 0x11,  /* delta + varint coded samples, see telemetry_codec.h */
+    PROTO_MSG_ACK       = 0x20,     /* u8 request type, u8 status (PROTO_ACK_*), u8[2] */
+    PROTO_MSG_PING      = 0x21,     /* empty, sent with PROTO_F_CORR; answered with an ACK */
+    PROTO_MSG_SUBSCRIBE = 0x22,     /* u32 loop mask (0 = unsubscribe), u8 policy, u8 depth, u8[2] */
+    PROTO_MSG_TIME      = 0x23,     /* clock sync, see net_clock.h: u64 t1; answer u64 t1, t2, t3 */
+    PROTO_MSG_UPLOAD_BEGIN = 0x30,  /* bulk log upload, see net_upload.h */
+    PROTO_MSG_UPLOAD_CHUNK = 0x31,
+    PROTO_MSG_UPLOAD_ACK = 0x32,
+} proto_msg_t;
+
+#define PROTO_F_CORR        0x01    /* a u32 correlation id precedes the payload */
+#define PROTO_F_RESPONSE    0x02    /* answer to the request with the same id */
+#define PROTO_F_STAGED      0x04    /* GAINS / LIMITS: wait for PROTO_MSG_COMMIT */
+#define PROTO_CORR_SIZE     4
+
+typedef enum {
+    PROTO_ACK_OK = 0,
+    PROTO_ACK_BAD_REQUEST,
+    PROTO_ACK_BAD_LOOP,
+    PROTO_ACK_BUSY,
+    PROTO_ACK_BAD_CRC,
+} proto_ack_status_t;
+
+#define PROTO_SETPOINT_SIZE     12
+#define PROTO_GAINS_SIZE        20
+#define PROTO_LIMITS_SIZE       12
+#define PROTO_MODE_SIZE         2
+#define PROTO_ACK_SIZE          4
+#define PROTO_SUBSCRIBE_SIZE    8
+#define PROTO_TIME_SIZE         8
+#define PROTO_TIME_REPLY_SIZE   24
+#define PROTO_TELEMETRY_HDR     8
+#define PROTO_SAMPLE_SIZE       12  /* f32 input, f32 output, f32 setpoint */
+#define PROTO_MAX_SAMPLES       ((PROTO_MAX_PAYLOAD - PROTO_TELEMETRY_HDR) / PROTO_SAMPLE_SIZE)
+
+typedef struct {
+    uint8_t type;
+    uint8_t flags;
+    uint16_t len;                   /* payload length, correlation id excluded */
+    uint32_t corr;                  /* correlation id, 0 without PROTO_F_CORR */
+    const uint8_t *payload;         /* points into the buffer given to proto_parse() */
+} proto_frame_t;
+
+typedef struct {
+    uint8_t loop;
+    uint8_t p_on;
+    uint8_t direction;
+    float kp, ki, kd;
+    uint32_t sample_ms;
+} proto_gains_t;
+
+typedef struct {
+    float input, output, setpoint;
+} proto_sample_t;
+
+/* little-endian field access ----------------------------------------------------------- */
+
+static inline uint16_t proto_get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t proto_get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t proto_get_u64(const uint8_t *p)
+{
+    return (uint64_t)proto_get_u32(p) | ((uint64_t)proto_get_u32(p + 4) << 32);
+}
+
+static inline float proto_get_f32(const uint8_t *p)
+{
+    uint32_t u = proto_get_u32(p);
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static inline double proto_get_f64(const uint8_t *p)
+{
+    uint64_t u = proto_get_u64(p);
+    double d;
+    memcpy(&d, &u, sizeof(d));
+    return d;
+}
+
+static inline void proto_put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void proto_put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline void proto_put_u64(uint8_t *p, uint64_t v)
+{
+    proto_put_u32(p, (uint32_t)v);
+    proto_put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static inline void proto_put_f32(uint8_t *p, float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    proto_put_u32(p, u);
+}
+
+static inline void proto_put_f64(uint8_t *p, double d)
+{
+    uint64_t u;
+    memcpy(&u, &d, sizeof(u));
+    proto_put_u64(p, u);
+}
+
+/* parsing ------------------------------------------------------------------------------ */
+
+/* returns the size of the frame at buf (header included), 0 if it isn't complete yet and
+   -1 if the header is invalid (the connection should be dropped) */
+int proto_parse(const uint8_t *buf, size_t len, proto_frame_t *frame);
+
+typedef void (*proto_handler_t)(const proto_frame_t *frame, void *arg);
+
+/* calls handler for every complete frame in data; returns the bytes consumed, or -1 on a
+   malformed frame.  Meant to be called from net_handlers_t.on_data. */
+int proto_consume(const uint8_t *data, size_t len, proto_handler_t handler, void *arg);
+
+/* typed views of a payload; return false if the payload is too short for the type */
+bool proto_read_setpoint(const proto_frame_t *frame, uint8_t *loop, double *setpoint);
+bool proto_read_gains(const proto_frame_t *frame, proto_gains_t *gains);
+bool proto_read_limits(const proto_frame_t *frame, uint8_t *loop, float *min, float *max);
+bool proto_read_mode(const proto_frame_t *frame, uint8_t *loop, uint8_t *mode);
+bool proto_read_telemetry(const proto_frame_t *frame, uint8_t *loop, uint8_t *count,
+                          uint16_t *period_ms, uint32_t *t0_ms);
+bool proto_read_ack(const proto_frame_t *frame, uint8_t *type, uint8_t *status);
+bool proto_read_subscribe(const proto_frame_t *frame, uint32_t *loops, uint8_t *policy, uint8_t *depth);
+/* t2 and t3 are 0 in a request */
+bool proto_read_time(const proto_frame_t *frame, int64_t *t1, int64_t *t2, int64_t *t3);
+
+static inline void proto_read_sample(const proto_frame_t *frame, int i, proto_sample_t *s)
+{
+    const uint8_t *p = frame->payload + PROTO_TELEMETRY_HDR + i * PROTO_SAMPLE_SIZE;
+    s->input = proto_get_f32(p);
+    s->output = proto_get_f32(p + 4);
+    s->setpoint = proto_get_f32(p + 8);
+}
+
+/* encoding: all return the frame size written to buf, or 0 if cap is too small --------- */
+
+size_t proto_write_header(uint8_t *buf, uint8_t type, uint8_t flags, uint16_t payload_len);
+size_t proto_encode_setpoint(uint8_t *buf, size_t cap, uint8_t loop, double setpoint);
+size_t proto_encode_gains(uint8_t *buf, size_t cap, const proto_gains_t *gains);
+size_t proto_encode_limits(uint8_t *buf, size_t cap, uint8_t loop, float min, float max);
+size_t proto_encode_mode(uint8_t *buf, size_t cap, uint8_t loop, uint8_t mode);
+size_t proto_encode_telemetry(uint8_t *buf, size_t cap, uint8_t loop, uint16_t period_ms,
+                              uint32_t t0_ms, const proto_sample_t *samples, int count);
+size_t proto_encode_ping(uint8_t *buf, size_t cap);
+size_t proto_encode_commit(uint8_t *buf, size_t cap, bool abort);
+size_t proto_encode_subscribe(uint8_t *buf, size_t cap, uint32_t loops, uint8_t policy, uint8_t depth);
+size_t proto_encode_ack(uint8_t *buf, size_t cap, uint32_t corr, uint8_t type, uint8_t status);
+size_t proto_encode_time(uint8_t *buf, size_t cap, int64_t t1);
+size_t proto_encode_time_reply(uint8_t *buf, size_t cap, uint32_t corr, int64_t t1, int64_t t2, int64_t t3);
+
+/* turns the len byte frame at buf, as written by one of the encoders above, into a request
+   carrying correlation id corr (the payload moves up by PROTO_CORR_SIZE) */
+size_t proto_set_corr(uint8_t *buf, size_t cap, size_t len, uint32_t corr);
+
+#endif
@@ -0,0 +1,160 @@
+/* Compact telemetry coding (see telemetry_codec.h) */
+#include <math.h>
+
+#include "telemetry_codec.h"
+
+static inline int32_t quantize(float v, float scale)
+{
+    float q = v * scale;
+    if (q > 2147483520.0f) {
+        return INT32_MAX;
+    }
+    if (q < -2147483520.0f) {
+        return INT32_MIN;
+    }
+    return (int32_t)lrintf(q);
+}
+
+static inline uint8_t *put_varint(uint8_t *p, uint32_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static inline const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint32_t *v)
+{
+    uint32_t r = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        r |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = r;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static inline uint32_t zigzag(int32_t d)
+{
+    return ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t z)
+{
+    return (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+}
+
+void telemetry_enc_init(telemetry_enc_t *enc, float resolution, int keyframe_interval)
+{
+    memset(enc, 0, sizeof(*enc));
+    enc->resolution = resolution;
+    enc->scale = 1.0f / resolution;
+    enc->keyframe_interval = keyframe_interval < 1 ? 1 : keyframe_interval;
+}
+
+size_t telemetry_enc_frame(telemetry_enc_t *enc, uint8_t *buf, size_t cap, uint8_t loop,
+                           uint16_t period_ms, uint32_t t0_ms, const proto_sample_t *samples, int count)
+{
+    size_t worst = TELEMETRY_DZ_HDR + (size_t)count * TELEMETRY_DZ_MAX_SAMPLE;
+    if (count < 0 || count > 255 || worst > PROTO_MAX_PAYLOAD || cap < PROTO_HEADER_SIZE + worst) {
+        return 0;
+    }
+    bool key = enc->since_key == 0;
+    if (++enc->since_key >= enc->keyframe_interval) {
+        enc->since_key = 0;
+    }
+
+    uint8_t *h = buf + PROTO_HEADER_SIZE;
+    h[0] = loop;
+    h[1] = (uint8_t)count;
+    proto_put_u16(h + 2, period_ms);
+    proto_put_u32(h + 4, t0_ms);
+    proto_put_f32(h + 8, enc->resolution);
+    proto_put_u16(h + 12, enc->seq++);
+    h[14] = key ? TELEMETRY_DZ_KEYFRAME : 0;
+    h[15] = 0;
+
+    uint8_t *p = h + TELEMETRY_DZ_HDR;
+    int32_t p0 = key ? 0 : enc->prev[0];
+    int32_t p1 = key ? 0 : enc->prev[1];
+    int32_t p2 = key ? 0 : enc->prev[2];
+    const float scale = enc->scale;
+    for (int i = 0; i < count; i++) {
+        int32_t q0 = quantize(samples[i].input, scale);
+        int32_t q1 = quantize(samples[i].output, scale);
+        int32_t q2 = quantize(samples[i].setpoint, scale);
+        /* differences wrap around like the decoder's sums, so extreme jumps survive too */
+        p = put_varint(p, zigzag((int32_t)((uint32_t)q0 - (uint32_t)p0)));
+        p = put_varint(p, zigzag((int32_t)((uint32_t)q1 - (uint32_t)p1)));
+        p = put_varint(p, zigzag((int32_t)((uint32_t)q2 - (uint32_t)p2)));
+        p0 = q0;
+        p1 = q1;
+        p2 = q2;
+    }
+    enc->prev[0] = p0;
+    enc->prev[1] = p1;
+    enc->prev[2] = p2;
+
+    size_t plen = p - h;
+    proto_write_header(buf, PROTO_MSG_TELEMETRY_DZ, 0, (uint16_t)plen);
+    return PROTO_HEADER_SIZE + plen;
+}
+
+void telemetry_dec_init(telemetry_dec_t *dec)
+{
+    memset(dec, 0, sizeof(*dec));
+}
+
+int telemetry_dec_frame(telemetry_dec_t *dec, const proto_frame_t *frame, uint8_t *loop,
+                        uint16_t *period_ms, uint32_t *t0_ms, proto_sample_t *samples, int max)
+{
+    const uint8_t *h = frame->payload;
+    if (frame->type != PROTO_MSG_TELEMETRY_DZ || frame->len < TELEMETRY_DZ_HDR) {
+        return -1;
+    }
+    int count = h[1];
+    float resolution = proto_get_f32(h + 8);
+    uint16_t seq = proto_get_u16(h + 12);
+    bool key = h[14] & TELEMETRY_DZ_KEYFRAME;
+    if (count > max) {
+        return -1;
+    }
+    if (!key && (!dec->synced || seq != (uint16_t)(dec->seq + 1))) {
+        dec->synced = false;
+        dec->lost++;
+        return -1;
+    }
+
+    const uint8_t *p = h + TELEMETRY_DZ_HDR, *end = h + frame->len;
+    uint32_t q0 = key ? 0 : (uint32_t)dec->prev[0];
+    uint32_t q1 = key ? 0 : (uint32_t)dec->prev[1];
+    uint32_t q2 = key ? 0 : (uint32_t)dec->prev[2];
+    for (int i = 0; i < count; i++) {
+        uint32_t z0, z1, z2;
+        if (!(p = get_varint(p, end, &z0)) || !(p = get_varint(p, end, &z1)) ||
+            !(p = get_varint(p, end, &z2))) {
+            dec->synced = false;
+            return -1;
+        }
+        q0 += (uint32_t)unzigzag(z0);
+        q1 += (uint32_t)unzigzag(z1);
+        q2 += (uint32_t)unzigzag(z2);
+        samples[i].input = (int32_t)q0 * resolution;
+        samples[i].output = (int32_t)q1 * resolution;
+        samples[i].setpoint = (int32_t)q2 * resolution;
+    }
+    dec->prev[0] = (int32_t)q0;
+    dec->prev[1] = (int32_t)q1;
+    dec->prev[2] = (int32_t)q2;
+    dec->seq = seq;
+    dec->synced = true;
+    *loop = h[0];
+    *period_ms = proto_get_u16(h + 2);
+    *t0_ms = proto_get_u32(h + 4);
+    return count;
+}
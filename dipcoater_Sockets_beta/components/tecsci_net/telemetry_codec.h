@@ -0,0 +1,61 @@
+/* Compact telemetry coding for the socket projects
+
+   Consecutive samples of a loop differ by little, so PROTO_MSG_TELEMETRY_DZ frames carry
+   them quantized to a fixed resolution, as the difference to the previous sample, zigzag
+   mapped and packed as varints (7 bits per byte, high bit = more).  A slowly moving
+   temperature at 0.01 resolution takes 1 byte per value instead of 4.
+
+   payload:  u8 loop, u8 count, u16 period_ms, u32 t0_ms, f32 resolution, u16 seq,
+             u8 flags (TELEMETRY_DZ_KEYFRAME), u8, then count x (input, output, setpoint)
+
+   A keyframe codes its first sample as absolute values, so a decoder that joins late or
+   lost a frame (seq jumps) resynchronizes at the next one; the encoder sends one every
+   keyframe_interval frames.  Encoder and decoder keep their state in the structs below
+   and never allocate.
+*/
+#ifndef TELEMETRY_CODEC_H
+#define TELEMETRY_CODEC_H
+
+#include "tecsci_proto.h"
+
+#define TELEMETRY_DZ_HDR        16
+#define TELEMETRY_DZ_KEYFRAME   0x01
+#define TELEMETRY_DZ_MAX_SAMPLE 15      /* 3 values x 5 byte varint */
+
+typedef struct {
+    float resolution;
+    float scale;                        /* 1 / resolution */
+    int keyframe_interval;              /* frames, 1 makes every frame a keyframe */
+    int since_key;
+    uint16_t seq;
+    int32_t prev[3];
+} telemetry_enc_t;
+
+typedef struct {
+    bool synced;
+    uint16_t seq;
+    int32_t prev[3];
+    uint32_t lost;                      /* frames skipped while out of sync */
+} telemetry_dec_t;
+
+void telemetry_enc_init(telemetry_enc_t *enc, float resolution, int keyframe_interval);
+
+/* forces the next frame to be a keyframe, e.g. when a subscriber joins */
+static inline void telemetry_enc_keyframe(telemetry_enc_t *enc)
+{
+    enc->since_key = 0;
+}
+
+/* writes one PROTO_MSG_TELEMETRY_DZ frame; returns its size, or 0 if it could exceed cap
+   or PROTO_MAX_PAYLOAD (count * TELEMETRY_DZ_MAX_SAMPLE bytes are reserved) */
+size_t telemetry_enc_frame(telemetry_enc_t *enc, uint8_t *buf, size_t cap, uint8_t loop,
+                           uint16_t period_ms, uint32_t t0_ms, const proto_sample_t *samples, int count);
+
+void telemetry_dec_init(telemetry_dec_t *dec);
+
+/* decodes up to max samples; returns the sample count, or -1 if the frame is malformed or
+   the decoder is waiting for a keyframe */
+int telemetry_dec_frame(telemetry_dec_t *dec, const proto_frame_t *frame, uint8_t *loop,
+                        uint16_t *period_ms, uint32_t *t0_ms, proto_sample_t *samples, int max);
+
+#endif
@@ -0,0 +1,77 @@
+/* Batched telemetry streaming (see telemetry_stream.h) */
+#include "telemetry_stream.h"
+
+void telemetry_stream_init(telemetry_stream_t *ts, uint8_t loop, uint16_t period_ms,
+                           int64_t deadline_us, size_t mss)
+{
+    memset(ts, 0, sizeof(*ts));
+    ts->loop = loop;
+    ts->period_ms = period_ms;
+    ts->deadline_us = deadline_us;
+
+    int fit = (int)((mss - PROTO_HEADER_SIZE - PROTO_TELEMETRY_HDR) / PROTO_SAMPLE_SIZE);
+    if (mss < PROTO_HEADER_SIZE + PROTO_TELEMETRY_HDR + PROTO_SAMPLE_SIZE) {
+        fit = 1;
+    }
+    ts->max_samples = fit > PROTO_MAX_SAMPLES ? PROTO_MAX_SAMPLES : fit;
+    if (deadline_us <= 0) {
+        ts->max_samples = 1;
+    }
+}
+
+void telemetry_stream_flush(telemetry_stream_t *ts, net_server_t *srv, net_conn_t *conn)
+{
+    if (ts->count == 0) {
+        return;
+    }
+    size_t plen = PROTO_TELEMETRY_HDR + (size_t)ts->count * PROTO_SAMPLE_SIZE;
+    uint8_t *h = ts->header + proto_write_header(ts->header, PROTO_MSG_TELEMETRY, 0, (uint16_t)plen);
+    h[0] = ts->loop;
+    h[1] = (uint8_t)ts->count;
+    proto_put_u16(h + 2, ts->period_ms);
+    proto_put_u32(h + 4, ts->t0_ms);
+
+    struct iovec iov[2] = {
+        { .iov_base = ts->header, .iov_len = sizeof(ts->header) },
+        { .iov_base = ts->payload, .iov_len = (size_t)ts->count * PROTO_SAMPLE_SIZE },
+    };
+    uint32_t before = conn->tx_dropped;
+    if (net_server_sendv(srv, conn, iov, 2, NET_TX_TELEMETRY) == 0) {
+        ts->frames++;
+        ts->samples += ts->count;
+    } else {
+        ts->dropped += ts->count;
+    }
+    ts->frames_dropped += conn->tx_dropped - before;
+    ts->count = 0;
+}
+
+void telemetry_stream_add(telemetry_stream_t *ts, net_server_t *srv, net_conn_t *conn,
+                          const proto_sample_t *sample, uint32_t t_ms, int64_t now_us)
+{
+    if (ts->count == 0) {
+        ts->t0_ms = t_ms;
+        ts->first_us = now_us;
+    }
+    uint8_t *p = ts->payload + ts->count * PROTO_SAMPLE_SIZE;
+    proto_put_f32(p, sample->input);
+    proto_put_f32(p + 4, sample->output);
+    proto_put_f32(p + 8, sample->setpoint);
+    if (++ts->count >= ts->max_samples) {
+        telemetry_stream_flush(ts, srv, conn);
+    }
+}
+
+int64_t telemetry_stream_poll(telemetry_stream_t *ts, net_server_t *srv, net_conn_t *conn,
+                              int64_t now_us)
+{
+    if (ts->count == 0) {
+        return -1;
+    }
+    int64_t left = ts->first_us + ts->deadline_us - now_us;
+    if (left > 0) {
+        return left;
+    }
+    telemetry_stream_flush(ts, srv, conn);
+    return -1;
+}
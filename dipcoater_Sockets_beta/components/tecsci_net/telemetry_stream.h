@@ -0,0 +1,55 @@
+/* Batched telemetry streaming for the socket servers
+
+   Samples of one loop are collected into a PROTO_MSG_TELEMETRY frame sized to fit one TCP
+   segment, and the frame is sent when it is full or when the oldest sample in it has
+   waited 'deadline' microseconds, whichever comes first.  The frame header and the sample
+   payload live in separate buffers and go out with a single sendmsg(), so nothing is
+   copied to glue them together.  net_server already sets TCP_NODELAY on accepted sockets,
+   so Nagle doesn't add its own delay on top of the deadline.  A frame the socket doesn't
+   take goes out as NET_TX_TELEMETRY: a client that stops reading loses the oldest frames
+   to the send budgets, and stays connected.
+*/
+#ifndef TELEMETRY_STREAM_H
+#define TELEMETRY_STREAM_H
+
+#include "net_server.h"
+#include "tecsci_proto.h"
+
+/* TCP payload of one full-size Wi-Fi / Ethernet segment */
+#define TELEMETRY_MSS 1460
+
+typedef struct {
+    uint8_t loop;
+    uint16_t period_ms;
+    int64_t deadline_us;                /* max age of the oldest queued sample */
+    int max_samples;                    /* samples per frame, from the MSS */
+
+    int count;
+    uint32_t t0_ms;
+    int64_t first_us;                   /* when the oldest queued sample was added */
+    uint8_t header[PROTO_HEADER_SIZE + PROTO_TELEMETRY_HDR];
+    uint8_t payload[PROTO_MAX_SAMPLES * PROTO_SAMPLE_SIZE];
+
+    uint32_t frames;
+    uint32_t samples;
+    uint32_t dropped;                   /* samples of frames refused by the connection */
+    uint32_t frames_dropped;            /* frames the connection's budgets dropped, already
+                                           queued ones included */
+} telemetry_stream_t;
+
+/* deadline_us == 0 sends every sample on its own */
+void telemetry_stream_init(telemetry_stream_t *ts, uint8_t loop, uint16_t period_ms,
+                           int64_t deadline_us, size_t mss);
+
+/* queues one sample taken at t_ms; sends the frame if it became full */
+void telemetry_stream_add(telemetry_stream_t *ts, net_server_t *srv, net_conn_t *conn,
+                          const proto_sample_t *sample, uint32_t t_ms, int64_t now_us);
+
+/* sends the pending frame if its deadline passed; returns the microseconds until the next
+   deadline, or -1 if nothing is pending (use it to bound net_server_poll()) */
+int64_t telemetry_stream_poll(telemetry_stream_t *ts, net_server_t *srv, net_conn_t *conn,
+                              int64_t now_us);
+
+void telemetry_stream_flush(telemetry_stream_t *ts, net_server_t *srv, net_conn_t *conn);
+
+#endif
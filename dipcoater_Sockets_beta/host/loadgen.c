@@ -0,0 +1,512 @@
+/* Load generator for the dip-coater socket servers
+
+   Opens N connections to the server and sends requests on all of them, either
+   closed-loop (a fixed number in flight per connection, the next one goes out when an
+   answer arrives) or open-loop at a fixed total arrival rate with exponentially
+   distributed gaps, which is how many independent operator stations behave.  Open-loop
+   latency is measured from the time a request was due, not from when it could be sent,
+   so a server that falls behind shows up in the percentiles instead of slowing the
+   generator down.
+
+   Two protocols:
+   - echo    fixed size messages echoed back (the ESP-IDF tcp_server example)
+   - tecsci  tecsci_proto requests with correlation ids from a configurable message mix,
+             answered with PROTO_MSG_ACK (tcp_server_linux in tecsci mode)
+
+   Latencies go into a log-linear histogram (64 sub-buckets per power of two, about 1.5%
+   resolution, like HdrHistogram) and percentiles come from it.  -o appends one CSV line
+   per run for regression tracking.
+
+   -k n closes a connection after n answers and opens a new one (closed loop only), which
+   measures how fast the server takes connections: with -k 1 every request costs a
+   connect, and req/s are connections/s.
+
+   build: gcc -O2 -I../components/tecsci_net -o loadgen loadgen.c \
+              ../components/tecsci_net/tecsci_proto.c -lm
+   usage: loadgen [-h host] [-p port] [-c connections] [-d seconds] [-P echo|tecsci]
+                  [-s msg_size] [-m setpoint=70,gains=10,limits=5,mode=5,ping=10]
+                  [-r total_req_per_s] [-w in_flight_per_connection] [-k requests_per_connection]
+                  [-o results.csv]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "tecsci_proto.h"
+
+#define MAX_MSG 4096
+#define MAX_PENDING 4096        /* requests in flight per connection */
+
+/* histogram ----------------------------------------------------------------------------- */
+
+#define HIST_SUB_BITS 6
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (HIST_SUB * 34)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+} hist_t;
+
+static int hist_index(uint64_t v)
+{
+    if (v < 2 * HIST_SUB) {
+        return (int)v;
+    }
+    int msb = 63 - __builtin_clzll(v);
+    int shift = msb - HIST_SUB_BITS;
+    int idx = shift * HIST_SUB + (int)(v >> shift);
+    return idx < HIST_BUCKETS ? idx : HIST_BUCKETS - 1;
+}
+
+static uint64_t hist_value(int idx)
+{
+    if (idx < 2 * HIST_SUB) {
+        return idx;
+    }
+    int shift = idx / HIST_SUB - 1;
+    return (uint64_t)(idx - shift * HIST_SUB) << shift;
+}
+
+static void hist_record(hist_t *h, uint64_t v)
+{
+    h->counts[hist_index(v)]++;
+    h->total++;
+    if (v > h->max) {
+        h->max = v;
+    }
+}
+
+static uint64_t hist_percentile(const hist_t *h, double p)
+{
+    uint64_t want = (uint64_t)ceil(h->total * p / 100.0), seen = 0;
+    if (want == 0) {
+        want = 1;
+    }
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= want) {
+            uint64_t v = hist_value(i);
+            return v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+/* message mix --------------------------------------------------------------------------- */
+
+typedef struct {
+    const char *name;
+    int weight;
+} mix_t;
+
+static mix_t mix[] = {
+    { "setpoint", 70 },
+    { "gains", 10 },
+    { "limits", 5 },
+    { "mode", 5 },
+    { "ping", 10 },
+};
+#define MIX_N (int)(sizeof(mix) / sizeof(mix[0]))
+
+static int parse_mix(char *spec)
+{
+    for (int i = 0; i < MIX_N; i++) {
+        mix[i].weight = 0;
+    }
+    for (char *tok = strtok(spec, ","); tok; tok = strtok(NULL, ",")) {
+        char *eq = strchr(tok, '=');
+        if (!eq) {
+            return -1;
+        }
+        *eq = 0;
+        int i = 0;
+        while (i < MIX_N && strcmp(mix[i].name, tok)) {
+            i++;
+        }
+        if (i == MIX_N) {
+            return -1;
+        }
+        mix[i].weight = atoi(eq + 1);
+    }
+    return 0;
+}
+
+static uint32_t rng_state = 2463534242u;
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static size_t encode_mixed(uint8_t *buf, uint32_t corr)
+{
+    int total = 0;
+    for (int i = 0; i < MIX_N; i++) {
+        total += mix[i].weight;
+    }
+    int pick = (int)(rng() % (uint32_t)total), k = 0;
+    while (pick >= mix[k].weight) {
+        pick -= mix[k++].weight;
+    }
+    uint8_t loop = (uint8_t)(rng() & 3);
+    size_t len;
+    switch (k) {
+    case 0:
+        len = proto_encode_setpoint(buf, MAX_MSG, loop, 80.0 + (rng() % 400) * 0.1);
+        break;
+    case 1: {
+        proto_gains_t g = { loop, 1, 0, 2.0f, 0.5f, 0.1f, 100 };
+        len = proto_encode_gains(buf, MAX_MSG, &g);
+        break;
+    }
+    case 2:
+        len = proto_encode_limits(buf, MAX_MSG, loop, 0.0f, 255.0f);
+        break;
+    case 3:
+        len = proto_encode_mode(buf, MAX_MSG, loop, 1);
+        break;
+    default:
+        len = proto_encode_ping(buf, MAX_MSG);
+        break;
+    }
+    return proto_set_corr(buf, MAX_MSG, len, corr);
+}
+
+/* connections --------------------------------------------------------------------------- */
+
+typedef struct {
+    int fd;
+    bool dead;
+    uint32_t answered;                  /* on this connection, for -k */
+    int64_t next_due;                   /* open-loop: when the next request is due */
+    uint32_t next_corr;
+    /* requests in flight, answered in order */
+    int64_t due[MAX_PENDING];
+    uint32_t corr[MAX_PENDING];
+    int head, count;
+    uint8_t rx[MAX_MSG * 2];
+    size_t rx_len;
+} client_t;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static bool tecsci;
+static size_t size = 64;
+static uint64_t sent, completed, errors, skipped, lost, connects;
+static int window = 1, per_conn;       /* -w, -k */
+static hist_t hist;
+
+static int send_request(client_t *c, int64_t due)
+{
+    if (c->count == MAX_PENDING) {
+        skipped++;
+        return 0;
+    }
+    uint8_t buf[MAX_MSG];
+    size_t len;
+    uint32_t corr = c->next_corr++;
+    if (tecsci) {
+        len = encode_mixed(buf, corr);
+    } else {
+        len = size;
+        memset(buf, 'x', size);
+    }
+    if (send(c->fd, buf, len, 0) != (ssize_t)len) {
+        errors++;
+        return -1;
+    }
+    int slot = (c->head + c->count) % MAX_PENDING;
+    c->due[slot] = due;
+    c->corr[slot] = corr;
+    c->count++;
+    sent++;
+    return 0;
+}
+
+static void complete(client_t *c, uint32_t corr, bool ok)
+{
+    if (c->count == 0) {
+        errors++;
+        return;
+    }
+    if (tecsci) {
+        /* answers come in order, so anything older than this one was dropped by the server */
+        int k = 0;
+        while (k < c->count && c->corr[(c->head + k) % MAX_PENDING] != corr) {
+            k++;
+        }
+        if (k == c->count) {
+            errors++;
+            return;
+        }
+        c->head = (c->head + k) % MAX_PENDING;
+        c->count -= k;
+        lost += k;
+        if (!ok) {
+            errors++;
+        }
+    }
+    hist_record(&hist, (uint64_t)(now_us() - c->due[c->head]));
+    c->head = (c->head + 1) % MAX_PENDING;
+    c->count--;
+    completed++;
+}
+
+/* returns the number of answers taken from the receive buffer */
+static int consume(client_t *c)
+{
+    size_t used = 0;
+    int answers = 0;
+    while (1) {
+        if (tecsci) {
+            proto_frame_t f;
+            int n = proto_parse(c->rx + used, c->rx_len - used, &f);
+            if (n < 0) {
+                c->dead = true;
+                errors++;
+                break;
+            }
+            if (n == 0) {
+                break;
+            }
+            uint8_t type, status;
+            bool ok = f.type == PROTO_MSG_ACK && proto_read_ack(&f, &type, &status) && status == PROTO_ACK_OK;
+            complete(c, f.corr, ok);
+            used += n;
+        } else {
+            if (c->rx_len - used < size) {
+                break;
+            }
+            complete(c, 0, true);
+            used += size;
+        }
+        answers++;
+    }
+    memmove(c->rx, c->rx + used, c->rx_len - used);
+    c->rx_len -= used;
+    return answers;
+}
+
+static int open_conn(client_t *c, const struct sockaddr_in *addr, int ep, int i)
+{
+    c->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(c->fd, (const struct sockaddr *)addr, sizeof(*addr)) != 0) {
+        fprintf(stderr, "connect %d failed: %s\n", i, strerror(errno));
+        close(c->fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    c->answered = 0;
+    c->rx_len = 0;
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)i };
+    epoll_ctl(ep, EPOLL_CTL_ADD, c->fd, &ev);
+    connects++;
+    return 0;
+}
+
+/* closed loop: keeps 'window' requests in flight, no more than -k allows */
+static void refill(client_t *c)
+{
+    while (!c->dead && c->count < window && (per_conn == 0 || c->answered + c->count < (uint32_t)per_conn)) {
+        if (send_request(c, now_us()) != 0) {
+            break;
+        }
+    }
+}
+
+static double exp_gap(double mean_us)
+{
+    double u = (rng() + 1.0) / 4294967297.0;
+    return -log(u) * mean_us;
+}
+
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1", *csv = NULL;
+    int port = 3333, conns = 200, duration = 10;
+    double rate = 0;
+    char mix_spec[256] = "default";
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-h")) host = argv[i + 1];
+        else if (!strcmp(argv[i], "-p")) port = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-c")) conns = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-s")) size = (size_t)atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-d")) duration = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-P")) tecsci = !strcmp(argv[i + 1], "tecsci");
+        else if (!strcmp(argv[i], "-r")) rate = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "-w")) window = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-k")) per_conn = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-o")) csv = argv[i + 1];
+        else if (!strcmp(argv[i], "-m")) {
+            snprintf(mix_spec, sizeof(mix_spec), "%s", argv[i + 1]);
+            char tmp[256];
+            snprintf(tmp, sizeof(tmp), "%s", argv[i + 1]);
+            if (parse_mix(tmp) != 0) {
+                fprintf(stderr, "bad message mix '%s'\n", argv[i + 1]);
+                return 2;
+            }
+        }
+    }
+    int mix_total = 0;
+    for (int i = 0; i < MIX_N; i++) {
+        mix_total += mix[i].weight;
+    }
+    if (conns < 1 || size < 1 || size > MAX_MSG || window < 1 || window > MAX_PENDING ||
+        rate < 0 || mix_total <= 0 || per_conn < 0 || (per_conn > 0 && rate > 0)) {
+        fprintf(stderr, "usage: %s [-h host] [-p port] [-c connections] [-d seconds] [-P echo|tecsci]\n"
+                "       [-s msg_size] [-m setpoint=70,gains=10,limits=5,mode=5,ping=10]\n"
+                "       [-r total_req_per_s] [-w in_flight_per_connection] [-k requests_per_connection]\n"
+                "       [-o results.csv]\n", argv[0]);
+        return 2;
+    }
+
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+    inet_pton(AF_INET, host, &addr.sin_addr);
+    client_t *cl = calloc(conns, sizeof(client_t));
+    int ep = epoll_create1(0);
+
+    for (int i = 0; i < conns; i++) {
+        if (open_conn(&cl[i], &addr, ep, i) != 0) {
+            return 1;
+        }
+        cl[i].next_corr = 1;
+    }
+    connects = 0;
+
+    const double mean_gap = rate > 0 ? 1e6 * conns / rate : 0;   /* per connection */
+    int64_t start = now_us(), end = start + (int64_t)duration * 1000000;
+    for (int i = 0; i < conns; i++) {
+        if (rate > 0) {
+            cl[i].next_due = start + (int64_t)exp_gap(mean_gap);
+        } else {
+            refill(&cl[i]);
+        }
+    }
+
+    int64_t now = start;
+    while (now < end) {
+        int timeout = 100;
+        if (rate > 0) {
+            /* send everything that is due; the next due time bounds the wait */
+            int64_t next = end;
+            for (int i = 0; i < conns; i++) {
+                client_t *c = &cl[i];
+                while (!c->dead && c->next_due <= now) {
+                    send_request(c, c->next_due);
+                    c->next_due += (int64_t)exp_gap(mean_gap);
+                }
+                if (c->next_due < next) {
+                    next = c->next_due;
+                }
+            }
+            timeout = next > now ? (int)((next - now) / 1000) : 0;
+        }
+        struct epoll_event evs[256];
+        int n = epoll_wait(ep, evs, 256, timeout);
+        for (int k = 0; k < n; k++) {
+            client_t *c = &cl[evs[k].data.u32];
+            ssize_t r = recv(c->fd, c->rx + c->rx_len, sizeof(c->rx) - c->rx_len, 0);
+            if (r <= 0) {
+                if (r == 0 || errno != EAGAIN) {
+                    errors++;
+                    c->dead = true;
+                    epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+                }
+                continue;
+            }
+            c->rx_len += r;
+            c->answered += consume(c);
+            if (rate == 0) {
+                if (per_conn > 0 && c->answered >= (uint32_t)per_conn && c->count == 0) {
+                    epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+                    close(c->fd);
+                    if (open_conn(c, &addr, ep, evs[k].data.u32) != 0) {
+                        errors++;
+                        c->dead = true;
+                        continue;
+                    }
+                }
+                refill(c);
+            }
+        }
+        now = now_us();
+    }
+    double secs = (now_us() - start) / 1e6;
+    uint64_t outstanding = 0;
+    for (int i = 0; i < conns; i++) {
+        outstanding += cl[i].count;
+    }
+
+    const double pct[] = { 50, 90, 99, 99.9, 99.99 };
+    uint64_t pv[5];
+    for (int i = 0; i < 5; i++) {
+        pv[i] = hist_percentile(&hist, pct[i]);
+    }
+    printf("%s, connections %d, %s, %.1f s\n", tecsci ? "tecsci" : "echo", conns,
+           rate > 0 ? "open loop" : "closed loop", secs);
+    if (rate > 0) {
+        printf("offered %.0f req/s, ", rate);
+    } else {
+        printf("%d in flight per connection, ", window);
+    }
+    printf("throughput %.0f req/s, sent %llu, answered %llu, outstanding %llu, lost %llu, errors %llu, skipped %llu\n",
+           completed / secs, (unsigned long long)sent, (unsigned long long)completed,
+           (unsigned long long)outstanding, (unsigned long long)lost, (unsigned long long)errors,
+           (unsigned long long)skipped);
+    if (per_conn > 0) {
+        printf("%d requests per connection: %.0f connections/s\n", per_conn, connects / secs);
+    }
+    if (hist.total > 0) {
+        printf("latency us: p50 %llu  p90 %llu  p99 %llu  p99.9 %llu  p99.99 %llu  max %llu\n",
+               (unsigned long long)pv[0], (unsigned long long)pv[1], (unsigned long long)pv[2],
+               (unsigned long long)pv[3], (unsigned long long)pv[4], (unsigned long long)hist.max);
+    }
+
+    if (csv) {
+        struct stat st;
+        bool fresh = stat(csv, &st) != 0 || st.st_size == 0;
+        FILE *f = fopen(csv, "a");
+        if (!f) {
+            fprintf(stderr, "cannot open %s: %s\n", csv, strerror(errno));
+            return 1;
+        }
+        if (fresh) {
+            fprintf(f, "time,protocol,connections,rate,window,size,mix,seconds,sent,answered,"
+                       "lost,errors,skipped,req_per_s,p50_us,p90_us,p99_us,p999_us,p9999_us,max_us\n");
+        }
+        fprintf(f, "%ld,%s,%d,%.0f,%d,%zu,\"%s\",%.2f,%llu,%llu,%llu,%llu,%llu,%.0f,%llu,%llu,%llu,%llu,%llu,%llu\n",
+                (long)time(NULL), tecsci ? "tecsci" : "echo", conns, rate, rate > 0 ? 0 : window,
+                tecsci ? 0 : size, tecsci ? mix_spec : "", secs, (unsigned long long)sent,
+                (unsigned long long)completed, (unsigned long long)lost, (unsigned long long)errors,
+                (unsigned long long)skipped,
+                completed / secs, (unsigned long long)pv[0], (unsigned long long)pv[1],
+                (unsigned long long)pv[2], (unsigned long long)pv[3], (unsigned long long)pv[4],
+                (unsigned long long)hist.max);
+        fclose(f);
+    }
+    return errors || lost ? 1 : 0;
+}
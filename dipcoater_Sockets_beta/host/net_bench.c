@@ -0,0 +1,2959 @@
+/* Host benchmarks for the tecsci_net component
+
+   Each subcommand exercises one part of the component in-process (no sockets unless the
+   subcommand says so) and prints throughput on the host.
+
+   build: gcc -O2 -I../components/tecsci_net -o net_bench net_bench.c \
+              ../components/tecsci_net/tecsci_proto.c ../components/tecsci_net/net_server.c \
+              ../components/tecsci_net/telemetry_stream.c ../components/tecsci_net/net_client.c \
+              ../components/tecsci_net/net_link.c ../components/tecsci_net/net_buf.c \
+              ../components/tecsci_net/net_pubsub.c ../components/tecsci_net/telemetry_codec.c \
+              ../components/tecsci_net/net_udp.c ../components/tecsci_net/net_upload.c \
+              ../components/tecsci_net/net_clock.c ../components/tecsci_net/net_cmd.c \
+              ../components/tecsci_net/net_ws.c ../components/tecsci_net/net_async.c -lm -lpthread
+   usage: net_bench framing [messages]
+          net_bench stream [samples_per_s] [seconds] [port]     (loopback sockets)
+          net_bench pipeline [seconds] [port]                   (loopback sockets)
+          net_bench reconnect [cycles] [heartbeat_ms] [port]    (forks loopback servers)
+          net_bench rxpool [messages] [port]                    (loopback sockets)
+          net_bench fanout [batches_per_s] [seconds] [port]     (loopback sockets)
+          net_bench codec [samples] [samples_per_frame] [keyframe_interval]
+          net_bench udp [seconds] [delay_ms] [rto_ms] [port]    (loopback sockets)
+          net_bench upload [max_mb] [dir] [port]                (loopback, files in dir)
+          net_bench clock [hours] [poll_s] [drift_ppm] [asym_us]  (simulated clocks)
+          net_bench cmd [mb] [segment]
+          net_bench ws [mb]
+          net_bench backpressure [seconds] [healthy] [stalled] [port]  (loopback sockets)
+          net_bench async [sessions] [seconds] [port]           (forks, loopback sockets)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <sys/wait.h>
+
+#include "tecsci_proto.h"
+#include "net_server.h"
+#include "telemetry_stream.h"
+#include "net_client.h"
+#include "net_link.h"
+#include "net_pubsub.h"
+#include "telemetry_codec.h"
+#include "net_udp.h"
+#include "net_upload.h"
+#include "net_clock.h"
+#include "net_cmd.h"
+#include "net_ws.h"
+#include "net_async.h"
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+#include <sys/resource.h>
+#include <limits.h>
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t rng_state = 12345;
+static uint32_t rng_u32(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/* framing ------------------------------------------------------------------------------
+   telemetry samples and setpoint commands encoded and decoded as the line based text the
+   tecsci projects exchange today and as tecsci_proto frames */
+
+typedef struct {
+    double sum;
+    long frames;
+} sink_t;
+
+static void sink_frame(const proto_frame_t *f, void *arg)
+{
+    sink_t *s = arg;
+    uint8_t loop, count;
+    uint16_t period;
+    uint32_t t0;
+    double sp;
+
+    s->frames++;
+    if (f->type == PROTO_MSG_TELEMETRY && proto_read_telemetry(f, &loop, &count, &period, &t0)) {
+        for (int i = 0; i < count; i++) {
+            proto_sample_t smp;
+            proto_read_sample(f, i, &smp);
+            s->sum += smp.input + smp.output + smp.setpoint;
+        }
+    } else if (f->type == PROTO_MSG_SETPOINT && proto_read_setpoint(f, &loop, &sp)) {
+        s->sum += sp;
+    }
+}
+
+static int bench_framing(int argc, char **argv)
+{
+    long n = argc > 0 ? atol(argv[0]) : 1000000;
+    const int batch = 32;
+    size_t cap = (size_t)n * 64 + 4096;
+    char *text = malloc(cap);
+    uint8_t *bin = malloc(cap);
+    proto_sample_t *smp = malloc(sizeof(proto_sample_t) * n);
+
+    for (long i = 0; i < n; i++) {
+        smp[i].setpoint = 85.0f;
+        smp[i].input = 85.0f + 0.5f * sinf(i * 0.01f);
+        smp[i].output = 120.0f + 30.0f * cosf(i * 0.01f);
+    }
+
+    /* text: one line per sample, as printed by the current projects */
+    double t0 = now_sec();
+    size_t tlen = 0;
+    for (long i = 0; i < n; i++) {
+        tlen += sprintf(text + tlen, "T %d %lu %.3f %.3f %.3f\n", 0, (unsigned long)(i * 10),
+                        smp[i].input, smp[i].output, smp[i].setpoint);
+    }
+    double t_tenc = now_sec() - t0;
+
+    t0 = now_sec();
+    double tsum = 0;
+    long tlines = 0;
+    char *p = text, *end = text + tlen;
+    while (p < end) {
+        char *nl = memchr(p, '\n', end - p);
+        if (!nl) {
+            break;
+        }
+        *nl = 0;
+        int loop;
+        unsigned long t;
+        float in, out, sp;
+        if (sscanf(p, "T %d %lu %f %f %f", &loop, &t, &in, &out, &sp) == 5) {
+            tsum += in + out + sp;
+        }
+        tlines++;
+        p = nl + 1;
+    }
+    double t_tdec = now_sec() - t0;
+
+    /* binary: telemetry frames of 'batch' samples */
+    t0 = now_sec();
+    size_t blen = 0;
+    for (long i = 0; i < n; i += batch) {
+        int c = (int)(n - i < batch ? n - i : batch);
+        blen += proto_encode_telemetry(bin + blen, cap - blen, 0, 10, (uint32_t)(i * 10), smp + i, c);
+    }
+    double t_benc = now_sec() - t0;
+
+    t0 = now_sec();
+    sink_t s = {0, 0};
+    proto_consume(bin, blen, sink_frame, &s);
+    double t_bdec = now_sec() - t0;
+
+    /* setpoint commands, one message each */
+    long ncmd = n;
+    t0 = now_sec();
+    size_t clen = 0;
+    for (long i = 0; i < ncmd; i++) {
+        clen += sprintf(text + clen, "SP %d %.3f\n", (int)(i & 3), 80.0 + (i % 100) * 0.01);
+    }
+    double t_cenc_t = now_sec() - t0;
+    t0 = now_sec();
+    p = text;
+    end = text + clen;
+    double csum = 0;
+    while (p < end) {
+        char *nl = memchr(p, '\n', end - p);
+        *nl = 0;
+        int loop;
+        double sp;
+        if (sscanf(p, "SP %d %lf", &loop, &sp) == 2) {
+            csum += sp;
+        }
+        p = nl + 1;
+    }
+    double t_cdec_t = now_sec() - t0;
+
+    t0 = now_sec();
+    size_t cblen = 0;
+    for (long i = 0; i < ncmd; i++) {
+        cblen += proto_encode_setpoint(bin + cblen, cap - cblen, (uint8_t)(i & 3), 80.0 + (i % 100) * 0.01);
+    }
+    double t_cenc_b = now_sec() - t0;
+    t0 = now_sec();
+    sink_t cs = {0, 0};
+    proto_consume(bin, cblen, sink_frame, &cs);
+    double t_cdec_b = now_sec() - t0;
+
+    printf("framing: %ld telemetry samples, %ld setpoint commands\n", n, ncmd);
+    printf("%-22s %12s %14s %14s\n", "", "bytes/msg", "encode Mmsg/s", "decode Mmsg/s");
+    printf("%-22s %12.2f %14.2f %14.2f\n", "telemetry text", (double)tlen / n,
+           n / t_tenc / 1e6, tlines / t_tdec / 1e6);
+    printf("%-22s %12.2f %14.2f %14.2f   (%d samples/frame)\n", "telemetry binary", (double)blen / n,
+           n / t_benc / 1e6, n / t_bdec / 1e6, batch);
+    printf("%-22s %12.2f %14.2f %14.2f\n", "setpoint text", (double)clen / ncmd,
+           ncmd / t_cenc_t / 1e6, ncmd / t_cdec_t / 1e6);
+    printf("%-22s %12.2f %14.2f %14.2f\n", "setpoint binary", (double)cblen / ncmd,
+           ncmd / t_cenc_b / 1e6, cs.frames / t_cdec_b / 1e6);
+    if (fabs(tsum - s.sum) > 1e-3 * fabs(tsum) + 1) {
+        printf("warning: text and binary telemetry decoded to different values\n");
+    }
+    (void)csum;
+
+    free(text);
+    free(bin);
+    free(smp);
+    return 0;
+}
+
+/* stream --------------------------------------------------------------------------------
+   a telemetry producer behind net_server sends samples at a fixed rate to a loopback client
+   through telemetry_stream, once per sample and with growing flush deadlines.  Each sample
+   carries its creation time (low 24 bits of the microsecond clock, exact in a float) so the
+   client measures how long it sat in the batch and the socket. */
+
+#define STREAM_STAMP_MASK 0xffffff
+
+typedef struct {
+    uint16_t port;
+    int64_t *lat;
+    long cap, n;
+    long frames, recv_calls;
+    uint64_t bytes;
+} stream_client_t;
+
+static void stream_frame(const proto_frame_t *f, void *arg)
+{
+    stream_client_t *c = arg;
+    uint8_t loop, count;
+    uint16_t period;
+    uint32_t t0;
+    if (!proto_read_telemetry(f, &loop, &count, &period, &t0)) {
+        return;
+    }
+    uint32_t now = (uint32_t)net_time_us() & STREAM_STAMP_MASK;
+    c->frames++;
+    for (int i = 0; i < count; i++) {
+        proto_sample_t smp;
+        proto_read_sample(f, i, &smp);
+        if (c->n < c->cap) {
+            c->lat[c->n++] = (now - (uint32_t)smp.input) & STREAM_STAMP_MASK;
+        }
+    }
+}
+
+static void *stream_client(void *arg)
+{
+    stream_client_t *c = arg;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(c->port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        close(fd);
+        return NULL;
+    }
+    static uint8_t buf[65536];
+    size_t have = 0;
+    while (1) {
+        int n = recv(fd, buf + have, sizeof(buf) - have, 0);
+        if (n <= 0) {
+            break;
+        }
+        c->recv_calls++;
+        c->bytes += n;
+        have += n;
+        int used = proto_consume(buf, have, stream_frame, c);
+        if (used < 0) {
+            break;
+        }
+        memmove(buf, buf + used, have - used);
+        have -= used;
+    }
+    close(fd);
+    return NULL;
+}
+
+static net_conn_t *stream_conn;
+
+static void stream_open(net_server_t *srv, net_conn_t *conn)
+{
+    stream_conn = conn;
+}
+
+static void stream_close(net_server_t *srv, net_conn_t *conn)
+{
+    stream_conn = NULL;
+}
+
+static size_t stream_data(net_server_t *srv, net_conn_t *conn, const uint8_t *data, size_t len)
+{
+    return len;
+}
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double thread_cpu_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int bench_stream(int argc, char **argv)
+{
+    double rate = argc > 0 ? atof(argv[0]) : 20000;
+    double seconds = argc > 1 ? atof(argv[1]) : 2;
+    uint16_t port = argc > 2 ? (uint16_t)atoi(argv[2]) : 3401;
+    static const int64_t deadlines[] = { 0, 1000, 2000, 5000, 10000, 20000 };
+    const int64_t interval = (int64_t)(1e6 / rate);
+    if (rate <= 0 || seconds <= 0 || interval < 1) {
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    static net_server_t srv;
+    static telemetry_stream_t ts;
+    const net_handlers_t handlers = { stream_open, stream_data, stream_close, NULL, NULL };
+    stream_client_t cl;
+    cl.cap = (long)(rate * seconds) + 1024;
+    cl.lat = malloc(sizeof(int64_t) * cl.cap);
+    cl.port = port;
+
+    printf("stream: %.0f samples/s for %.1fs per run, %d-byte MSS, loopback\n",
+           rate, seconds, TELEMETRY_MSS);
+    printf("%9s %8s %11s %11s %10s %9s %9s %9s %10s\n", "deadline", "frames", "sends/smp",
+           "wire B/smp", "recv/smp", "p50 us", "p99 us", "max us", "cpu us/smp");
+    for (size_t d = 0; d < sizeof(deadlines) / sizeof(deadlines[0]); d++) {
+        if (net_server_init(&srv, port, &handlers) != 0) {
+            free(cl.lat);
+            return 1;
+        }
+        telemetry_stream_init(&ts, 0, 10, deadlines[d], TELEMETRY_MSS);
+        cl.n = cl.frames = cl.recv_calls = 0;
+        cl.bytes = 0;
+        stream_conn = NULL;
+        pthread_t th;
+        pthread_create(&th, NULL, stream_client, &cl);
+        while (!stream_conn) {
+            net_server_poll(&srv, 10);
+        }
+
+        double cpu0 = thread_cpu_sec();
+        int64_t now = net_time_us();
+        int64_t end = now + (int64_t)(seconds * 1e6);
+        int64_t next = now;
+        long produced = 0;
+        while (now < end && stream_conn) {
+            while (next <= now) {
+                proto_sample_t smp = {
+                    .input = (float)((uint32_t)now & STREAM_STAMP_MASK),
+                    .output = 50.0f,
+                    .setpoint = 85.0f,
+                };
+                telemetry_stream_add(&ts, &srv, stream_conn, &smp, (uint32_t)(now / 1000), now);
+                produced++;
+                next += interval;
+            }
+            int64_t wait = next - now;
+            int64_t left = telemetry_stream_poll(&ts, &srv, stream_conn, now);
+            if (left >= 0 && left < wait) {
+                wait = left;
+            }
+            if (wait >= 1000) {
+                net_server_poll(&srv, (int)(wait / 1000));
+            } else {
+                net_server_poll(&srv, 0);
+                struct timespec sl = { 0, wait * 1000 };
+                nanosleep(&sl, NULL);
+            }
+            now = net_time_us();
+        }
+        if (stream_conn) {
+            telemetry_stream_flush(&ts, &srv, stream_conn);
+            net_server_close(&srv, stream_conn);
+        }
+        while (stream_conn) {
+            net_server_poll(&srv, 10);
+        }
+        double cpu = thread_cpu_sec() - cpu0;
+        pthread_join(th, NULL);
+        uint32_t sends = srv.stats.send_calls;
+        net_server_deinit(&srv);
+
+        long n = cl.n ? cl.n : 1;
+        qsort(cl.lat, cl.n, sizeof(int64_t), cmp_i64);
+        char name[24];
+        if (deadlines[d] == 0) {
+            snprintf(name, sizeof(name), "none");
+        } else {
+            snprintf(name, sizeof(name), "%lldms", (long long)(deadlines[d] / 1000));
+        }
+        printf("%9s %8ld %11.3f %11.2f %10.3f %9lld %9lld %9lld %10.2f\n", name, cl.frames,
+               (double)sends / n, (double)cl.bytes / n, (double)cl.recv_calls / n,
+               (long long)cl.lat[cl.n / 2], (long long)cl.lat[(long)(cl.n * 0.99)],
+               (long long)cl.lat[cl.n ? cl.n - 1 : 0], cpu * 1e6 / n);
+        if (cl.n != produced || ts.dropped) {
+            printf("warning: %ld samples produced, %ld received, %u dropped\n",
+                   produced, cl.n, (unsigned)ts.dropped);
+        }
+    }
+    free(cl.lat);
+    return 0;
+}
+
+/* pipeline ------------------------------------------------------------------------------
+   setpoint commands from net_client to a loopback net_server that holds every answer back
+   for an artificial round trip time; one request in flight at a time (what tcp_client
+   does today) against windows of several pipelined requests */
+
+#define PIPE_QUEUE 4096
+
+typedef struct {
+    int64_t rtt_us;
+    volatile bool stop;
+    uint16_t port;
+    net_server_t srv;
+    net_conn_t *conn;
+    /* answers waiting for their time, in arrival order (the delay is the same for all) */
+    struct { int64_t due; uint32_t corr; uint8_t type; } q[PIPE_QUEUE];
+    int head, tail;
+} pipe_server_t;
+
+static void pipe_frame(const proto_frame_t *f, void *arg)
+{
+    pipe_server_t *ps = arg;
+    uint8_t loop;
+    double sp;
+    if (!(f->flags & PROTO_F_CORR) || (ps->tail + 1) % PIPE_QUEUE == ps->head) {
+        return;
+    }
+    ps->q[ps->tail].due = net_time_us() + ps->rtt_us;
+    ps->q[ps->tail].corr = f->corr;
+    ps->q[ps->tail].type = proto_read_setpoint(f, &loop, &sp) ? PROTO_ACK_OK : PROTO_ACK_BAD_REQUEST;
+    ps->tail = (ps->tail + 1) % PIPE_QUEUE;
+}
+
+static size_t pipe_data(net_server_t *srv, net_conn_t *conn, const uint8_t *data, size_t len)
+{
+    int used = proto_consume(data, len, pipe_frame, srv->handlers.ctx);
+    if (used < 0) {
+        net_server_close(srv, conn);
+        return len;
+    }
+    return used;
+}
+
+static void pipe_open(net_server_t *srv, net_conn_t *conn)
+{
+    ((pipe_server_t *)srv->handlers.ctx)->conn = conn;
+}
+
+static void pipe_close(net_server_t *srv, net_conn_t *conn)
+{
+    ((pipe_server_t *)srv->handlers.ctx)->conn = NULL;
+}
+
+static void *pipe_server(void *arg)
+{
+    pipe_server_t *ps = arg;
+    while (!ps->stop) {
+        int64_t now = net_time_us();
+        while (ps->head != ps->tail && ps->q[ps->head].due <= now) {
+            uint8_t ack[PROTO_HEADER_SIZE + PROTO_CORR_SIZE + PROTO_ACK_SIZE];
+            size_t n = proto_encode_ack(ack, sizeof(ack), ps->q[ps->head].corr, PROTO_MSG_SETPOINT,
+                                        ps->q[ps->head].type);
+            if (ps->conn) {
+                net_server_send(&ps->srv, ps->conn, ack, n);
+            }
+            ps->head = (ps->head + 1) % PIPE_QUEUE;
+        }
+        int timeout = 1;
+        if (ps->head != ps->tail) {
+            int64_t wait = ps->q[ps->head].due - now;
+            if (wait < 1000) {
+                timeout = 0;
+            }
+        }
+        net_server_poll(&ps->srv, timeout);
+    }
+    return NULL;
+}
+
+typedef struct {
+    net_client_t *client;
+    uint8_t frame[PROTO_HEADER_SIZE + PROTO_SETPOINT_SIZE];
+    size_t len;
+    long done, errors;
+    bool refill;
+} pipe_client_t;
+
+static void pipe_done(void *arg, uint32_t corr, int status, const proto_frame_t *reply)
+{
+    pipe_client_t *pc = arg;
+    if (status == NET_CLIENT_CLOSED) {
+        return;
+    }
+    pc->done++;
+    if (status != PROTO_ACK_OK) {
+        pc->errors++;
+    }
+    if (pc->refill) {
+        net_client_request(pc->client, pc->frame, pc->len, pipe_done, pc);
+    }
+}
+
+static int bench_pipeline(int argc, char **argv)
+{
+    double seconds = argc > 0 ? atof(argv[0]) : 1;
+    uint16_t port = argc > 1 ? (uint16_t)atoi(argv[1]) : 3402;
+    static const int rtts_ms[] = { 0, 1, 5, 20, 50 };
+    static const int windows[] = { 1, 4, 16, 64 };
+    const int nr = sizeof(rtts_ms) / sizeof(rtts_ms[0]), nw = sizeof(windows) / sizeof(windows[0]);
+    signal(SIGPIPE, SIG_IGN);
+
+    static pipe_server_t ps;
+    static net_client_t client;
+    const net_handlers_t handlers = { pipe_open, pipe_data, pipe_close, &ps, NULL };
+
+    printf("pipeline: setpoint commands over loopback, %.1fs per run, answers held back by the rtt\n",
+           seconds);
+    printf("%8s", "rtt");
+    for (int w = 0; w < nw; w++) {
+        printf("  %8s %-3d", "window", windows[w]);
+    }
+    printf("   (commands/s)\n");
+    for (int r = 0; r < nr; r++) {
+        printf("%6dms", rtts_ms[r]);
+        for (int w = 0; w < nw; w++) {
+            memset(&ps, 0, sizeof(ps));
+            ps.rtt_us = rtts_ms[r] * 1000;
+            if (net_server_init(&ps.srv, port, &handlers) != 0) {
+                return 1;
+            }
+            pthread_t th;
+            pthread_create(&th, NULL, pipe_server, &ps);
+
+            net_client_init(&client, NULL, NULL);
+            if (net_client_connect(&client, "127.0.0.1", port, 1000) != 0) {
+                ps.stop = true;
+                pthread_join(th, NULL);
+                net_server_deinit(&ps.srv);
+                return 1;
+            }
+            pipe_client_t pc = { .client = &client, .refill = true };
+            pc.len = proto_encode_setpoint(pc.frame, sizeof(pc.frame), 0, 85.0);
+            for (int i = 0; i < windows[w]; i++) {
+                net_client_request(&client, pc.frame, pc.len, pipe_done, &pc);
+            }
+            int64_t t0 = net_time_us(), end = t0 + (int64_t)(seconds * 1e6);
+            while (net_time_us() < end && net_client_connected(&client)) {
+                net_client_poll(&client, 10);
+            }
+            double elapsed = (net_time_us() - t0) * 1e-6;
+            long done = pc.done;
+            pc.refill = false;
+            net_client_close(&client);
+
+            ps.stop = true;
+            pthread_join(th, NULL);
+            net_server_deinit(&ps.srv);
+            printf("  %12.0f", done / elapsed);
+            if (pc.errors) {
+                printf(" (%ld failed)", pc.errors);
+            }
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
+/* reconnect -----------------------------------------------------------------------------
+   a net_link against a server in a child process that is repeatedly taken away, either
+   killed (the kernel closes the socket, the client sees it at once) or frozen with
+   SIGSTOP (the socket stays open and TCP keeps acknowledging, only the heartbeats notice).
+   After an outage a new server is started; recovery is the time until the link has
+   reconnected and the server acknowledged the replayed state. */
+
+static void ack_frame(const proto_frame_t *f, void *arg)
+{
+    net_server_t *srv = ((void **)arg)[0];
+    net_conn_t *conn = ((void **)arg)[1];
+    if (f->flags & PROTO_F_CORR) {
+        uint8_t ack[PROTO_HEADER_SIZE + PROTO_CORR_SIZE + PROTO_ACK_SIZE];
+        net_server_send(srv, conn, ack, proto_encode_ack(ack, sizeof(ack), f->corr, f->type, PROTO_ACK_OK));
+    }
+}
+
+static size_t ack_data(net_server_t *srv, net_conn_t *conn, const uint8_t *data, size_t len)
+{
+    void *ctx[2] = { srv, conn };
+    int used = proto_consume(data, len, ack_frame, ctx);
+    if (used < 0) {
+        net_server_close(srv, conn);
+        return len;
+    }
+    return used;
+}
+
+static pid_t start_ack_server(uint16_t port)
+{
+    pid_t pid = fork();
+    if (pid == 0) {
+        static net_server_t srv;
+        const net_handlers_t handlers = { NULL, ack_data, NULL, NULL, NULL };
+        if (net_server_init(&srv, port, &handlers) != 0) {
+            _exit(1);
+        }
+        while (1) {
+            net_server_poll(&srv, 1000);
+        }
+    }
+    return pid;
+}
+
+typedef struct {
+    net_link_state_t state;
+    int64_t at_us;
+} link_event_t;
+
+static void link_event(net_link_t *link, net_link_state_t state, void *arg)
+{
+    link_event_t *ev = arg;
+    ev->state = state;
+    ev->at_us = net_time_us();
+}
+
+static bool wait_link(net_link_t *link, link_event_t *ev, net_link_state_t state, int64_t limit_us)
+{
+    int64_t end = net_time_us() + limit_us;
+    while (ev->state != state && net_time_us() < end) {
+        net_link_poll(link, 5);
+    }
+    return ev->state == state;
+}
+
+static int bench_reconnect(int argc, char **argv)
+{
+    int cycles = argc > 0 ? atoi(argv[0]) : 6;
+    int hb = argc > 1 ? atoi(argv[1]) : 200;
+    uint16_t port = argc > 2 ? (uint16_t)atoi(argv[2]) : 3403;
+    const int outage_ms = 1000;
+    if (cycles < 1 || hb < 1) {
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    static net_link_t link;
+    link_event_t ev = { NET_LINK_DOWN, 0 };
+    net_link_config_t cfg = NET_LINK_CONFIG_DEFAULT("127.0.0.1", port);
+    cfg.heartbeat_ms = hb;
+    cfg.backoff_min_ms = 20;
+    cfg.backoff_max_ms = 500;
+    net_link_init(&link, &cfg, NULL, NULL, link_event, &ev);
+
+    uint8_t frame[NET_LINK_STATE_FRAME];
+    proto_gains_t gains = { 0, 1, 0, 2.0f, 0.5f, 0.1f, 100 };
+    net_link_set_state(&link, frame, proto_encode_gains(frame, sizeof(frame), &gains));
+    for (int loop = 0; loop < 4; loop++) {
+        net_link_set_state(&link, frame, proto_encode_setpoint(frame, sizeof(frame), loop, 80.0));
+    }
+
+    pid_t server = start_ack_server(port);
+    if (!wait_link(&link, &ev, NET_LINK_SYNCED, 5000000)) {
+        printf("reconnect: no connection to the first server\n");
+        kill(server, SIGKILL);
+        waitpid(server, NULL, 0);
+        return 1;
+    }
+
+    printf("reconnect: heartbeat %dms, miss limit %d, outage %dms, backoff %d..%dms\n",
+           hb, cfg.miss_limit, outage_ms, cfg.backoff_min_ms, cfg.backoff_max_ms);
+    printf("%6s %8s %14s %14s %10s\n", "cycle", "fault", "detect ms", "recover ms", "replayed");
+    double worst_freeze = 0;
+    for (int i = 0; i < cycles; i++) {
+        bool freeze = i & 1;
+        uint32_t replayed = link.stats.replayed;
+        int64_t fault = net_time_us();
+        kill(server, freeze ? SIGSTOP : SIGKILL);
+        bool down = wait_link(&link, &ev, NET_LINK_DOWN, 10 * (int64_t)hb * 1000 + 1000000);
+        double detect = (ev.at_us - fault) * 1e-3;
+        if (freeze && detect > worst_freeze) {
+            worst_freeze = detect;
+        }
+
+        /* the operator keeps changing the setpoint during the outage */
+        int64_t restart = fault + (int64_t)outage_ms * 1000;
+        double sp = 80.0;
+        while (net_time_us() < restart) {
+            sp += 0.5;
+            net_link_set_state(&link, frame, proto_encode_setpoint(frame, sizeof(frame), 0, sp));
+            net_link_poll(&link, 20);
+        }
+        kill(server, SIGKILL);
+        waitpid(server, NULL, 0);
+        server = start_ack_server(port);
+        restart = net_time_us();
+        bool synced = wait_link(&link, &ev, NET_LINK_SYNCED, 10000000);
+
+        printf("%6d %8s %14.1f %14.1f %10u%s\n", i, freeze ? "freeze" : "kill",
+               down ? detect : -1.0, synced ? (ev.at_us - restart) * 1e-3 : -1.0,
+               (unsigned)(link.stats.replayed - replayed), down && synced ? "" : "   (timed out)");
+    }
+    printf("worst freeze detection %.1fms = %.2f heartbeat periods; %u heartbeat losses, "
+           "%u closed by peer, %u failed connects\n",
+           worst_freeze, worst_freeze / hb, (unsigned)link.stats.heartbeat_losses,
+           (unsigned)link.stats.closed_by_peer, (unsigned)link.stats.connect_failures);
+
+    net_link_drop(&link);
+    kill(server, SIGKILL);
+    waitpid(server, NULL, 0);
+    return 0;
+}
+
+/* rxpool --------------------------------------------------------------------------------
+   a client writes setpoint and gains commands in randomly sized chunks, so frames straddle
+   reads and slab ends;
+   the server either copies every parsed frame into a command queue (what the projects did)
+   or queues a reference to the receive slab and the frame pointing into it.  malloc() is
+   counted for the whole run.  The last run leaves the server a single slab and lets go of
+   the references only while the connection waits for room: a partial frame at the end of
+   that slab has to be moved to its start once it is no longer shared, or the connection
+   never reads again. */
+
+extern void *__libc_malloc(size_t size);
+static long malloc_calls;
+
+void *malloc(size_t size)
+{
+    __atomic_add_fetch(&malloc_calls, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+#define RX_QUEUE 64
+
+typedef struct {
+    uint8_t frame[PROTO_HEADER_SIZE + PROTO_GAINS_SIZE];
+} rx_cmd_t;
+
+typedef struct {
+    bool hold;
+    bool opened, closed;
+    long frames;
+    uint64_t copied;
+    double sum;
+    int head;
+    rx_cmd_t copies[RX_QUEUE];
+    struct { net_buf_t *buf; proto_frame_t frame; } refs[RX_QUEUE];
+    net_server_t *srv;
+    net_conn_t *conn;
+} rx_server_t;
+
+static void rx_apply(rx_server_t *rs, const proto_frame_t *f)
+{
+    uint8_t loop;
+    double sp;
+    proto_gains_t g;
+    if (proto_read_setpoint(f, &loop, &sp) && f->type == PROTO_MSG_SETPOINT) {
+        rs->sum += sp;
+    } else if (f->type == PROTO_MSG_GAINS && proto_read_gains(f, &g)) {
+        rs->sum += g.kp;
+    }
+}
+
+/* the control task side: applies a queued command */
+static void rx_use(rx_server_t *rs, int slot)
+{
+    if (rs->hold) {
+        if (rs->refs[slot].buf) {
+            rx_apply(rs, &rs->refs[slot].frame);
+            net_buf_release(rs->refs[slot].buf);
+            rs->refs[slot].buf = NULL;
+        }
+    } else {
+        proto_frame_t f;
+        if (rs->frames > slot && proto_parse(rs->copies[slot].frame, sizeof(rs->copies[slot].frame), &f) > 0) {
+            rx_apply(rs, &f);
+        }
+    }
+}
+
+static void rx_frame(const proto_frame_t *f, void *arg)
+{
+    rx_server_t *rs = arg;
+    int slot = rs->head;
+    rs->head = (rs->head + 1) % RX_QUEUE;
+    rx_use(rs, slot);           /* the queue is full, the oldest command gets consumed */
+    if (rs->hold) {
+        rs->refs[slot].buf = net_conn_hold(rs->conn);
+        rs->refs[slot].frame = *f;
+    } else {
+        size_t n = PROTO_HEADER_SIZE + f->len;
+        memcpy(rs->copies[slot].frame, f->payload - PROTO_HEADER_SIZE, n);
+        rs->copied += n;
+    }
+    rs->frames++;
+}
+
+static size_t rx_data(net_server_t *srv, net_conn_t *conn, const uint8_t *data, size_t len)
+{
+    rx_server_t *rs = srv->handlers.ctx;
+    rs->conn = conn;
+    int used = proto_consume(data, len, rx_frame, rs);
+    if (used < 0) {
+        net_server_close(srv, conn);
+        return len;
+    }
+    return used;
+}
+
+static void rx_open(net_server_t *srv, net_conn_t *conn)
+{
+    ((rx_server_t *)srv->handlers.ctx)->opened = true;
+}
+
+static void rx_close(net_server_t *srv, net_conn_t *conn)
+{
+    ((rx_server_t *)srv->handlers.ctx)->closed = true;
+}
+
+typedef struct {
+    uint16_t port;
+    long messages;
+} rx_client_t;
+
+static void *rx_client(void *arg)
+{
+    rx_client_t *rc = arg;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(rc->port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        close(fd);
+        return NULL;
+    }
+    static uint8_t buf[1 << 16];
+    size_t len = 0;
+    uint32_t seed = 7;
+    for (long i = 0; i < rc->messages; i++) {
+        if (i % 3 == 2) {
+            proto_gains_t g = { (uint8_t)(i & 3), 1, 0, 2.0f, 0.5f, 0.1f, 100 };
+            len += proto_encode_gains(buf + len, sizeof(buf) - len, &g);
+        } else {
+            len += proto_encode_setpoint(buf + len, sizeof(buf) - len, (uint8_t)(i & 3), 80.0 + (i % 100) * 0.01);
+        }
+        if (len > sizeof(buf) - 64 || i == rc->messages - 1) {
+            size_t off = 0;
+            while (off < len) {
+                seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+                size_t chunk = 1 + seed % 4096;
+                if (chunk > len - off) {
+                    chunk = len - off;
+                }
+                if (send(fd, buf + off, chunk, 0) < 0) {
+                    close(fd);
+                    return NULL;
+                }
+                off += chunk;
+            }
+            len = 0;
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+static int bench_rxpool(int argc, char **argv)
+{
+    long messages = argc > 0 ? atol(argv[0]) : 2000000;
+    uint16_t port = argc > 1 ? (uint16_t)atoi(argv[1]) : 3404;
+    signal(SIGPIPE, SIG_IGN);
+
+    static net_server_t srv;
+    static rx_server_t rs;
+    const net_handlers_t handlers = { rx_open, rx_data, rx_close, &rs, NULL };
+
+    printf("rxpool: %ld commands (16 and 24 bytes) over loopback, chunks of 1..4096 bytes, "
+           "%d commands queued, %d slabs of %d bytes\n", messages, RX_QUEUE, NET_BUF_COUNT, NET_BUF_SIZE);
+    printf("%-10s %12s %12s %12s %12s %10s %10s %10s\n", "mode", "Mmsg/s", "handler B/msg",
+           "server B/msg", "slabs/msg", "min free", "starved", "mallocs");
+    static net_buf_t *taken[NET_BUF_COUNT];
+    static const char *modes[] = { "copy", "zero-copy", "1 slab" };
+    bool stuck = false;
+    for (int mode = 0; mode < 3 && !stuck; mode++) {
+        memset(&rs, 0, sizeof(rs));
+        rs.hold = mode > 0;
+        rs.srv = &srv;
+        if (net_server_init(&srv, port, &handlers) != 0) {
+            return 1;
+        }
+        int ntaken = 0;
+        while (mode == 2 && srv.rx_pool.nfree > 1) {
+            taken[ntaken++] = net_buf_get(&srv.rx_pool);
+        }
+        rx_client_t rc = { port, mode == 2 && messages > 200000 ? 200000 : messages };
+        pthread_t th;
+        long m0 = __atomic_load_n(&malloc_calls, __ATOMIC_RELAXED);
+        int64_t t0 = net_time_us(), progress = t0;
+        long frames = 0;
+        pthread_create(&th, NULL, rx_client, &rc);
+        while (!rs.closed && !stuck) {
+            net_server_poll(&srv, 100);
+            if (mode == 2 && srv.rx_waiting > 0) {
+                for (int i = 0; i < RX_QUEUE; i++) {
+                    rx_use(&rs, i);         /* the control task catches up */
+                }
+            }
+            if (rs.frames != frames) {
+                frames = rs.frames;
+                progress = net_time_us();
+            }
+            stuck = net_time_us() - progress > 2000000;
+        }
+        if (stuck) {
+            net_server_deinit(&srv);        /* the client's send fails */
+        }
+        pthread_join(th, NULL);
+        double t = (net_time_us() - t0) * 1e-6;
+        for (int i = 0; i < RX_QUEUE; i++) {
+            rx_use(&rs, i);
+        }
+        while (ntaken > 0) {
+            net_buf_release(taken[--ntaken]);
+        }
+        long mallocs = __atomic_load_n(&malloc_calls, __ATOMIC_RELAXED) - m0;
+        long n = rs.frames ? rs.frames : 1;
+        printf("%-10s %12.2f %12.2f %12.3f %12.4f %10u %10u %10ld%s\n", modes[mode],
+               rs.frames / t / 1e6, (double)rs.copied / n, (double)srv.stats.rx_copied / n,
+               (double)srv.rx_pool.stats.gets / n, (unsigned)srv.rx_pool.stats.min_free,
+               (unsigned)srv.stats.rx_starved, mallocs,
+               stuck ? "   (stuck on a partial frame)"
+               : rs.frames == rc.messages && srv.rx_pool.nfree == NET_BUF_COUNT ? "" : "   (lost frames or slabs)");
+        if (!stuck) {
+            net_server_deinit(&srv);
+        }
+    }
+    return stuck ? 1 : 0;
+}
+
+/* fanout --------------------------------------------------------------------------------
+   a publisher sends 100-sample telemetry batches to 1..64 loopback subscribers, encoding
+   every batch per connection into its tx buffer (what the projects did) or serializing it
+   once and queueing shared references through net_pubsub.  Publisher CPU time is taken
+   from the thread clock.  A last run stops reading on one subscriber to show that the
+   others and the publisher are not held up. */
+
+#define FAN_SAMPLES 100
+
+typedef struct {
+    uint16_t port;
+    int n;
+    bool slow;                  /* subscriber 0 never reads */
+    volatile bool stop;
+    uint64_t bytes;
+    int connected;
+} fan_client_t;
+
+static void *fan_client(void *arg)
+{
+    fan_client_t *fc = arg;
+    int ep = epoll_create1(0);
+    int fds[NET_PUBSUB_MAX_SUBS];
+    uint8_t sub[PROTO_HEADER_SIZE + PROTO_SUBSCRIBE_SIZE];
+    size_t sub_len = proto_encode_subscribe(sub, sizeof(sub), 1, NET_SUB_DROP_OLDEST, 8);
+    for (int i = 0; i < fc->n; i++) {
+        fds[i] = socket(AF_INET, SOCK_STREAM, 0);
+        int rcv = 16384;
+        setsockopt(fds[i], SOL_SOCKET, SO_RCVBUF, &rcv, sizeof(rcv));
+        struct sockaddr_in addr = {
+            .sin_family = AF_INET,
+            .sin_port = htons(fc->port),
+            .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        };
+        if (connect(fds[i], (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            perror("connect");
+            break;
+        }
+        send(fds[i], sub, sub_len, 0);
+        if (!(fc->slow && i == 0)) {
+            struct epoll_event ev = { .events = EPOLLIN, .data.u32 = i };
+            epoll_ctl(ep, EPOLL_CTL_ADD, fds[i], &ev);
+        }
+        fc->connected++;
+    }
+    static uint8_t buf[65536];
+    while (!fc->stop) {
+        struct epoll_event evs[64];
+        int n = epoll_wait(ep, evs, 64, 10);
+        for (int i = 0; i < n; i++) {
+            int r = recv(fds[evs[i].data.u32], buf, sizeof(buf), 0);
+            if (r > 0) {
+                fc->bytes += r;
+            }
+        }
+    }
+    for (int i = 0; i < fc->connected; i++) {
+        close(fds[i]);
+    }
+    close(ep);
+    return NULL;
+}
+
+typedef struct {
+    net_pubsub_t ps;
+    int conns;
+    net_conn_t *list[NET_PUBSUB_MAX_SUBS];
+} fan_server_t;
+
+static void fan_sub_frame(const proto_frame_t *f, void *arg)
+{
+    void **ctx = arg;
+    fan_server_t *fs = ctx[0];
+    net_conn_t *conn = ctx[1];
+    if (net_pubsub_handle(&fs->ps, conn, f) && fs->conns < NET_PUBSUB_MAX_SUBS) {
+        /* small socket buffers so a subscriber that stops reading backs up quickly */
+        int snd = 16384;
+        setsockopt(conn->fd, SOL_SOCKET, SO_SNDBUF, &snd, sizeof(snd));
+        fs->list[fs->conns++] = conn;
+    }
+}
+
+static size_t fan_data(net_server_t *srv, net_conn_t *conn, const uint8_t *data, size_t len)
+{
+    void *ctx[2] = { srv->handlers.ctx, conn };
+    int used = proto_consume(data, len, fan_sub_frame, ctx);
+    return used < 0 ? len : (size_t)used;
+}
+
+static void fan_close(net_server_t *srv, net_conn_t *conn)
+{
+    fan_server_t *fs = srv->handlers.ctx;
+    net_pubsub_unsubscribe(&fs->ps, conn);
+}
+
+static int bench_fanout(int argc, char **argv)
+{
+    double rate = argc > 0 ? atof(argv[0]) : 500;
+    double seconds = argc > 1 ? atof(argv[1]) : 1;
+    uint16_t port = argc > 2 ? (uint16_t)atoi(argv[2]) : 3405;
+    if (rate <= 0 || seconds <= 0) {
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    static net_server_t srv;
+    static fan_server_t fs;
+    static proto_sample_t smp[FAN_SAMPLES];
+    const net_handlers_t handlers = { NULL, fan_data, fan_close, &fs, NULL };
+    for (int i = 0; i < FAN_SAMPLES; i++) {
+        smp[i].input = 85.0f + 0.01f * i;
+        smp[i].output = 40.0f;
+        smp[i].setpoint = 85.0f;
+    }
+    const int64_t interval = (int64_t)(1e6 / rate);
+
+    printf("fanout: %d-sample batches (%d bytes) at %.0f/s for %.1fs\n", FAN_SAMPLES,
+           PROTO_HEADER_SIZE + PROTO_TELEMETRY_HDR + FAN_SAMPLES * PROTO_SAMPLE_SIZE, rate, seconds);
+    printf("%6s %8s %14s %14s %12s %10s %8s\n", "subs", "mode", "cpu us/batch", "cpu us/sub",
+           "MB/s out", "sends/bat", "drops");
+    static const int counts[] = { 1, 2, 4, 8, 16, 32, 64, -8 };
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        for (int shared = 0; shared <= 1; shared++) {
+            int n = counts[c] < 0 ? -counts[c] : counts[c];
+            bool slow = counts[c] < 0;
+            if (slow && !shared) {
+                continue;
+            }
+            if (n > NET_PUBSUB_MAX_SUBS) {
+                break;
+            }
+            memset(&fs, 0, sizeof(fs));
+            if (net_server_init(&srv, port, &handlers) != 0) {
+                return 1;
+            }
+            net_pubsub_init(&fs.ps, &srv);
+            fan_client_t fc = { .port = port, .n = n, .slow = slow };
+            pthread_t th;
+            pthread_create(&th, NULL, fan_client, &fc);
+            while (fs.conns < n) {
+                net_server_poll(&srv, 10);
+            }
+
+            uint8_t frame[PROTO_HEADER_SIZE + PROTO_TELEMETRY_HDR + FAN_SAMPLES * PROTO_SAMPLE_SIZE];
+            double cpu0 = thread_cpu_sec();
+            uint32_t sends0 = srv.stats.send_calls;
+            uint64_t out0 = srv.stats.bytes_out;
+            int64_t now = net_time_us(), end = now + (int64_t)(seconds * 1e6), next = now;
+            long batches = 0;
+            while (now < end) {
+                if (now >= next) {
+                    if (shared) {
+                        net_pubsub_publish_telemetry(&fs.ps, 0, 10, (uint32_t)(now / 1000), smp, FAN_SAMPLES);
+                    } else {
+                        for (int i = 0; i < fs.conns; i++) {
+                            if (fs.list[i]->state == NET_CONN_OPEN) {
+                                size_t len = proto_encode_telemetry(frame, sizeof(frame), 0, 10,
+                                                                    (uint32_t)(now / 1000), smp, FAN_SAMPLES);
+                                net_server_send(&srv, fs.list[i], frame, len);
+                            }
+                        }
+                    }
+                    batches++;
+                    next += interval;
+                }
+                int64_t wait = next - net_time_us();
+                if (wait >= 1000) {
+                    net_server_poll(&srv, (int)(wait / 1000));
+                } else {
+                    net_server_poll(&srv, 0);
+                    if (wait > 0) {
+                        struct timespec sl = { 0, wait * 1000 };
+                        nanosleep(&sl, NULL);
+                    }
+                }
+                now = net_time_us();
+            }
+            double cpu = thread_cpu_sec() - cpu0;
+            double mb = (srv.stats.bytes_out - out0) / seconds / 1e6;
+            uint32_t sends = srv.stats.send_calls - sends0;
+            uint32_t drops = shared ? fs.ps.stats.drops : srv.stats.tx_overflows;
+
+            fc.stop = true;
+            pthread_join(th, NULL);
+            net_server_deinit(&srv);
+            printf("%5d%s %8s %14.2f %14.2f %12.1f %10.1f %8u\n", n, slow ? "*" : " ",
+                   shared ? "shared" : "copy", cpu * 1e6 / batches, cpu * 1e6 / batches / n, mb,
+                   (double)sends / batches, (unsigned)drops);
+        }
+    }
+    printf("* subscriber 0 stops reading, drop-oldest policy with an 8 frame queue\n");
+    return 0;
+}
+
+/* codec ---------------------------------------------------------------------------------
+   a simulated 1 kHz loop (setpoint steps, first order plant with sensor noise, clamped
+   controller output) coded as PROTO_MSG_TELEMETRY and as PROTO_MSG_TELEMETRY_DZ at several
+   resolutions; then the same stream with every 37th frame lost */
+
+static void codec_signal(proto_sample_t *s, long n)
+{
+    double temp = 25.0, sp = 80.0;
+    for (long i = 0; i < n; i++) {
+        if (i % 20000 == 0) {
+            sp = 80.0 + 10.0 * (double)(rng_u32() % 5);
+        }
+        double noise = ((int)(rng_u32() % 2001) - 1000) * 5e-5;
+        double out = 8.0 * (sp - temp);
+        out = out < 0 ? 0 : out > 255 ? 255 : out;
+        temp += (0.4 * out - (temp - 25.0)) * 0.001 / 5.0;
+        s[i].input = (float)(temp + noise);
+        s[i].output = (float)out;
+        s[i].setpoint = (float)sp;
+    }
+}
+
+static int bench_codec(int argc, char **argv)
+{
+    long n = argc > 0 ? atol(argv[0]) : 1000000;
+    int per_frame = argc > 1 ? atoi(argv[1]) : 50;
+    int key_every = argc > 2 ? atoi(argv[2]) : 20;
+    if (n < 1 || per_frame < 1 || per_frame * TELEMETRY_DZ_MAX_SAMPLE + TELEMETRY_DZ_HDR > PROTO_MAX_PAYLOAD) {
+        return 2;
+    }
+    proto_sample_t *smp = malloc(sizeof(proto_sample_t) * n);
+    proto_sample_t *dec = malloc(sizeof(proto_sample_t) * per_frame);
+    size_t cap = (size_t)n * 16 + 4096;
+    uint8_t *buf = malloc(cap);
+    codec_signal(smp, n);
+
+    printf("codec: %ld samples of a 1 kHz loop, %d samples/frame, keyframe every %d frames\n",
+           n, per_frame, key_every);
+    printf("%-12s %10s %10s %10s %12s %12s %12s\n", "coding", "B/sample", "vs f32", "vs f64",
+           "max error", "enc Msmp/s", "dec Msmp/s");
+
+    /* plain float frames as the reference */
+    double t0 = now_sec();
+    size_t len = 0;
+    for (long i = 0; i < n; i += per_frame) {
+        int c = (int)(n - i < per_frame ? n - i : per_frame);
+        len += proto_encode_telemetry(buf + len, cap - len, 0, 1, (uint32_t)i, smp + i, c);
+    }
+    double t_enc = now_sec() - t0;
+    printf("%-12s %10.2f %10.2f %10.2f %12s %12.1f %12s\n", "f32 frames", (double)len / n,
+           12.0 * n / len, 24.0 * n / len, "0", n / t_enc / 1e6, "-");
+
+    static const float resolutions[] = { 0.1f, 0.01f, 0.001f };
+    for (int r = 0; r < 3; r++) {
+        telemetry_enc_t enc;
+        telemetry_enc_init(&enc, resolutions[r], key_every);
+        t0 = now_sec();
+        len = 0;
+        for (long i = 0; i < n; i += per_frame) {
+            int c = (int)(n - i < per_frame ? n - i : per_frame);
+            len += telemetry_enc_frame(&enc, buf + len, cap - len, 0, 1, (uint32_t)i, smp + i, c);
+        }
+        t_enc = now_sec() - t0;
+
+        telemetry_dec_t d;
+        telemetry_dec_init(&d);
+        double max_err = 0, t_dec = 0;
+        long k = 0;
+        size_t off = 0;
+        while (off < len) {
+            proto_frame_t f;
+            int fl = proto_parse(buf + off, len - off, &f);
+            if (fl <= 0) {
+                break;
+            }
+            uint8_t loop;
+            uint16_t period;
+            uint32_t t_ms;
+            t0 = now_sec();
+            int c = telemetry_dec_frame(&d, &f, &loop, &period, &t_ms, dec, per_frame);
+            t_dec += now_sec() - t0;
+            for (int j = 0; j < c; j++, k++) {
+                double e = fmax(fabs(dec[j].input - smp[k].input),
+                                fmax(fabs(dec[j].output - smp[k].output), fabs(dec[j].setpoint - smp[k].setpoint)));
+                max_err = fmax(max_err, e);
+            }
+            off += fl;
+        }
+        char name[16];
+        snprintf(name, sizeof(name), "dz %g", resolutions[r]);
+        printf("%-12s %10.2f %10.2f %10.2f %12.2g %12.1f %12.1f%s\n", name, (double)len / n,
+               12.0 * n / len, 24.0 * n / len, max_err, n / t_enc / 1e6, k / t_dec / 1e6,
+               k == n ? "" : "   (samples missing)");
+    }
+
+    /* lossy link: every 37th frame never arrives */
+    telemetry_enc_t enc;
+    telemetry_dec_t d;
+    telemetry_enc_init(&enc, 0.01f, key_every);
+    telemetry_dec_init(&d);
+    long frames = 0, lost = 0, decoded = 0, skipped = 0;
+    for (long i = 0; i < n; i += per_frame, frames++) {
+        int c = (int)(n - i < per_frame ? n - i : per_frame);
+        size_t fl = telemetry_enc_frame(&enc, buf, cap, 0, 1, (uint32_t)i, smp + i, c);
+        if (frames % 37 == 36) {
+            lost++;
+            continue;
+        }
+        proto_frame_t f;
+        uint8_t loop;
+        uint16_t period;
+        uint32_t t_ms;
+        proto_parse(buf, fl, &f);
+        if (telemetry_dec_frame(&d, &f, &loop, &period, &t_ms, dec, per_frame) >= 0) {
+            decoded++;
+        } else {
+            skipped++;
+        }
+    }
+    printf("lossy link: %ld frames, %ld lost, %ld decoded, %ld dropped while waiting for a keyframe\n",
+           frames, lost, decoded, skipped);
+
+    free(smp);
+    free(dec);
+    free(buf);
+    return 0;
+}
+
+/* udp -----------------------------------------------------------------------------------
+   1 kHz jog setpoints through a local proxy standing in for a lossy Wi-Fi hop, over TCP
+   and over the net_udp side channel.  The proxy delays everything by delay_ms and loses a
+   fraction of the packets.  On UDP a lost datagram is simply gone.  TCP can't lose bytes
+   on loopback, so the proxy plays what TCP does over a lossy link: the lost segment
+   arrives one retransmission timeout later and everything sent after it waits behind it
+   (head-of-line blocking).  Every setpoint carries its send time; the receiver records
+   the age of each setpoint it applies. */
+
+#define PROXY_QUEUE 65536
+
+typedef struct {
+    bool udp;
+    double loss;
+    int64_t delay_us, rto_us;
+    int in_fd, out_fd;                  /* tcp: accepted client and connection to the receiver */
+    struct sockaddr_in out_addr;        /* udp: receiver */
+    volatile bool stop;
+    struct { int64_t due; uint16_t len; uint8_t data[64]; } q[PROXY_QUEUE];
+    int head, tail;
+    int64_t last_due;
+    uint32_t seed;
+} proxy_t;
+
+static void *proxy_run(void *arg)
+{
+    proxy_t *px = arg;
+    while (!px->stop) {
+        int64_t now = net_time_us();
+        while (px->head != px->tail && px->q[px->head].due <= now) {
+            if (px->udp) {
+                sendto(px->out_fd, px->q[px->head].data, px->q[px->head].len, 0,
+                       (struct sockaddr *)&px->out_addr, sizeof(px->out_addr));
+            } else {
+                send(px->out_fd, px->q[px->head].data, px->q[px->head].len, 0);
+            }
+            px->head = (px->head + 1) % PROXY_QUEUE;
+        }
+        int timeout = 1;
+        if (px->head != px->tail && px->q[px->head].due - now < 1000) {
+            timeout = 0;
+        }
+        struct pollfd pfd = { px->in_fd, POLLIN, 0 };
+        if (poll(&pfd, 1, timeout) <= 0) {
+            continue;
+        }
+        uint8_t data[64];
+        int n = recv(px->in_fd, data, sizeof(data), 0);
+        if (n <= 0 || (px->tail + 1) % PROXY_QUEUE == px->head) {
+            continue;
+        }
+        px->seed ^= px->seed << 13; px->seed ^= px->seed >> 17; px->seed ^= px->seed << 5;
+        bool lost = (px->seed % 100000) < px->loss * 100000;
+        int64_t due = net_time_us() + px->delay_us;
+        if (px->udp) {
+            if (lost) {
+                continue;
+            }
+        } else {
+            if (lost) {
+                due += px->rto_us;
+            }
+            if (due < px->last_due) {
+                due = px->last_due;     /* in order: nothing overtakes a retransmission */
+            }
+            px->last_due = due;
+        }
+        px->q[px->tail].due = due;
+        px->q[px->tail].len = (uint16_t)n;
+        memcpy(px->q[px->tail].data, data, n);
+        px->tail = (px->tail + 1) % PROXY_QUEUE;
+    }
+    return NULL;
+}
+
+typedef struct {
+    bool udp;
+    int fd;                             /* tcp receiver socket */
+    net_udp_t *chan;
+    volatile bool stop;
+    int64_t *age;
+    long n, cap;
+} jog_rx_t;
+
+static void jog_frame(const proto_frame_t *f, void *arg)
+{
+    jog_rx_t *rx = arg;
+    uint8_t loop;
+    double sent;
+    if (proto_read_setpoint(f, &loop, &sent) && rx->n < rx->cap) {
+        rx->age[rx->n++] = net_time_us() - (int64_t)sent;
+    }
+}
+
+static void *jog_receiver(void *arg)
+{
+    jog_rx_t *rx = arg;
+    static uint8_t buf[4096];
+    size_t have = 0;
+    while (!rx->stop) {
+        if (rx->udp) {
+            net_udp_poll(rx->chan, 5, jog_frame, rx);
+            continue;
+        }
+        struct pollfd pfd = { rx->fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 5) <= 0) {
+            continue;
+        }
+        int n = recv(rx->fd, buf + have, sizeof(buf) - have, 0);
+        if (n <= 0) {
+            break;
+        }
+        have += n;
+        int used = proto_consume(buf, have, jog_frame, rx);
+        if (used < 0) {
+            break;
+        }
+        memmove(buf, buf + used, have - used);
+        have -= used;
+    }
+    return NULL;
+}
+
+static int tcp_pair(uint16_t port, int *client, int *accepted)
+{
+    int ls = socket(AF_INET, SOCK_STREAM, 0), one = 1;
+    setsockopt(ls, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (bind(ls, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(ls, 1) != 0) {
+        close(ls);
+        return -1;
+    }
+    *client = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(*client, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(ls);
+        return -1;
+    }
+    *accepted = accept(ls, NULL, NULL);
+    close(ls);
+    setsockopt(*client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(*accepted, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return *accepted < 0 ? -1 : 0;
+}
+
+static int bench_udp(int argc, char **argv)
+{
+    double seconds = argc > 0 ? atof(argv[0]) : 3;
+    int delay_ms = argc > 1 ? atoi(argv[1]) : 5;
+    int rto_ms = argc > 2 ? atoi(argv[2]) : 200;
+    uint16_t port = argc > 3 ? (uint16_t)atoi(argv[3]) : 3406;
+    static const double losses[] = { 0, 0.001, 0.01, 0.05 };
+    signal(SIGPIPE, SIG_IGN);
+
+    static proxy_t px;
+    static net_udp_t tx, rx_chan, px_chan;
+    jog_rx_t rx;
+    rx.cap = (long)(seconds * 1000) + 100;
+    rx.age = malloc(sizeof(int64_t) * rx.cap);
+
+    printf("udp: 1 kHz setpoints for %.1fs, proxy delay %dms, tcp retransmission after %dms\n",
+           seconds, delay_ms, rto_ms);
+    printf("%6s %5s %10s %10s %10s %10s %10s\n", "loss", "chan", "applied", "p50 ms", "p99 ms",
+           "p99.9 ms", "max ms");
+    for (size_t l = 0; l < sizeof(losses) / sizeof(losses[0]); l++) {
+        for (int udp = 0; udp <= 1; udp++) {
+            memset(&px, 0, sizeof(px));
+            px.udp = udp;
+            px.loss = losses[l];
+            px.delay_us = delay_ms * 1000;
+            px.rto_us = rto_ms * 1000;
+            px.seed = 99;
+            rx.udp = udp;
+            rx.stop = false;
+            rx.n = 0;
+            int sender = -1;
+
+            if (udp) {
+                /* sender -> proxy (port) -> receiver (port + 1) */
+                if (net_udp_open(&rx_chan, port + 1) != 0 || net_udp_open(&px_chan, port) != 0 ||
+                    net_udp_open(&tx, 0) != 0) {
+                    return 1;
+                }
+                net_udp_set_peer(&tx, "127.0.0.1", port);
+                px.in_fd = px_chan.fd;
+                px.out_fd = socket(AF_INET, SOCK_DGRAM, 0);
+                px.out_addr.sin_family = AF_INET;
+                px.out_addr.sin_port = htons(port + 1);
+                px.out_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                rx.chan = &rx_chan;
+            } else {
+                /* sender -> proxy in, proxy out -> receiver */
+                if (tcp_pair(port, &sender, &px.in_fd) != 0 || tcp_pair(port + 1, &px.out_fd, &rx.fd) != 0) {
+                    return 1;
+                }
+            }
+            pthread_t pt, rt;
+            pthread_create(&pt, NULL, proxy_run, &px);
+            pthread_create(&rt, NULL, jog_receiver, &rx);
+
+            int64_t next = net_time_us(), end = next + (int64_t)(seconds * 1e6);
+            long sent = 0;
+            while (next < end) {
+                int64_t now = net_time_us();
+                if (now < next) {
+                    struct timespec sl = { 0, (next - now) * 1000 };
+                    nanosleep(&sl, NULL);
+                    continue;
+                }
+                uint8_t frame[PROTO_HEADER_SIZE + PROTO_SETPOINT_SIZE];
+                size_t len = proto_encode_setpoint(frame, sizeof(frame), 0, (double)net_time_us());
+                if (udp) {
+                    net_udp_send(&tx, frame, len);
+                } else {
+                    send(sender, frame, len, 0);
+                }
+                sent++;
+                next += 1000;
+            }
+            net_sleep_ms(delay_ms + rto_ms * 3 + 50);
+            px.stop = true;
+            rx.stop = true;
+            pthread_join(pt, NULL);
+            pthread_join(rt, NULL);
+            if (udp) {
+                net_udp_close(&tx);
+                net_udp_close(&px_chan);
+                net_udp_close(&rx_chan);
+                close(px.out_fd);
+            } else {
+                close(sender);
+                close(px.in_fd);
+                close(px.out_fd);
+                close(rx.fd);
+            }
+
+            qsort(rx.age, rx.n, sizeof(int64_t), cmp_i64);
+            long n = rx.n ? rx.n : 1;
+            printf("%5.1f%% %5s %9.1f%% %10.2f %10.2f %10.2f %10.2f\n", losses[l] * 100, udp ? "udp" : "tcp",
+                   100.0 * rx.n / sent, rx.age[n / 2] * 1e-3, rx.age[(long)(n * 0.99)] * 1e-3,
+                   rx.age[(long)(n * 0.999)] * 1e-3, rx.age[n - 1] * 1e-3);
+        }
+    }
+    free(rx.age);
+    return 0;
+}
+
+/* upload -------------------------------------------------------------------------------
+   log files of 1 MB .. max_mb streamed to a net_server receiver on loopback: one send()
+   per 64 byte record (what tcp_client does today), net_upload with pread() into the double
+   buffer, and net_upload with mmap() CRC + sendfile().  The receiver checks every CRC and
+   discards the data so the disk doesn't set the pace.  Then one upload into a file is cut
+   in the middle, resumed, and compared with the original, and one more goes through a
+   link that flips a bit in every corrupt_every-th piece of chunk body (after TCP has
+   checked it, like a bad cable or a flaky bridge would): the CRC has to catch each, the
+   sender rewind, and the file still come out identical. */
+
+#define UPLOAD_RECORD 64
+
+typedef struct {
+    net_server_t srv;
+    net_upload_rx_t rx;
+    volatile bool stop;
+    uint64_t raw_bytes;
+    uint32_t corrupt_every;             /* 0: leave the data alone */
+    uint32_t body_reads, corrupted;
+} upload_server_t;
+
+static int raw_marker;
+
+static size_t upload_data(net_server_t *srv, net_conn_t *conn, const uint8_t *data, size_t len)
+{
+    upload_server_t *us = srv->handlers.ctx;
+    if (conn->user == &raw_marker) {
+        us->raw_bytes += len;
+        return len;
+    }
+    if (conn->user == NULL && len >= 4 && memcmp(data, "LOG\n", 4) == 0) {
+        conn->user = &raw_marker;       /* record by record baseline */
+        return 4;
+    }
+    const net_upload_session_t *s = conn->user;
+    if (us->corrupt_every > 0 && s != NULL && s->in_chunk && !s->skip && s->got < s->len &&
+        ++us->body_reads % us->corrupt_every == 0) {
+        ((uint8_t *)data)[0] ^= 0x10;   /* the receive slab, next byte of the body */
+        us->corrupted++;
+    }
+    return net_upload_rx_data(&us->rx, srv, conn, data, len);
+}
+
+static void upload_close(net_server_t *srv, net_conn_t *conn)
+{
+    upload_server_t *us = srv->handlers.ctx;
+    if (conn->user != &raw_marker) {
+        net_upload_rx_close(&us->rx, conn);
+    }
+    conn->user = NULL;
+}
+
+static void *upload_server_run(void *arg)
+{
+    upload_server_t *us = arg;
+    while (!us->stop) {
+        net_server_poll(&us->srv, 10);
+    }
+    return NULL;
+}
+
+static int make_log(const char *path, uint64_t size)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        return -1;
+    }
+    static char line[UPLOAD_RECORD + 1];
+    uint64_t t = 0;
+    for (uint64_t done = 0; done < size; done += UPLOAD_RECORD, t += 10) {
+        snprintf(line, sizeof(line), "%012llu;%08.3f;%08.3f;%08.3f;%08u;%-11s\n", (unsigned long long)t,
+                 80 + (rng_u32() % 1000) * 0.01, (rng_u32() % 25500) * 0.01, 80.0, rng_u32() % 100000000,
+                 "RUN");
+        size_t n = size - done < UPLOAD_RECORD ? (size_t)(size - done) : UPLOAD_RECORD;
+        fwrite(line, 1, n, f);
+    }
+    fclose(f);
+    return 0;
+}
+
+static uint32_t file_crc(const char *path)
+{
+    static uint8_t buf[1 << 16];
+    FILE *f = fopen(path, "rb");
+    uint32_t crc = 0;
+    size_t n;
+    if (!f) {
+        return 0;
+    }
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        crc = net_crc32(crc, buf, n);
+    }
+    fclose(f);
+    return crc;
+}
+
+static int upload_records(const char *path, uint16_t port, upload_server_t *us, uint64_t size)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    FILE *f = fopen(path, "rb");
+    char rec[UPLOAD_RECORD];
+    size_t n;
+    send(fd, "LOG\n", 4, 0);
+    while ((n = fread(rec, 1, sizeof(rec), f)) > 0) {
+        if (send(fd, rec, n, 0) != (ssize_t)n) {
+            break;
+        }
+    }
+    fclose(f);
+    while (us->raw_bytes < size) {
+        usleep(100);
+    }
+    close(fd);
+    return 0;
+}
+
+static int bench_upload(int argc, char **argv)
+{
+    int max_mb = argc > 0 ? atoi(argv[0]) : 1024;
+    const char *dir = argc > 1 ? argv[1] : "/tmp";
+    uint16_t port = argc > 2 ? (uint16_t)atoi(argv[2]) : 3409;
+    if (max_mb < 1) {
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    static upload_server_t us;
+    static net_upload_t up;
+    const net_handlers_t handlers = { NULL, upload_data, upload_close, &us, NULL };
+    if (net_server_init(&us.srv, port, &handlers) != 0) {
+        return 1;
+    }
+    net_upload_rx_init(&us.rx, NULL);
+    pthread_t th;
+    pthread_create(&th, NULL, upload_server_run, &us);
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/net_bench_upload.log", dir);
+    static const char *const modes[] = { "record send()", "double buffer", "sendfile" };
+    printf("upload: %d KB chunks, window %d, %d byte records for the baseline, loopback\n",
+           NET_UPLOAD_CHUNK / 1024, NET_UPLOAD_WINDOW, UPLOAD_RECORD);
+    printf("%8s %15s %10s %12s %10s\n", "size MB", "mode", "MB/s", "cpu ms/MB", "messages");
+    for (int mb = 1; mb <= max_mb; mb *= 4) {
+        uint64_t size = (uint64_t)mb << 20;
+        if (make_log(path, size) != 0) {
+            perror(path);
+            return 1;
+        }
+        file_crc(path);                     /* warm the page cache like a fresh log */
+        for (int m = 0; m < 3; m++) {
+            double t0 = now_sec(), c0 = thread_cpu_sec();
+            uint64_t sends;
+            if (m == 0) {
+                us.raw_bytes = 0;
+                upload_records(path, port, &us, size);
+                sends = (size + UPLOAD_RECORD - 1) / UPLOAD_RECORD;
+            } else {
+                if (net_upload_open(&up, path, (uint32_t)mb, m == 2) != 0 ||
+                    net_upload_connect(&up, "127.0.0.1", port, 1000) != 0) {
+                    return 1;
+                }
+                while (net_upload_poll(&up, 100) == 0) {
+                }
+                sends = up.stats.chunks;
+                net_upload_close(&up);
+            }
+            double t = now_sec() - t0, cpu = thread_cpu_sec() - c0;
+            printf("%8d %15s %10.0f %12.2f %10llu\n", mb, modes[m], size / t / 1048576,
+                   cpu * 1e3 / mb, (unsigned long long)sends);
+        }
+    }
+
+    /* resume: cut the connection half way, reconnect, compare */
+    us.stop = true;
+    pthread_join(th, NULL);
+    net_server_deinit(&us.srv);
+    us.stop = false;
+    if (net_server_init(&us.srv, port, &handlers) != 0) {
+        return 1;
+    }
+    net_upload_rx_init(&us.rx, dir);
+    pthread_create(&th, NULL, upload_server_run, &us);
+
+    uint64_t size = 16u << 20;
+    char out[300];
+    snprintf(out, sizeof(out), "%s/log_%u.bin", dir, 7u);
+    unlink(out);
+    make_log(path, size);
+    net_upload_open(&up, path, 7, true);
+    net_upload_connect(&up, "127.0.0.1", port, 1000);
+    while (up.acked < size / 2 && net_upload_poll(&up, 100) == 0) {
+    }
+    uint64_t cut = up.acked;
+    close(up.sock);                         /* the link drops */
+    up.sock = -1;
+    usleep(20000);
+    int r = net_upload_connect(&up, "127.0.0.1", port, 1000);
+    uint64_t resumed = up.acked;
+    while (r == 0 && (r = net_upload_poll(&up, 100)) == 0) {
+    }
+    net_upload_close(&up);
+    usleep(20000);
+    bool same = file_crc(path) == file_crc(out);
+    printf("\nresume: cut after %.1f MB committed, resumed at %.1f MB, file %s, %u chunks rejected\n",
+           cut / 1048576.0, resumed / 1048576.0, same ? "identical" : "DIFFERENT",
+           (unsigned)us.rx.stats.bad_crc);
+    unlink(out);
+
+    /* corruption: bits flipped in flight, the CRC and rewind path has to repair them */
+    uint32_t bad_before = us.rx.stats.bad_crc;
+    us.corrupt_every = 997;
+    snprintf(out, sizeof(out), "%s/log_%u.bin", dir, 8u);
+    unlink(out);
+    net_upload_open(&up, path, 8, false);
+    r = net_upload_connect(&up, "127.0.0.1", port, 1000);
+    double t0 = now_sec();
+    while (r == 0 && (r = net_upload_poll(&up, 100)) == 0) {
+    }
+    double t = now_sec() - t0;
+    uint32_t rewinds = up.stats.rewinds, chunks = up.stats.chunks;
+    net_upload_close(&up);
+    usleep(20000);
+    uint32_t rejected = us.rx.stats.bad_crc - bad_before;
+    bool repaired = r == 1 && file_crc(path) == file_crc(out);
+    printf("corrupt: %u bits flipped in flight, %u chunks rejected, %u rewinds, %u chunks sent for %u, "
+           "%.0f MB/s, file %s\n",
+           (unsigned)us.corrupted, (unsigned)rejected, (unsigned)rewinds, (unsigned)chunks,
+           (unsigned)((size + NET_UPLOAD_CHUNK - 1) / NET_UPLOAD_CHUNK), size / t / 1048576,
+           repaired ? "identical" : "DIFFERENT");
+
+    us.stop = true;
+    pthread_join(th, NULL);
+    net_server_deinit(&us.srv);
+    unlink(path);
+    unlink(out);
+    return same && repaired && rejected > 0 ? 0 : 1;
+}
+
+/* clock ----------------------------------------------------------------------------------
+
+   A board clock simulated against true time on a 10 ms grid: a fixed rate error of
+   drift_ppm, a +-2 ppm temperature swing over 30 minutes and a small random walk.  Every
+   poll_s it runs one exchange with a reference (true time plus a constant offset) through
+   the real frames: one way delays of 1 ms plus an exponential 1.5 ms mean, 3% of them
+   20-80 ms (Wi-Fi retries), the uplink asym_us slower than the downlink.  The answer is
+   handed to net_clock_update() once the board clock reaches t4.  At every grid point the
+   shared time is compared to the reference; the first 5 minutes are left out.  The naive
+   column uses the raw offset of the last exchange, the way a one-shot time request would. */
+
+#define CLOCK_GRID_US 10000
+#define CLOCK_REF_OFFSET 1234567890123LL
+
+static double rng_exp(double mean)
+{
+    return -mean * log(((rng_u32() >> 8) + 1) / 16777217.0);
+}
+
+static double clock_one_way(void)
+{
+    double d = 1000 + rng_exp(1500);
+    if (rng_u32() % 100 < 3) {
+        d += 20000 + rng_u32() % 60000;
+    }
+    return d;
+}
+
+static void clock_report(const char *name, int64_t *err, long n)
+{
+    double sum = 0;
+    for (long i = 0; i < n; i++) {
+        sum += (double)err[i];
+    }
+    for (long i = 0; i < n; i++) {
+        err[i] = err[i] < 0 ? -err[i] : err[i];
+    }
+    qsort(err, n, sizeof(int64_t), cmp_i64);
+    printf("  %-10s %10.1f %10lld %10lld %10lld %10lld\n", name, sum / n, (long long)err[n / 2],
+           (long long)err[n * 99 / 100], (long long)err[n * 999 / 1000], (long long)err[n - 1]);
+}
+
+static int bench_clock(int argc, char **argv)
+{
+    double hours = argc > 0 ? atof(argv[0]) : 2;
+    double poll_s = argc > 1 ? atof(argv[1]) : 4;
+    double drift_ppm = argc > 2 ? atof(argv[2]) : 40;
+    double asym_us = argc > 3 ? atof(argv[3]) : 200;
+    if (hours <= 0 || poll_s <= 0) {
+        return 2;
+    }
+    const int64_t warmup_us = 300LL * 1000000;
+    long steps = (long)(hours * 3600e6 / CLOCK_GRID_US);
+    int64_t *err = malloc(sizeof(int64_t) * steps);
+    int64_t *naive_err = malloc(sizeof(int64_t) * steps);
+    long n = 0;
+
+    static net_clock_t clk;
+    net_clock_init(&clk);
+    double local = 5e6;                 /* the board booted 5 s before the run */
+    double walk = 0;
+    int64_t naive_offset = 0;
+    bool naive_set = false;
+    int64_t next_poll = 0, last_shared = INT64_MIN;
+    long backwards = 0, pending = 0;
+    int64_t p1 = 0, p2 = 0, p3 = 0, p4 = 0;
+    uint32_t corr = 1;
+
+    for (long k = 0; k < steps; k++) {
+        int64_t t = (int64_t)k * CLOCK_GRID_US;
+        double ppm = drift_ppm + 2 * sin(2 * M_PI * t / 1800e6) + walk;
+        walk += ((double)(rng_u32() % 2001) - 1000) * 1e-6;
+        double rate = 1 + ppm * 1e-6;
+
+        if (t >= next_poll && !pending) {
+            uint8_t req[PROTO_HEADER_SIZE + PROTO_CORR_SIZE + PROTO_TIME_SIZE];
+            uint8_t ans[PROTO_HEADER_SIZE + PROTO_CORR_SIZE + PROTO_TIME_REPLY_SIZE];
+            proto_frame_t f;
+            size_t len = proto_set_corr(req, sizeof(req), proto_encode_time(req, sizeof(req), (int64_t)local),
+                                        corr++);
+            double up = clock_one_way() + asym_us, down = clock_one_way();
+            int64_t t2 = t + (int64_t)up + CLOCK_REF_OFFSET;
+            int64_t t3 = t2 + 50;
+            proto_parse(req, len, &f);
+            len = net_clock_answer(ans, sizeof(ans), &f, t2, t3);
+            proto_parse(ans, len, &f);
+            proto_read_time(&f, &p1, &p2, &p3);
+            p4 = (int64_t)(local + (up + 50 + down) * rate);
+            pending = 1;
+            next_poll = t + (int64_t)(poll_s * 1e6);
+        }
+        if (pending && local >= p4) {
+            net_clock_update(&clk, p1, p2, p3, p4);
+            naive_offset = ((p2 - p1) + (p3 - p4)) / 2;
+            naive_set = true;
+            pending = 0;
+        }
+
+        int64_t shared = net_clock_shared_us(&clk, (int64_t)local);
+        if (net_clock_synced(&clk) && shared < last_shared) {
+            backwards++;
+        }
+        last_shared = shared;
+        if (t >= warmup_us && naive_set) {
+            err[n] = shared - (t + CLOCK_REF_OFFSET);
+            naive_err[n] = (int64_t)local + naive_offset - (t + CLOCK_REF_OFFSET);
+            n++;
+        }
+        local += CLOCK_GRID_US * rate;
+    }
+
+    printf("clock: %.1f h, exchange every %.1f s, drift %.0f ppm +-2 ppm, path asymmetry %.0f us\n",
+           hours, poll_s, drift_ppm, asym_us);
+    printf("  exchanges %u, used %u, steps %u, fitted drift %.3f ppm, shared time backwards %ld\n",
+           clk.stats.exchanges, clk.stats.used, clk.stats.steps, clk.stats.drift_ppb / 1000.0, backwards);
+    printf("  error us   %10s %10s %10s %10s %10s\n", "mean", "p50 |e|", "p99", "p99.9", "max");
+    if (n > 0) {
+        clock_report("net_clock", err, n);
+        clock_report("naive", naive_err, n);
+    }
+
+    /* what it costs on this machine */
+    const long reps = 2000000;
+    int64_t sink = 0;
+    double t0 = now_sec();
+    for (long i = 0; i < reps; i++) {
+        sink += net_clock_shared_us(&clk, (int64_t)local + i);
+    }
+    double map_ns = (now_sec() - t0) * 1e9 / reps;
+    net_clock_t bench;
+    net_clock_init(&bench);
+    t0 = now_sec();
+    for (long i = 0; i < reps; i++) {
+        int64_t t1 = i * 4000000LL;
+        net_clock_update(&bench, t1, t1 + 2000 + (i & 7) * 100, t1 + 2050 + (i & 7) * 100, t1 + 4000);
+    }
+    double update_ns = (now_sec() - t0) * 1e9 / reps;
+    printf("  net_clock_shared_us %.1f ns, net_clock_update %.0f ns (%lld)\n", map_ns, update_ns,
+           (long long)(sink & 1));
+    free(err);
+    free(naive_err);
+    return 0;
+}
+
+/* cmd ------------------------------------------------------------------------------------
+
+   Text commands as the first projects send them, mb of them, arriving 'segment' bytes at a
+   time and handed over the way net_server does it (the unconsumed tail again, together
+   with the next segment).  The baseline is the usual handler: look for '\n' from the start
+   of the pending data byte by byte, copy the line out, strtok it, strcmp down a list of
+   names and sscanf the arguments, one line per call.  The second stream has 800 byte RAMP
+   lines in 64 byte segments, where rescanning the partial line after every segment is what
+   costs. */
+
+static const char *cmd_names[] = { "SP", "GAINS", "LIMITS", "MODE", "PING", "RAMP" };
+
+static size_t cmd_stream(char *buf, size_t size, bool long_lines)
+{
+    size_t len = 0;
+    while (len + 1024 < size) {
+        uint32_t r = rng_u32();
+        int loop = (int)(r & 3);
+        if (long_lines) {
+            len += sprintf(buf + len, "RAMP %d", loop);
+            for (int i = 0; i < 100; i++) {
+                len += sprintf(buf + len, " %.2f", 20 + i * 0.5);
+            }
+            buf[len++] = '\n';
+            continue;
+        }
+        switch ((r >> 8) % 8) {
+        case 0:
+            len += sprintf(buf + len, "GAINS %d %.2f %.3f %.3f\n", loop, 2 + (r % 100) * 0.01, 0.5, 0.05);
+            break;
+        case 1:
+            len += sprintf(buf + len, "LIMITS %d 0 %.1f\n", loop, 200 + (double)(r % 50));
+            break;
+        case 2:
+            len += sprintf(buf + len, "MODE %d %d\n", loop, (int)((r >> 4) & 1));
+            break;
+        case 3:
+            len += sprintf(buf + len, "PING\n");
+            break;
+        default:
+            len += sprintf(buf + len, "SP %d %.3f\n", loop, 80 + (r % 1000) * 0.01);
+            break;
+        }
+    }
+    return len;
+}
+
+typedef struct {
+    long commands;
+    double sum;
+} cmd_sink_t;
+
+static size_t cmd_legacy(cmd_sink_t *sink, const uint8_t *data, size_t len)
+{
+    size_t i = 0;
+    while (i < len && data[i] != '\n') {
+        i++;
+    }
+    if (i == len) {
+        return 0;
+    }
+    char line[2048];
+    memcpy(line, data, i);
+    line[i] = 0;
+    char *save;
+    char *name = strtok_r(line, " ", &save);
+    char *rest = name ? name + strlen(name) + 1 : NULL;
+    int loop, mode;
+    double a, b, c;
+    if (name == NULL) {
+    } else if (!strcmp(name, "SP") && sscanf(rest, "%d %lf", &loop, &a) == 2) {
+        sink->sum += a;
+    } else if (!strcmp(name, "GAINS") && sscanf(rest, "%d %lf %lf %lf", &loop, &a, &b, &c) == 4) {
+        sink->sum += a + b + c;
+    } else if (!strcmp(name, "LIMITS") && sscanf(rest, "%d %lf %lf", &loop, &a, &b) == 3) {
+        sink->sum += a + b;
+    } else if (!strcmp(name, "MODE") && sscanf(rest, "%d %d", &loop, &mode) == 2) {
+        sink->sum += mode;
+    } else if (!strcmp(name, "PING")) {
+    } else if (!strcmp(name, "RAMP")) {
+        char *tok;
+        strtok_r(NULL, " ", &save);
+        while ((tok = strtok_r(NULL, " ", &save)) != NULL) {
+            sink->sum += atof(tok);
+        }
+    }
+    sink->commands++;
+    return i + 1;
+}
+
+static int cmd_args(const net_cmd_t *cmd, void *arg, int first, int n)
+{
+    cmd_sink_t *sink = arg;
+    long loop;
+    double v;
+    if (!net_cmd_int(&cmd->argv[1], &loop)) {
+        return -1;
+    }
+    for (int i = first; i < first + n && i < cmd->argc; i++) {
+        if (!net_cmd_double(&cmd->argv[i], &v)) {
+            return -1;
+        }
+        sink->sum += v;
+    }
+    sink->commands++;
+    return 0;
+}
+
+static int cmd_sp(const net_cmd_t *cmd, void *arg)
+{
+    return cmd_args(cmd, arg, 2, 1);
+}
+
+static int cmd_gains(const net_cmd_t *cmd, void *arg)
+{
+    return cmd_args(cmd, arg, 2, 3);
+}
+
+static int cmd_limits(const net_cmd_t *cmd, void *arg)
+{
+    return cmd_args(cmd, arg, 2, 2);
+}
+
+static int cmd_mode(const net_cmd_t *cmd, void *arg)
+{
+    return cmd_args(cmd, arg, 2, 1);
+}
+
+static int cmd_ping(const net_cmd_t *cmd, void *arg)
+{
+    ((cmd_sink_t *)arg)->commands++;
+    return 0;
+}
+
+static int cmd_ramp(const net_cmd_t *cmd, void *arg)
+{
+    /* only NET_CMD_MAX_ARGS tokens are split out; the rest of a long line is read here,
+       up to the '\n' the parser found */
+    cmd_sink_t *sink = arg;
+    const char *p = cmd->argv[2].p, *end = p;
+    while (*end != '\n') {
+        end++;
+    }
+    while (p < end) {
+        net_cmd_tok_t tok = { p, 0 };
+        while (p + tok.len < end && p[tok.len] != ' ') {
+            tok.len++;
+        }
+        double v;
+        if (!net_cmd_double(&tok, &v)) {
+            return -1;
+        }
+        sink->sum += v;
+        p += tok.len + 1;
+    }
+    sink->commands++;
+    return 0;
+}
+
+static const net_cmd_def_t cmd_defs[] = {
+    { "SP", cmd_sp, 2 },
+    { "GAINS", cmd_gains, 4 },
+    { "LIMITS", cmd_limits, 3 },
+    { "MODE", cmd_mode, 2 },
+    { "PING", cmd_ping, 0 },
+    { "RAMP", cmd_ramp, 2 },
+};
+
+/* feeds buf in segments the way net_server does; returns seconds */
+static double cmd_run(const uint8_t *buf, size_t len, size_t segment, bool legacy, const net_cmd_table_t *t,
+                      cmd_sink_t *sink, net_cmd_parser_t *parser)
+{
+    size_t start = 0, arrived = 0;
+    double t0 = now_sec();
+    while (arrived < len) {
+        arrived = arrived + segment < len ? arrived + segment : len;
+        for (;;) {
+            size_t c = legacy ? cmd_legacy(sink, buf + start, arrived - start)
+                              : net_cmd_feed(parser, t, buf + start, arrived - start, sink);
+            if (c == 0) {
+                break;
+            }
+            start += c;
+        }
+    }
+    return now_sec() - t0;
+}
+
+static int bench_cmd(int argc, char **argv)
+{
+    double mb = argc > 0 ? atof(argv[0]) : 64;
+    size_t segment = argc > 1 ? (size_t)atol(argv[1]) : 1460;
+    if (mb <= 0 || segment == 0) {
+        return 2;
+    }
+    size_t size = (size_t)(mb * 1048576);
+    char *buf = malloc(size + 1024);
+    static net_cmd_table_t table;
+    if (net_cmd_table_init(&table, cmd_defs, sizeof(cmd_defs) / sizeof(cmd_defs[0])) != 0) {
+        printf("no perfect hash for the command table\n");
+        return 1;
+    }
+
+    /* the delimiter search alone */
+    size_t len = cmd_stream(buf, size, false);
+    const uint8_t *b = (const uint8_t *)buf, *e = b + len;
+    printf("cmd: %.1f MB of commands, %d names in a %d slot table\n", len / 1048576.0,
+           (int)(sizeof(cmd_names) / sizeof(cmd_names[0])), 1 << table.bits);
+    printf("  %-28s %10s %12s\n", "'\\n' search", "GB/s", "lines");
+    for (int v = 0; v < 4; v++) {
+        static const char *names[] = { "byte loop", "memchr", "SWAR (Xtensa path)", "net_cmd_find_nl" };
+        long lines = 0;
+        double t0 = now_sec();
+        for (const uint8_t *p = b; p < e; p++) {
+            switch (v) {
+            case 0:
+                while (p < e && *p != '\n') {
+                    p++;
+                }
+                break;
+            case 1: {
+                const uint8_t *q = memchr(p, '\n', (size_t)(e - p));
+                p = q ? q : e;
+                break;
+            }
+            case 2:
+                p = net_cmd_find_nl_swar(p, e);
+                break;
+            default:
+                p = net_cmd_find_nl(p, e);
+                break;
+            }
+            lines += p < e;
+        }
+        double dt = now_sec() - t0;
+        printf("  %-28s %10.2f %12ld\n", names[v], len / dt / 1e9, lines);
+    }
+
+    printf("\n  %-28s %8s %10s %10s %12s\n", "parse + dispatch", "segment", "MB/s", "Mcmd/s", "checksum");
+    for (int stream = 0; stream < 2; stream++) {
+        size_t seg = stream == 0 ? segment : 64;
+        if (stream == 1) {
+            len = cmd_stream(buf, size / 4, true);
+        }
+        for (int legacy = 1; legacy >= 0; legacy--) {
+            cmd_sink_t sink = {0, 0};
+            net_cmd_parser_t parser;
+            net_cmd_parser_init(&parser);
+            double dt = cmd_run((const uint8_t *)buf, len, seg, legacy, &table, &sink, &parser);
+            char name[64];
+            snprintf(name, sizeof(name), "%s %s", stream ? "RAMP lines," : "mixed,", legacy ? "strtok+sscanf" : "net_cmd");
+            printf("  %-28s %8zu %10.1f %10.2f %12.0f\n", name, seg, len / dt / 1048576.0, sink.commands / dt / 1e6,
+                   sink.sum);
+            if (!legacy && (parser.stats.failed || parser.stats.unknown)) {
+                printf("  warning: %u failed, %u unknown\n", parser.stats.failed, parser.stats.unknown);
+            }
+        }
+    }
+    free(buf);
+    return 0;
+}
+
+/* ws ------------------------------------------------------------------------------------ */
+
+/* WebSocket unmasking, the way every frame from a browser has to go, byte by byte against
+   net_ws_mask() a word at a time, for frame sizes from a ping to a full segment */
+static int bench_ws(int argc, char **argv)
+{
+    double mb = argc > 0 ? atof(argv[0]) : 256;
+    if (mb <= 0) {
+        return 2;
+    }
+    char accept[29];
+    net_ws_accept_key("dGhlIHNhbXBsZSBub25jZQ==", 24, accept);
+    printf("ws: handshake key of RFC 6455 section 1.3 -> %s (%s)\n", accept,
+           strcmp(accept, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") ? "WRONG" : "ok");
+
+    static const size_t sizes[] = { 16, 125, 1400, 65536 };
+    const uint8_t key[4] = { 0x37, 0xfa, 0x21, 0x3d };
+    uint8_t *buf = malloc(65536 + 8), *ref = malloc(65536 + 8);
+    printf("  %8s %6s %14s %14s %8s\n", "bytes", "offset", "byte GB/s", "word GB/s", "check");
+    for (size_t z = 0; z < sizeof(sizes) / sizeof(sizes[0]); z++) {
+        for (size_t off = 0; off < 2; off++) {
+            /* offset 1: payloads follow a 2, 4 or 10 byte header and are rarely aligned */
+            size_t n = sizes[z];
+            uint8_t *p = buf + off * 3;
+            for (size_t i = 0; i < n; i++) {
+                ref[i] = (uint8_t)rng_u32();
+                p[i] = ref[i];
+            }
+            net_ws_mask(p, n, key);
+            bool ok = true;
+            for (size_t i = 0; i < n; i++) {
+                ok &= p[i] == (uint8_t)(ref[i] ^ key[i & 3]);
+            }
+            long reps = (long)(mb * 1048576 / n);
+            double t0 = now_sec();
+            for (long r = 0; r < reps; r++) {
+                for (size_t i = 0; i < n; i++) {
+                    p[i] ^= key[i & 3];
+                }
+                __asm__ volatile("" : : "r"(p) : "memory");
+            }
+            double t_byte = now_sec() - t0;
+            t0 = now_sec();
+            for (long r = 0; r < reps; r++) {
+                net_ws_mask(p, n, key);
+                __asm__ volatile("" : : "r"(p) : "memory");
+            }
+            double t_word = now_sec() - t0;
+            printf("  %8zu %6zu %14.2f %14.2f %8s\n", n, off * 3, reps * n / t_byte / 1e9, reps * n / t_word / 1e9,
+                   ok ? "ok" : "WRONG");
+        }
+    }
+    free(buf);
+    free(ref);
+    return 0;
+}
+
+/* backpressure --------------------------------------------------------------------------
+   healthy clients read everything and keep PING requests in flight; stalled clients (an
+   operator laptop gone to sleep) keep sending PINGs and never read.  The server publishes
+   a 1212 byte telemetry batch per millisecond to every connection, serialized once and
+   queued as NET_TX_TELEMETRY, and answers every PING as a command.  Twice a second it
+   prints what the send queues hold, the pool and the process RSS: with the budgets all of
+   it levels off, however long the stalled clients stay asleep.  At the end one more client
+   stops reading a telemetry_stream, whose frames go out through net_server_sendv(): they
+   must be dropped like the queued batches, without the connection being closed. */
+
+#define BP_MAX 256
+#define BP_WINDOW 4             /* PINGs in flight per healthy client */
+
+typedef struct {
+    uint16_t port;
+    int healthy, stalled;
+    volatile bool stop;
+    int connected;
+    uint64_t bytes[BP_MAX];     /* received per healthy client */
+    uint64_t answers, pings_sent;
+} bp_client_t;
+
+typedef struct {
+    bp_client_t *bc;
+    int i;
+} bp_rx_t;
+
+static void bp_frame(const proto_frame_t *f, void *arg)
+{
+    bp_rx_t *rx = arg;
+    if (f->type == PROTO_MSG_ACK) {
+        rx->bc->answers++;
+        rx->i = -rx->i - 1;     /* tells the loop to send the next PING */
+    }
+}
+
+static bool bp_ping(int fd, uint32_t corr)
+{
+    uint8_t req[PROTO_HEADER_SIZE + PROTO_CORR_SIZE];
+    size_t n = proto_encode_ping(req, sizeof(req));
+    n = proto_set_corr(req, sizeof(req), n, corr);
+    return send(fd, req, n, MSG_DONTWAIT) == (ssize_t)n;
+}
+
+static void *bp_client(void *arg)
+{
+    bp_client_t *bc = arg;
+    int n = bc->healthy + bc->stalled;
+    int ep = epoll_create1(0);
+    int fds[BP_MAX];
+    static uint8_t rx[BP_MAX][8192];
+    static size_t rx_len[BP_MAX];
+    for (int i = 0; i < n; i++) {
+        fds[i] = socket(AF_INET, SOCK_STREAM, 0);
+        bool stalled = i >= bc->healthy;
+        if (stalled) {
+            int rcv = 4096;
+            setsockopt(fds[i], SOL_SOCKET, SO_RCVBUF, &rcv, sizeof(rcv));
+        }
+        struct sockaddr_in addr = {
+            .sin_family = AF_INET,
+            .sin_port = htons(bc->port),
+            .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        };
+        if (connect(fds[i], (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            perror("connect");
+            break;
+        }
+        if (!stalled) {
+            struct epoll_event ev = { .events = EPOLLIN, .data.u32 = i };
+            epoll_ctl(ep, EPOLL_CTL_ADD, fds[i], &ev);
+            for (int k = 0; k < BP_WINDOW; k++) {
+                bc->pings_sent += bp_ping(fds[i], (uint32_t)k);
+            }
+        }
+        bc->connected++;
+    }
+    /* a stalled client's PINGs stop going out once the server stops reading it; a PING
+       half sent (EAGAIN inside a frame) would break the stream, so they go whole or not */
+    uint32_t corr = 0;
+    double next_stalled = now_sec();
+    while (!bc->stop) {
+        struct epoll_event evs[64];
+        int m = epoll_wait(ep, evs, 64, 1);
+        for (int k = 0; k < m; k++) {
+            int i = (int)evs[k].data.u32;
+            int r = recv(fds[i], rx[i] + rx_len[i], sizeof(rx[i]) - rx_len[i], 0);
+            if (r <= 0) {
+                continue;
+            }
+            bc->bytes[i] += r;
+            rx_len[i] += r;
+            size_t used = 0;
+            while (used < rx_len[i]) {
+                proto_frame_t f;
+                int c = proto_parse(rx[i] + used, rx_len[i] - used, &f);
+                if (c <= 0) {
+                    break;
+                }
+                bp_rx_t ctx = { bc, i };
+                bp_frame(&f, &ctx);
+                if (ctx.i < 0) {
+                    bc->pings_sent += bp_ping(fds[i], corr++);
+                }
+                used += (size_t)c;
+            }
+            memmove(rx[i], rx[i] + used, rx_len[i] - used);
+            rx_len[i] -= used;
+        }
+        if (now_sec() >= next_stalled) {
+            next_stalled += 0.001;
+            for (int i = bc->healthy; i < bc->connected; i++) {
+                int pending = 0;
+                ioctl(fds[i], TIOCOUTQ, &pending);
+                if (pending < 4096) {
+                    bc->pings_sent += bp_ping(fds[i], corr++);
+                }
+            }
+        }
+    }
+    for (int i = 0; i < bc->connected; i++) {
+        close(fds[i]);
+    }
+    close(ep);
+    return NULL;
+}
+
+typedef struct {
+    uint64_t pings;
+    int conns;
+    net_conn_t *list[BP_MAX];
+} bp_server_t;
+
+static void bp_open(net_server_t *srv, net_conn_t *conn)
+{
+    bp_server_t *bs = srv->handlers.ctx;
+    /* small socket buffers, so a client that stops reading backs up into the server soon */
+    int snd = 16384;
+    setsockopt(conn->fd, SOL_SOCKET, SO_SNDBUF, &snd, sizeof(snd));
+    if (bs->conns < BP_MAX) {
+        bs->list[bs->conns++] = conn;
+    }
+}
+
+static void bp_request(const proto_frame_t *f, void *arg)
+{
+    net_server_t *srv = ((void **)arg)[0];
+    net_conn_t *conn = ((void **)arg)[1];
+    bp_server_t *bs = srv->handlers.ctx;
+    bs->pings++;
+    uint8_t ack[PROTO_HEADER_SIZE + PROTO_CORR_SIZE + PROTO_ACK_SIZE];
+    net_server_send(srv, conn, ack, proto_encode_ack(ack, sizeof(ack), f->corr, f->type, PROTO_ACK_OK));
+}
+
+static size_t bp_data(net_server_t *srv, net_conn_t *conn, const uint8_t *data, size_t len)
+{
+    void *ctx[2] = { srv, conn };
+    int used = proto_consume(data, len, bp_request, ctx);
+    return used < 0 ? len : (size_t)used;
+}
+
+static long rss_kb(void)
+{
+    long pages = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static int bench_backpressure(int argc, char **argv)
+{
+    double seconds = argc > 0 ? atof(argv[0]) : 10;
+    int healthy = argc > 1 ? atoi(argv[1]) : 16;
+    int stalled = argc > 2 ? atoi(argv[2]) : 16;
+    uint16_t port = argc > 3 ? (uint16_t)atoi(argv[3]) : 3412;
+    if (seconds <= 0 || healthy < 1 || stalled < 0 || healthy + stalled >= BP_MAX) {
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    static net_server_t srv;
+    static bp_server_t bs;
+    static net_buf_pool_t pool;
+    static proto_sample_t smp[FAN_SAMPLES];
+    const net_handlers_t handlers = { bp_open, bp_data, NULL, &bs, NULL };
+    for (int i = 0; i < FAN_SAMPLES; i++) {
+        smp[i].input = 85.0f + 0.01f * i;
+        smp[i].output = 40.0f;
+        smp[i].setpoint = 85.0f;
+    }
+    if (net_server_init(&srv, port, &handlers) != 0) {
+        return 1;
+    }
+    net_buf_pool_init(&pool);
+    static bp_client_t bc;
+    bc.port = port;
+    bc.healthy = healthy;
+    bc.stalled = stalled;
+    pthread_t th;
+    pthread_create(&th, NULL, bp_client, &bc);
+    while (bs.conns < healthy + stalled) {
+        net_server_poll(&srv, 10);
+    }
+
+    printf("backpressure: %d healthy and %d stalled clients, a %d byte telemetry batch per ms to each\n",
+           healthy, stalled, PROTO_HEADER_SIZE + PROTO_TELEMETRY_HDR + FAN_SAMPLES * PROTO_SAMPLE_SIZE);
+    printf("  budgets: %d bytes of telemetry per connection, watermarks %d/%d, %d bytes in all\n",
+           NET_CONN_TX_BUDGET, NET_CONN_TX_HIGH, NET_CONN_TX_LOW, NET_SERVER_TX_BUDGET);
+    printf("  %6s %12s %14s %10s %10s %10s %10s %10s\n", "t s", "queued kB", "stalled kB", "throttled",
+           "dropped", "pool free", "rss kB", "MB/s");
+    int64_t start = net_time_us(), end = start + (int64_t)(seconds * 1e6), next = start;
+    int64_t report = start + 500000;
+    uint64_t published = 0, healthy_bytes0 = 0;
+    while (net_time_us() < end) {
+        int64_t now = net_time_us();
+        while (now >= next) {
+            net_buf_t *buf = net_buf_get(&pool);
+            if (buf) {
+                buf->len = proto_encode_telemetry(buf->data, NET_BUF_SIZE, 0, 1, (uint32_t)(now / 1000), smp,
+                                                  FAN_SAMPLES);
+                for (int i = 0; i < bs.conns; i++) {
+                    net_server_send_buf(&srv, bs.list[i], buf, NET_TX_TELEMETRY);
+                }
+                published += buf->len;
+                net_buf_release(buf);
+            }
+            next += 1000;
+        }
+        if (now >= report) {
+            size_t stalled_pending = 0;
+            int throttled = 0;
+            for (int i = 0; i < bs.conns; i++) {
+                throttled += bs.list[i]->throttled;
+                if (i >= healthy) {
+                    stalled_pending += net_conn_pending(bs.list[i]);
+                }
+            }
+            uint64_t hb = 0;
+            for (int i = 0; i < healthy; i++) {
+                hb += bc.bytes[i];
+            }
+            printf("  %6.1f %12.1f %14.1f %10d %10u %10u %10ld %10.2f\n", (now - start) / 1e6,
+                   srv.stats.tx_mem / 1024.0, stalled_pending / 1024.0, throttled, (unsigned)srv.stats.tx_dropped,
+                   (unsigned)(pool.nfree + srv.rx_pool.nfree), rss_kb(), (hb - healthy_bytes0) / 0.5 / healthy / 1e6);
+            healthy_bytes0 = hb;
+            report += 500000;
+        }
+        int64_t wait = next - net_time_us();
+        net_server_poll(&srv, wait >= 1000 ? (int)(wait / 1000) : 0);
+    }
+    double secs = (net_time_us() - start) / 1e6;
+    uint64_t hb = 0, hmin = UINT64_MAX;
+    uint32_t hdrop = 0;
+    for (int i = 0; i < healthy; i++) {
+        hb += bc.bytes[i];
+        hmin = bc.bytes[i] < hmin ? bc.bytes[i] : hmin;
+        hdrop += bs.list[i]->tx_dropped;
+    }
+    bc.stop = true;
+    pthread_join(th, NULL);
+    printf("  healthy: %.2f MB/s each (slowest %.2f) of %.2f MB/s published, %u telemetry frames dropped\n",
+           hb / secs / healthy / 1e6, hmin / secs / 1e6, published / secs / 1e6, (unsigned)hdrop);
+    printf("  PINGs: %llu sent, %llu read by the server, %llu answers received; %u answers refused, "
+           "%u connections closed for not reading\n", (unsigned long long)bc.pings_sent,
+           (unsigned long long)bs.pings, (unsigned long long)bc.answers, (unsigned)srv.stats.tx_overflows,
+           (unsigned)srv.stats.tx_stalled);
+    printf("  send queues held at most %.1f kB\n", srv.stats.tx_mem_max / 1024.0);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int rcv = 4096;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcv, sizeof(rcv));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    int conns = bs.conns;
+    uint32_t closed = srv.stats.tx_stalled;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        return 1;
+    }
+    while (bs.conns == conns) {
+        net_server_poll(&srv, 10);
+    }
+    net_conn_t *sc = bs.list[bs.conns - 1];
+    static telemetry_stream_t ts;
+    telemetry_stream_init(&ts, 0, 1, 10000, TELEMETRY_MSS);
+    end = net_time_us() + 1000000;
+    while (net_time_us() < end && sc->state == NET_CONN_OPEN) {
+        int64_t now = net_time_us();
+        for (int i = 0; i < 100; i++) {
+            telemetry_stream_add(&ts, &srv, sc, &smp[i], (uint32_t)(now / 1000), now);
+        }
+        net_server_poll(&srv, 1);
+    }
+    bool ok = sc->state == NET_CONN_OPEN && srv.stats.tx_stalled == closed && sc->tx_dropped > 0 &&
+              ts.frames_dropped > 0;
+    printf("  stalled telemetry_stream: %u frames sent, %u dropped (%u samples refused), connection %s%s\n",
+           (unsigned)ts.frames, (unsigned)ts.frames_dropped, (unsigned)ts.dropped,
+           sc->state == NET_CONN_OPEN ? "open" : "closed", ok ? "" : "   (expected drops, not a close)");
+    close(fd);
+    net_server_deinit(&srv);
+    return ok ? 0 : 1;
+}
+
+/* async ---------------------------------------------------------------------------------
+   the same heartbeat protocol run two ways, each in a child process of its own so that
+   one doesn't count in the memory of the other: a thread per session with blocking
+   sockets, as the tcp_client / tcp_server tasks do, with the smallest stack glibc allows;
+   and net_async sessions, all in one thread.  Every client connects, then sends a PING
+   and waits for its ACK once per heartbeat; a server session per connection answers.
+   Memory per session is the growth of the resident set over all of them, client and
+   server sessions each counted as one. */
+
+#define AS_MAX          2048
+#define AS_HEARTBEAT_MS 100
+#define AS_PING_LEN     (PROTO_HEADER_SIZE + PROTO_CORR_SIZE)
+#define AS_ACK_LEN      (PROTO_HEADER_SIZE + PROTO_CORR_SIZE + PROTO_ACK_SIZE)
+
+typedef struct {
+    net_task_t task;
+    uint32_t corr;
+    uint16_t have;
+    uint8_t buf[AS_ACK_LEN];
+} as_client_t;
+
+typedef struct {
+    net_task_t task;
+    uint16_t have, out;
+    uint8_t rx[4 * AS_PING_LEN];
+    uint8_t tx[4 * AS_ACK_LEN];
+} as_server_t;
+
+static struct {
+    struct sockaddr_in addr;
+    int sessions;
+    volatile bool stop;
+    uint32_t connected, accepted, failed;
+    uint64_t exchanges;
+} as;
+
+static as_client_t as_clients[AS_MAX];
+static as_server_t as_servers[AS_MAX];
+static net_task_t as_listener;
+
+static size_t as_ping(uint8_t *buf, uint32_t corr)
+{
+    size_t n = proto_encode_ping(buf, AS_PING_LEN);
+    return proto_set_corr(buf, AS_PING_LEN, n, corr);
+}
+
+static void as_ack(const proto_frame_t *f, void *arg)
+{
+    as_server_t *s = arg;
+    if ((f->flags & PROTO_F_CORR) && s->out + AS_ACK_LEN <= (int)sizeof(s->tx)) {
+        s->out += proto_encode_ack(s->tx + s->out, AS_ACK_LEN, f->corr, f->type, PROTO_ACK_OK);
+    }
+}
+
+static int as_listen_socket(void)
+{
+    int ls = socket(AF_INET, SOCK_STREAM, 0), one = 1;
+    setsockopt(ls, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(ls, (struct sockaddr *)&as.addr, sizeof(as.addr)) != 0 || listen(ls, 1024) != 0) {
+        perror("listen");
+        close(ls);
+        return -1;
+    }
+    return ls;
+}
+
+static int as_serve(net_async_t *a, net_task_t *t)
+{
+    as_server_t *s = (as_server_t *)t;
+    NET_PT_BEGIN(t);
+    while (1) {
+        NET_PT_RECV(a, t, s->rx + s->have, sizeof(s->rx) - s->have, 0);
+        if (t->result <= 0) {
+            break;
+        }
+        s->have += t->result;
+        int used = proto_consume(s->rx, s->have, as_ack, s);
+        if (used < 0) {
+            break;
+        }
+        s->have -= used;
+        memmove(s->rx, s->rx + used, s->have);
+        if (s->out > 0) {
+            NET_PT_SEND(a, t, s->tx, s->out, 1000);
+            s->out = 0;
+            if (t->result < 0) {
+                break;
+            }
+        }
+    }
+    NET_PT_END(a, t);
+}
+
+static int as_listen(net_async_t *a, net_task_t *t)
+{
+    NET_PT_BEGIN(t);
+    while (!as.stop) {
+        NET_PT_ACCEPT(a, t, 0);
+        if (t->result < 0) {
+            break;
+        }
+        if (as.accepted == AS_MAX) {
+            close(t->result);
+            continue;
+        }
+        as_server_t *s = &as_servers[as.accepted++];
+        net_async_start(a, &s->task, as_serve);
+        net_async_attach(a, &s->task, t->result);
+    }
+    NET_PT_END(a, t);
+}
+
+static int as_client(net_async_t *a, net_task_t *t)
+{
+    as_client_t *c = (as_client_t *)t;
+    NET_PT_BEGIN(t);
+    NET_PT_SLEEP(a, t, (int)(rng_u32() % AS_HEARTBEAT_MS));     /* spread the heartbeats */
+    NET_PT_CONNECT(a, t, &as.addr, 5000);
+    if (t->result < 0) {
+        as.failed++;
+        NET_PT_EXIT(a, t);
+    }
+    as.connected++;
+    while (!as.stop) {
+        as_ping(c->buf, ++c->corr);
+        NET_PT_SEND(a, t, c->buf, AS_PING_LEN, 1000);
+        for (c->have = 0; c->have < AS_ACK_LEN; c->have += t->result) {
+            NET_PT_RECV(a, t, c->buf + c->have, AS_ACK_LEN - c->have, 2000);
+            if (t->result <= 0) {
+                break;
+            }
+        }
+        if (c->have < AS_ACK_LEN) {
+            as.failed++;
+            break;
+        }
+        as.exchanges++;
+        NET_PT_SLEEP(a, t, AS_HEARTBEAT_MS);
+    }
+    NET_PT_END(a, t);
+}
+
+static void *as_thread_serve(void *arg)
+{
+    int fd = (int)(intptr_t)arg;
+    as_server_t s = { 0 };
+    while (1) {
+        ssize_t n = recv(fd, s.rx + s.have, sizeof(s.rx) - s.have, 0);
+        if (n <= 0) {
+            break;
+        }
+        s.have += n;
+        int used = proto_consume(s.rx, s.have, as_ack, &s);
+        if (used < 0) {
+            break;
+        }
+        s.have -= used;
+        memmove(s.rx, s.rx + used, s.have);
+        if (s.out > 0 && send(fd, s.tx, s.out, MSG_NOSIGNAL) != s.out) {
+            break;
+        }
+        s.out = 0;
+    }
+    close(fd);
+    return NULL;
+}
+
+static void *as_thread_listen(void *arg)
+{
+    int ls = (int)(intptr_t)arg;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, PTHREAD_STACK_MIN);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    while (!as.stop) {
+        int fd = accept(ls, NULL, NULL), one = 1;
+        if (fd < 0) {
+            continue;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        pthread_t th;
+        if (pthread_create(&th, &attr, as_thread_serve, (void *)(intptr_t)fd) != 0) {
+            close(fd);
+            continue;
+        }
+        __atomic_fetch_add(&as.accepted, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static void *as_thread_client(void *arg)
+{
+    uint8_t buf[AS_ACK_LEN];
+    uint32_t corr = 0;
+    usleep((useconds_t)((uintptr_t)arg % AS_HEARTBEAT_MS) * 1000);
+    int fd = socket(AF_INET, SOCK_STREAM, 0), one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (struct sockaddr *)&as.addr, sizeof(as.addr)) != 0) {
+        __atomic_fetch_add(&as.failed, 1, __ATOMIC_RELAXED);
+        close(fd);
+        return NULL;
+    }
+    __atomic_fetch_add(&as.connected, 1, __ATOMIC_RELAXED);
+    while (!as.stop) {
+        as_ping(buf, ++corr);
+        if (send(fd, buf, AS_PING_LEN, MSG_NOSIGNAL) != AS_PING_LEN) {
+            break;
+        }
+        size_t have = 0;
+        while (have < AS_ACK_LEN) {
+            ssize_t n = recv(fd, buf + have, AS_ACK_LEN - have, 0);
+            if (n <= 0) {
+                break;
+            }
+            have += n;
+        }
+        if (have < AS_ACK_LEN) {
+            __atomic_fetch_add(&as.failed, 1, __ATOMIC_RELAXED);
+            break;
+        }
+        __atomic_fetch_add(&as.exchanges, 1, __ATOMIC_RELAXED);
+        usleep(AS_HEARTBEAT_MS * 1000);
+    }
+    close(fd);
+    return NULL;
+}
+
+static double process_cpu_sec(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+/* one mode, in the calling (child) process */
+static int as_run(bool threads, double seconds)
+{
+    static net_async_t loop;
+    int ls = as_listen_socket();
+    if (ls < 0 || (!threads && net_async_init(&loop) != 0)) {
+        return 1;
+    }
+    long rss0 = rss_kb();
+    int64_t start = net_time_us();
+    if (threads) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, PTHREAD_STACK_MIN);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        pthread_t th;
+        pthread_create(&th, &attr, as_thread_listen, (void *)(intptr_t)ls);
+        for (int i = 0; i < as.sessions; i++) {
+            if (pthread_create(&th, &attr, as_thread_client, (void *)(uintptr_t)rng_u32()) != 0) {
+                perror("pthread_create");
+                return 1;
+            }
+        }
+    } else {
+        net_async_start(&loop, &as_listener, as_listen);
+        net_async_attach(&loop, &as_listener, ls);
+        for (int i = 0; i < as.sessions; i++) {
+            net_async_start(&loop, &as_clients[i].task, as_client);
+        }
+    }
+
+    /* all connected, then the measured window */
+    int64_t limit = start + 10000000, end = 0;
+    uint64_t ex0 = 0;
+    double cpu0 = 0;
+    while (end == 0 || net_time_us() < end) {
+        if (end == 0 && ((__atomic_load_n(&as.accepted, __ATOMIC_RELAXED) >= (uint32_t)as.sessions &&
+                          __atomic_load_n(&as.connected, __ATOMIC_RELAXED) >= (uint32_t)as.sessions) ||
+                         net_time_us() > limit)) {
+            end = net_time_us() + (int64_t)(seconds * 1e6);
+            ex0 = __atomic_load_n(&as.exchanges, __ATOMIC_RELAXED);
+            cpu0 = process_cpu_sec();
+        }
+        if (threads) {
+            net_sleep_ms(10);
+        } else {
+            net_async_run(&loop, 10);
+        }
+    }
+    double secs = seconds, cpu = process_cpu_sec() - cpu0;
+    uint64_t ex = __atomic_load_n(&as.exchanges, __ATOMIC_RELAXED) - ex0;
+    long rss = rss_kb();
+    int n = 2 * as.sessions;
+    printf("  %-22s %6u/%-6u %10.0f %10.0f %8.1f %10ld %12.0f %6u\n",
+           threads ? "thread per session" : "net_async, one thread", (unsigned)as.connected,
+           (unsigned)as.accepted, ex / secs, as.sessions * 1000.0 / AS_HEARTBEAT_MS, 100 * cpu / secs,
+           rss - rss0, (rss - rss0) * 1024.0 / n, (unsigned)as.failed);
+    if (!threads) {
+        printf("  net_async state: client session %zu B, server session %zu B (buffers included), "
+               "scheduler %zu B = %zu B per session\n", sizeof(as_client_t), sizeof(as_server_t),
+               sizeof(net_async_t), sizeof(net_async_t) / n);
+    } else {
+        printf("  thread stacks: %zu B reserved each (PTHREAD_STACK_MIN), resident only as touched\n",
+               (size_t)PTHREAD_STACK_MIN);
+    }
+    fflush(stdout);
+    return 0;
+}
+
+static int bench_async(int argc, char **argv)
+{
+    int sessions = argc > 0 ? atoi(argv[0]) : 1000;
+    double seconds = argc > 1 ? atof(argv[1]) : 5;
+    uint16_t port = argc > 2 ? (uint16_t)atoi(argv[2]) : 3413;
+    if (sessions < 1 || sessions > AS_MAX || seconds <= 0) {
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    /* a socket per client and one per server session */
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+    if (rl.rlim_cur < (rlim_t)(2 * sessions + 16)) {
+        printf("async: %d sessions need %d file descriptors, the limit is %lu\n", sessions, 2 * sessions + 16,
+               (unsigned long)rl.rlim_cur);
+        return 1;
+    }
+
+    printf("async: %d clients and %d server sessions on loopback, a PING / ACK every %d ms each, %.0f s\n",
+           sessions, sessions, AS_HEARTBEAT_MS, seconds);
+    printf("  %-22s %13s %10s %10s %8s %10s %12s %6s\n", "", "conn/accept", "ex/s", "expected", "cpu %",
+           "rss kB", "B/session", "failed");
+    fflush(stdout);
+    for (int threads = 1; threads >= 0; threads--) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            as.addr.sin_family = AF_INET;
+            as.addr.sin_port = htons((uint16_t)(port + threads));
+            as.addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            as.sessions = sessions;
+            _exit(as_run(threads, seconds));
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && !strcmp(argv[1], "framing")) {
+        return bench_framing(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "stream")) {
+        return bench_stream(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "pipeline")) {
+        return bench_pipeline(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "reconnect")) {
+        return bench_reconnect(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "rxpool")) {
+        return bench_rxpool(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "fanout")) {
+        return bench_fanout(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "codec")) {
+        return bench_codec(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "udp")) {
+        return bench_udp(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "upload")) {
+        return bench_upload(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "clock")) {
+        return bench_clock(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "cmd")) {
+        return bench_cmd(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "ws")) {
+        return bench_ws(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "backpressure")) {
+        return bench_backpressure(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "async")) {
+        return bench_async(argc - 2, argv + 2);
+    }
+    printf("usage: %s framing [messages]\n"
+           "       %s stream [samples_per_s] [seconds] [port]\n"
+           "       %s pipeline [seconds] [port]\n"
+           "       %s reconnect [cycles] [heartbeat_ms] [port]\n"
+           "       %s rxpool [messages] [port]\n"
+           "       %s fanout [batches_per_s] [seconds] [port]\n"
+           "       %s codec [samples] [samples_per_frame] [keyframe_interval]\n"
+           "       %s udp [seconds] [delay_ms] [rto_ms] [port]\n"
+           "       %s upload [max_mb] [dir] [port]\n"
+           "       %s clock [hours] [poll_s] [drift_ppm] [asym_us]\n"
+           "       %s cmd [mb] [segment]\n"
+           "       %s ws [mb]\n"
+           "       %s backpressure [seconds] [healthy] [stalled] [port]\n"
+           "       %s async [sessions] [seconds] [port]\n",
+           argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0],
+           argv[0], argv[0], argv[0]);
+    return 2;
+}
@@ -0,0 +1,732 @@
+/* Linux build of the dip-coater tcp_server
+
+   Runs the tecsci_net event loop against POSIX sockets so the server logic can be loaded
+   and measured on a PC.  In echo mode it echoes what it receives, like the ESP-IDF
+   tcp_server example; in tecsci mode it parses tecsci_proto frames and answers every
+   request that carries a correlation id with PROTO_MSG_ACK, which is what host/loadgen
+   -P tecsci expects.  In text mode it takes the newline terminated commands of the first
+   projects (SP, GAINS, LIMITS, MODE, PING) through net_cmd and answers each line with
+   OK, BUSY or ERR.  Answers are never dropped while a slab is left for them: a client that
+   doesn't read them gets its answers queued and, past the high watermark, is no longer
+   read from (net_server.h).  Only an answer with no slab left is dropped and counted in
+   tx_overflows; loadgen reports it as lost.
+
+   Next to the network task a control task runs LOOPS PID loops (PID_ESP32) every
+   LOOP_PERIOD_MS against a simulated first order plant, the way the dip coater firmware
+   does.  Setpoints, gains (with direction and sample time), limits and modes from the
+   network reach it through PID_Mailbox; GAINS and LIMITS flagged PROTO_F_STAGED are
+   collected into a PID_Tuning transaction instead and reach all loops at the same tick on
+   PROTO_MSG_COMMIT.  A request is answered OK only once it has been handed over; one the
+   loops can't take (unknown loop, min >= max, a value that is nan or inf, a mode other
+   than MANUAL / AUTOMATIC) is answered BAD_REQUEST or BAD_LOOP; GAINS goes over as one
+   mailbox message, so no tick runs with half of it.  PROTO_MSG_SUBSCRIBE subscribes the
+   connection to telemetry of the loops in its mask, batches of TELEMETRY_BATCH samples
+   per loop published through net_pubsub.  PROTO_MSG_TIME requests are answered from
+   net_time_us(), which makes this server the clock reference of its clients
+   (net_clock.h).  Both tasks record into their own net_metrics shard, and GET /metrics on
+   the server port returns everything in Prometheus text format:
+
+       curl -s localhost:3333/metrics
+
+   GET /ws upgrades the connection to a WebSocket that streams every loop's samples to a
+   dashboard at about 30 Hz (net_ws.h); the control task hands the samples over through a
+   single producer ring, so it never waits for the network task.  host/ws_client measures
+   it.
+
+   With a workers argument above 1 the network task is replicated for a Linux gateway
+   that serves many coaters: every worker thread, pinned to a core, has its own
+   net_server with its own epoll instance and SO_REUSEPORT listener on the port, so the
+   kernel spreads new connections over them and a connection lives on one worker for
+   good.  Its WebSocket hub, subscribers, sample ring, text parsers and metrics shard are the
+   worker's own too, and so are its PID mailboxes: one per loop and worker, all feeding
+   the same PID, so a worker never finds another one's post in progress.  The control
+   task takes them in worker order every tick, and posts are stamped, so the latest one
+   wins whichever worker took it (PID_Mailbox.h).  The workers share only the tuning
+   transaction and a lock around the rare GET /metrics.  Measure with several loadgen
+   processes, e.g. for 4:
+
+       ./tcp_server_linux 3333 tecsci 4 &
+       for i in 1 2 3 4; do ./loadgen -P tecsci -c 64 -w 16 -d 10 -o scale.csv & done; wait
+       for i in 1 2 3 4; do ./loadgen -P tecsci -c 64 -k 1 -d 10 -o scale.csv & done; wait
+
+   build: gcc -O2 -I../components/tecsci_net -I../../PID_ESP32 -o tcp_server_linux \
+              tcp_server_linux.c ../components/tecsci_net/net_server.c \
+              ../components/tecsci_net/net_buf.c ../components/tecsci_net/tecsci_proto.c \
+              ../components/tecsci_net/net_metrics.c ../components/tecsci_net/net_clock.c \
+              ../components/tecsci_net/net_cmd.c ../components/tecsci_net/net_ws.c \
+              ../components/tecsci_net/net_pubsub.c \
+              ../../PID_ESP32/PID.c ../../PID_ESP32/PID_Mailbox.c ../../PID_ESP32/PID_Tuning.c \
+              -lm -lpthread
+   usage: tcp_server_linux [port] [echo|tecsci|text] [workers]
+*/
+#define _GNU_SOURCE /* pthread_setaffinity_np */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "net_server.h"
+#include "net_metrics.h"
+#include "net_clock.h"
+#include "net_cmd.h"
+#include "net_ws.h"
+#include "net_pubsub.h"
+#include "tecsci_proto.h"
+#include "PID.h"
+#include "PID_Mailbox.h"
+#include "PID_Tuning.h"
+
+#define PORT 3333
+#define LOOPS 4
+#define LOOP_PERIOD_MS 10
+#define MAX_WORKERS 16
+#define TELEMETRY_BATCH 10      /* samples per published telemetry frame, 100 ms */
+
+static const char *TAG = "tcp_server_linux";
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+/* PID_ESP32 takes its clock from the program */
+unsigned long millis()
+{
+    return (unsigned long)(net_time_us() / 1000);
+}
+
+static net_metrics_t metrics;
+static net_lock_t scrape_lock = NET_LOCK_INIT;
+
+static const uint32_t compute_ns_bounds[] = { 100, 250, 500, 1000, 2500, 5000, 10000, 25000 };
+static const uint32_t jitter_us_bounds[] = { 10, 50, 100, 250, 500, 1000, 2500, 5000, 10000 };
+
+static int m_jitter, m_overruns, m_commands, m_busy, m_commits;
+static int m_compute[LOOPS], m_saturated[LOOPS];
+static char loop_names[LOOPS][2][64];
+
+static PID_t pid[LOOPS];
+static Tuning_t tuning;
+static net_conn_t *tuning_owner;        /* connection with the open transaction, atomic */
+static double input[LOOPS], output[LOOPS], setpoint[LOOPS];
+
+/* samples from the control task to a network task; full means dropped */
+#define SAMPLE_RING 1024
+
+typedef struct {
+    uint32_t t_ms;
+    uint8_t loop;
+    proto_sample_t s;
+} ring_sample_t;
+
+/* a network task: everything its connections touch on the hot path is its own */
+typedef struct {
+    net_server_t server;
+    net_ws_t ws;
+    net_pubsub_t pubsub;
+    Mailbox_t mailbox[LOOPS];           /* worker 0's are the leads (PID_Mailbox.h) */
+    proto_sample_t batch[LOOPS][TELEMETRY_BATCH];   /* for the subscribers */
+    uint32_t batch_t0[LOOPS];
+    int batch_count[LOOPS];
+    net_metrics_shard_t *shard;
+    pthread_t thread;
+    ring_sample_t ring[SAMPLE_RING];
+    uint32_t ring_head, ring_tail, ring_dropped;
+    net_cmd_parser_t text_parsers[NET_SERVER_MAX_CONN];
+} worker_t;
+
+static worker_t *workers;
+static int nworkers = 1;
+
+static void register_metrics(void)
+{
+    net_metrics_init(&metrics);
+    for (int i = 0; i < nworkers; i++) {
+        net_metrics_add_server(&metrics, &workers[i].server);
+    }
+    m_commands = net_metrics_counter(&metrics, "tecsci_commands_total", "Requests answered with an ACK");
+    m_busy = net_metrics_counter(&metrics, "tecsci_commands_busy_total",
+                                 "Requests refused because another post or tuning transaction was in progress");
+    m_commits = net_metrics_counter(&metrics, "pid_tuning_commits_total",
+                                    "Staged tuning transactions committed");
+    m_jitter = net_metrics_histogram(&metrics, "pid_loop_jitter_seconds",
+                                     "Delay between the control tick deadline and the wake-up",
+                                     jitter_us_bounds, sizeof(jitter_us_bounds) / sizeof(jitter_us_bounds[0]),
+                                     1e-6);
+    m_overruns = net_metrics_counter(&metrics, "pid_loop_overruns_total",
+                                     "Control ticks that woke up after the next one was due");
+    for (int i = 0; i < LOOPS; i++) {
+        snprintf(loop_names[i][0], sizeof(loop_names[i][0]), "pid_compute_seconds{loop=\"%d\"}", i);
+        m_compute[i] = net_metrics_histogram(&metrics, loop_names[i][0],
+                                             "Time spent in Mailbox_Service and PID_Compute per tick",
+                                             compute_ns_bounds,
+                                             sizeof(compute_ns_bounds) / sizeof(compute_ns_bounds[0]), 1e-9);
+    }
+    for (int i = 0; i < LOOPS; i++) {
+        snprintf(loop_names[i][1], sizeof(loop_names[i][1]), "pid_output_saturated_total{loop=\"%d\"}", i);
+        m_saturated[i] = net_metrics_counter(&metrics, loop_names[i][1],
+                                             "Ticks with the PID output at one of its limits");
+    }
+}
+
+/* control task -------------------------------------------------------------------------- */
+
+/* into every worker's ring, so each streams to its own WebSocket clients */
+static void push_sample(uint8_t loop, uint32_t t_ms)
+{
+    for (int i = 0; i < nworkers; i++) {
+        worker_t *w = &workers[i];
+        uint32_t head = w->ring_head;
+        if (head - __atomic_load_n(&w->ring_tail, __ATOMIC_ACQUIRE) == SAMPLE_RING) {
+            w->ring_dropped++;
+            continue;
+        }
+        ring_sample_t *r = &w->ring[head % SAMPLE_RING];
+        r->t_ms = t_ms;
+        r->loop = loop;
+        r->s.input = (float)input[loop];
+        r->s.output = (float)output[loop];
+        r->s.setpoint = (float)setpoint[loop];
+        __atomic_store_n(&w->ring_head, head + 1, __ATOMIC_RELEASE);
+    }
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void *control_task(void *arg)
+{
+    (void)arg;
+    net_metrics_shard_t *sh = net_metrics_shard(&metrics);
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (!stop) {
+        next.tv_nsec += LOOP_PERIOD_MS * 1000000L;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        int64_t late = now_ns() - ((int64_t)next.tv_sec * 1000000000 + next.tv_nsec);
+        net_metric_observe(sh, m_jitter, late > 0 ? (uint32_t)(late / 1000) : 0);
+        if (late > LOOP_PERIOD_MS * 1000000L) {
+            net_metric_add(sh, m_overruns, 1);
+        }
+
+        Tuning_Service(&tuning);
+        uint32_t t_ms = (uint32_t)millis();
+        for (int i = 0; i < LOOPS; i++) {
+            int64_t t0 = now_ns();
+            /* worker 0's mailbox last, it runs the setpoint ramp */
+            for (int w = nworkers - 1; w >= 0; w--) {
+                Mailbox_Service(&workers[w].mailbox[i]);
+            }
+            PID_Compute(&pid[i]);
+            net_metric_observe(sh, m_compute[i], (uint32_t)(now_ns() - t0));
+            if (output[i] <= pid[i].outMin || output[i] >= pid[i].outMax) {
+                net_metric_add(sh, m_saturated[i], 1);
+            }
+            /* first order plant, gain 0.5, time constant 1 s */
+            input[i] += (0.5 * output[i] - input[i]) * (LOOP_PERIOD_MS / 1000.0);
+            push_sample((uint8_t)i, t_ms);
+        }
+    }
+    return NULL;
+}
+
+static void start_control(pthread_t *th)
+{
+    PID_t *pids[LOOPS];
+
+    for (int i = 0; i < LOOPS; i++) {
+        setpoint[i] = 50;
+        PID_constructor(&pid[i], &input[i], &output[i], &setpoint[i], 2, 0.5, 0, P_ON_E, DIRECT);
+        PID_SetSampleTime(&pid[i], LOOP_PERIOD_MS);
+        PID_SetMode(&pid[i], AUTOMATIC);
+        Mailbox_constructor(&workers[0].mailbox[i], &pid[i]);
+        for (int w = 1; w < nworkers; w++) {
+            Mailbox_constructorShared(&workers[w].mailbox[i], &workers[0].mailbox[i]);
+        }
+        pids[i] = &pid[i];
+    }
+    Tuning_constructor(&tuning, pids, LOOPS);
+    pthread_create(th, NULL, control_task, NULL);
+}
+
+/* network task -------------------------------------------------------------------------- */
+
+static void drain_samples(worker_t *w)
+{
+    uint32_t tail = w->ring_tail, head = __atomic_load_n(&w->ring_head, __ATOMIC_ACQUIRE);
+    for (; tail != head; tail++) {
+        const ring_sample_t *r = &w->ring[tail % SAMPLE_RING];
+        net_ws_add_sample(&w->ws, r->loop, &r->s, r->t_ms);
+        if (w->pubsub.nsubs == 0) {
+            continue;
+        }
+        int *count = &w->batch_count[r->loop];
+        if (*count == 0) {
+            w->batch_t0[r->loop] = r->t_ms;
+        }
+        w->batch[r->loop][(*count)++] = r->s;
+        if (*count == TELEMETRY_BATCH) {
+            net_pubsub_publish_telemetry(&w->pubsub, r->loop, LOOP_PERIOD_MS, w->batch_t0[r->loop],
+                                         w->batch[r->loop], *count);
+            *count = 0;
+        }
+    }
+    __atomic_store_n(&w->ring_tail, tail, __ATOMIC_RELEASE);
+}
+
+/* requests every mode answers: the WebSocket stream and GET /metrics */
+static bool web_data(net_server_t *srv, net_conn_t *conn, const uint8_t *data, size_t len, size_t *used)
+{
+    worker_t *w = srv->handlers.ctx;
+    if (net_ws_client(&w->ws, conn)) {
+        *used = net_ws_data(&w->ws, conn, data, len);
+    } else if (net_ws_is_upgrade(data, len)) {
+        *used = net_ws_accept(&w->ws, conn, data, len);
+    } else if (net_metrics_is_http(data, len)) {
+        /* rare, and the rendering buffer is shared by the workers */
+        net_lock(&scrape_lock);
+        *used = net_metrics_http(&metrics, srv, conn, data, len);
+        net_unlock(&scrape_lock);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static size_t echo_data(net_server_t *srv, net_conn_t *conn, const uint8_t *data, size_t len)
+{
+    size_t used;
+    if (web_data(srv, conn, data, len, &used)) {
+        return used;
+    }
+    size_t n = len < net_conn_tx_free(conn) ? len : net_conn_tx_free(conn);
+    if (n > 0) {
+        net_server_send(srv, conn, data, n);
+    }
+    return n;
+}
+
+/* staged GAINS / LIMITS: the first one opens the connection's transaction */
+static uint8_t stage_request(worker_t *w, net_conn_t *conn, const proto_frame_t *f)
+{
+    uint8_t loop;
+    float lo, hi;
+    proto_gains_t g;
+    bool ok;
+
+    if (__atomic_load_n(&tuning_owner, __ATOMIC_ACQUIRE) != conn) {
+        /* Tuning_Begin() lets one connection in, of whichever worker */
+        if (!Tuning_Begin(&tuning)) {
+            net_metric_add(w->shard, m_busy, 1);
+            return PROTO_ACK_BUSY;
+        }
+        __atomic_store_n(&tuning_owner, conn, __ATOMIC_RELEASE);
+    }
+    if (f->type == PROTO_MSG_GAINS) {
+        if (!proto_read_gains(f, &g) || !isfinite(g.kp) || !isfinite(g.ki) || !isfinite(g.kd)) {
+            return PROTO_ACK_BAD_REQUEST;
+        }
+        if (g.loop >= LOOPS) {
+            return PROTO_ACK_BAD_LOOP;
+        }
+        ok = Tuning_StageTunings(&tuning, g.loop, g.kp, g.ki, g.kd, g.p_on ? P_ON_E : P_ON_M) &&
+             Tuning_StageDirection(&tuning, g.loop, g.direction) &&
+             (g.sample_ms == 0 || Tuning_StageSampleTime(&tuning, g.loop, (int)g.sample_ms));
+    } else {
+        if (!proto_read_limits(f, &loop, &lo, &hi) || !isfinite(lo) || !isfinite(hi)) {
+            return PROTO_ACK_BAD_REQUEST;
+        }
+        if (loop >= LOOPS) {
+            return PROTO_ACK_BAD_LOOP;
+        }
+        ok = Tuning_StageLimits(&tuning, loop, lo, hi);
+    }
+    return ok ? PROTO_ACK_OK : PROTO_ACK_BAD_REQUEST;
+}
+
+static uint8_t apply_request(worker_t *w, net_conn_t *conn, const proto_frame_t *f)
+{
+    uint8_t loop, mode, type, status, policy, depth;
+    double sp;
+    float lo, hi;
+    uint32_t loops;
+    proto_gains_t g;
+    bool posted;
+
+    if ((f->flags & PROTO_F_STAGED) && (f->type == PROTO_MSG_GAINS || f->type == PROTO_MSG_LIMITS)) {
+        return stage_request(w, conn, f);
+    }
+    switch (f->type) {
+    case PROTO_MSG_SETPOINT:
+        if (!proto_read_setpoint(f, &loop, &sp) || !isfinite(sp)) {
+            return PROTO_ACK_BAD_REQUEST;
+        }
+        if (loop >= LOOPS) {
+            return PROTO_ACK_BAD_LOOP;
+        }
+        posted = Mailbox_PostSetpoint(&w->mailbox[loop], sp);
+        break;
+    case PROTO_MSG_GAINS:
+        if (!proto_read_gains(f, &g)) {
+            return PROTO_ACK_BAD_REQUEST;
+        }
+        if (g.loop >= LOOPS) {
+            return PROTO_ACK_BAD_LOOP;
+        }
+        if ((g.direction != DIRECT && g.direction != REVERSE) ||
+            !isfinite(g.kp) || !isfinite(g.ki) || !isfinite(g.kd)) {
+            return PROTO_ACK_BAD_REQUEST;
+        }
+        posted = Mailbox_PostGains(&w->mailbox[g.loop], g.kp, g.ki, g.kd, g.p_on ? P_ON_E : P_ON_M,
+                                   g.direction, (int)g.sample_ms);
+        break;
+    case PROTO_MSG_LIMITS:
+        if (!proto_read_limits(f, &loop, &lo, &hi) || !isfinite(lo) || !isfinite(hi) || !(lo < hi)) {
+            return PROTO_ACK_BAD_REQUEST;
+        }
+        if (loop >= LOOPS) {
+            return PROTO_ACK_BAD_LOOP;
+        }
+        posted = Mailbox_PostLimits(&w->mailbox[loop], lo, hi);
+        break;
+    case PROTO_MSG_MODE:
+        if (!proto_read_mode(f, &loop, &mode) || (mode != MANUAL && mode != AUTOMATIC)) {
+            return PROTO_ACK_BAD_REQUEST;
+        }
+        if (loop >= LOOPS) {
+            return PROTO_ACK_BAD_LOOP;
+        }
+        posted = Mailbox_PostMode(&w->mailbox[loop], mode);
+        break;
+    case PROTO_MSG_COMMIT:
+    case PROTO_MSG_ABORT:
+        if (__atomic_load_n(&tuning_owner, __ATOMIC_ACQUIRE) != conn) {
+            return PROTO_ACK_BAD_REQUEST;
+        }
+        __atomic_store_n(&tuning_owner, NULL, __ATOMIC_RELEASE);
+        if (f->type == PROTO_MSG_ABORT) {
+            Tuning_Abort(&tuning);
+        } else if (Tuning_Commit(&tuning) != 0) {
+            net_metric_add(w->shard, m_commits, 1);
+        }
+        return PROTO_ACK_OK;
+    case PROTO_MSG_SUBSCRIBE:
+        if (!proto_read_subscribe(f, &loops, &policy, &depth) || policy > NET_SUB_DISCONNECT) {
+            return PROTO_ACK_BAD_REQUEST;
+        }
+        if (loops >> LOOPS) {
+            return PROTO_ACK_BAD_LOOP;
+        }
+        /* no free subscriber slot: may work later */
+        return net_pubsub_subscribe(&w->pubsub, conn, loops, (net_sub_policy_t)policy, depth) == 0
+                   ? PROTO_ACK_OK : PROTO_ACK_BUSY;
+    case PROTO_MSG_PING:
+        return PROTO_ACK_OK;
+    case PROTO_MSG_ACK:
+        return proto_read_ack(f, &type, &status) ? PROTO_ACK_OK : PROTO_ACK_BAD_REQUEST;
+    default:
+        return PROTO_ACK_BAD_REQUEST;
+    }
+    if (!posted) {
+        net_metric_add(w->shard, m_busy, 1);
+        return PROTO_ACK_BUSY;
+    }
+    return PROTO_ACK_OK;
+}
+
+static size_t tecsci_data(net_server_t *srv, net_conn_t *conn, const uint8_t *data, size_t len)
+{
+    size_t used;
+    if (web_data(srv, conn, data, len, &used)) {
+        return used;
+    }
+    worker_t *w = srv->handlers.ctx;
+    int64_t received = net_time_us();
+    used = 0;
+    while (used < len) {
+        proto_frame_t f;
+        int n = proto_parse(data + used, len - used, &f);
+        if (n < 0) {
+            net_server_close(srv, conn);
+            return len;
+        }
+        if (n == 0) {
+            break;
+        }
+        if (f.type == PROTO_MSG_TIME && (f.flags & PROTO_F_CORR)) {
+            uint8_t reply[PROTO_HEADER_SIZE + PROTO_CORR_SIZE + PROTO_TIME_REPLY_SIZE];
+            size_t rlen = net_clock_answer(reply, sizeof(reply), &f, received, net_time_us());
+            if (rlen > 0) {
+                net_server_send(srv, conn, reply, rlen);
+                used += n;
+                continue;
+            }
+        }
+        if (f.flags & PROTO_F_CORR) {
+            uint8_t ack[PROTO_HEADER_SIZE + PROTO_CORR_SIZE + PROTO_ACK_SIZE];
+            size_t alen = proto_encode_ack(ack, sizeof(ack), f.corr, f.type, apply_request(w, conn, &f));
+            net_server_send(srv, conn, ack, alen);
+            net_metric_add(w->shard, m_commands, 1);
+        }
+        used += n;
+    }
+    return used;
+}
+
+/* text commands -------------------------------------------------------------------------- */
+
+typedef struct {
+    net_server_t *srv;
+    net_conn_t *conn;
+    worker_t *w;
+} text_ctx_t;
+
+static net_cmd_table_t text_table;
+
+static int text_reply(const text_ctx_t *ctx, uint8_t status)
+{
+    static const char *answers[] = { "OK\n", "ERR\n", "ERR\n", "BUSY\n" };
+    const char *a = status < sizeof(answers) / sizeof(answers[0]) ? answers[status] : "ERR\n";
+    net_server_send(ctx->srv, ctx->conn, a, strlen(a));
+    net_metric_add(ctx->w->shard, m_commands, 1);
+    return status == PROTO_ACK_OK ? 0 : -1;
+}
+
+/* loop and numbers of a command; false answers ERR.  A nan or inf would stick in the PID
+   (its output and integral never recover), so they are refused here too */
+static bool text_args(const net_cmd_t *cmd, long *loop, double *v, int n)
+{
+    if (!net_cmd_int(&cmd->argv[1], loop) || *loop < 0 || *loop >= LOOPS) {
+        return false;
+    }
+    for (int i = 0; i < n; i++) {
+        if (!net_cmd_double(&cmd->argv[2 + i], &v[i]) || !isfinite(v[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int text_setpoint(const net_cmd_t *cmd, void *arg)
+{
+    long loop;
+    double v[1];
+    if (!text_args(cmd, &loop, v, 1)) {
+        return text_reply(arg, PROTO_ACK_BAD_REQUEST);
+    }
+    if (!Mailbox_PostSetpoint(&((text_ctx_t *)arg)->w->mailbox[loop], v[0])) {
+        net_metric_add(((text_ctx_t *)arg)->w->shard, m_busy, 1);
+        return text_reply(arg, PROTO_ACK_BUSY);
+    }
+    return text_reply(arg, PROTO_ACK_OK);
+}
+
+static int text_gains(const net_cmd_t *cmd, void *arg)
+{
+    long loop;
+    double v[3];
+    if (!text_args(cmd, &loop, v, 3)) {
+        return text_reply(arg, PROTO_ACK_BAD_REQUEST);
+    }
+    if (!Mailbox_PostTunings(&((text_ctx_t *)arg)->w->mailbox[loop], v[0], v[1], v[2], P_ON_E)) {
+        net_metric_add(((text_ctx_t *)arg)->w->shard, m_busy, 1);
+        return text_reply(arg, PROTO_ACK_BUSY);
+    }
+    return text_reply(arg, PROTO_ACK_OK);
+}
+
+static int text_limits(const net_cmd_t *cmd, void *arg)
+{
+    long loop;
+    double v[2];
+    if (!text_args(cmd, &loop, v, 2) || !(v[0] < v[1])) {
+        return text_reply(arg, PROTO_ACK_BAD_REQUEST);
+    }
+    if (!Mailbox_PostLimits(&((text_ctx_t *)arg)->w->mailbox[loop], v[0], v[1])) {
+        net_metric_add(((text_ctx_t *)arg)->w->shard, m_busy, 1);
+        return text_reply(arg, PROTO_ACK_BUSY);
+    }
+    return text_reply(arg, PROTO_ACK_OK);
+}
+
+static int text_mode(const net_cmd_t *cmd, void *arg)
+{
+    long loop;
+    double v[1];
+    if (!text_args(cmd, &loop, v, 1) || (v[0] != MANUAL && v[0] != AUTOMATIC)) {
+        return text_reply(arg, PROTO_ACK_BAD_REQUEST);
+    }
+    if (!Mailbox_PostMode(&((text_ctx_t *)arg)->w->mailbox[loop], (int)v[0])) {
+        net_metric_add(((text_ctx_t *)arg)->w->shard, m_busy, 1);
+        return text_reply(arg, PROTO_ACK_BUSY);
+    }
+    return text_reply(arg, PROTO_ACK_OK);
+}
+
+static int text_ping(const net_cmd_t *cmd, void *arg)
+{
+    return text_reply(arg, PROTO_ACK_OK);
+}
+
+static int text_reject(const net_cmd_t *cmd, void *arg)
+{
+    return text_reply(arg, PROTO_ACK_BAD_REQUEST);
+}
+
+static const net_cmd_def_t text_defs[] = {
+    { "SP", text_setpoint, 2 },         /* SP <loop> <setpoint> */
+    { "GAINS", text_gains, 4 },         /* GAINS <loop> <kp> <ki> <kd> */
+    { "LIMITS", text_limits, 3 },       /* LIMITS <loop> <min> <max> */
+    { "MODE", text_mode, 2 },           /* MODE <loop> <0|1> */
+    { "PING", text_ping, 0 },
+};
+
+static void text_open(net_server_t *srv, net_conn_t *conn)
+{
+    conn->user = &((worker_t *)srv->handlers.ctx)->text_parsers[conn - srv->conns];
+    net_cmd_parser_init(conn->user);
+}
+
+static size_t text_data(net_server_t *srv, net_conn_t *conn, const uint8_t *data, size_t len)
+{
+    size_t used;
+    if (web_data(srv, conn, data, len, &used)) {
+        return used;
+    }
+    text_ctx_t ctx = { srv, conn, srv->handlers.ctx };
+    return net_cmd_feed(conn->user, &text_table, data, len, &ctx);
+}
+
+static void conn_close(net_server_t *srv, net_conn_t *conn)
+{
+    net_ws_close(&((worker_t *)srv->handlers.ctx)->ws, conn);
+    net_pubsub_unsubscribe(&((worker_t *)srv->handlers.ctx)->pubsub, conn);
+    if (__atomic_load_n(&tuning_owner, __ATOMIC_ACQUIRE) == conn) {
+        __atomic_store_n(&tuning_owner, NULL, __ATOMIC_RELEASE);
+        Tuning_Abort(&tuning);
+    }
+}
+
+static void *worker_run(void *arg)
+{
+    worker_t *w = arg;
+    while (!stop) {
+        drain_samples(w);
+        int64_t wait_us = net_ws_poll(&w->ws, net_time_us());
+        net_server_poll(&w->server, wait_us < 100000 ? (int)(wait_us + 999) / 1000 : 100);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    uint16_t port = argc > 1 ? (uint16_t)atoi(argv[1]) : PORT;
+    bool tecsci = argc > 2 && !strcmp(argv[2], "tecsci");
+    bool text = argc > 2 && !strcmp(argv[2], "text");
+    nworkers = argc > 3 ? atoi(argv[3]) : 1;
+    if (nworkers < 1 || nworkers > MAX_WORKERS) {
+        fprintf(stderr, "usage: %s [port] [echo|tecsci|text] [workers, 1..%d]\n", argv[0], MAX_WORKERS);
+        return 2;
+    }
+    pthread_t control;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    net_cmd_table_init(&text_table, text_defs, sizeof(text_defs) / sizeof(text_defs[0]));
+    text_table.reject = text_reject;
+    workers = calloc((size_t)nworkers, sizeof(worker_t));
+    if (workers == NULL) {
+        return 1;
+    }
+    for (int i = 0; i < nworkers; i++) {
+        const net_handlers_t handlers = {
+            .on_open = text ? text_open : NULL,
+            .on_data = tecsci ? tecsci_data : text ? text_data : echo_data,
+            .on_close = conn_close,
+            .ctx = &workers[i],
+        };
+        int err = nworkers == 1 ? net_server_init(&workers[i].server, port, &handlers)
+                                : net_server_init_reuseport(&workers[i].server, port, &handlers);
+        if (err != 0) {
+            return 1;
+        }
+    }
+    register_metrics();
+    for (int i = 0; i < nworkers; i++) {
+        net_ws_init(&workers[i].ws, &workers[i].server, LOOP_PERIOD_MS);
+        net_pubsub_init(&workers[i].pubsub, &workers[i].server);
+        workers[i].shard = net_metrics_shard(&metrics);
+    }
+    start_control(&control);
+
+    /* worker 0 is this thread; with more than one, each is pinned to a core of its own */
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 0; i < nworkers; i++) {
+        workers[i].thread = i == 0 ? pthread_self() : 0;
+        if (i > 0) {
+            pthread_create(&workers[i].thread, NULL, worker_run, &workers[i]);
+        }
+        if (nworkers > 1) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET((int)(i % (ncpu > 0 ? ncpu : 1)), &set);
+            pthread_setaffinity_np(workers[i].thread, sizeof(set), &set);
+        }
+    }
+    worker_run(&workers[0]);
+    for (int i = 1; i < nworkers; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    pthread_join(control, NULL);
+
+    net_server_stats_t st = { 0 };
+    net_ws_stats_t ws = { 0 };
+    uint32_t ring_dropped = 0;
+    char per_worker[16 * MAX_WORKERS] = "", *pw = per_worker;
+    for (int i = 0; i < nworkers; i++) {
+        const worker_t *w = &workers[i];
+        st.accepted += w->server.stats.accepted;
+        st.rejected += w->server.stats.rejected;
+        st.bytes_in += w->server.stats.bytes_in;
+        st.bytes_out += w->server.stats.bytes_out;
+        st.tx_overflows += w->server.stats.tx_overflows;
+        ws.upgrades += w->ws.stats.upgrades;
+        ws.messages += w->ws.stats.messages;
+        ws.deliveries += w->ws.stats.deliveries;
+        ws.drops += w->ws.stats.drops;
+        ws.samples += w->ws.stats.samples;
+        ws.samples_dropped += w->ws.stats.samples_dropped;
+        ring_dropped += w->ring_dropped;
+        pw += snprintf(pw, per_worker + sizeof(per_worker) - pw, " %u", (unsigned)w->server.stats.accepted);
+    }
+    NET_LOGI(TAG, "accepted %u, rejected %u, in %llu bytes, out %llu bytes, tx overflows %u, scrapes %u",
+             (unsigned)st.accepted, (unsigned)st.rejected, (unsigned long long)st.bytes_in,
+             (unsigned long long)st.bytes_out, (unsigned)st.tx_overflows, (unsigned)metrics.scrapes);
+    if (nworkers > 1) {
+        NET_LOGI(TAG, "connections accepted per worker:%s", per_worker);
+    }
+    NET_LOGI(TAG, "websocket: %u upgrades, %u messages, %u deliveries, %u dropped, %u samples (%u lost)",
+             (unsigned)ws.upgrades, (unsigned)ws.messages, (unsigned)ws.deliveries, (unsigned)ws.drops,
+             (unsigned)ws.samples, (unsigned)(ws.samples_dropped + ring_dropped));
+    for (int i = 0; i < nworkers; i++) {
+        net_server_deinit(&workers[i].server);
+    }
+    free(workers);
+    return 0;
+}
@@ -0,0 +1,355 @@
+/* WebSocket test client for the dip-coater live plot stream
+
+   Opens N WebSocket connections to GET /ws (tcp_server_linux, net_ws.h), checks the
+   handshake answer, and reads the binary messages the way the browser dashboard does:
+   each one is unpacked into its tecsci_proto telemetry frames and the samples are
+   counted.  Once a second every connection sends a masked ping and a masked text message,
+   so the server's unmasking is exercised too; the pong has to carry the ping's payload
+   back.
+
+   -z makes that many of the connections stop reading after the handshake: their socket
+   buffers fill and the server has to drop messages for them instead of growing a queue.
+   With -s the server's CPU time (utime + stime from /proc) and resident memory are read
+   before and after the run.
+
+   build: gcc -O2 -I../components/tecsci_net -o ws_client ws_client.c \
+              ../components/tecsci_net/net_ws.c ../components/tecsci_net/net_server.c \
+              ../components/tecsci_net/net_buf.c ../components/tecsci_net/tecsci_proto.c -lm
+   usage: ws_client [-h host] [-p port] [-c connections] [-d seconds] [-z stalled]
+                    [-s server_pid]
+*/
+#define _GNU_SOURCE            /* memmem */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "net_ws.h"
+#include "tecsci_proto.h"
+
+#define RX_BUF 65536
+
+typedef struct {
+    int fd;
+    bool open;                          /* handshake answered */
+    bool stalled;
+    bool dead;
+    size_t rx_len;
+    uint8_t rx[RX_BUF];
+    char accept[29];
+    uint32_t ping_seq;
+    int64_t last_msg_us;
+} client_t;
+
+static uint64_t messages, frames, samples, bytes, pongs, bad_pongs, errors;
+static uint64_t gaps[1 << 20];
+static size_t ngaps;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t rng_state = 2463534242u;
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* utime + stime in seconds and VmRSS in kB of a process */
+static bool proc_usage(int pid, double *cpu_s, long *rss_kb)
+{
+    char path[64], buf[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return false;
+    }
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = 0;
+    /* fields after the command name, which is in parentheses and may hold spaces */
+    char *p = strrchr(buf, ')');
+    unsigned long ut = 0, st = 0;
+    if (p == NULL || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &ut, &st) != 2) {
+        return false;
+    }
+    *cpu_s = (double)(ut + st) / sysconf(_SC_CLK_TCK);
+
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    f = fopen(path, "r");
+    *rss_kb = 0;
+    while (f && fgets(buf, sizeof(buf), f)) {
+        if (sscanf(buf, "VmRSS: %ld", rss_kb) == 1) {
+            break;
+        }
+    }
+    if (f) {
+        fclose(f);
+    }
+    return true;
+}
+
+/* a masked client frame, as browsers send them */
+static void send_frame(client_t *c, uint8_t opcode, const void *data, size_t len)
+{
+    uint8_t frame[NET_WS_HEADER_MAX + 4 + 125];
+    size_t h = net_ws_header(frame, opcode, len);
+    frame[1] |= 0x80;
+    uint32_t key = rng();
+    memcpy(frame + h, &key, 4);
+    memcpy(frame + h + 4, data, len);
+    net_ws_mask(frame + h + 4, len, frame + h);
+    if (send(c->fd, frame, h + 4 + len, MSG_NOSIGNAL) < 0) {
+        c->dead = true;
+    }
+}
+
+static void handshake(client_t *c, const char *host)
+{
+    uint8_t raw[16];
+    char key[25], req[512];
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (int i = 0; i < 16; i++) {
+        raw[i] = (uint8_t)rng();
+    }
+    char *o = key;
+    for (int i = 0; i < 16; i += 3) {
+        uint32_t v = (uint32_t)raw[i] << 16 | (i + 1 < 16 ? (uint32_t)raw[i + 1] << 8 : 0) |
+                     (i + 2 < 16 ? raw[i + 2] : 0);
+        *o++ = b64[(v >> 18) & 63];
+        *o++ = b64[(v >> 12) & 63];
+        *o++ = i + 1 < 16 ? b64[(v >> 6) & 63] : '=';
+        *o++ = i + 2 < 16 ? b64[v & 63] : '=';
+    }
+    *o = 0;
+    net_ws_accept_key(key, strlen(key), c->accept);
+    int n = snprintf(req, sizeof(req), "GET /ws HTTP/1.1\r\nHost: %s\r\nUpgrade: websocket\r\n"
+                     "Connection: Upgrade\r\nSec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n",
+                     host, key);
+    send(c->fd, req, (size_t)n, MSG_NOSIGNAL);
+}
+
+static void on_message(client_t *c, uint8_t opcode, const uint8_t *p, size_t len, int64_t now)
+{
+    if (opcode == NET_WS_OP_PONG) {
+        uint32_t seq;
+        if (len == sizeof(seq) && (memcpy(&seq, p, sizeof(seq)), seq == c->ping_seq)) {
+            pongs++;
+        } else {
+            bad_pongs++;
+        }
+        return;
+    }
+    if (opcode != NET_WS_OP_BINARY) {
+        return;
+    }
+    messages++;
+    if (c->last_msg_us && ngaps < sizeof(gaps) / sizeof(gaps[0])) {
+        gaps[ngaps++] = (uint64_t)(now - c->last_msg_us);
+    }
+    c->last_msg_us = now;
+    size_t used = 0;
+    while (used < len) {
+        proto_frame_t f;
+        int n = proto_parse(p + used, len - used, &f);
+        uint8_t loop, count;
+        uint16_t period;
+        uint32_t t0;
+        if (n <= 0 || !proto_read_telemetry(&f, &loop, &count, &period, &t0)) {
+            errors++;
+            return;
+        }
+        frames++;
+        samples += count;
+        used += (size_t)n;
+    }
+}
+
+static void consume(client_t *c, int64_t now)
+{
+    size_t used = 0;
+    if (!c->open) {
+        const char *end = memmem(c->rx, c->rx_len, "\r\n\r\n", 4);
+        if (end == NULL) {
+            return;
+        }
+        c->rx[end - (char *)c->rx] = 0;
+        if (strncmp((char *)c->rx, "HTTP/1.1 101", 12) != 0 || strstr((char *)c->rx, c->accept) == NULL) {
+            fprintf(stderr, "handshake refused: %.40s\n", (char *)c->rx);
+            c->dead = true;
+            return;
+        }
+        c->open = true;
+        used = (size_t)(end + 4 - (char *)c->rx);
+    }
+    while (c->rx_len - used >= 2) {
+        const uint8_t *f = c->rx + used;
+        uint64_t len = f[1] & 0x7f;
+        size_t h = 2;
+        if (len == 126) {
+            if (c->rx_len - used < 4) {
+                break;
+            }
+            len = (uint64_t)f[2] << 8 | f[3];
+            h = 4;
+        } else if (len == 127) {
+            if (c->rx_len - used < 10) {
+                break;
+            }
+            len = 0;
+            for (int i = 0; i < 8; i++) {
+                len = len << 8 | f[2 + i];
+            }
+            h = 10;
+        }
+        if (c->rx_len - used < h + len) {
+            break;
+        }
+        on_message(c, f[0] & 0x0f, f + h, (size_t)len, now);
+        used += h + (size_t)len;
+    }
+    memmove(c->rx, c->rx + used, c->rx_len - used);
+    c->rx_len -= used;
+}
+
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1";
+    int port = 3333, conns = 10, duration = 10, stalled = 0, server_pid = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-h")) host = argv[i + 1];
+        else if (!strcmp(argv[i], "-p")) port = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-c")) conns = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-d")) duration = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-z")) stalled = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-s")) server_pid = atoi(argv[i + 1]);
+    }
+    if (conns < 1 || stalled < 0 || stalled > conns || duration < 1) {
+        fprintf(stderr, "usage: %s [-h host] [-p port] [-c connections] [-d seconds] [-z stalled]\n"
+                "       [-s server_pid]\n", argv[0]);
+        return 2;
+    }
+
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+    inet_pton(AF_INET, host, &addr.sin_addr);
+    client_t *cl = calloc(conns, sizeof(client_t));
+    int ep = epoll_create1(0);
+
+    for (int i = 0; i < conns; i++) {
+        cl[i].fd = socket(AF_INET, SOCK_STREAM, 0);
+        cl[i].stalled = i < stalled;
+        if (cl[i].stalled) {
+            /* a small window, so the server runs into its queue limit rather than ours */
+            int rcvbuf = 4096;
+            setsockopt(cl[i].fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        }
+        if (connect(cl[i].fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            fprintf(stderr, "connect %d failed: %s\n", i, strerror(errno));
+            return 1;
+        }
+        int one = 1;
+        setsockopt(cl[i].fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)i };
+        epoll_ctl(ep, EPOLL_CTL_ADD, cl[i].fd, &ev);
+        handshake(&cl[i], host);
+    }
+
+    double cpu0 = 0, cpu1 = 0;
+    long rss0 = 0, rss1 = 0;
+    bool have_server = server_pid > 0 && proc_usage(server_pid, &cpu0, &rss0);
+    struct rusage ru0, ru1;
+    getrusage(RUSAGE_SELF, &ru0);
+
+    int64_t start = now_us(), end = start + (int64_t)duration * 1000000, next_ping = start + 1000000;
+    int64_t now = start;
+    while (now < end) {
+        struct epoll_event evs[256];
+        int n = epoll_wait(ep, evs, 256, 100);
+        now = now_us();
+        for (int k = 0; k < n; k++) {
+            client_t *c = &cl[evs[k].data.u32];
+            if (c->dead) {
+                continue;
+            }
+            /* a stalled client only takes the handshake answer, then stops reading */
+            if (c->stalled && c->open) {
+                struct epoll_event ev = { 0 };
+                epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, &ev);
+                continue;
+            }
+            ssize_t r = recv(c->fd, c->rx + c->rx_len, RX_BUF - c->rx_len, 0);
+            if (r <= 0) {
+                c->dead = true;
+                continue;
+            }
+            bytes += (uint64_t)r;
+            c->rx_len += (size_t)r;
+            consume(c, now);
+        }
+        if (now >= next_ping) {
+            next_ping += 1000000;
+            for (int i = 0; i < conns; i++) {
+                client_t *c = &cl[i];
+                if (c->open && !c->stalled && !c->dead) {
+                    c->ping_seq++;
+                    send_frame(c, NET_WS_OP_PING, &c->ping_seq, sizeof(c->ping_seq));
+                    send_frame(c, NET_WS_OP_TEXT, "plot 0 1 2 3", 12);
+                }
+            }
+        }
+    }
+    double secs = (now - start) / 1e6;
+    getrusage(RUSAGE_SELF, &ru1);
+    if (have_server) {
+        have_server = proc_usage(server_pid, &cpu1, &rss1);
+    }
+
+    int open = 0, dead = 0, readers = 0;
+    for (int i = 0; i < conns; i++) {
+        open += cl[i].open;
+        dead += cl[i].dead;
+        readers += cl[i].open && !cl[i].stalled;
+    }
+    qsort(gaps, ngaps, sizeof(gaps[0]), cmp_u64);
+    printf("connections   %d open, %d stalled, %d closed\n", open, stalled, dead);
+    printf("messages/s    %.1f per reading client (%.0f total)\n",
+           readers ? messages / secs / readers : 0, messages / secs);
+    printf("frames/s      %.0f telemetry frames, %.0f samples/s, %.2f MB/s\n",
+           frames / secs, samples / secs, bytes / secs / 1e6);
+    if (ngaps) {
+        printf("interval      p50 %.1f ms, p99 %.1f ms, max %.1f ms\n", gaps[ngaps / 2] / 1e3,
+               gaps[ngaps * 99 / 100] / 1e3, gaps[ngaps - 1] / 1e3);
+    }
+    printf("pongs         %llu ok, %llu wrong; %llu bad messages\n", (unsigned long long)pongs,
+           (unsigned long long)bad_pongs, (unsigned long long)errors);
+    double own = (ru1.ru_utime.tv_sec - ru0.ru_utime.tv_sec + ru1.ru_stime.tv_sec - ru0.ru_stime.tv_sec) +
+                 (ru1.ru_utime.tv_usec - ru0.ru_utime.tv_usec + ru1.ru_stime.tv_usec - ru0.ru_stime.tv_usec) / 1e6;
+    printf("client cpu    %.1f%% of one core\n", 100 * own / secs);
+    if (have_server) {
+        printf("server cpu    %.1f%% of one core, rss %ld -> %ld kB\n", 100 * (cpu1 - cpu0) / secs, rss0, rss1);
+    }
+    return errors || bad_pongs ? 1 : 0;
+}